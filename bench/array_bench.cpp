@@ -0,0 +1,148 @@
+#include <fmt/format.h>
+
+#include "bench.hpp"
+
+namespace FLLua {
+
+// The same 128-element chains as llx.List methods and as ctx.array
+// kernels. Array chains start from fill(0):add(source), a copy that
+// allocates nothing; one operation is one chain.
+static constexpr char kScript[] = R"lua(
+local llx = require('llx')
+local List = llx.List
+
+local size = 128
+local values, lut = {}, {}
+for i = 1, size do
+  values[i] = (i * 37) % 128
+  lut[i] = math.floor(127 * ((i - 1) / 127) ^ 0.6)
+end
+-- Nearest scale tone, ties going down, as the quantize kernel does
+local major = { 0, 2, 4, 5, 7, 9, 11 }
+local in_scale, shift = {}, {}
+for _, pc in ipairs(major) do in_scale[pc] = true end
+for pc = 0, 11 do
+  for d = 0, 6 do
+    if in_scale[(pc - d) % 12] then shift[pc] = -d break end
+    if in_scale[(pc + d) % 12] then shift[pc] = d break end
+  end
+end
+
+local list = List(values)
+local source = ctx.array(values, 'f32')
+local work = ctx.array(size, 'f32')
+local curve = ctx.array(lut, 'f32')
+local out = {}
+
+local function soften(v) return v * 0.8 end
+local function limit(v) return math.max(20, math.min(110, v)) end
+local function through_curve(v) return lut[math.floor(v) + 1] end
+local function quantize(v) return v + shift[math.floor(v) % 12] end
+
+cases = {}
+
+-- Scale, clamp, sum
+function cases.list_scale(ops)
+  for _ = 1, ops do
+    list:map(soften):map(limit):sum()
+  end
+end
+
+function cases.array_scale(ops)
+  for _ = 1, ops do
+    work:fill(0):add(source):scale(0.8):clamp(20, 110):sum()
+  end
+end
+
+-- Velocity curve lookup
+function cases.list_lookup(ops)
+  for _ = 1, ops do
+    list:map(through_curve)
+  end
+end
+
+function cases.array_lookup(ops)
+  for _ = 1, ops do
+    work:fill(0):add(source):lookup(curve)
+  end
+end
+
+-- Quantize to C major
+function cases.list_quantize(ops)
+  for _ = 1, ops do
+    list:map(quantize)
+  end
+end
+
+function cases.array_quantize(ops)
+  for _ = 1, ops do
+    work:fill(0):add(source):quantize(major)
+  end
+end
+
+-- Index of the loudest step
+function cases.list_argmax(ops)
+  for _ = 1, ops do
+    local top = list:max()
+    list:find_index(function(v) return v == top end)
+  end
+end
+
+function cases.array_argmax(ops)
+  for _ = 1, ops do
+    source:argmax()
+  end
+end
+
+-- Element reads from Lua
+function cases.list_index(ops)
+  for _ = 1, ops do
+    local total = 0
+    for i = 1, size do total = total + list[i] end
+  end
+end
+
+function cases.array_index(ops)
+  for _ = 1, ops do
+    local total = 0
+    for i = 1, size do total = total + source[i] end
+  end
+end
+
+-- Round trip through a Lua table. List(values) adopts the table, so the
+-- baseline copies element by element.
+function cases.table_convert(ops)
+  for _ = 1, ops do
+    local copy = {}
+    for i = 1, size do copy[i] = values[i] end
+    for i = 1, size do out[i] = copy[i] end
+  end
+end
+
+function cases.array_convert(ops)
+  for _ = 1, ops do
+    work:load(values):to_table(out)
+  end
+end
+)lua";
+
+void benchArray(const BenchOptions& options) {
+  printHeader("array: 128-element llx.List chains and ctx.array kernels");
+  ScriptBench bench(options, kScript);
+  if (!bench.error().empty()) {
+    fmt::print("  {}\n", bench.error());
+    return;
+  }
+
+  constexpr int64_t kChains = 1000;
+  for (const char* chain : {"scale", "lookup", "quantize", "argmax", "index"}) {
+    bench.time(fmt::format("{} llx.List", chain),
+               fmt::format("list_{}", chain), kChains);
+    bench.time(fmt::format("{} ctx.array", chain),
+               fmt::format("array_{}", chain), kChains);
+  }
+  bench.time("convert table copy loops", "table_convert", kChains);
+  bench.time("convert ctx.array load + to_table", "array_convert", kChains);
+}
+
+}  // namespace FLLua
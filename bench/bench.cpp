@@ -0,0 +1,129 @@
+#include "bench.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <variant>
+
+namespace FLLua {
+
+namespace {
+
+// Bytes one case call allocates, measured with the collector stopped
+constexpr char kAllocationProbe[] = R"lua(
+function bench_allocated(name, ops)
+  collectgarbage('collect')
+  collectgarbage('stop')
+  local before = collectgarbage('count')
+  cases[name](ops)
+  local after = collectgarbage('count')
+  collectgarbage('restart')
+  return (after - before) * 1024
+end
+)lua";
+
+double toNumber(const PlainValue& value) {
+  if (auto* number = std::get_if<double>(&value.value)) return *number;
+  if (auto* integer = std::get_if<int64_t>(&value.value)) {
+    return static_cast<double>(*integer);
+  }
+  return -1.0;
+}
+
+}  // namespace
+
+ScriptBench::ScriptBench(const BenchOptions& options,
+                         const std::string& source)
+    : m_seconds(options.seconds) {
+  m_context.eventQueue = &m_events;
+  m_context.logQueue = &m_log;
+  m_context.scheduledNoteOffs = &m_noteOffs;
+  m_context.transport.playing = true;
+  m_context.transport.blockSize = 512;
+  m_noteOffs.reserve(8192);
+
+  if (!m_engine.init(&m_context, options.luaLibsPath)) {
+    m_error = "could not create a Lua state";
+    return;
+  }
+  m_engine.setInterrupt([] { return false; });
+  m_error = m_engine.loadScript(source + kAllocationProbe);
+}
+
+void ScriptBench::time(const std::string& label, const std::string& name,
+                       int64_t ops) {
+  if (!m_error.empty()) return;
+
+  // Draining what the call queued, as the audio thread would, is timed too
+  std::string function = "cases." + name;
+  std::vector<PlainValue> args{PlainValue{ops}};
+  PlainValue result;
+  std::string error;
+  double seconds = medianSeconds(m_seconds, [&] {
+    if (error.empty()) error = m_engine.callJob(function, args, result);
+    drain();
+  });
+  if (!error.empty()) {
+    fmt::print("  {:<36} {}\n", label, error);
+    return;
+  }
+
+  PlainValue bytes;
+  error = m_engine.callJob("bench_allocated",
+                           {PlainValue{name}, PlainValue{ops}}, bytes);
+  drain();
+  double perOp = 1.0 / static_cast<double>(ops);
+  printRow(label, seconds * perOp,
+           error.empty() ? toNumber(bytes) * perOp : -1.0);
+}
+
+std::string ScriptBench::call(const std::string& name,
+                              const std::vector<PlainValue>& args) {
+  if (!m_error.empty()) return m_error;
+  PlainValue result;
+  auto error = m_engine.callJob("cases." + name, args, result);
+  drain();
+  return error;
+}
+
+void ScriptBench::drain() {
+  MidiEvent event;
+  while (m_events.try_dequeue(event)) {
+  }
+  m_noteOffs.clear();
+  std::string line;
+  while (m_log.try_dequeue(line)) {
+  }
+}
+
+double medianSeconds(double seconds, const std::function<void()>& body) {
+  using Clock = std::chrono::steady_clock;
+  body();
+
+  std::vector<double> samples;
+  auto end = Clock::now() + std::chrono::duration<double>(seconds);
+  while (samples.size() < 5 || Clock::now() < end) {
+    auto start = Clock::now();
+    body();
+    samples.push_back(
+        std::chrono::duration<double>(Clock::now() - start).count());
+  }
+  auto middle = samples.begin() + samples.size() / 2;
+  std::nth_element(samples.begin(), middle, samples.end());
+  return *middle;
+}
+
+void printRow(const std::string& label, double secondsPerOp,
+              double bytesPerOp) {
+  fmt::print("  {:<36} {:>10.1f} ns/op {:>10.1f} ops/ms", label,
+             secondsPerOp * 1e9, 1e-3 / secondsPerOp);
+  if (bytesPerOp >= 0.0) fmt::print(" {:>10.1f} B/op", bytesPerOp);
+  fmt::print("\n");
+}
+
+void printHeader(const std::string& suite) {
+  fmt::print("{}\n", suite);
+}
+
+}  // namespace FLLua
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "events/event_queue.hpp"
+#include "lua/api.hpp"
+#include "lua/engine.hpp"
+
+namespace FLLua {
+
+struct BenchOptions {
+  std::string luaLibsPath;
+  double seconds = 0.25;  // Timed per case, after one warm-up call
+};
+
+// A Lua state set up the way a layer's worker states are: the full ctx API
+// and bundled libraries, no async runner (so worker-only APIs run) and no
+// instruction cap. The script defines its cases as functions in a global
+// `cases` table; each takes the number of operations to perform.
+class ScriptBench {
+ public:
+  ScriptBench(const BenchOptions& options, const std::string& source);
+
+  // Empty once the script loaded
+  const std::string& error() const { return m_error; }
+
+  // Call cases[name](ops) repeatedly and print the median time and the
+  // Lua heap bytes allocated per operation
+  void time(const std::string& label, const std::string& name, int64_t ops);
+
+  // Call cases[name](args...) once, untimed
+  std::string call(const std::string& name,
+                   const std::vector<PlainValue>& args = {});
+
+ private:
+  void drain();
+
+  double m_seconds;
+  std::string m_error;
+  PluginContext m_context;
+  MidiEventQueue m_events{8192};
+  LogQueue m_log;
+  std::vector<ScheduledNoteOff> m_noteOffs;
+  LuaEngine m_engine;
+};
+
+// Median of the timed calls, in seconds. Calls `body` once to warm up,
+// then until `seconds` pass (at least five times).
+double medianSeconds(double seconds, const std::function<void()>& body);
+
+// One result line: label, time per operation, operations per millisecond
+// and, when known, bytes allocated per operation
+void printRow(const std::string& label, double secondsPerOp,
+              double bytesPerOp = -1.0);
+
+void printHeader(const std::string& suite);
+
+// Suites, one per feature
+void benchEvents(const BenchOptions& options);
+void benchSolver(const BenchOptions& options);
+void benchDiskCache(const BenchOptions& options);
+void benchStream(const BenchOptions& options);
+void benchArray(const BenchOptions& options);
+
+}  // namespace FLLua
@@ -0,0 +1,105 @@
+#include <fmt/format.h>
+
+#include <chrono>
+
+#include "bench.hpp"
+#include "lua/disk_cache.hpp"
+
+namespace FLLua {
+
+// A project whose scripts keep `ops` solved melodies in ctx.cache, loaded
+// cold (every key misses and is solved) and warm (every key is read back
+// from disk). Cold keys carry a new generation on every call so they never
+// hit; the run id keeps them apart from earlier runs.
+static constexpr char kScript[] = R"lua(
+local llx = require('llx')
+local musica = require('musica')
+
+local run_id
+local generation = 0
+
+local function solve(key)
+  local generator = musica.Generator({
+    rules = {
+      musica.PitchRangeRule({ min_pitch = 55, max_pitch = 76 }),
+      musica.MaxIntervalRule({ max_semitones = 4 }),
+      musica.InScaleRule({
+        scale = musica.Scale(musica.Pitch.c4, musica.Mode.major),
+      }),
+      musica.StartOnPitchRule({ pitch = 60 }),
+      musica.EndOnPitchRule({ pitch = 60 }),
+      musica.TotalDurationRule({ exact_total = 8 }),
+    },
+    context = { num_notes = 8 },
+    seed = key.seed,
+    budget = 10,
+  })
+  local notes = {}
+  for i, note in ipairs(generator:generate_one().notes) do
+    notes[i] = { pitch = llx.tointeger(note.pitch), duration = note.duration }
+  end
+  return notes
+end
+
+local function load_project(tag, ops, expect_hit)
+  for seed = 1, ops do
+    local key = { 'fl-lua-bench', run = run_id, tag = tag, seed = seed }
+    local _, hit = ctx.cache.get_or_compute(key, solve)
+    if expect_hit ~= nil and hit ~= expect_hit then
+      error(hit and 'unexpected cache hit' or 'unexpected cache miss')
+    end
+  end
+end
+
+cases = {}
+
+function cases.start(id)
+  run_id = id
+end
+
+function cases.cold(ops)
+  generation = generation + 1
+  load_project(generation, ops, false)
+end
+
+function cases.fill(ops)
+  load_project('warm', ops)
+end
+
+function cases.warm(ops)
+  load_project('warm', ops, true)
+end
+)lua";
+
+void benchDiskCache(const BenchOptions& options) {
+  printHeader("cache: project load with ctx.cache.get_or_compute");
+  ScriptBench bench(options, kScript);
+  if (!bench.error().empty()) {
+    fmt::print("  {}\n", bench.error());
+    return;
+  }
+
+  // The writer thread stores misses; releasing it flushes queued writes
+  auto& cache = DiskCache::instance();
+  cache.retain();
+  auto runId = static_cast<int64_t>(
+      std::chrono::system_clock::now().time_since_epoch().count());
+  constexpr int64_t kEntries = 8;
+  std::string error = bench.call("start", {PlainValue{runId}});
+  if (error.empty()) error = bench.call("fill", {PlainValue{kEntries}});
+  cache.release();
+  cache.retain();
+  if (!error.empty()) {
+    fmt::print("  {}\n", error);
+    cache.release();
+    return;
+  }
+
+  bench.time(fmt::format("cold load, {} entries", kEntries), "cold",
+             kEntries);
+  bench.time(fmt::format("warm load, {} entries", kEntries), "warm",
+             kEntries);
+  cache.release();
+}
+
+}  // namespace FLLua
@@ -0,0 +1,89 @@
+#include <fmt/format.h>
+
+#include "bench.hpp"
+
+namespace FLLua {
+
+// The same notes submitted one ctx.note call at a time, as ctx.notes
+// tuples, as one ctx.chord, and through an event buffer that is refilled
+// or re-sent. Notes go out in groups of `size`: a chord, then a drum fill.
+static constexpr char kScript[] = R"lua(
+cases = {}
+
+local function define(size)
+  local pitches, tuples = {}, {}
+  for i = 1, size do
+    pitches[i] = 36 + (i * 7) % 60
+    tuples[i] = { pitches[i], 100, 0.25 }
+  end
+  local buffer = ctx.event_buffer(size)
+
+  cases['note_' .. size] = function(ops)
+    for _ = 1, ops // size do
+      for i = 1, size do
+        ctx.note(pitches[i], 100, 0.25)
+      end
+    end
+  end
+
+  cases['notes_' .. size] = function(ops)
+    for _ = 1, ops // size do
+      ctx.notes(tuples)
+    end
+  end
+
+  cases['chord_' .. size] = function(ops)
+    for _ = 1, ops // size do
+      ctx.chord(pitches, 100, 0.25)
+    end
+  end
+
+  cases['fill_emit_' .. size] = function(ops)
+    for _ = 1, ops // size do
+      buffer:clear()
+      for i = 1, size do
+        buffer:note(pitches[i], 100, 0.25)
+      end
+      ctx.emit(buffer)
+    end
+  end
+
+  cases['emit_' .. size] = function(ops)
+    buffer:clear()
+    for i = 1, size do
+      buffer:note(pitches[i], 100, 0.25)
+    end
+    for _ = 1, ops // size do
+      ctx.emit(buffer)
+    end
+  end
+end
+
+define(4)
+define(32)
+)lua";
+
+void benchEvents(const BenchOptions& options) {
+  printHeader("events: notes submitted per call");
+  ScriptBench bench(options, kScript);
+  if (!bench.error().empty()) {
+    fmt::print("  {}\n", bench.error());
+    return;
+  }
+
+  constexpr int64_t kNotes = 1024;
+  for (int size : {4, 32}) {
+    auto suffix = fmt::format("_{}", size);
+    auto label = [&](const char* what) {
+      return fmt::format("{} x{}", what, size);
+    };
+    bench.time(label("ctx.note loop"), "note" + suffix, kNotes);
+    bench.time(label("ctx.notes"), "notes" + suffix, kNotes);
+    bench.time(label("ctx.chord"), "chord" + suffix, kNotes);
+    bench.time(label("buffer fill + ctx.emit"), "fill_emit" + suffix,
+               kNotes);
+    bench.time(label("ctx.emit prefilled buffer"), "emit" + suffix, kNotes);
+  }
+}
+
+}  // namespace FLLua
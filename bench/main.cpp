@@ -0,0 +1,72 @@
+#include <fmt/format.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+
+#ifndef FL_LUA_LIBS_DIR
+#define FL_LUA_LIBS_DIR "lua_libs"
+#endif
+
+namespace {
+
+struct Suite {
+  const char* name;
+  void (*run)(const FLLua::BenchOptions&);
+};
+
+constexpr Suite kSuites[] = {
+    {"events", FLLua::benchEvents},
+    {"solver", FLLua::benchSolver},
+    {"cache", FLLua::benchDiskCache},
+    {"stream", FLLua::benchStream},
+    {"array", FLLua::benchArray},
+};
+
+void printUsage() {
+  fmt::print(
+      "usage: fl-lua-bench [--libs <lua_libs>] [--seconds <per case>] "
+      "[suite...]\nsuites:");
+  for (const auto& suite : kSuites) fmt::print(" {}", suite.name);
+  fmt::print("\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  FLLua::BenchOptions options;
+  options.luaLibsPath = FL_LUA_LIBS_DIR;
+  std::vector<std::string> selected;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--libs" && i + 1 < argc) {
+      options.luaLibsPath = argv[++i];
+    } else if (arg == "--seconds" && i + 1 < argc) {
+      options.seconds = std::atof(argv[++i]);
+    } else if (arg.starts_with("-")) {
+      printUsage();
+      return arg == "--help" ? 0 : 1;
+    } else {
+      selected.push_back(arg);
+    }
+  }
+
+  for (const auto& name : selected) {
+    bool known = false;
+    for (const auto& suite : kSuites) known = known || name == suite.name;
+    if (!known) {
+      fmt::print("unknown suite '{}'\n", name);
+      printUsage();
+      return 1;
+    }
+  }
+
+  for (const auto& suite : kSuites) {
+    bool run = selected.empty();
+    for (const auto& name : selected) run = run || name == suite.name;
+    if (run) suite.run(options);
+  }
+  return 0;
+}
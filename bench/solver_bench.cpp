@@ -0,0 +1,101 @@
+#include <fmt/format.h>
+
+#include "bench.hpp"
+
+namespace FLLua {
+
+// musica.generation rule sets on the native solver. generate_one builds
+// the context and translates the rules for every melody; enumeration finds
+// `ops` distinct melodies in one search.
+static constexpr char kScript[] = R"lua(
+local musica = require('musica')
+
+local c_major = musica.Scale(musica.Pitch.c4, musica.Mode.major)
+
+local rule_sets = {
+  -- generated_melody.lua
+  melody = function()
+    return {
+      musica.PitchRangeRule({ min_pitch = 55, max_pitch = 76 }),
+      musica.MaxIntervalRule({ max_semitones = 4 }),
+      musica.InScaleRule({ scale = c_major }),
+      musica.StartOnPitchRule({ pitch = 60 }),
+      musica.EndOnPitchRule({ pitch = 60 }),
+      musica.TotalDurationRule({ exact_total = 8 }),
+      musica.VolumeRangeRule({ min_volume = 0.5, max_volume = 1 }),
+    }
+  end,
+  -- Stepwise rising line that swells
+  ascending = function()
+    return {
+      musica.PitchRangeRule({ min_pitch = 48, max_pitch = 84 }),
+      musica.InScaleRule({ scale = c_major }),
+      musica.MonotonicPitchRule({}),
+      musica.ConjunctMotionRule({ max_step = 2 }),
+      musica.MonotonicVolumeRule({ increasing = true }),
+    }
+  end,
+  -- Starts on the tonic or the fifth
+  disjunction = function()
+    return {
+      musica.PitchRangeRule({ min_pitch = 55, max_pitch = 79 }),
+      musica.MaxIntervalRule({ max_semitones = 3 }),
+      musica.AnyOfRule({
+        rules = {
+          musica.StartOnPitchRule({ pitch = 60 }),
+          musica.StartOnPitchRule({ pitch = 67 }),
+        },
+      }),
+    }
+  end,
+}
+
+cases = {}
+
+for name, rules in pairs(rule_sets) do
+  cases['one_' .. name] = function(ops)
+    for seed = 1, ops do
+      local generator = musica.Generator({
+        rules = rules(),
+        context = { num_notes = 8 },
+        seed = seed,
+        budget = 10,
+      })
+      assert(generator:generate_one(), name .. ': no solution')
+    end
+  end
+
+  cases['all_' .. name] = function(ops)
+    local generator = musica.Generator({
+      rules = rules(),
+      context = { num_notes = 8 },
+      max_solutions = ops,
+      seed = 1,
+      budget = 10,
+    })
+    local count = 0
+    for _ in generator:generate_all() do
+      count = count + 1
+    end
+    assert(count == ops, name .. ': only ' .. count .. ' solutions')
+  end
+end
+)lua";
+
+void benchSolver(const BenchOptions& options) {
+  printHeader("solver: musica.generation melodies of 8 notes");
+  ScriptBench bench(options, kScript);
+  if (!bench.error().empty()) {
+    fmt::print("  {}\n", bench.error());
+    return;
+  }
+
+  for (const char* rules : {"melody", "ascending", "disjunction"}) {
+    bench.time(fmt::format("{}: generate_one", rules),
+               fmt::format("one_{}", rules), 20);
+    bench.time(fmt::format("{}: generate_all", rules),
+               fmt::format("all_{}", rules), 1000);
+  }
+}
+
+}  // namespace FLLua
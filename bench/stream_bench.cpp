@@ -0,0 +1,96 @@
+#include <fmt/format.h>
+
+#include "bench.hpp"
+
+namespace FLLua {
+
+// Common generative chains written with the eager llx.functional
+// combinators and as fused llx.stream pipelines; one operation is one
+// evaluation of the chain
+static constexpr char kScript[] = R"lua(
+local functional = require('llx.functional')
+local stream = require('llx.stream')
+
+local major = {
+  [0] = true, [2] = true, [4] = true, [5] = true, [7] = true, [9] = true,
+  [11] = true,
+}
+local function in_major(step) return major[step % 12] end
+local function to_pitch(step) return 48 + step end
+local function is_even(v) return v % 2 == 0 end
+local function square(v) return v * v end
+local buffer = {}
+
+cases = {}
+
+-- map(f, filter(p, range(64)))
+function cases.eager_map_filter(ops)
+  for _ = 1, ops do
+    functional.map(to_pitch,
+      functional.filter(in_major, functional.range(64)))
+  end
+end
+
+function cases.stream_map_filter(ops)
+  for _ = 1, ops do
+    stream.range(64):filter(in_major):map(to_pitch):to_list()
+  end
+end
+
+function cases.stream_map_filter_into(ops)
+  for _ = 1, ops do
+    stream.range(64):filter(in_major):map(to_pitch):into(buffer)
+  end
+end
+
+-- The first four scale tones from a moving start
+function cases.eager_take(ops)
+  for i = 1, ops do
+    functional.map(to_pitch,
+      functional.filter(in_major, functional.range(i % 7, 24, 2))):take(4)
+  end
+end
+
+function cases.stream_take(ops)
+  for i = 1, ops do
+    stream.range(i % 7, 24, 2):filter(in_major):map(to_pitch):take(4)
+      :into(buffer)
+  end
+end
+
+-- Sum of the squares of the even numbers below 64
+function cases.eager_sum(ops)
+  for _ = 1, ops do
+    functional.sum(functional.map(square,
+      functional.filter(is_even, functional.range(64))))
+  end
+end
+
+function cases.stream_sum(ops)
+  for _ = 1, ops do
+    stream.range(64):filter(is_even):map(square):sum()
+  end
+end
+)lua";
+
+void benchStream(const BenchOptions& options) {
+  printHeader("stream: eager llx.functional chains and llx.stream");
+  ScriptBench bench(options, kScript);
+  if (!bench.error().empty()) {
+    fmt::print("  {}\n", bench.error());
+    return;
+  }
+
+  constexpr int64_t kChains = 1000;
+  bench.time("map(filter(range)) eager", "eager_map_filter", kChains);
+  bench.time("map(filter(range)) stream to_list", "stream_map_filter",
+             kChains);
+  bench.time("map(filter(range)) stream into", "stream_map_filter_into",
+             kChains);
+  bench.time("take 4 scale tones eager", "eager_take", kChains);
+  bench.time("take 4 scale tones stream into", "stream_take", kChains);
+  bench.time("sum of squares eager", "eager_sum", kChains);
+  bench.time("sum of squares stream", "stream_sum", kChains);
+}
+
+}  // namespace FLLua
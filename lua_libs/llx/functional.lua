@@ -79,19 +79,33 @@ end
 -- @param lambda The transformation function
 -- @param ... One or more iterator/sequence arguments
 -- @return List of transformed values
+-- @see llx.stream for lazy pipelines that skip the intermediate lists
 -- @usage
 -- local doubled = map(function(x) return x * 2 end, range(5))
 -- -- Returns List{2, 4, 6, 8}
 function map(lambda, ...)
   local sequences = { ... }
+  local count = #sequences
   local result = List({})
   local controls = {}
   local index = 0
+  if count == 1 then
+    local sequence = sequences[1]
+    local control, value = sequence(nil, nil)
+    while control ~= nil do
+      index = index + 1
+      result[index] = lambda(value)
+      control, value = sequence(nil, control)
+    end
+    return result
+  end
+
+  -- One argument buffer, refilled for every element
+  local values = {}
   while true do
-    local values = List({})
     local control
-    for i, sequence in ipairs(sequences) do
-      control, values[i] = sequence(nil, controls[i])
+    for i = 1, count do
+      control, values[i] = sequences[i](nil, controls[i])
       if control ~= nil then
         controls[i] = control
       else
@@ -102,7 +116,7 @@ function map(lambda, ...)
       break
     end
     index = index + 1
-    result[index] = lambda(unpack(values))
+    result[index] = lambda(unpack(values, 1, count))
   end
   return result
 end
@@ -30,6 +30,7 @@ return require('llx.flatten_submodules')({
   operators = require('llx.operators'),
   property = require('llx.property'),
   proxy = require('llx.proxy'),
+  stream = require('llx.stream'),
   truthy = require('llx.truthy'),
   type_check_decorator = require('llx.type_check_decorator'),
 })
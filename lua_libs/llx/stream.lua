@@ -0,0 +1,443 @@
+-- Copyright 2024 Alexander Ames <Alexander.Ames@gmail.com>
+
+--- Lazy, fused sequence pipelines.
+-- A stream records a source and a chain of stages without running them.
+-- Terminal operations (to_list, reduce, each, ...) push every element
+-- through all stages in a single pass: stages are composed into one sink
+-- per run, so chains like `range(64):filter(p):map(f):to_list()` build no
+-- intermediate lists and allocate nothing per element.
+-- @module llx.stream
+-- @usage
+-- local stream = require('llx.stream')
+-- local notes = stream.range(0, 24)
+--   :filter(function(step) return step % 3 ~= 1 end)
+--   :map(function(step) return 48 + step end)
+--   :into(buffer)  -- Reuses `buffer` between beats
+
+local environment = require('llx.environment')
+local list = require('llx.types.list')
+
+local _ENV, _M = environment.create_module_environment()
+
+local List = list.List
+
+--- Stream: a source and the stages chained onto it.
+-- Each chaining method returns a new stream sharing its parent, so a
+-- partial pipeline can be kept and extended more than once.
+Stream = {}
+Stream.__index = Stream
+
+-- `source(sink)` feeds values to `sink` until it returns true
+local function new_stream(source, parent, stage)
+  return setmetatable({ _source = source, _parent = parent, _stage = stage },
+    Stream)
+end
+
+-- Compose the stages around `sink`, last stage innermost, and run the
+-- source through them
+local function run(stream, sink)
+  local node = stream
+  while node._stage do
+    sink = node._stage(sink)
+    node = node._parent
+  end
+  node._source(sink)
+end
+
+local function chain(stream, stage)
+  return new_stream(nil, stream, stage)
+end
+
+-- Sources ---------------------------------------------------------------------
+
+--- Creates a stream over the array part of a table.
+-- @param t Array or List
+-- @return Stream
+function of(t)
+  return new_stream(function(sink)
+    for i = 1, #t do
+      if sink(t[i]) then
+        return
+      end
+    end
+  end)
+end
+
+--- Creates a stream over a range of numbers.
+-- Same arguments as llx.functional.range; the end value is exclusive.
+-- @param a If only argument: end value (start=1). Otherwise the start value.
+-- @param b End value (exclusive)
+-- @param c Step value (default: 1). Can be negative.
+-- @return Stream
+-- @usage
+-- stream.range(2, 5):to_list()  -- List{2, 3, 4}
+function range(a, b, c)
+  local start = b and a or 1
+  local finish = b or a
+  local step = c or 1
+  if step == 0 then
+    error('range step must not be zero')
+  end
+  return new_stream(function(sink)
+    local i = start
+    if step > 0 then
+      while i < finish do
+        if sink(i) then
+          return
+        end
+        i = i + step
+      end
+    else
+      while i > finish do
+        if sink(i) then
+          return
+        end
+        i = i + step
+      end
+    end
+  end)
+end
+
+--- Creates a stream over an iterator.
+-- Accepts llx.functional iterators and generic-for triples; the second
+-- value of each step is the element, as with `for _, v in ...`.
+-- @param iterator Iterator function
+-- @param state Optional iterator state
+-- @param control Optional initial control value
+-- @return Stream
+function iterate(iterator, state, control)
+  return new_stream(function(sink)
+    local current, value = control, nil
+    while true do
+      current, value = iterator(state, current)
+      if current == nil or sink(value) then
+        return
+      end
+    end
+  end)
+end
+
+--- Creates a stream from a table or an iterator.
+-- @param source Array, List or iterator function
+-- @return Stream
+function from(source)
+  if getmetatable(source) == Stream then
+    return source
+  elseif type(source) == 'function' then
+    return iterate(source)
+  end
+  return of(source)
+end
+
+-- Stages ----------------------------------------------------------------------
+
+--- Transforms each element.
+-- @param fn Function(value) -> new value
+-- @return Stream
+function Stream:map(fn)
+  return chain(self, function(down)
+    return function(v)
+      return down(fn(v))
+    end
+  end)
+end
+
+--- Keeps elements for which the predicate is truthy.
+-- @param predicate Function(value) -> boolean
+-- @return Stream
+function Stream:filter(predicate)
+  return chain(self, function(down)
+    return function(v)
+      if predicate(v) then
+        return down(v)
+      end
+    end
+  end)
+end
+
+--- Drops elements for which the predicate is truthy.
+-- @param predicate Function(value) -> boolean
+-- @return Stream
+function Stream:reject(predicate)
+  return chain(self, function(down)
+    return function(v)
+      if not predicate(v) then
+        return down(v)
+      end
+    end
+  end)
+end
+
+--- Keeps the first n elements and stops the source after them.
+-- @param n Number of elements
+-- @return Stream
+function Stream:take(n)
+  return chain(self, function(down)
+    local remaining = n
+    return function(v)
+      if remaining <= 0 then
+        return true
+      end
+      remaining = remaining - 1
+      return down(v) or remaining <= 0
+    end
+  end)
+end
+
+--- Skips the first n elements.
+-- @param n Number of elements
+-- @return Stream
+function Stream:skip(n)
+  return chain(self, function(down)
+    local remaining = n
+    return function(v)
+      if remaining > 0 then
+        remaining = remaining - 1
+        return
+      end
+      return down(v)
+    end
+  end)
+end
+
+--- Keeps elements while the predicate holds, then stops.
+-- @param predicate Function(value) -> boolean
+-- @return Stream
+function Stream:take_while(predicate)
+  return chain(self, function(down)
+    return function(v)
+      if not predicate(v) then
+        return true
+      end
+      return down(v)
+    end
+  end)
+end
+
+--- Skips elements while the predicate holds, then keeps the rest.
+-- @param predicate Function(value) -> boolean
+-- @return Stream
+function Stream:drop_while(predicate)
+  return chain(self, function(down)
+    local dropping = true
+    return function(v)
+      if dropping and predicate(v) then
+        return
+      end
+      dropping = false
+      return down(v)
+    end
+  end)
+end
+
+--- Replaces each element with the elements of the array it maps to.
+-- @param fn Function(value) -> array, or nil for no elements
+-- @return Stream
+function Stream:flat_map(fn)
+  return chain(self, function(down)
+    return function(v)
+      local inner = fn(v)
+      if inner then
+        for i = 1, #inner do
+          if down(inner[i]) then
+            return true
+          end
+        end
+      end
+    end
+  end)
+end
+
+--- Pairs each element with the next one of another sequence.
+-- Stops when either runs out.
+-- @param other Array, List or iterator function
+-- @param fn Function(a, b) -> combined value
+-- @return Stream
+function Stream:zip(other, fn)
+  return chain(self, function(down)
+    if type(other) == 'function' then
+      local control, value
+      return function(v)
+        control, value = other(nil, control)
+        if control == nil then
+          return true
+        end
+        return down(fn(v, value))
+      end
+    end
+    local index = 0
+    return function(v)
+      index = index + 1
+      if index > #other then
+        return true
+      end
+      return down(fn(v, other[index]))
+    end
+  end)
+end
+
+--- Drops elements whose key was already seen in this run.
+-- @param key_fn Optional function(value) -> key (default: the value)
+-- @return Stream
+function Stream:distinct(key_fn)
+  return chain(self, function(down)
+    local seen = {}
+    return function(v)
+      local key = v
+      if key_fn then
+        key = key_fn(v)
+      end
+      if seen[key] then
+        return
+      end
+      seen[key] = true
+      return down(v)
+    end
+  end)
+end
+
+--- Calls a function on each element as it passes.
+-- @param fn Function(value)
+-- @return Stream
+function Stream:tap(fn)
+  return chain(self, function(down)
+    return function(v)
+      fn(v)
+      return down(v)
+    end
+  end)
+end
+
+-- Terminal operations ---------------------------------------------------------
+
+--- Calls a function on each element; returning true from it stops.
+-- @param fn Function(value) -> stop
+function Stream:each(fn)
+  run(self, fn)
+end
+
+--- Collects the elements into a new List.
+-- @return List
+function Stream:to_list()
+  local result = List({})
+  local n = 0
+  run(self, function(v)
+    n = n + 1
+    result[n] = v
+  end)
+  return result
+end
+
+--- Collects the elements into an existing table, replacing its array
+-- part. Reusing one buffer avoids a new list per run.
+-- @param buffer Table to fill
+-- @return buffer
+function Stream:into(buffer)
+  local previous = #buffer
+  local n = 0
+  run(self, function(v)
+    n = n + 1
+    buffer[n] = v
+  end)
+  for i = n + 1, previous do
+    buffer[i] = nil
+  end
+  return buffer
+end
+
+--- Folds the elements into one value.
+-- Without an initial value the first element starts the fold.
+-- @param fn Function(accumulator, value) -> new accumulator
+-- @param initial_value Optional initial accumulator
+-- @return The accumulated value, or nil for an empty stream
+function Stream:reduce(fn, initial_value)
+  local accumulator = initial_value
+  local started = initial_value ~= nil
+  run(self, function(v)
+    if started then
+      accumulator = fn(accumulator, v)
+    else
+      accumulator = v
+      started = true
+    end
+  end)
+  return accumulator
+end
+
+--- Sums the elements.
+-- @return The sum, 0 for an empty stream
+function Stream:sum()
+  local total = 0
+  run(self, function(v)
+    total = total + v
+  end)
+  return total
+end
+
+--- Counts the elements.
+-- @return Number of elements
+function Stream:count()
+  local n = 0
+  run(self, function()
+    n = n + 1
+  end)
+  return n
+end
+
+--- Returns the smallest element, or nil for an empty stream.
+function Stream:min()
+  return self:reduce(function(a, b)
+    return b < a and b or a
+  end)
+end
+
+--- Returns the largest element, or nil for an empty stream.
+function Stream:max()
+  return self:reduce(function(a, b)
+    return b > a and b or a
+  end)
+end
+
+--- Returns the first element matching the predicate, stopping there.
+-- @param predicate Optional function(value) -> boolean (default: any)
+-- @return The element, or nil if none matched
+function Stream:first(predicate)
+  local found
+  run(self, function(v)
+    if predicate == nil or predicate(v) then
+      found = v
+      return true
+    end
+  end)
+  return found
+end
+
+--- Checks whether any element matches the predicate.
+-- @param predicate Function(value) -> boolean
+-- @return boolean
+function Stream:any(predicate)
+  local result = false
+  run(self, function(v)
+    if predicate(v) then
+      result = true
+      return true
+    end
+  end)
+  return result
+end
+
+--- Checks whether every element matches the predicate.
+-- @param predicate Function(value) -> boolean
+-- @return boolean
+function Stream:all(predicate)
+  local result = true
+  run(self, function(v)
+    if not predicate(v) then
+      result = false
+      return true
+    end
+  end)
+  return result
+end
+
+return _M
@@ -0,0 +1,12 @@
+-- Copyright 2024 Alexander Ames <Alexander.Ames@gmail.com>
+
+--- Constraint backend for musica.generation.
+-- The z3 module when it can be loaded, otherwise the z3-compatible builder
+-- over FL-Lua's native finite-domain solver.
+-- @module musica.generation.backend
+
+local ok, z3 = pcall(require, 'z3')
+if ok then
+  return z3
+end
+return require('musica.generation.native')
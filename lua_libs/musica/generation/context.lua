@@ -1,13 +1,14 @@
 -- Copyright 2024 Alexander Ames <Alexander.Ames@gmail.com>
 
---- Generation context managing Z3 variables and music mappings.
+--- Generation context managing solver variables and music mappings.
 -- The GenerationContext bridges between musical concepts (Pitch, Note, Figure)
 -- and Z3 constraint solving. It creates Z3 variables for each note position
 -- and handles conversion between music objects and Z3 values.
 -- @module musica.generation.context
 
--- Require z3 before llx to avoid strict mode conflicts
-local z3 = require('z3')
+-- Require the backend (z3 or the native solver) before llx to avoid strict
+-- mode conflicts
+local z3 = require('musica.generation.backend')
 local llx = require('llx')
 
 -- Require individual musica modules to avoid circular dependency
@@ -36,6 +37,8 @@ GenerationContext = class('GenerationContext')({
   -- @tparam number args.num_notes Number of notes to generate
   -- @tparam[opt=1000] number args.duration_precision Multiplier for duration (Z3 uses integers)
   -- @tparam[opt=1000] number args.volume_precision Multiplier for volume (Z3 uses integers)
+  -- @tparam[opt] table args.duration_values Durations the native solver chooses from (default 1/4, 1/2, 1, 2)
+  -- @tparam[opt] table args.volume_values Volumes the native solver chooses from (default steps of 1/8)
   __init = function(self, args)
     args = args or {}
     self.z3_ctx = z3.Context()
@@ -48,6 +51,11 @@ GenerationContext = class('GenerationContext')({
     self.duration_precision = args.duration_precision or 1000
     self.volume_precision = args.volume_precision or 1000
 
+    -- The native solver searches finite domains; z3 does not need them
+    self.duration_values = args.duration_values or { 0.25, 0.5, 1, 2 }
+    self.volume_values = args.volume_values
+      or { 0, 0.125, 0.25, 0.375, 0.5, 0.625, 0.75, 0.875, 1 }
+
     -- Z3 variables for each note position
     self.pitch_vars = List({})
     self.duration_vars = List({})
@@ -78,7 +86,30 @@ GenerationContext = class('GenerationContext')({
       -- Volume must be in range [0, precision] (maps to [0.0, 1.0])
       self.solver:add(volume_var:ge(self.z3_ctx:int_val(0)))
       self.solver:add(volume_var:le(self.z3_ctx:int_val(self.volume_precision)))
+
+      if self.z3_ctx.set_domain then
+        self.z3_ctx:set_domain(pitch_var, { min = 0, max = 127 })
+        self.z3_ctx:set_domain(duration_var, {
+          values = self:_scaled(self.duration_values, self.duration_precision),
+        })
+        self.z3_ctx:set_domain(volume_var, {
+          values = self:_scaled(self.volume_values, self.volume_precision),
+        })
+      end
+    end
+  end,
+
+  --- Scales real values to the integers the solver works with.
+  -- @tparam GenerationContext self
+  -- @tparam table values Real values
+  -- @tparam number precision The precision multiplier
+  -- @treturn table Integer values
+  _scaled = function(self, values, precision)
+    local scaled = {}
+    for i, value in ipairs(values) do
+      scaled[i] = math.floor(value * precision + 0.5)
     end
+    return scaled
   end,
 
   --- Gets the Z3 context.
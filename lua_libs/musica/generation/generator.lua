@@ -1,13 +1,14 @@
 -- Copyright 2024 Alexander Ames <Alexander.Ames@gmail.com>
 
---- Generator for musical figures using Z3 constraint solving.
--- The Generator takes a collection of Rules and uses Z3 to find note
--- sequences that satisfy all constraints. It supports both single-solution
--- generation and enumeration of all possible solutions.
+--- Generator for musical figures using constraint solving.
+-- The Generator takes a collection of Rules and uses Z3, or the native
+-- solver when z3 is not available, to find note sequences that satisfy all
+-- constraints. It supports both single-solution generation and enumeration
+-- of all possible solutions.
 -- @module musica.generation.generator
 
 local llx = require('llx')
-local z3 = require('z3')
+local z3 = require('musica.generation.backend')
 local context_module = require('musica.generation.context')
 
 local _ENV, _M = llx.environment.create_module_environment()
@@ -27,11 +28,15 @@ Generator = class('Generator')({
   -- @tparam[opt] List args.rules List of Rule objects
   -- @tparam[opt] table args.context Context configuration (passed to GenerationContext)
   -- @tparam[opt=100] number args.max_solutions Maximum solutions to enumerate
+  -- @tparam[opt=1] number args.budget Seconds the native solver may search
+  -- @tparam[opt=0] number args.seed Native solver value order; 0 is ascending
   __init = function(self, args)
     args = args or {}
     self.rules = List(args.rules or {})
     self.context_args = args.context or {}
     self.max_solutions = args.max_solutions or 100
+    self.budget = args.budget or 1
+    self.seed = args.seed or 0
   end,
 
   --- Adds a rule to the generator.
@@ -46,6 +51,11 @@ Generator = class('Generator')({
   -- @treturn GenerationContext The configured context
   _setup_context = function(self)
     local ctx = GenerationContext(self.context_args)
+    local solver = ctx:get_solver()
+    if solver.set_budget then
+      solver:set_budget(self.budget)
+      solver:set_seed(self.seed)
+    end
 
     -- Apply all enabled rules to the context
     for i, rule in ipairs(self.rules) do
@@ -85,6 +95,15 @@ Generator = class('Generator')({
     local z3_ctx = ctx:get_z3_context()
     local count = 0
 
+    -- The native solver enumerates distinct solutions in a single search
+    if solver.enumerate then
+      for model in solver:enumerate(self.max_solutions) do
+        count = count + 1
+        coroutine.yield(count, ctx:build_figure(model))
+      end
+      return
+    end
+
     while count < self.max_solutions do
       local result = solver:check()
       if result ~= 'sat' then
@@ -1,6 +1,7 @@
 -- Copyright 2024 Alexander Ames <Alexander.Ames@gmail.com>
 
---- Generation module for procedural music creation using Z3 constraint solving.
+--- Generation module for procedural music creation using constraint solving
+-- (Z3, or FL-Lua's native solver when z3 is not available).
 -- @module musica.generation
 
 local llx = require('llx')
@@ -0,0 +1,219 @@
+-- Copyright 2024 Alexander Ames <Alexander.Ames@gmail.com>
+
+--- Z3-compatible constraint builder backed by FL-Lua's native solver.
+-- Implements the part of the z3 module that musica.generation uses
+-- (contexts, integer expressions, And/Or/Not, solvers and models) and
+-- solves with the plugin's built-in finite-domain solver, so rules written
+-- against z3 run unchanged where z3 cannot be loaded. Every variable
+-- ranges over a finite domain, MIDI pitches (0-127) unless set with
+-- Context:set_domain.
+-- @module musica.generation.native
+
+local llx = require('llx')
+local fd = require('fllua.solver')
+
+local _ENV, _M = llx.environment.create_module_environment()
+
+local class = llx.class
+
+--- Expression nodes, read directly by the native solver.
+-- Children are stored at array indices 1 and 2.
+local Expr = {}
+Expr.__index = Expr
+
+local function node(op, ...)
+  return setmetatable({ op = op, ... }, Expr)
+end
+
+local function lift(value)
+  if getmetatable(value) == Expr then
+    return value
+  end
+  return setmetatable({ op = 'const', value = value }, Expr)
+end
+
+Expr.__add = function(a, b)
+  return node('add', lift(a), lift(b))
+end
+
+Expr.__sub = function(a, b)
+  a, b = lift(a), lift(b)
+  -- z3 rules spell `x mod m` as x - (x / m) * m
+  if
+    b.op == 'mul'
+    and b[1].op == 'div'
+    and b[1][1] == a
+    and b[1][2].op == 'const'
+    and b[2].op == 'const'
+    and b[1][2].value == b[2].value
+  then
+    return node('mod', a, b[2])
+  end
+  return node('sub', a, b)
+end
+
+Expr.__unm = function(a)
+  return node('neg', a)
+end
+
+Expr.__mul = function(a, b)
+  return node('mul', lift(a), lift(b))
+end
+
+Expr.__div = function(a, b)
+  return node('div', lift(a), lift(b))
+end
+
+Expr.__mod = function(a, b)
+  return node('mod', lift(a), lift(b))
+end
+
+for _, op in ipairs({ 'eq', 'ne', 'lt', 'le', 'gt', 'ge' }) do
+  Expr[op] = function(self, other)
+    return node(op, self, lift(other))
+  end
+end
+
+--- Conjunction of constraints.
+-- @treturn table Constraint expression
+function And(...)
+  return node('and', ...)
+end
+
+--- Disjunction of constraints.
+-- @treturn table Constraint expression
+function Or(...)
+  return node('or', ...)
+end
+
+--- Negation of a constraint.
+-- @treturn table Constraint expression
+function Not(constraint)
+  return node('not', constraint)
+end
+
+--- Variable factory holding each variable's domain.
+-- @type Context
+Context = class('Context')({
+  __init = function(self)
+    self.domains = {}
+  end,
+
+  --- Creates an integer variable ranging over MIDI pitches by default.
+  -- @tparam Context self
+  -- @tparam string name Variable name
+  -- @treturn table The variable expression
+  int_const = function(self, name)
+    local index = #self.domains + 1
+    self.domains[index] = { min = 0, max = 127 }
+    local var = node('var')
+    var.index = index
+    var.name = name
+    return var
+  end,
+
+  --- Sets the values a variable may take.
+  -- @tparam Context self
+  -- @tparam table var Variable from int_const
+  -- @tparam table domain `{ min = lo, max = hi }` or `{ values = {...} }`
+  set_domain = function(self, var, domain)
+    self.domains[var.index] = domain
+  end,
+
+  --- Creates an integer literal.
+  -- @tparam Context self
+  -- @tparam number value The integer value
+  -- @treturn table The literal expression
+  int_val = function(self, value)
+    return lift(value)
+  end,
+})
+
+--- Values of one solution.
+-- @type Model
+Model = class('Model')({
+  __init = function(self, values)
+    self.values = values
+  end,
+
+  --- Gets a variable's value in this solution.
+  -- @tparam Model self
+  -- @tparam table var Variable from int_const
+  -- @treturn number The integer value
+  get_value = function(self, var)
+    return self.values[var.index]
+  end,
+})
+
+--- Collects constraints and searches for solutions.
+-- @type Solver
+Solver = class('Solver')({
+  __init = function(self, context)
+    self.context = context
+    self.constraints = {}
+    self.budget = 1
+    self.seed = 0
+  end,
+
+  --- Adds a constraint.
+  -- @tparam Solver self
+  -- @tparam table constraint Constraint expression
+  add = function(self, constraint)
+    table.insert(self.constraints, constraint)
+  end,
+
+  --- Sets the wall-clock time a search may take.
+  -- @tparam Solver self
+  -- @tparam number seconds Search budget
+  set_budget = function(self, seconds)
+    self.budget = seconds
+  end,
+
+  --- Sets the seed for value order; 0 tries values in ascending order.
+  -- @tparam Solver self
+  -- @tparam number seed Random seed
+  set_seed = function(self, seed)
+    self.seed = seed
+  end,
+
+  _solve = function(self, max_solutions)
+    return fd.solve({
+      domains = self.context.domains,
+      constraints = self.constraints,
+      max_solutions = max_solutions,
+      budget = self.budget,
+      seed = self.seed,
+    })
+  end,
+
+  --- Searches for a solution.
+  -- @tparam Solver self
+  -- @treturn string 'sat', 'unsat', or 'unknown' if the budget ran out
+  check = function(self)
+    local status, solutions = self:_solve(1)
+    self.model = solutions[1] and Model(solutions[1]) or nil
+    return status
+  end,
+
+  --- Gets the solution found by the last check.
+  -- @tparam Solver self
+  -- @treturn Model|nil The model
+  get_model = function(self)
+    return self.model
+  end,
+
+  --- Enumerates distinct solutions in a single search.
+  -- @tparam Solver self
+  -- @tparam number max_solutions Maximum number of solutions
+  -- @treturn function Iterator over Models
+  enumerate = function(self, max_solutions)
+    local _, solutions = self:_solve(max_solutions)
+    local i = 0
+    return function()
+      i = i + 1
+      return solutions[i] and Model(solutions[i]) or nil
+    end
+  end,
+})
+
+return _M
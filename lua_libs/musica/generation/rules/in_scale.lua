@@ -3,7 +3,7 @@
 --- Rule requiring all pitches to be in a given scale.
 -- @module musica.generation.rules.in_scale
 
-local z3 = require('z3')
+local z3 = require('musica.generation.backend')
 local llx = require('llx')
 local rule_module = require('musica.generation.rule')
 
@@ -3,7 +3,7 @@
 --- Rules for monotonic pitch movement (ascending/descending melodies).
 -- @module musica.generation.rules.monotonic
 
-local z3 = require('z3')
+local z3 = require('musica.generation.backend')
 local llx = require('llx')
 local rule_module = require('musica.generation.rule')
 local direction_module = require('musica.direction')
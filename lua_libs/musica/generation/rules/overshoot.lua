@@ -6,7 +6,7 @@
 -- @module musica.generation.rules.overshoot
 
 local llx = require('llx')
-local z3 = require('z3')
+local z3 = require('musica.generation.backend')
 local rule_module = require('musica.generation.rule')
 
 local _ENV, _M = llx.environment.create_module_environment()
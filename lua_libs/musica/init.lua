@@ -37,5 +37,7 @@ return require('llx.flatten_submodules')({ --        |
   require('musica.spiral'), -- No     | No
   require('musica.tempo'), -- No     | No
   require('musica.util'), -- No     | No
+  require('musica.voice_leading'), -- No     | No
   require('musica.generation'), -- No     | No
+  transformations = require('musica.transformations'), -- No | No
 })
@@ -1,87 +1,369 @@
-from copy import deepcopy
+-- Copyright 2024 Alexander Ames <Alexander.Ames@gmail.com>
 
-def identity(note):
-  return deepcopy(note)
+--- Lazy figure transformations.
+-- A FigureView is a lightweight view over a source Figure and a list of
+-- transformations (transpose, scalewise transpose, volume curves, time
+-- scaling, retrograde). Nothing is copied when a view is derived: the
+-- transformations run on the fly, one note at a time, when the view's notes
+-- are iterated or scheduled. Deriving any number of variations of a phrase
+-- only costs the small view and transformation tables.
+-- @module musica.transformations
+-- @usage
+-- local t = musica.transformations
+-- local answer = t.view(phrase):transpose(7):retrograde():augment(2)
+-- for i, pitch, time, duration, volume in answer:notes() do
+--   ...
+-- end
 
-def transpose(steps):
-  def function(note):
-    newNote = deepcopy(note)
-    newNote.pitch += steps
-    return newNote
-  return function
+local llx = require('llx')
+local figure = require('musica.figure')
 
-def transposeOctave(octaves):
+local _ENV, _M = llx.environment.create_module_environment()
+
+local class = llx.class
+local tointeger = llx.tointeger
+local Figure = figure.Figure
+
+-- Each transformation is a table with an `apply` function mapping
+-- (op, span, pitch, time, duration, volume) to the transformed values.
+-- `span` is the duration of the figure as the transformation sees it, after
+-- the time scaling applied before it.
+
+local function apply_transpose(op, span, pitch, time, duration, volume)
+  return pitch + op.semitones, time, duration, volume
+end
+
+--- Transposes by a number of semitones.
+-- @param semitones Semitones to add (negative transposes down)
+-- @return Transformation
+function transpose(semitones)
+  return { apply = apply_transpose, semitones = semitones }
+end
+
+--- Transposes by whole octaves.
+-- @param octaves Octaves to add
+-- @return Transformation
+function transpose_octave(octaves)
   return transpose(octaves * 12)
+end
+
+local function apply_scalewise(op, span, pitch, time, duration, volume)
+  local size = op.size
+  local octave_size = op.octave_size
+  local offset = pitch - op.tonic
+  local octave = offset // octave_size
+  local within = offset % octave_size
+
+  -- Notes outside the scale keep their distance above the scale degree
+  -- below them
+  local index = octave * size + op.degrees[within] + op.steps
+  local degree = index % size
+  local target = op.tonic + (index // size) * octave_size + op.offsets[degree]
+  return target + op.remainders[within], time, duration, volume
+end
+
+--- Transposes by scale degrees.
+-- Pitches in the scale move to the degree `steps` away; other pitches keep
+-- their offset from the scale degree below them.
+-- @param scale A musica Scale
+-- @param steps Scale degrees to move (negative moves down)
+-- @return Transformation
+function scalewise_transpose(scale, steps)
+  local tonic = tointeger(scale.tonic)
+  local octave_size = tointeger(scale.mode:octave_interval())
+  local offsets = {}
+  local pitches = scale:get_pitches()
+  for i = 1, #pitches do
+    offsets[i - 1] = tointeger(pitches[i]) - tonic
+  end
+
+  -- Degree below each semitone of the octave and the distance above it
+  local degrees, remainders = {}, {}
+  local degree = 0
+  for semitone = 0, octave_size - 1 do
+    while offsets[degree + 1] and offsets[degree + 1] <= semitone do
+      degree = degree + 1
+    end
+    degrees[semitone] = degree
+    remainders[semitone] = semitone - offsets[degree]
+  end
+
+  return {
+    apply = apply_scalewise,
+    steps = steps,
+    tonic = tonic,
+    size = #pitches,
+    octave_size = octave_size,
+    offsets = offsets,
+    degrees = degrees,
+    remainders = remainders,
+  }
+end
+
+local function apply_crescendo(op, span, pitch, time, duration, volume)
+  local finish = op.finish or span
+  if time < op.start or time > finish then
+    return pitch, time, duration, volume
+  end
+  local length = finish - op.start
+  local x = length > 0 and (time - op.start) / length or 1
+  return pitch, time, duration, op.low + (op.high - op.low) * x
+end
 
-def scalewiseTranspose(scale, steps):
-  # What do we do when the note isn't in the scale?
-  def function(note):
-    newNote = deepcopy(note)
-    newNote.pitch += steps
-    return newNote
-  return function
-
-def crescendo(low, high, start, end):
-  def function(note):
-    newNote = deepcopy(note)
-    if start <= note.time <= end:
-      newNote.volume = lerp(start, end, low, high, note.time)
-    return newNote
-  return function
-
-# Works out to the be the same thing, except eventually we might want to attach
-# some additional metadata so that the sheet music can output notation
+--- Sets volumes along a straight line between two times.
+-- Notes starting outside [start, finish] keep their volume.
+-- @param low Volume at `start`
+-- @param high Volume at `finish`
+-- @param start Start time in beats (default: 0)
+-- @param finish End time in beats (default: the figure's end)
+-- @return Transformation
+function crescendo(low, high, start, finish)
+  return {
+    apply = apply_crescendo,
+    low = low,
+    high = high,
+    start = start or 0,
+    finish = finish,
+  }
+end
+
+--- Same as crescendo, from a louder to a softer volume.
 decrescendo = crescendo
 
-def setPitch(pitch):
-  def function(note):
-    newNote = deepcopy(note)
-    newNote.pitch = pitch
-    return newNote
-  return function
-
-def setPitches(pitchSequence):
-  pitchIter = iter(pitchSequence)
-  def function(note):
-    pitch = next(pitchIter)
-    newNote = deepcopy(note)
-    newNote.pitch = pitch
-    return newNote
-  return function
-
-def setDurations(duration):
-  def function(note):
-    newNote = deepcopy(note)
-    newNote.duration = duration
-    return newNote
-  return function
-
-def setVolumes(volume):
-  def function(note):
-    newNote = deepcopy(note)
-    newNote.volume = volume
-    return newNote
-  return function
-
-def setTimes(time):
-  def function(note):
-    newNote = deepcopy(note)
-    newNote.time = time
-    return newNote
-  return function
-
-def makeConsecutive(durationSequence):
-  time = nil
-  durationIter = iter(durationSequence)
-  def function(note):
-    nonlocal time
-    nonlocal durationIter
-    duration = next(durationIter)
-    if time is nil:
-      time = note.time
-    newNote = deepcopy(note)
-    newNote.time = time
-    newNote.duration = duration
-    time += duration
-    return newNote
-  return function
+local function apply_volume_curve(op, span, pitch, time, duration, volume)
+  local x = span > 0 and time / span or 0
+  return pitch, time, duration, volume * op.curve(x)
+end
+
+--- Scales volumes by a curve over the figure.
+-- @param curve Function(position) -> factor, position from 0 at the start
+--   of the figure to 1 at its end
+-- @return Transformation
+function volume_curve(curve)
+  return { apply = apply_volume_curve, curve = curve }
+end
+
+local function apply_scale_volume(op, span, pitch, time, duration, volume)
+  return pitch, time, duration, volume * op.factor
+end
+
+--- Scales every volume by a factor.
+-- @param factor Volume multiplier
+-- @return Transformation
+function scale_volume(factor)
+  return { apply = apply_scale_volume, factor = factor }
+end
+
+local function apply_augment(op, span, pitch, time, duration, volume)
+  return pitch, time * op.factor, duration * op.factor, volume
+end
+
+--- Scales times and durations, lengthening the figure.
+-- @param factor Time multiplier (2 plays at half speed)
+-- @return Transformation
+function augment(factor)
+  return {
+    apply = apply_augment,
+    factor = factor,
+    scales_span = factor,
+  }
+end
+
+--- Scales times and durations, shortening the figure.
+-- @param factor Time divisor (2 plays at double speed)
+-- @return Transformation
+function diminish(factor)
+  return augment(1 / factor)
+end
+
+local function apply_retrograde(op, span, pitch, time, duration, volume)
+  return pitch, span - time - duration, duration, volume
+end
+
+--- Reverses the figure in time. Notes are visited in reverse order.
+-- @return Transformation
+function retrograde()
+  return { apply = apply_retrograde, reverses = true }
+end
+
+local function apply_function(op, span, pitch, time, duration, volume)
+  return op.fn(pitch, time, duration, volume)
+end
+
+--- Wraps a custom function of a note's values.
+-- @param fn Function(pitch, time, duration, volume) -> the four new values
+-- @return Transformation
+function transform(fn)
+  return { apply = apply_function, fn = fn }
+end
+
+--- FigureView: a source figure seen through a list of transformations.
+-- Derived views share the source figure and their parents' transformations.
+FigureView = class('FigureView')({
+  __init = function(self, source, ops, spans, duration, reversed)
+    self.source = source
+    self.ops = ops or {}
+    self.spans = spans or {}
+    self.duration = duration
+    self.reversed = reversed or false
+  end,
+
+  --- Returns a new view with more transformations applied after these.
+  -- @param ... Transformations
+  -- @return FigureView
+  apply = function(self, ...)
+    local ops, spans = {}, {}
+    for i = 1, #self.ops do
+      ops[i] = self.ops[i]
+      spans[i] = self.spans[i]
+    end
+    local duration = self.duration
+    local reversed = self.reversed
+    for i = 1, select('#', ...) do
+      local op = select(i, ...)
+      ops[#ops + 1] = op
+      spans[#spans + 1] = duration
+      duration = duration * (op.scales_span or 1)
+      if op.reverses then
+        reversed = not reversed
+      end
+    end
+    return FigureView(self.source, ops, spans, duration, reversed)
+  end,
+
+  transpose = function(self, semitones)
+    return self:apply(transpose(semitones))
+  end,
+
+  transpose_octave = function(self, octaves)
+    return self:apply(transpose_octave(octaves))
+  end,
+
+  scalewise_transpose = function(self, scale, steps)
+    return self:apply(scalewise_transpose(scale, steps))
+  end,
+
+  crescendo = function(self, low, high, start, finish)
+    return self:apply(crescendo(low, high, start, finish))
+  end,
+
+  decrescendo = function(self, high, low, start, finish)
+    return self:apply(decrescendo(high, low, start, finish))
+  end,
+
+  volume_curve = function(self, curve)
+    return self:apply(volume_curve(curve))
+  end,
+
+  scale_volume = function(self, factor)
+    return self:apply(scale_volume(factor))
+  end,
+
+  augment = function(self, factor)
+    return self:apply(augment(factor))
+  end,
+
+  diminish = function(self, factor)
+    return self:apply(diminish(factor))
+  end,
+
+  retrograde = function(self)
+    return self:apply(retrograde())
+  end,
+
+  transform = function(self, fn)
+    return self:apply(transform(fn))
+  end,
+
+  --- Number of notes in the view.
+  __len = function(self)
+    return #self.source.notes
+  end,
+
+  --- Transformed values of the i-th note of the view.
+  -- @param i Note index, 1 to #view
+  -- @return pitch (MIDI number), time, duration, volume
+  note = function(self, i)
+    local notes = self.source.notes
+    local n = notes[self.reversed and #notes + 1 - i or i]
+    local pitch = tointeger(n.pitch)
+    local time, duration, volume = n.time or 0, n.duration, n.volume
+    local ops, spans = self.ops, self.spans
+    for k = 1, #ops do
+      local op = ops[k]
+      pitch, time, duration, volume =
+        op.apply(op, spans[k], pitch, time, duration, volume)
+    end
+    return pitch, time, duration, volume
+  end,
+
+  --- Iterates the transformed notes without creating tables.
+  -- @return Iterator yielding (index, pitch, time, duration, volume)
+  -- @usage
+  -- for i, pitch, time, duration, volume in view:notes() do ... end
+  notes = function(self)
+    local count = #self.source.notes
+    return function(_, i)
+      i = i + 1
+      if i <= count then
+        return i, self:note(i)
+      end
+    end, nil, 0
+  end,
+
+  --- Copies the transformed notes into a new Figure.
+  -- @return Figure
+  materialize = function(self)
+    local notes = llx.List({})
+    for i, pitch, time, duration, volume in self:notes() do
+      notes[i] = {
+        pitch = pitch,
+        time = time,
+        duration = duration,
+        volume = volume,
+      }
+    end
+    return Figure({ duration = self.duration, notes = notes })
+  end,
+
+  --- Fills `buffer` with {beat, pitch, velocity, duration} tuples for
+  -- ctx.clip.load, reusing the tuples already in it.
+  -- @param buffer Table to fill (default: a new table)
+  -- @param offset Beat added to every note time (default: 0)
+  -- @return buffer
+  to_clip_events = function(self, buffer, offset)
+    buffer = buffer or {}
+    offset = offset or 0
+    local count = 0
+    for i, pitch, time, duration, volume in self:notes() do
+      local event = buffer[i] or {}
+      event[1] = offset + time
+      event[2] = pitch
+      event[3] = math.max(1, math.min(127, math.floor(volume * 127 + 0.5)))
+      event[4] = duration
+      buffer[i] = event
+      count = i
+    end
+    for i = count + 1, #buffer do
+      buffer[i] = nil
+    end
+    return buffer
+  end,
+
+  __tostring = function(self)
+    return string.format('FigureView{notes=%d, duration=%s}', #self,
+      self.duration)
+  end,
+})
+
+--- Creates a view over a figure, or returns an existing view.
+-- @param source Figure or FigureView
+-- @return FigureView
+function view(source)
+  if llx.isinstance(source, FigureView) then
+    return source
+  end
+  return FigureView(source, {}, {}, source.duration, false)
+end
+
+return _M
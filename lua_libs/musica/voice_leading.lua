@@ -0,0 +1,145 @@
+-- Copyright 2024 Alexander Ames <Alexander.Ames@gmail.com>
+
+--- Minimum-movement voice leading for chord progressions.
+-- Voices a sequence of Chords within a range, voice count, doubling and
+-- leap limits so the voices move as little as possible in total. The search
+-- runs natively (FL-Lua's `fllua.voicing`): every voicing of each chord is
+-- enumerated once, and dynamic programming over consecutive chords keeps
+-- the best cost per voicing, so setting the next chord of a progression
+-- only solves that one step. It runs on worker threads only: keep the
+-- leader in the worker state and call it through `ctx.async`.
+-- @module musica.voice_leading
+-- @usage
+-- local leader = musica.VoiceLeader({ low = 48, high = 76, voices = 4 })
+-- leader:set_chords(progression)
+-- local voicings = leader:solve()  -- One List of Pitches per chord
+
+local llx = require('llx')
+local pitch = require('musica.pitch')
+
+local _ENV, _M = llx.environment.create_module_environment()
+
+local class = llx.class
+local List = llx.List
+local Pitch = pitch.Pitch
+local tointeger = llx.tointeger
+
+-- MIDI pitches of a Chord, root first
+local function chord_pitches(chord)
+  local pitches = {}
+  for i, p in ipairs(chord:get_pitches()) do
+    pitches[i] = tointeger(p)
+  end
+  return pitches
+end
+
+--- Voices chords one step at a time.
+-- @type VoiceLeader
+VoiceLeader = class('VoiceLeader')({
+  --- Creates a VoiceLeader.
+  -- @function VoiceLeader:__init
+  -- @tparam VoiceLeader self
+  -- @tparam[opt] table args Constraints
+  -- @tparam[opt=48] number args.low Lowest MIDI pitch of any voice
+  -- @tparam[opt=79] number args.high Highest MIDI pitch of any voice
+  -- @tparam[opt=4] number args.voices Number of voices (1-8)
+  -- @tparam[opt=7] number args.max_leap Semitones a voice may move (0-24)
+  -- @tparam[opt=12] number args.max_spacing Largest gap between adjacent
+  --   voices above the bass
+  -- @tparam[opt=false] boolean args.root_in_bass Keep the root lowest
+  -- @tparam[opt] table args.doubled Chord indices that may be doubled
+  --   (default {0}, the root)
+  -- @tparam[opt] table args.omit Chord indices that may be left out
+  --   (default: the fifth, when a chord has more tones than voices)
+  -- @tparam[opt=64] number args.center Pitch the first voicing centers on
+  --   among equally smooth progressions
+  __init = function(self, args)
+    self.native = require('fllua.voicing').new(args or {})
+  end,
+
+  --- Sets the chord at a position, at most one past the last.
+  -- Chords after it are kept; only the steps from `index` on are solved
+  -- again.
+  -- @tparam VoiceLeader self
+  -- @tparam number index 1-based position
+  -- @tparam Chord chord The chord
+  -- @treturn VoiceLeader self
+  set = function(self, index, chord)
+    self.native:set(index, chord_pitches(chord))
+    return self
+  end,
+
+  --- Appends a chord.
+  -- @tparam VoiceLeader self
+  -- @tparam Chord chord The chord
+  -- @treturn VoiceLeader self
+  push = function(self, chord)
+    return self:set(#self.native + 1, chord)
+  end,
+
+  --- Replaces the progression; unchanged leading chords are not solved
+  -- again.
+  -- @tparam VoiceLeader self
+  -- @tparam table chords List of Chords
+  -- @treturn VoiceLeader self
+  set_chords = function(self, chords)
+    for i, chord in ipairs(chords) do
+      self:set(i, chord)
+    end
+    self.native:truncate(#chords)
+    return self
+  end,
+
+  --- Keeps only the first chords.
+  -- @tparam VoiceLeader self
+  -- @tparam number count Chords to keep
+  -- @treturn VoiceLeader self
+  truncate = function(self, count)
+    self.native:truncate(count)
+    return self
+  end,
+
+  --- Voicings as MIDI pitches, for ctx.async results.
+  -- @tparam VoiceLeader self
+  -- @treturn table|nil One array of ascending MIDI pitches per chord, or
+  --   nil when a chord cannot be reached within max_leap
+  -- @treturn number|string Total semitones moved, or the error
+  solve_midi = function(self)
+    return self.native:solve()
+  end,
+
+  --- Voicings as Pitches.
+  -- @tparam VoiceLeader self
+  -- @treturn List|nil One List of ascending Pitches per chord, or nil
+  -- @treturn number|string Total semitones moved, or the error
+  solve = function(self)
+    local voicings, motion = self.native:solve()
+    if not voicings then
+      return nil, motion
+    end
+    local result = List({})
+    for i, voicing in ipairs(voicings) do
+      local pitches = List({})
+      for v, midi in ipairs(voicing) do
+        pitches[v] = Pitch({ midi_index = midi })
+      end
+      result[i] = pitches
+    end
+    return result, motion
+  end,
+
+  __len = function(self)
+    return #self.native
+  end,
+})
+
+--- Voices a whole progression at once.
+-- @tparam table chords List of Chords
+-- @tparam[opt] table args Constraints, as for VoiceLeader
+-- @treturn List|nil One List of Pitches per chord, or nil
+-- @treturn number|string Total semitones moved, or the error
+function voice_lead(chords, args)
+  return VoiceLeader(args):set_chords(chords):solve()
+end
+
+return _M
@@ -0,0 +1,39 @@
+-- async_melody.lua
+-- Searches thousands of random 8-note melodies for the smoothest one on
+-- the async worker every 4 bars, and plays the best melody found so far.
+
+local scale = { 0, 2, 3, 5, 7, 8, 10 } -- C natural minor
+local melody = { 60, 62, 63, 65, 67, 65, 63, 62 }
+
+-- Runs on the worker: a plain function of plain data
+function search(candidates, length)
+  local best, bestScore = nil, math.huge
+  for _ = 1, candidates do
+    local notes, score = {}, 0
+    for i = 1, length do
+      local degree = math.random(#scale)
+      notes[i] = 60 + scale[degree] + 12 * math.random(0, 1)
+      if i > 1 then score = score + math.abs(notes[i] - notes[i - 1]) end
+    end
+    score = score + math.abs(notes[length] - 60) * 4 -- End near the root
+    if score < bestScore then
+      best, bestScore = notes, score
+    end
+  end
+  return best
+end
+
+function on_beat(ctx, beat)
+  if beat % 16 == 0 then
+    ctx.async('search', 20000, #melody)
+  end
+  ctx.note(melody[beat % #melody + 1], 90, 0.9)
+end
+
+function on_result(ctx, future, notes, err)
+  if err then
+    ctx.log('Search failed: ' .. err)
+  else
+    melody = notes
+  end
+end
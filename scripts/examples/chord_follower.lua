@@ -0,0 +1,15 @@
+-- chord_follower.lua
+-- Arpeggiates whatever chord conductor.lua published for the beat being
+-- played, an octave up, in sixteenths.
+
+ctx.spawn(function()
+  local step = 0
+  while true do
+    local chord = ctx.bus.read('chord')
+    if chord then
+      ctx.note(chord[step % #chord + 1] + 12, 85, 0.2)
+    end
+    step = step + 1
+    ctx.wait(0.25)
+  end
+end)
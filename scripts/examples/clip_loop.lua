@@ -0,0 +1,24 @@
+-- clip_loop.lua
+-- Loops a one-bar bass clip natively and moves it up a fourth every 4 bars.
+-- The script only runs when the clip changes; playback itself is native.
+
+local bass = ctx.clip.load({
+  { 0.0, 36, 110, 0.5 },
+  { 1.0, 36, 90, 0.5 },
+  { 1.5, 48, 80, 0.25 },
+  { 2.0, 43, 100, 0.5 },
+  { 3.0, 41, 90, 0.5 },
+})
+
+local started = false
+
+function on_beat(ctx, beat)
+  if not started then
+    ctx.clip.play(bass, { at = beat, loop = true })
+    started = true
+  end
+  if beat % 16 == 0 then
+    local shift = (beat // 16) % 2 * 5
+    ctx.clip.transform(bass, { transpose = shift })
+  end
+end
@@ -0,0 +1,18 @@
+-- conductor.lua
+-- Decides the harmony for every FL-Lua instance: publishes the chord for
+-- each bar on the shared bus and plays it as pads.
+-- Pair with chord_follower.lua in other instances or layers.
+
+local progression = {
+  { 57, 60, 64 }, -- Am
+  { 53, 57, 60 }, -- F
+  { 48, 52, 55 }, -- C
+  { 55, 59, 62 }, -- G
+}
+
+function on_beat(ctx, beat)
+  if beat % 4 ~= 0 then return end
+  local chord = progression[(beat // 4) % #progression + 1]
+  ctx.bus.publish('chord', chord)
+  ctx.chord(chord, 70, 3.9)
+end
@@ -0,0 +1,24 @@
+-- filter_sweep.lua
+-- Sweeps the filter cutoff (CC 74) up and down every two bars and dips the
+-- pitch at the end of each bar. The ramps are rendered natively, so the
+-- script only runs once per bar.
+
+options = {
+  ramp_resolution = 1 / 64,
+}
+
+function on_beat(ctx, beat)
+  if beat % 8 == 0 then
+    ctx.cc_ramp(74, 20, 110, 4, 'smooth')
+  elseif beat % 8 == 4 then
+    ctx.cc_ramp(74, 110, 20, 4, 'exp')
+  end
+
+  if beat % 4 == 3 then
+    ctx.bend_ramp(0, -2048, 0.5, 'log')
+  elseif beat % 4 == 0 then
+    ctx.pitch_bend(0)
+  end
+
+  ctx.note(36 + (beat % 2) * 12, 100, 0.5)
+end
@@ -0,0 +1,73 @@
+-- generated_melody.lua
+-- Solves a new C major melody under musica.generation rules on the async
+-- worker every 4 bars, and loops the latest one. Eight seeds take turns;
+-- their melodies are kept in the disk cache, so later passes and sessions
+-- skip the solver.
+
+local musica = require('musica')
+local llx = require('llx')
+
+local melody = { { pitch = 60, duration = 1, volume = 0.8 } }
+
+-- Runs on the worker: returns the melody as plain data
+local function compose(seed)
+  local generator = musica.Generator({
+    rules = {
+      musica.PitchRangeRule({ min_pitch = 55, max_pitch = 76 }),
+      musica.MaxIntervalRule({ max_semitones = 4 }),
+      musica.InScaleRule({
+        scale = musica.Scale(musica.Pitch.c4, musica.Mode.major),
+      }),
+      musica.StartOnPitchRule({ pitch = 60 }),
+      musica.EndOnPitchRule({ pitch = 60 }),
+      musica.TotalDurationRule({ exact_total = 8 }),
+      musica.VolumeRangeRule({ min_volume = 0.5, max_volume = 1 }),
+    },
+    context = { num_notes = 8 },
+    seed = seed,
+    budget = 0.5,
+  })
+
+  local figure = generator:generate_one()
+  if not figure then
+    return nil
+  end
+  local notes = {}
+  for i, note in ipairs(figure.notes) do
+    notes[i] = {
+      pitch = llx.tointeger(note.pitch),
+      duration = note.duration,
+      volume = note.volume,
+    }
+  end
+  return notes
+end
+
+function solve(seed)
+  return (ctx.cache.get_or_compute({ 'melody', seed }, function()
+    return compose(seed)
+  end))
+end
+
+function on_beat(ctx, beat)
+  if beat % 16 == 0 then
+    ctx.async('solve', (beat // 16) % 8 + 1)
+  end
+end
+
+function on_result(ctx, future, notes, err)
+  if err then
+    ctx.log('Generation failed: ' .. err)
+  elseif notes then
+    melody = notes
+  end
+end
+
+ctx.spawn(function()
+  while true do
+    for _, note in ipairs(melody) do
+      ctx.note(note.pitch, math.floor(note.volume * 127), note.duration * 0.9)
+      ctx.wait(note.duration)
+    end
+  end
+end)
@@ -0,0 +1,41 @@
+-- groove.lua
+-- Straight sixteenth hats and a four-on-the-floor kick, grooved natively:
+-- 4 bars of humanized swing, then 4 bars of a groove taken from a clip
+-- whose offbeats lay back and whose downbeats push ahead.
+
+local kick = ctx.pattern({ steps = { 1, 0, 0, 0 }, notes = 36, velocities = 115, channel = 9 })
+
+local hats = ctx.pattern({
+  steps = 16,
+  notes = 42,
+  velocities = 100,
+  gates = 0.2,
+  channel = 9,
+})
+
+-- One bar of played sixteenths; only its timing and accents matter
+local feel = {}
+for step = 0, 15 do
+  local late = step % 2 == 1 and 0.04 or (step % 4 == 0 and -0.01 or 0)
+  local velocity = step % 4 == 0 and 120 or (step % 2 == 0 and 95 or 70)
+  feel[#feel + 1] = { step * 0.25 + late, 42, velocity, 0.1 }
+end
+local feel_clip = ctx.clip.load(feel, 4)
+
+local swung = { swing = 57, timing = 3, velocity = 5 }
+local played = { clip = feel_clip, amount = 0.8, timing = 2, early = 20 }
+
+ctx.groove(swung)
+
+local started = false
+
+function on_beat(ctx, beat)
+  if not started then
+    kick:play()
+    hats:play()
+    started = true
+  end
+  if beat % 16 == 0 then
+    ctx.groove((beat // 16) % 2 == 0 and swung or played)
+  end
+end
@@ -0,0 +1,34 @@
+-- harmonizer.lua
+-- Live harmonizer: every played note is doubled a diatonic third above in
+-- C major. Works with the transport stopped.
+
+local major = { 0, 2, 4, 5, 7, 9, 11 }
+local sounding = {}
+
+-- Third above `note` within C major (chromatic notes get a major third)
+local function third_above(note)
+  local pc = note % 12
+  for i, degree in ipairs(major) do
+    if degree == pc then
+      local target = major[(i + 1) % 7 + 1]
+      return note + (target - pc) % 12
+    end
+  end
+  return note + 4
+end
+
+function on_note_on(ctx, note, velocity, channel)
+  local harmony = third_above(note)
+  sounding[channel * 128 + note] = harmony
+  ctx.note_on(note, velocity, channel)
+  ctx.note_on(harmony, math.floor(velocity * 0.8), channel)
+end
+
+function on_note_off(ctx, note, channel)
+  local key = channel * 128 + note
+  ctx.note_off(note, channel)
+  if sounding[key] then
+    ctx.note_off(sounding[key], channel)
+    sounding[key] = nil
+  end
+end
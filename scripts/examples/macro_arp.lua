@@ -0,0 +1,25 @@
+-- macro_arp.lua
+-- Arpeggiates a C minor chord under host automation: Macro 1 sets the
+-- rate (1 to 4 notes per beat) and Macro 2 the range (1 to 3 octaves).
+
+local chord = { 60, 63, 67, 70 } -- C Eb G Bb
+
+ctx.spawn(function()
+  local i = 0
+  while true do
+    local rate = 1 + math.floor(ctx.param(1) * 3 + 0.5)
+    local octaves = 1 + math.floor(ctx.param(2) * 2 + 0.5)
+    local steps = #chord * octaves
+    i = i % steps
+    local pitch = chord[i % #chord + 1] + 12 * (i // #chord)
+    ctx.note(pitch, 90, 0.8 / rate)
+    i = i + 1
+    ctx.wait(1 / rate)
+  end
+end)
+
+function on_param(ctx, index, value)
+  if index == 2 then
+    ctx.log(string.format('Range: %d octaves', 1 + math.floor(value * 2 + 0.5)))
+  end
+end
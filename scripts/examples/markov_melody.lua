@@ -0,0 +1,45 @@
+-- markov_melody.lua
+-- Learns a melody model from a folder of MIDI files on the async worker,
+-- caches it on disk, then plays an endless line drawn from it with a
+-- seeded stream.
+
+local corpus = 'C:/Users/Public/Documents/MIDI' -- Folder of .mid files
+local rng = ctx.rng('markov')
+local requested = false
+
+-- Runs on the worker: the trained model crosses back as a string
+function learn(path)
+  local data = ctx.cache.get_or_compute({ 'markov', path }, function()
+    local model = ctx.markov.new({ order = 3, intervals = true, velocity_step = 16 })
+    model:train(path)
+    return model:save()
+  end)
+  return data
+end
+
+function on_beat(ctx, beat)
+  if not requested then
+    requested = true
+    ctx.async('learn', corpus)
+  end
+end
+
+function on_result(ctx, future, data, err)
+  if err then
+    ctx.log('Training failed: ' .. err)
+    return
+  end
+  local model = ctx.markov.load(data)
+  local info = model:info()
+  ctx.log(('Learned %d notes, %d contexts'):format(info.notes, info.contexts))
+
+  local walker = model:walk(rng, 60)
+  ctx.spawn(function()
+    while true do
+      local pitch, duration, velocity = walker:next()
+      if not pitch then return end
+      ctx.note(pitch, velocity, duration * 0.9)
+      ctx.wait(duration)
+    end
+  end)
+end
@@ -0,0 +1,24 @@
+-- random_walk.lua
+-- Weighted random melody from a seeded stream: steps are drawn from a
+-- compiled weight table, velocities drift with noise over the beat and
+-- timing and velocity are humanized. The instance seed is saved with the
+-- project, so every take of it plays the same line.
+
+local rng = ctx.rng('melody')
+local steps = ctx.weights({ 1, 4, 2, 4, 1 }, { -3, -1, 0, 1, 3 })
+local scale = { 0, 2, 3, 5, 7, 8, 10 } -- C natural minor
+local degree = 8
+
+function on_beat(ctx, beat)
+  if beat % 32 == 0 then
+    rng:reseed() -- Repeat the line every 8 bars
+    degree = 8
+  end
+
+  degree = math.max(1, math.min(15, degree + rng:choice(steps)))
+  local pitch = 48 + scale[(degree - 1) % 7 + 1] + 12 * ((degree - 1) // 7)
+  local velocity = 80 + math.floor(30 * rng:noise(beat / 8, 2))
+  if rng:chance(0.85) then
+    ctx.note(pitch, rng:humanize(velocity, 8), rng:humanize(0.45, 0.05))
+  end
+end
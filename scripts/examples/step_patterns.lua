@@ -0,0 +1,48 @@
+-- step_patterns.lua
+-- Native drum patterns: a Euclidean kick, a backbeat snare and probabilistic
+-- hats. Every 4 bars the kick swaps to a rotated variation on the next bar.
+
+local kick = ctx.pattern({
+  euclid = { 5, 16 },
+  notes = 36,
+  velocities = { 120, 90, 100 },
+  channel = 9,
+})
+
+local snare = ctx.pattern({
+  steps = { 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0.3 },
+  notes = 38,
+  velocities = 110,
+  channel = 9,
+})
+
+local hats = ctx.pattern({
+  steps = 16,
+  probability = { 1, 0.5, 0.8, 0.5 },
+  notes = 42,
+  velocities = { 90, 60 },
+  gates = 0.2,
+  channel = 9,
+})
+
+local started = false
+local variation = 0
+
+function on_beat(ctx, beat)
+  if not started then
+    kick:play()
+    snare:play()
+    hats:play()
+    started = true
+  end
+  if beat > 0 and beat % 16 == 0 then
+    variation = (variation + 1) % 4
+    kick:swap({
+      euclid = { 5 + variation, 16 },
+      rotate = variation * 2,
+      notes = 36,
+      velocities = { 120, 90, 100 },
+      channel = 9,
+    })
+  end
+end
@@ -0,0 +1,24 @@
+-- tasks.lua
+-- Sequences a riff and a counter-line as straight-line coroutine tasks.
+-- Each task sleeps natively between notes; no Lua runs while both wait.
+
+local riff = { 48, 55, 58, 60, 58, 55 }
+
+ctx.spawn(function()
+  while true do
+    for _, pitch in ipairs(riff) do
+      ctx.note(pitch, 100, 0.4)
+      ctx.wait(0.5)
+    end
+  end
+end)
+
+ctx.spawn(function()
+  ctx.wait(4) -- enter after one bar
+  while true do
+    ctx.note(72, 70, 1.5)
+    ctx.wait(3)
+    ctx.note(70, 70, 0.5)
+    ctx.wait(1)
+  end
+end)
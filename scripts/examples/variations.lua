@@ -0,0 +1,55 @@
+-- variations.lua
+-- Derives 16 variations of one phrase as lazy musica.transformations views
+-- (transposed, inverted in time, augmented, shaped in volume) and plays
+-- them in turn from a task. No notes are copied to build the variations.
+
+local musica = require('musica')
+
+local t = musica.transformations
+
+local phrase = musica.Figure({
+  duration = 4,
+  melody = {
+    { pitch = 60, duration = 0.5, volume = 0.8 },
+    { pitch = 62, duration = 0.5, volume = 0.7 },
+    { pitch = 64, duration = 1, volume = 0.9 },
+    { pitch = 67, duration = 0.5, volume = 0.7 },
+    { pitch = 65, duration = 0.5, volume = 0.7 },
+    { pitch = 64, duration = 1, volume = 0.8 },
+  },
+})
+
+local c_major = musica.Scale(musica.Pitch.c4, musica.Mode.major)
+local base = t.view(phrase)
+
+local variations = {}
+for i = 0, 15 do
+  local v = base:scalewise_transpose(c_major, i % 5)
+  if i % 2 == 1 then
+    v = v:retrograde()
+  end
+  if i % 4 == 3 then
+    v = v:augment(2)
+  end
+  variations[#variations + 1] = v:crescendo(0.5, 1.0)
+end
+
+local function play(view)
+  local now = 0
+  for _, pitch, time, duration, volume in view:notes() do
+    if time > now then
+      ctx.wait(time - now)
+      now = time
+    end
+    ctx.note(pitch, math.floor(volume * 127), duration * 0.9)
+  end
+  ctx.wait(view.duration - now)
+end
+
+ctx.spawn(function()
+  while true do
+    for _, view in ipairs(variations) do
+      play(view)
+    end
+  end
+end)
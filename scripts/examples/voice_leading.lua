@@ -0,0 +1,74 @@
+-- voice_leading.lua
+-- Plays a four-voice seventh-chord progression with minimum voice motion.
+-- Every 8 bars the async worker swaps the last two chords for a new pair
+-- and voices the progression again; its voice leader keeps the first six
+-- chords solved, so only the changed steps are searched.
+
+local musica = require('musica')
+local llx = require('llx')
+
+local Chord = musica.Chord
+local Pitch = musica.Pitch
+
+local function seventh(...)
+  return Chord({ pitches = llx.List({ ... }) })
+end
+
+local progression = {
+  seventh(Pitch.c4, Pitch.e4, Pitch.g4, Pitch.b4), -- Cmaj7
+  seventh(Pitch.a3, Pitch.c4, Pitch.e4, Pitch.g4), -- Am7
+  seventh(Pitch.d4, Pitch.f4, Pitch.a4, Pitch.c5), -- Dm7
+  seventh(Pitch.g3, Pitch.b3, Pitch.d4, Pitch.f4), -- G7
+  seventh(Pitch.e4, Pitch.g4, Pitch.b4, Pitch.d5), -- Em7
+  seventh(Pitch.a3, Pitch.c4, Pitch.e4, Pitch.g4), -- Am7
+}
+local endings = {
+  { seventh(Pitch.d4, Pitch.f4, Pitch.a4, Pitch.c5), seventh(Pitch.g3, Pitch.b3, Pitch.d4, Pitch.f4) },
+  { seventh(Pitch.f4, Pitch.a4, Pitch.c5, Pitch.e5), seventh(Pitch.g3, Pitch.b3, Pitch.d4, Pitch.f4) },
+  { seventh(Pitch.b3, Pitch.d4, Pitch.f4, Pitch.a4), seventh(Pitch.e4, Pitch.gsharp4, Pitch.b4, Pitch.d5) },
+}
+
+local voicings = {}
+
+-- Worker only: the leader lives in the worker state between jobs
+local leader
+
+function voice(ending)
+  leader = leader or musica.VoiceLeader({ low = 48, high = 74, voices = 4, max_leap = 5 })
+  local chords = { table.unpack(progression) }
+  chords[#chords + 1] = endings[ending][1]
+  chords[#chords + 1] = endings[ending][2]
+  local result, err = leader:set_chords(chords):solve_midi()
+  if not result then
+    error(err)
+  end
+  return result
+end
+
+function on_beat(ctx, beat)
+  if beat % 32 == 0 then
+    ctx.async('voice', (beat // 32) % #endings + 1)
+  end
+end
+
+function on_result(ctx, future, result, err)
+  if err then
+    ctx.log('Voice leading failed: ' .. err)
+  elseif result then
+    voicings = result
+  end
+end
+
+ctx.spawn(function()
+  while true do
+    if #voicings == 0 then
+      ctx.wait(1)
+    end
+    for _, voicing in ipairs(voicings) do
+      for _, pitch in ipairs(voicing) do
+        ctx.note(pitch, 80, 3.8)
+      end
+      ctx.wait(4)
+    end
+  end
+end)
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace FLLua {
+
+// Last controller and pitch-bend values sent per channel, used to drop
+// ramp points that would not change anything on the receiving end. Every
+// send updates it; only ramp points are ever dropped, and never on data
+// entry or channel-mode controllers, whose repeats are meaningful.
+class ControllerCache {
+ public:
+  ControllerCache() { reset(); }
+
+  // Returns false if a ramp point repeats the controller's last value
+  bool updateCC(uint8_t channel, uint8_t controller, uint8_t value,
+                bool ramp) {
+    auto& last = m_cc[(channel & 0x0F) * 128 + (controller & 0x7F)];
+    if (ramp && last == value && !repeatsMatter(controller)) return false;
+    last = value;
+    return true;
+  }
+
+  bool updatePitchBend(uint8_t channel, int16_t value, bool ramp) {
+    auto& last = m_bend[channel & 0x0F];
+    if (ramp && last == value) return false;
+    last = value;
+    return true;
+  }
+
+  // Data entry (6/38), increment/decrement (96/97) and channel-mode
+  // messages (120-127) act on every send
+  static bool repeatsMatter(uint8_t controller) {
+    return controller == 6 || controller == 38 || controller == 96 ||
+           controller == 97 || controller >= 120;
+  }
+
+  // Forget everything, e.g. when the script changes or the host may have
+  // reset its state
+  void reset() {
+    m_cc.fill(kUnknown);
+    m_bend.fill(kUnknown);
+  }
+
+ private:
+  static constexpr int16_t kUnknown = INT16_MIN;
+
+  std::array<int16_t, 16 * 128> m_cc;
+  std::array<int16_t, 16> m_bend;
+};
+
+}  // namespace FLLua
@@ -17,6 +17,7 @@ using LogQueue = moodycamel::ReaderWriterQueue<std::string>;
 // Message to swap script in the processor
 struct ScriptSwapMessage {
   std::string source;
+  int layer = 0;
 };
 using ScriptQueue = moodycamel::ReaderWriterQueue<ScriptSwapMessage>;
 
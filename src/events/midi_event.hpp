@@ -23,21 +23,37 @@ struct CC {
   uint8_t value = 0;
   uint8_t channel = 0;
   int32_t sampleOffset = 0;
+  bool ramp = false;  // Rendered by a ramp; dropped if it repeats a value
 };
 
 struct PitchBend {
   int16_t value = 0;
   uint8_t channel = 0;
   int32_t sampleOffset = 0;
+  bool ramp = false;
 };
 
 using MidiEvent = std::variant<NoteOn, NoteOff, CC, PitchBend>;
 
+inline int32_t sampleOffsetOf(const MidiEvent& event) {
+  return std::visit([](const auto& ev) { return ev.sampleOffset; }, event);
+}
+
+// Event stamped with an absolute beat position (lookahead generation)
+struct TimedEvent {
+  double beat = 0.0;
+  MidiEvent event;
+  uint32_t generation = 0;
+};
+
 // Scheduled note-off (for ctx.note with duration)
 struct ScheduledNoteOff {
   uint8_t note;
   uint8_t channel;
   double endBeat;
+  // Due on the layer's sample clock instead when set (>= 0): notes started
+  // while the transport is stopped, where beats stand still
+  int64_t endSample = -1;
 };
 
 }  // namespace FLLua
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace FLLua {
+
+// Per-block copy of the macro parameters' automation points. The processor
+// fills it at the start of a block; scripts read it for the rest of the
+// block without touching host interfaces or allocating.
+class ParamSnapshot {
+ public:
+  static constexpr int kNumParams = 8;
+  static constexpr int kMaxPoints = 64;  // Per parameter and block
+
+  // Carry the previous block's final values over and drop its points
+  void beginBlock() {
+    for (auto& lane : m_lanes) {
+      lane.startValue = lane.endValue;
+      lane.count = 0;
+      lane.changed = false;
+    }
+  }
+
+  // Points must arrive in sample order, as VST3 queues deliver them
+  void addPoint(int param, int32_t sampleOffset, double value) {
+    if (param < 0 || param >= kNumParams) return;
+    auto& lane = m_lanes[param];
+    if (lane.count == kMaxPoints) {
+      lane.points[kMaxPoints - 1] = Point{sampleOffset, value};  // Keep last
+    } else {
+      lane.points[lane.count++] = Point{sampleOffset, value};
+    }
+    lane.changed = lane.changed || value != lane.endValue;
+    lane.endValue = value;
+  }
+
+  // Set a value outside of automation (state restore)
+  void set(int param, double value) {
+    if (param < 0 || param >= kNumParams) return;
+    auto& lane = m_lanes[param];
+    lane.startValue = lane.endValue = value;
+    lane.count = 0;
+  }
+
+  // Value at the end of the block
+  double value(int param) const { return m_lanes[param].endValue; }
+
+  // Piecewise-linear value at a sample offset in the current block. Before
+  // the first point the value ramps from the previous block's final value.
+  double valueAt(int param, int32_t sampleOffset) const {
+    const auto& lane = m_lanes[param];
+    double prevValue = lane.startValue;
+    int32_t prevOffset = 0;
+    for (int i = 0; i < lane.count; ++i) {
+      const auto& point = lane.points[i];
+      if (sampleOffset < point.sampleOffset) {
+        double span = point.sampleOffset - prevOffset;
+        double t = span > 0 ? (sampleOffset - prevOffset) / span : 1.0;
+        return prevValue + (point.value - prevValue) * std::clamp(t, 0.0, 1.0);
+      }
+      prevValue = point.value;
+      prevOffset = point.sampleOffset;
+    }
+    return prevValue;
+  }
+
+  // Whether the value moved during the current block
+  bool changed(int param) const { return m_lanes[param].changed; }
+
+  // Offset of the block's last automation point, 0 without points
+  int32_t lastOffset(int param) const {
+    const auto& lane = m_lanes[param];
+    return lane.count ? lane.points[lane.count - 1].sampleOffset : 0;
+  }
+
+ private:
+  struct Point {
+    int32_t sampleOffset;
+    double value;
+  };
+
+  struct Lane {
+    std::array<Point, kMaxPoints> points{};
+    int count = 0;
+    double startValue = 0.0;
+    double endValue = 0.0;
+    bool changed = false;
+  };
+
+  std::array<Lane, kNumParams> m_lanes;
+};
+
+}  // namespace FLLua
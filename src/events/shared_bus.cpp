@@ -0,0 +1,118 @@
+#include "shared_bus.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+namespace FLLua {
+
+// Attempts at a consistent copy before a busy record is skipped
+static constexpr int kReadRetries = 4;
+
+SharedBus& SharedBus::instance() {
+  static SharedBus bus;
+  return bus;
+}
+
+int SharedBus::channel(std::string_view name) {
+  if (name.empty() || name.size() > kMaxNameLength) return -1;
+
+  // Open addressing: every instance probes the same slots for a name, so
+  // concurrent first publications agree on one channel
+  size_t start = std::hash<std::string_view>{}(name) % kMaxChannels;
+  for (int probe = 0; probe < kMaxChannels; ++probe) {
+    int index = static_cast<int>((start + probe) % kMaxChannels);
+    auto& channel = m_channels[index];
+
+    int state = channel.state.load(std::memory_order_acquire);
+    if (state == kFree &&
+        channel.state.compare_exchange_strong(state, kClaimed,
+                                              std::memory_order_acquire)) {
+      std::memcpy(channel.name, name.data(), name.size());
+      channel.name[name.size()] = '\0';
+      channel.state.store(kReady, std::memory_order_release);
+      return index;
+    }
+
+    // Another thread is naming the slot, maybe with this name: the caller
+    // tries again rather than wait on the audio thread
+    if (state != kReady) return kBusy;
+    if (name == channel.name) return index;
+  }
+  return -1;
+}
+
+bool SharedBus::publish(int channel, double beat, const double* values,
+                        int count, bool isArray) {
+  auto& ch = m_channels[channel];
+  uint64_t serial = ch.published.fetch_add(1, std::memory_order_relaxed) + 1;
+  auto& record = ch.records[serial % kHistory];
+
+  // Enter the record's seqlock. A writer only finds it taken when kHistory
+  // publications overlap one write; it drops its own rather than spin.
+  uint32_t seq = record.seq.load(std::memory_order_relaxed);
+  if ((seq & 1) || !record.seq.compare_exchange_strong(
+                       seq, seq + 1, std::memory_order_relaxed)) {
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+
+  count = std::clamp(count, 0, kMaxValues);
+  record.serial.store(serial, std::memory_order_relaxed);
+  record.beat.store(beat, std::memory_order_relaxed);
+  record.count.store(count, std::memory_order_relaxed);
+  record.isArray.store(isArray, std::memory_order_relaxed);
+  for (int i = 0; i < count; ++i) {
+    record.values[i].store(values[i], std::memory_order_relaxed);
+  }
+
+  record.seq.store(seq + 2, std::memory_order_release);
+  return true;
+}
+
+bool SharedBus::read(int channel, double beat, Snapshot& out) const {
+  const auto& ch = m_channels[channel];
+
+  // Pick among the history by serial, since records fill in any order
+  uint64_t bestSerial = 0;
+  uint64_t latestSerial = 0;
+  Snapshot candidate;
+  Snapshot latest;
+  for (const auto& record : ch.records) {
+    uint64_t serial = 0;
+    if (!readRecord(record, serial, candidate) || serial == 0) continue;
+    if (serial > latestSerial) {
+      latestSerial = serial;
+      latest = candidate;
+    }
+    if (candidate.beat <= beat && serial > bestSerial) {
+      bestSerial = serial;
+      out = candidate;
+    }
+  }
+
+  if (bestSerial == 0 && latestSerial > 0) out = latest;
+  return latestSerial > 0;
+}
+
+bool SharedBus::readRecord(const Record& record, uint64_t& serial,
+                           Snapshot& out) {
+  for (int attempt = 0; attempt < kReadRetries; ++attempt) {
+    uint32_t before = record.seq.load(std::memory_order_acquire);
+    if (before & 1) continue;
+
+    serial = record.serial.load(std::memory_order_relaxed);
+    out.beat = record.beat.load(std::memory_order_relaxed);
+    out.count = record.count.load(std::memory_order_relaxed);
+    out.isArray = record.isArray.load(std::memory_order_relaxed);
+    for (int i = 0; i < out.count; ++i) {
+      out.values[i] = record.values[i].load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (record.seq.load(std::memory_order_relaxed) == before) return true;
+  }
+  return false;
+}
+
+}  // namespace FLLua
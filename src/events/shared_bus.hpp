@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+namespace FLLua {
+
+// Process-wide publish/subscribe store shared by every plugin instance in
+// the host process. Channels are named and hold small arrays of numbers.
+// Each publication is stamped with the publisher's beat and kept in a short
+// history, so a follower reads the value that applied at the beat it is
+// rendering. Nothing waits: every history record is a seqlock, readers
+// retry a few times, and a writer that finds its record or channel busy
+// drops the publication instead of spinning.
+class SharedBus {
+ public:
+  static constexpr int kMaxChannels = 64;
+  static constexpr int kMaxValues = 16;
+  static constexpr int kHistory = 8;  // Publications kept per channel
+  static constexpr size_t kMaxNameLength = 31;
+  static constexpr int kBusy = -2;  // Channel is being created, try later
+
+  struct Snapshot {
+    double beat = 0.0;
+    int count = 0;
+    bool isArray = false;  // Published as a table rather than a number
+    std::array<double, kMaxValues> values{};
+  };
+
+  static SharedBus& instance();
+
+  // Index of the named channel, created on first use. -1 when the name is
+  // too long or every channel is taken, kBusy while another thread is
+  // naming a slot the name probes.
+  int channel(std::string_view name);
+
+  // False when the publication was dropped because another writer still
+  // held its history record
+  bool publish(int channel, double beat, const double* values, int count,
+               bool isArray);
+
+  // Latest publication stamped at or before `beat`, or the latest one if
+  // all are later (e.g. after the transport jumped back). False when the
+  // channel was never published.
+  bool read(int channel, double beat, Snapshot& out) const;
+
+ private:
+  struct Record {
+    std::atomic<uint32_t> seq{0};     // Odd while a writer is inside
+    std::atomic<uint64_t> serial{0};  // Publication number, 0 = empty
+    std::atomic<double> beat{0.0};
+    std::atomic<int> count{0};
+    std::atomic<bool> isArray{false};
+    std::array<std::atomic<double>, kMaxValues> values{};
+  };
+
+  struct Channel {
+    std::atomic<int> state{0};  // kFree, kClaimed or kReady
+    char name[kMaxNameLength + 1] = {};
+    std::atomic<uint64_t> published{0};
+    std::array<Record, kHistory> records;
+  };
+
+  static constexpr int kFree = 0;
+  static constexpr int kClaimed = 1;
+  static constexpr int kReady = 2;
+
+  static bool readRecord(const Record& record, uint64_t& serial,
+                         Snapshot& out);
+
+  std::array<Channel, kMaxChannels> m_channels;
+};
+
+}  // namespace FLLua
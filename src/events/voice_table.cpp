@@ -0,0 +1,50 @@
+#include "voice_table.hpp"
+
+#include <algorithm>
+
+namespace FLLua {
+
+VoiceTable::NoteOnResult VoiceTable::noteOn(uint8_t channel, uint8_t note,
+                                            int64_t time) {
+  uint16_t key = keyFor(channel, note);
+  auto& voice = m_voices[key];
+  NoteOnResult result{nextNoteId(), -1};
+
+  if (m_active.test(key)) {
+    // Retrigger: end the sounding note so the new one articulates, and
+    // keep counting so the earlier note's off does not cut the new one
+    result.retriggeredId = voice.noteId;
+    if (voice.refs < 255) ++voice.refs;
+  } else {
+    m_active.set(key);
+    m_slotOf[key] = static_cast<int16_t>(m_activeCount);
+    m_activeKeys[m_activeCount++] = key;
+    m_peak = std::max(m_peak, m_activeCount);
+    voice.refs = 1;
+  }
+  voice.noteId = result.noteId;
+  voice.startTime = time;
+  voice.warned = false;
+  return result;
+}
+
+int32_t VoiceTable::noteOff(uint8_t channel, uint8_t note) {
+  uint16_t key = keyFor(channel, note);
+  if (!m_active.test(key)) return -1;
+
+  auto& voice = m_voices[key];
+  if (--voice.refs > 0) return -1;
+
+  int32_t noteId = voice.noteId;
+  voice = Voice{};
+  m_active.reset(key);
+
+  // Swap-remove from the dense list
+  int slot = m_slotOf[key];
+  uint16_t last = m_activeKeys[--m_activeCount];
+  m_activeKeys[slot] = last;
+  m_slotOf[last] = static_cast<int16_t>(slot);
+  return noteId;
+}
+
+}  // namespace FLLua
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+
+namespace FLLua {
+
+// Sounding notes on the output bus, keyed by channel and pitch. Every
+// output event passes through the table in sample order, so overlapping
+// note-ons of the same pitch are reference counted and only the last
+// note-off is sent, and stop/panic releases exactly the sounding notes.
+class VoiceTable {
+ public:
+  static constexpr int kChannels = 16;
+  static constexpr int kNotes = 128;
+  static constexpr int kKeys = kChannels * kNotes;
+
+  struct NoteOnResult {
+    int32_t noteId;         // VST3 note id for the new note
+    int32_t retriggeredId;  // Id to release first on a retrigger, else -1
+  };
+
+  // `time` is a monotonic sample clock used for stuck-note detection
+  NoteOnResult noteOn(uint8_t channel, uint8_t note, int64_t time);
+
+  // Returns the note id to release, or -1 when nothing should be sent
+  // (the note is not sounding or is still held by a later note-on)
+  int32_t noteOff(uint8_t channel, uint8_t note);
+
+  // Call fn(channel, note, noteId) for every sounding note and clear
+  template <typename Fn>
+  void releaseAll(Fn&& fn) {
+    for (int i = 0; i < m_activeCount; ++i) {
+      uint16_t key = m_activeKeys[i];
+      fn(static_cast<uint8_t>(key / kNotes),
+         static_cast<uint8_t>(key % kNotes), m_voices[key].noteId);
+      m_voices[key] = Voice{};
+      m_active.reset(key);
+    }
+    m_activeCount = 0;
+  }
+
+  // Call fn(channel, note, heldTime) once for each note sounding longer
+  // than maxTime
+  template <typename Fn>
+  void reportStuck(int64_t time, int64_t maxTime, Fn&& fn) {
+    for (int i = 0; i < m_activeCount; ++i) {
+      auto& voice = m_voices[m_activeKeys[i]];
+      if (voice.warned || time - voice.startTime <= maxTime) continue;
+      voice.warned = true;
+      uint16_t key = m_activeKeys[i];
+      fn(static_cast<uint8_t>(key / kNotes),
+         static_cast<uint8_t>(key % kNotes), time - voice.startTime);
+    }
+  }
+
+  bool isSounding(uint8_t channel, uint8_t note) const {
+    return m_active.test(keyFor(channel, note));
+  }
+  int activeCount() const { return m_activeCount; }
+
+  // Most voices sounding at once since the last call
+  int takePeak() {
+    int peak = m_peak;
+    m_peak = m_activeCount;
+    return peak;
+  }
+
+ private:
+  struct Voice {
+    int64_t startTime = 0;
+    int32_t noteId = -1;
+    uint8_t refs = 0;
+    bool warned = false;
+  };
+
+  static uint16_t keyFor(uint8_t channel, uint8_t note) {
+    return static_cast<uint16_t>((channel & 0x0F) * kNotes + (note & 0x7F));
+  }
+
+  int32_t nextNoteId() {
+    m_nextNoteId = (m_nextNoteId + 1) & 0x7FFFFFFF;
+    return m_nextNoteId;
+  }
+
+  std::bitset<kKeys> m_active;
+  std::array<Voice, kKeys> m_voices{};
+  // Dense list of sounding keys so release and scans touch only live voices
+  std::array<uint16_t, kKeys> m_activeKeys{};
+  std::array<int16_t, kKeys> m_slotOf{};  // Index into m_activeKeys
+  int m_activeCount = 0;
+  int m_peak = 0;
+  int32_t m_nextNoteId = 0;
+};
+
+}  // namespace FLLua
@@ -0,0 +1,348 @@
+#include "fd_solver.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+namespace FLLua {
+
+static int64_t floorDiv(int64_t a, int64_t b) {
+  int64_t q = a / b;
+  if (a % b != 0 && ((a < 0) != (b < 0))) --q;
+  return q;
+}
+
+static int64_t ceilDiv(int64_t a, int64_t b) {
+  int64_t q = a / b;
+  if (a % b != 0 && ((a < 0) == (b < 0))) ++q;
+  return q;
+}
+
+static bool hasResidue(const FdSolver::Constraint& c, int64_t value) {
+  int64_t r = ((value % c.modulus) + c.modulus) % c.modulus;
+  return (c.residues >> r) & 1;
+}
+
+int FdSolver::addVariable(std::vector<int32_t> values) {
+  std::sort(values.begin(), values.end());
+  values.erase(std::unique(values.begin(), values.end()), values.end());
+  m_values.push_back(std::move(values));
+  return static_cast<int>(m_values.size()) - 1;
+}
+
+void FdSolver::add(Constraint constraint) {
+  m_constraints.push_back(std::move(constraint));
+}
+
+FdSolver::Result FdSolver::solve(const Options& options) {
+  Result result;
+  m_options = options;
+  m_random = options.seed;
+  m_deadline = std::chrono::steady_clock::now() +
+               std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                   std::chrono::duration<double>(options.budgetSeconds));
+
+  // Every domain starts full
+  int numVars = numVariables();
+  m_bitOffset.assign(numVars, 0);
+  size_t words = 0;
+  for (int v = 0; v < numVars; ++v) {
+    m_bitOffset[v] = words * 64;
+    words += (m_values[v].size() + 63) / 64;
+  }
+  m_state.lo.assign(numVars, 0);
+  m_state.hi.assign(numVars, 0);
+  m_state.bits.assign(words, ~uint64_t{0});
+  for (int v = 0; v < numVars; ++v) {
+    if (m_values[v].empty()) return result;  // Nothing satisfies it
+    m_state.hi[v] = static_cast<int32_t>(m_values[v].size()) - 1;
+  }
+
+  // Per-depth scratch, sized up front so references stay valid
+  m_trail.resize(numVars + 1);
+  m_active.resize(numVars + 2);
+  m_orders.resize(numVars + 1);
+  m_active[0].clear();
+  for (const auto& constraint : m_constraints) {
+    m_active[0].push_back(&constraint);
+  }
+
+  search(0, result);
+  if (!result.solutions.empty()) {
+    result.status = Status::Sat;
+  } else {
+    result.status = result.complete ? Status::Unsat : Status::Unknown;
+  }
+  return result;
+}
+
+bool FdSolver::search(int depth, Result& result) {
+  if ((++result.nodes & 1023) == 0 &&
+      std::chrono::steady_clock::now() > m_deadline) {
+    result.complete = false;
+    return false;
+  }
+
+  auto& active = m_active[depth];
+  if (!propagate(active)) return true;
+
+  int var = chooseVariable();
+  if (var < 0) {
+    auto& solution = result.solutions.emplace_back(numVariables());
+    for (int v = 0; v < numVariables(); ++v) {
+      solution[v] = m_values[v][m_state.lo[v]];
+    }
+    return static_cast<int>(result.solutions.size()) < m_options.maxSolutions;
+  }
+
+  // Constraints entailed here stay entailed below
+  auto& next = m_active[depth + 1];
+  next.clear();
+  for (const auto* constraint : active) {
+    if (!entailed(*constraint)) next.push_back(constraint);
+  }
+
+  auto& order = m_orders[depth];
+  order.clear();
+  for (int32_t i = m_state.lo[var]; i <= m_state.hi[var]; ++i) {
+    if (alive(var, i)) order.push_back(i);
+  }
+  if (m_options.seed != 0) {
+    for (size_t i = order.size(); i > 1; --i) {
+      std::swap(order[i - 1], order[nextRandom() % i]);
+    }
+  }
+
+  m_trail[depth] = m_state;
+  for (int32_t index : order) {
+    m_state.lo[var] = m_state.hi[var] = index;
+    if (!search(depth + 1, result)) return false;
+    m_state = m_trail[depth];
+  }
+  return true;
+}
+
+int FdSolver::chooseVariable() const {
+  int best = -1;
+  int32_t bestSize = 0;
+  for (int v = 0; v < numVariables(); ++v) {
+    if (m_state.lo[v] == m_state.hi[v]) continue;
+    int32_t s = size(v);
+    if (best < 0 || s < bestSize) {
+      best = v;
+      bestSize = s;
+    }
+  }
+  return best;
+}
+
+uint64_t FdSolver::nextRandom() {
+  // splitmix64
+  uint64_t z = (m_random += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+bool FdSolver::alive(int var, int32_t index) const {
+  if (index < m_state.lo[var] || index > m_state.hi[var]) return false;
+  size_t bit = m_bitOffset[var] + index;
+  return (m_state.bits[bit / 64] >> (bit % 64)) & 1;
+}
+
+int32_t FdSolver::size(int var) const {
+  size_t first = m_bitOffset[var] + m_state.lo[var];
+  size_t last = m_bitOffset[var] + m_state.hi[var];
+  int32_t count = 0;
+  for (size_t word = first / 64; word <= last / 64; ++word) {
+    uint64_t bits = m_state.bits[word];
+    if (word == first / 64) bits &= ~uint64_t{0} << (first % 64);
+    if (word == last / 64 && last % 64 != 63) {
+      bits &= (uint64_t{1} << (last % 64 + 1)) - 1;
+    }
+    count += std::popcount(bits);
+  }
+  return count;
+}
+
+bool FdSolver::removeIndex(int var, int32_t index) {
+  if (!alive(var, index)) return true;
+  size_t bit = m_bitOffset[var] + index;
+  m_state.bits[bit / 64] &= ~(uint64_t{1} << (bit % 64));
+  m_changed = true;
+
+  // Keep lo and hi on live values
+  auto& lo = m_state.lo[var];
+  auto& hi = m_state.hi[var];
+  if (index == lo) {
+    ++lo;
+    while (lo <= hi && !alive(var, lo)) ++lo;
+  }
+  if (index == hi) {
+    --hi;
+    while (hi >= lo && !alive(var, hi)) --hi;
+  }
+  return lo <= hi;
+}
+
+bool FdSolver::restrict(int var, int64_t min, int64_t max) {
+  const auto& values = m_values[var];
+  auto& lo = m_state.lo[var];
+  auto& hi = m_state.hi[var];
+  if (values[lo] < min) {
+    while (lo <= hi && (values[lo] < min || !alive(var, lo))) ++lo;
+    m_changed = true;
+  }
+  if (lo <= hi && values[hi] > max) {
+    while (hi >= lo && (values[hi] > max || !alive(var, hi))) --hi;
+    m_changed = true;
+  }
+  return lo <= hi;
+}
+
+bool FdSolver::propagate(const std::vector<const Constraint*>& active) {
+  do {
+    m_changed = false;
+    for (const auto* constraint : active) {
+      if (!propagate(*constraint)) return false;
+    }
+  } while (m_changed);
+  return true;
+}
+
+void FdSolver::bounds(const Constraint& c, int64_t& min, int64_t& max) const {
+  min = max = 0;
+  for (const auto& term : c.terms) {
+    int64_t low = term.coef * minValue(term.var);
+    int64_t high = term.coef * maxValue(term.var);
+    if (term.coef < 0) std::swap(low, high);
+    min += low;
+    max += high;
+  }
+}
+
+bool FdSolver::propagate(const Constraint& c) {
+  switch (c.kind) {
+    case Constraint::Kind::Linear: {
+      int64_t sumMin, sumMax;
+      bounds(c, sumMin, sumMax);
+      if (sumMin > c.max || sumMax < c.min) return false;
+      if (sumMin >= c.min && sumMax <= c.max) return true;
+
+      for (const auto& term : c.terms) {
+        int64_t low = term.coef * minValue(term.var);
+        int64_t high = term.coef * maxValue(term.var);
+        if (term.coef < 0) std::swap(low, high);
+
+        // What this term may contribute given the others' bounds
+        int64_t lowProduct =
+            c.min <= -kInfinity ? -kInfinity : c.min - (sumMax - high);
+        int64_t highProduct =
+            c.max >= kInfinity ? kInfinity : c.max - (sumMin - low);
+        int64_t min = -kInfinity;
+        int64_t max = kInfinity;
+        if (term.coef > 0) {
+          if (lowProduct > -kInfinity) min = ceilDiv(lowProduct, term.coef);
+          if (highProduct < kInfinity) max = floorDiv(highProduct, term.coef);
+        } else {
+          if (highProduct < kInfinity) min = ceilDiv(highProduct, term.coef);
+          if (lowProduct > -kInfinity) max = floorDiv(lowProduct, term.coef);
+        }
+        if (!restrict(term.var, min, max)) return false;
+      }
+      return true;
+    }
+
+    case Constraint::Kind::Residue: {
+      for (int32_t i = m_state.lo[c.var]; i <= m_state.hi[c.var]; ++i) {
+        if (alive(c.var, i) && !hasResidue(c, m_values[c.var][i]) &&
+            !removeIndex(c.var, i)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    case Constraint::Kind::AnyOf: {
+      const std::vector<Constraint>* only = nullptr;
+      int possible = 0;
+      for (const auto& alternative : c.alternatives) {
+        bool ok = std::none_of(
+            alternative.begin(), alternative.end(),
+            [this](const Constraint& part) { return violated(part); });
+        if (!ok) continue;
+        if (std::all_of(
+                alternative.begin(), alternative.end(),
+                [this](const Constraint& part) { return entailed(part); })) {
+          return true;
+        }
+        ++possible;
+        only = &alternative;
+      }
+      if (possible == 0) return false;
+
+      // A single way left to satisfy it: enforce that one
+      if (possible == 1) {
+        for (const auto& part : *only) {
+          if (!propagate(part)) return false;
+        }
+      }
+      return true;
+    }
+  }
+  return true;
+}
+
+bool FdSolver::violated(const Constraint& c) const {
+  switch (c.kind) {
+    case Constraint::Kind::Linear: {
+      int64_t sumMin, sumMax;
+      bounds(c, sumMin, sumMax);
+      return sumMin > c.max || sumMax < c.min;
+    }
+    case Constraint::Kind::Residue:
+      for (int32_t i = m_state.lo[c.var]; i <= m_state.hi[c.var]; ++i) {
+        if (alive(c.var, i) && hasResidue(c, m_values[c.var][i])) {
+          return false;
+        }
+      }
+      return true;
+    case Constraint::Kind::AnyOf:
+      return std::all_of(
+          c.alternatives.begin(), c.alternatives.end(),
+          [this](const std::vector<Constraint>& alternative) {
+            return std::any_of(
+                alternative.begin(), alternative.end(),
+                [this](const Constraint& part) { return violated(part); });
+          });
+  }
+  return false;
+}
+
+bool FdSolver::entailed(const Constraint& c) const {
+  switch (c.kind) {
+    case Constraint::Kind::Linear: {
+      int64_t sumMin, sumMax;
+      bounds(c, sumMin, sumMax);
+      return sumMin >= c.min && sumMax <= c.max;
+    }
+    case Constraint::Kind::Residue:
+      for (int32_t i = m_state.lo[c.var]; i <= m_state.hi[c.var]; ++i) {
+        if (alive(c.var, i) && !hasResidue(c, m_values[c.var][i])) {
+          return false;
+        }
+      }
+      return true;
+    case Constraint::Kind::AnyOf:
+      return std::any_of(
+          c.alternatives.begin(), c.alternatives.end(),
+          [this](const std::vector<Constraint>& alternative) {
+            return std::all_of(
+                alternative.begin(), alternative.end(),
+                [this](const Constraint& part) { return entailed(part); });
+          });
+  }
+  return false;
+}
+
+}  // namespace FLLua
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace FLLua {
+
+// Finite-domain constraint solver for musica.generation. Variables range
+// over small sorted integer domains (MIDI pitches, scaled durations and
+// volumes); constraints are linear ranges, residues and disjunctions of
+// those. Search is depth-first with bounds propagation and smallest-domain
+// variable choice, stopped by a wall-clock budget.
+class FdSolver {
+ public:
+  static constexpr int64_t kInfinity = int64_t{1} << 60;
+  static constexpr size_t kMaxDomain = 4096;  // Values per variable
+
+  struct Term {
+    int var;
+    int64_t coef;
+  };
+
+  struct Constraint {
+    enum class Kind : uint8_t { Linear, Residue, AnyOf };
+    Kind kind = Kind::Linear;
+
+    // Linear: min <= sum(coef * var) <= max
+    std::vector<Term> terms;
+    int64_t min = -kInfinity;
+    int64_t max = kInfinity;
+
+    // Residue: var mod modulus (1-64) is one of the bits of `residues`
+    int var = -1;
+    int64_t modulus = 0;
+    uint64_t residues = 0;
+
+    // AnyOf: at least one alternative holds in full
+    std::vector<std::vector<Constraint>> alternatives;
+  };
+
+  struct Options {
+    int maxSolutions = 1;
+    double budgetSeconds = 1.0;
+    uint64_t seed = 0;  // 0 tries values in ascending order
+  };
+
+  enum class Status { Sat, Unsat, Unknown };  // Unknown: out of time
+
+  struct Result {
+    Status status = Status::Unsat;
+    std::vector<std::vector<int32_t>> solutions;  // Values per variable
+    int64_t nodes = 0;
+    bool complete = true;  // Search finished within the budget
+  };
+
+  // Returns the variable's index. `values` need not be sorted.
+  int addVariable(std::vector<int32_t> values);
+  void add(Constraint constraint);
+
+  int numVariables() const { return static_cast<int>(m_values.size()); }
+
+  Result solve(const Options& options);
+
+ private:
+  // Live part of every domain: [lo, hi] indices into m_values plus a bit
+  // per value for holes
+  struct State {
+    std::vector<int32_t> lo;
+    std::vector<int32_t> hi;
+    std::vector<uint64_t> bits;
+  };
+
+  bool alive(int var, int32_t index) const;
+  int64_t minValue(int var) const { return m_values[var][m_state.lo[var]]; }
+  int64_t maxValue(int var) const { return m_values[var][m_state.hi[var]]; }
+  int32_t size(int var) const;
+  bool removeIndex(int var, int32_t index);
+  bool restrict(int var, int64_t min, int64_t max);
+
+  bool propagate(const std::vector<const Constraint*>& active);
+  bool propagate(const Constraint& constraint);
+  bool violated(const Constraint& constraint) const;
+  bool entailed(const Constraint& constraint) const;
+  void bounds(const Constraint& constraint, int64_t& min, int64_t& max) const;
+
+  // Returns false to stop: enough solutions or out of time
+  bool search(int depth, Result& result);
+  int chooseVariable() const;
+  uint64_t nextRandom();
+
+  std::vector<std::vector<int32_t>> m_values;  // Sorted, per variable
+  std::vector<size_t> m_bitOffset;
+  std::vector<Constraint> m_constraints;
+
+  State m_state;
+  std::vector<State> m_trail;  // Saved states by depth
+  std::vector<std::vector<const Constraint*>> m_active;  // Unentailed
+  std::vector<std::vector<int32_t>> m_orders;            // Values to try
+  bool m_changed = false;
+
+  Options m_options;
+  uint64_t m_random = 0;
+  std::chrono::steady_clock::time_point m_deadline;
+};
+
+}  // namespace FLLua
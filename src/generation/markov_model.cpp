@@ -0,0 +1,431 @@
+#include "markov_model.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "lua/random.hpp"
+#include "sequencing/midi_clip.hpp"
+
+namespace FLLua {
+
+namespace {
+
+constexpr char kMagic[4] = {'F', 'L', 'M', 'K'};
+constexpr uint8_t kVersion = 1;
+constexpr uint32_t kEmptySlot = UINT32_MAX;
+constexpr uint64_t kKeySeed = 0x6d61726b6f76ull;
+constexpr size_t kInitialCounts = 1024;  // Slots, a power of two
+
+void putVarint(std::string& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void putFixed(std::string& out, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+bool getVarint(std::string_view& data, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && !data.empty(); shift += 7) {
+    auto byte = static_cast<uint8_t>(data.front());
+    data.remove_prefix(1);
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+bool getFixed(std::string_view& data, uint64_t& value) {
+  if (data.size() < 8) return false;
+  value = 0;
+  for (int i = 0; i < 8; ++i) {
+    value |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+  }
+  data.remove_prefix(8);
+  return true;
+}
+
+double bitsToDouble(uint64_t bits) {
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+uint64_t doubleToBits(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+}  // namespace
+
+MarkovModel::MarkovModel() : MarkovModel(Options()) {}
+
+MarkovModel::MarkovModel(Options options) : m_options(options) {
+  m_options.order = std::clamp(m_options.order, 0, kMaxOrder);
+  m_options.velocityStep = std::clamp(m_options.velocityStep, 0, 127);
+  if (!(m_options.grid > 0.0)) m_options.grid = 0.25;
+}
+
+uint32_t MarkovModel::tokenFor(int value, double duration,
+                               int velocity) const {
+  uint32_t steps = 0;
+  if (m_options.durations) {
+    steps = static_cast<uint32_t>(
+        std::clamp(std::lround(duration / m_options.grid), 1l, 255l));
+  }
+  uint32_t bucket = 0;
+  if (m_options.velocityStep > 0) {
+    bucket = static_cast<uint32_t>(
+        std::min(velocity / m_options.velocityStep, 255));
+  }
+  return static_cast<uint32_t>(value) | steps << 8 | bucket << 16;
+}
+
+uint64_t MarkovModel::contextKey(const uint32_t* tokens, int length) {
+  uint64_t key = mixSeed(kKeySeed, static_cast<uint64_t>(length));
+  for (int i = 0; i < length; ++i) key = mixSeed(key, tokens[i]);
+  return key;
+}
+
+void MarkovModel::train(std::vector<Note> notes) {
+  if (m_frozen || notes.empty()) return;
+
+  // One note per onset: the highest of a chord carries the melody
+  std::stable_sort(
+      notes.begin(), notes.end(),
+      [](const Note& a, const Note& b) { return a.beat < b.beat; });
+  size_t count = 0;
+  for (const auto& note : notes) {
+    if (count > 0 && note.beat - notes[count - 1].beat < 1e-6) {
+      if (note.pitch > notes[count - 1].pitch) notes[count - 1] = note;
+    } else {
+      notes[count++] = note;
+    }
+  }
+  notes.resize(count);
+
+  std::vector<uint32_t> tokens;
+  tokens.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    const auto& note = notes[i];
+    m_velocitySum += note.velocity;
+    ++m_notes;
+
+    double duration = i + 1 < count ? notes[i + 1].beat - note.beat
+                                    : note.duration;
+    if (!(duration > 0.0)) duration = m_options.grid;
+    int value = note.pitch;
+    if (m_options.intervals) {
+      if (i == 0) continue;  // Only the start pitch
+      value = std::clamp(note.pitch - notes[i - 1].pitch, -127, 127) + 128;
+    }
+    tokens.push_back(tokenFor(value, duration, note.velocity));
+  }
+
+  for (size_t j = 0; j < tokens.size(); ++j) {
+    int longest = static_cast<int>(
+        std::min<size_t>(static_cast<size_t>(m_options.order), j));
+    for (int k = 0; k <= longest; ++k) {
+      addCount(contextKey(&tokens[j - k], k), tokens[j]);
+    }
+  }
+}
+
+void MarkovModel::addCount(uint64_t context, uint32_t token) {
+  // Grow at half full so probes stay short
+  if ((m_countsUsed + 1) * 2 > m_counts.size()) {
+    std::vector<Count> old;
+    old.swap(m_counts);
+    m_counts.assign(std::max(old.size() * 2, kInitialCounts), Count{});
+    m_countsUsed = 0;
+    for (const auto& entry : old) {
+      if (entry.count == 0) continue;
+      uint64_t mask = m_counts.size() - 1;
+      uint64_t slot = mixSeed(entry.context, entry.token) & mask;
+      while (m_counts[slot].count != 0) slot = (slot + 1) & mask;
+      m_counts[slot] = entry;
+      ++m_countsUsed;
+    }
+  }
+
+  uint64_t mask = m_counts.size() - 1;
+  for (uint64_t slot = mixSeed(context, token) & mask;;
+       slot = (slot + 1) & mask) {
+    auto& entry = m_counts[slot];
+    if (entry.count == 0) {
+      entry = Count{context, token, 1};
+      ++m_countsUsed;
+      return;
+    }
+    if (entry.context == context && entry.token == token) {
+      if (entry.count < UINT32_MAX) ++entry.count;
+      return;
+    }
+  }
+}
+
+std::string MarkovModel::trainSmf(const uint8_t* data, size_t size,
+                                  int channel) {
+  MidiClip clip;
+  auto error = clip.loadSmf(data, size);
+  if (!error.empty()) return error;
+
+  // Tracks were read one after another; merge them in time
+  auto events = clip.events();
+  std::stable_sort(
+      events.begin(), events.end(),
+      [](const ClipEvent& a, const ClipEvent& b) { return a.tick < b.tick; });
+
+  constexpr double kTicks = static_cast<double>(MidiClip::kTicksPerBeat);
+  std::array<std::vector<Note>, 16> lines;
+  std::array<int32_t, 16 * 128> sounding;
+  sounding.fill(-1);
+  for (const auto& event : events) {
+    auto& line = lines[event.channel()];
+    int32_t& held = sounding[event.channel() * 128 + (event.data1 & 0x7F)];
+    if (event.type() == 0x90) {
+      held = static_cast<int32_t>(line.size());
+      line.push_back(Note{event.tick / kTicks, event.data1, event.data2, 0.0});
+    } else if (event.type() == 0x80 && held >= 0) {
+      line[held].duration = event.tick / kTicks - line[held].beat;
+      held = -1;
+    }
+  }
+
+  for (int ch = 0; ch < 16; ++ch) {
+    if (channel >= 0 ? ch != channel : ch == 9) continue;
+    train(std::move(lines[ch]));
+  }
+  return {};
+}
+
+void MarkovModel::freeze() {
+  if (m_frozen) return;
+
+  // Group the counts by context, contexts in key order
+  std::vector<Count> counts;
+  counts.reserve(m_countsUsed);
+  for (const auto& entry : m_counts) {
+    if (entry.count != 0) counts.push_back(entry);
+  }
+  std::vector<Count>().swap(m_counts);
+  m_countsUsed = 0;
+  std::sort(counts.begin(), counts.end(),
+            [](const Count& a, const Count& b) {
+              return a.context != b.context ? a.context < b.context
+                                            : a.token < b.token;
+            });
+
+  std::vector<Transition> transitions;
+  for (size_t i = 0; i < counts.size();) {
+    transitions.clear();
+    size_t j = i;
+    for (; j < counts.size() && counts[j].context == counts[i].context; ++j) {
+      transitions.push_back({counts[j].token, counts[j].count});
+    }
+    addContext(counts[i].context, transitions);
+    i = j;
+  }
+  buildIndex();
+  m_frozen = true;
+}
+
+void MarkovModel::addContext(uint64_t key,
+                             const std::vector<Transition>& transitions) {
+  auto offset = static_cast<uint32_t>(m_tokens.size());
+  auto size = static_cast<uint32_t>(transitions.size());
+  m_contexts.push_back(Context{key, offset, size});
+
+  auto sorted = transitions;
+  std::sort(sorted.begin(), sorted.end(),
+            [](const Transition& a, const Transition& b) {
+              return a.token < b.token;
+            });
+  std::vector<double> weights(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    m_tokens.push_back(sorted[i].token);
+    m_weights.push_back(sorted[i].count);
+    weights[i] = sorted[i].count;
+  }
+  m_probabilities.resize(offset + size);
+  m_aliases.resize(offset + size);
+  buildAlias(weights.data(), size, m_probabilities.data() + offset,
+             m_aliases.data() + offset);
+}
+
+void MarkovModel::buildIndex() {
+  size_t capacity = 16;
+  while (capacity < m_contexts.size() * 2) capacity *= 2;
+  m_slots.assign(capacity, kEmptySlot);
+  m_slotMask = capacity - 1;
+  for (uint32_t i = 0; i < m_contexts.size(); ++i) {
+    uint64_t slot = m_contexts[i].key & m_slotMask;
+    while (m_slots[slot] != kEmptySlot) slot = (slot + 1) & m_slotMask;
+    m_slots[slot] = i;
+  }
+}
+
+const MarkovModel::Context* MarkovModel::find(uint64_t key) const {
+  if (m_slots.empty()) return nullptr;
+  for (uint64_t slot = key & m_slotMask;; slot = (slot + 1) & m_slotMask) {
+    uint32_t index = m_slots[slot];
+    if (index == kEmptySlot) return nullptr;
+    if (m_contexts[index].key == key) return &m_contexts[index];
+  }
+}
+
+bool MarkovModel::next(Walk& walk, Xoshiro256& rng, Step& out) const {
+  if (!m_frozen || m_contexts.empty()) return false;
+
+  // Longest context seen in training, down to no context at all
+  const Context* context = nullptr;
+  for (int k = std::min(m_options.order, walk.length); k >= 0 && !context;
+       --k) {
+    context = find(contextKey(walk.history.data() + walk.length - k, k));
+  }
+  if (!context) return false;
+
+  uint32_t index =
+      sampleAlias(m_probabilities.data() + context->offset,
+                  m_aliases.data() + context->offset, context->size, rng);
+  uint32_t token = m_tokens[context->offset + index];
+
+  if (m_options.order > 0) {
+    if (walk.length == m_options.order) {
+      std::copy(walk.history.begin() + 1,
+                walk.history.begin() + walk.length, walk.history.begin());
+      --walk.length;
+    }
+    walk.history[walk.length++] = token;
+  }
+
+  int value = static_cast<int>(token & 0xFF);
+  if (m_options.intervals) {
+    int pitch = walk.pitch + value - 128;
+    while (pitch > 127) pitch -= 12;
+    while (pitch < 0) pitch += 12;
+    walk.pitch = pitch;
+  } else {
+    walk.pitch = value;
+  }
+  out.pitch = walk.pitch;
+
+  uint32_t steps = (token >> 8) & 0xFF;
+  out.duration = m_options.durations ? steps * m_options.grid
+                                     : m_options.grid;
+
+  int step = m_options.velocityStep;
+  if (step > 0) {
+    out.velocity =
+        std::clamp(static_cast<int>((token >> 16) & 0xFF) * step + step / 2,
+                   1, 127);
+  } else {
+    out.velocity = m_notes > 0 ? static_cast<int>(std::lround(
+                                     m_velocitySum / m_notes))
+                               : 100;
+  }
+  return true;
+}
+
+std::string MarkovModel::serialize() const {
+  std::string out(kMagic, sizeof(kMagic));
+  out.push_back(static_cast<char>(kVersion));
+  out.push_back(static_cast<char>(m_options.order));
+  out.push_back(static_cast<char>((m_options.intervals ? 1 : 0) |
+                                  (m_options.durations ? 2 : 0)));
+  out.push_back(static_cast<char>(m_options.velocityStep));
+  putFixed(out, doubleToBits(m_options.grid));
+  putVarint(out, static_cast<uint64_t>(m_notes));
+  putFixed(out, doubleToBits(m_velocitySum));
+
+  putVarint(out, m_contexts.size());
+  for (const auto& context : m_contexts) {
+    putFixed(out, context.key);
+    putVarint(out, context.size);
+    for (uint32_t i = 0; i < context.size; ++i) {
+      putVarint(out, m_tokens[context.offset + i]);
+      putVarint(out, m_weights[context.offset + i]);
+    }
+  }
+  return out;
+}
+
+bool MarkovModel::deserialize(std::string_view data, MarkovModel& out) {
+  if (data.size() < 8 || data.substr(0, 4) != std::string_view(kMagic, 4) ||
+      static_cast<uint8_t>(data[4]) != kVersion) {
+    return false;
+  }
+  Options options;
+  options.order = static_cast<uint8_t>(data[5]);
+  options.intervals = data[6] & 1;
+  options.durations = data[6] & 2;
+  options.velocityStep = static_cast<uint8_t>(data[7]);
+  data.remove_prefix(8);
+
+  uint64_t gridBits = 0, notes = 0, velocityBits = 0, contexts = 0;
+  if (!getFixed(data, gridBits) || !getVarint(data, notes) ||
+      !getFixed(data, velocityBits) || !getVarint(data, contexts)) {
+    return false;
+  }
+  options.grid = bitsToDouble(gridBits);
+  if (options.order > kMaxOrder || !(options.grid > 0.0) ||
+      !std::isfinite(options.grid) || options.velocityStep > 127 ||
+      contexts > data.size()) {
+    return false;
+  }
+
+  MarkovModel model(options);
+  model.m_notes = static_cast<int64_t>(notes);
+  model.m_velocitySum = bitsToDouble(velocityBits);
+  std::vector<Transition> transitions;
+  for (uint64_t c = 0; c < contexts; ++c) {
+    uint64_t key = 0, size = 0;
+    if (!getFixed(data, key) || !getVarint(data, size) || size == 0 ||
+        size > data.size()) {
+      return false;
+    }
+    transitions.resize(size);
+    for (auto& transition : transitions) {
+      uint64_t token = 0, count = 0;
+      if (!getVarint(data, token) || !getVarint(data, count) ||
+          token > UINT32_MAX || count == 0 || count > UINT32_MAX) {
+        return false;
+      }
+      transition = {static_cast<uint32_t>(token),
+                    static_cast<uint32_t>(count)};
+    }
+    model.addContext(key, transitions);
+  }
+  if (!data.empty()) return false;
+
+  model.buildIndex();
+  model.m_frozen = true;
+  out = std::move(model);
+  return true;
+}
+
+size_t MarkovModel::contexts() const {
+  if (m_frozen) return m_contexts.size();
+  std::vector<uint64_t> keys;
+  keys.reserve(m_countsUsed);
+  for (const auto& entry : m_counts) {
+    if (entry.count != 0) keys.push_back(entry.context);
+  }
+  std::sort(keys.begin(), keys.end());
+  return static_cast<size_t>(
+      std::unique(keys.begin(), keys.end()) - keys.begin());
+}
+
+size_t MarkovModel::transitions() const {
+  return m_frozen ? m_tokens.size() : m_countsUsed;
+}
+
+}  // namespace FLLua
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace FLLua {
+
+class Xoshiro256;
+
+// Order-N Markov model of melodies. Each note becomes one token packing its
+// pitch (or interval from the previous note), the time to the next note on
+// a grid, and optionally a velocity bucket. Training counts transitions
+// from every context of 0 to N previous tokens in one flat open-addressing
+// table keyed by context and token; freezing compiles the counts into flat
+// alias tables indexed by an open-addressing table, so a sampling step is a
+// few hash probes and one alias draw, backing off to shorter contexts that
+// were never seen.
+class MarkovModel {
+ public:
+  static constexpr int kMaxOrder = 8;
+
+  struct Options {
+    int order = 2;
+    bool intervals = false;  // Tokens hold intervals instead of pitches
+    double grid = 0.25;      // Beats per duration step
+    bool durations = true;   // Model time to the next note
+    int velocityStep = 0;    // Velocity bucket width, 0 to not model them
+  };
+
+  // One note of a monophonic line, in beats
+  struct Note {
+    double beat = 0.0;
+    uint8_t pitch = 60;
+    uint8_t velocity = 100;
+    double duration = 1.0;
+  };
+
+  // Sampling state: the last tokens drawn and the current pitch
+  struct Walk {
+    std::array<uint32_t, kMaxOrder> history{};
+    int length = 0;
+    int pitch = 60;
+  };
+
+  // A generated note; `duration` is also the time to the next one
+  struct Step {
+    int pitch = 60;
+    int velocity = 100;
+    double duration = 0.25;
+  };
+
+  MarkovModel();
+  explicit MarkovModel(Options options);
+
+  const Options& options() const { return m_options; }
+
+  // Count the transitions of one line, sorted by beat. Notes starting
+  // together are reduced to the highest. Frozen models ignore training.
+  void train(std::vector<Note> notes);
+
+  // Train on every channel of a Standard MIDI File, or only on `channel`
+  // (0-15). With all channels, channel 10 (drums) is skipped. Returns an
+  // error message, empty on success.
+  std::string trainSmf(const uint8_t* data, size_t size, int channel = -1);
+
+  // Compile the counts into alias tables and release them
+  void freeze();
+  bool frozen() const { return m_frozen; }
+
+  // Draw the next note. Returns false when the model holds no notes.
+  bool next(Walk& walk, Xoshiro256& rng, Step& out) const;
+
+  // Compact encoding of a frozen model, and its inverse
+  std::string serialize() const;
+  static bool deserialize(std::string_view data, MarkovModel& out);
+
+  int64_t notes() const { return m_notes; }
+  size_t contexts() const;
+  size_t transitions() const;
+
+ private:
+  struct Transition {
+    uint32_t token;
+    uint32_t count;
+  };
+
+  struct Context {
+    uint64_t key;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  // Training count of one token after one context; count 0 marks a free
+  // slot
+  struct Count {
+    uint64_t context;
+    uint32_t token;
+    uint32_t count;
+  };
+
+  uint32_t tokenFor(int value, double duration, int velocity) const;
+  static uint64_t contextKey(const uint32_t* tokens, int length);
+  const Context* find(uint64_t key) const;
+  void addCount(uint64_t context, uint32_t token);
+  void addContext(uint64_t key, const std::vector<Transition>& transitions);
+  void buildIndex();
+
+  Options m_options;
+  bool m_frozen = false;
+  int64_t m_notes = 0;
+  double m_velocitySum = 0.0;
+
+  // Training: transition counts, open addressing on context and token
+  std::vector<Count> m_counts;
+  size_t m_countsUsed = 0;
+
+  // Frozen: contexts sorted by key, their transitions in flat arrays, and
+  // an open-addressing index from key to context
+  std::vector<Context> m_contexts;
+  std::vector<uint32_t> m_tokens;
+  std::vector<uint32_t> m_weights;
+  std::vector<float> m_probabilities;
+  std::vector<uint32_t> m_aliases;
+  std::vector<uint32_t> m_slots;
+  uint64_t m_slotMask = 0;
+};
+
+}  // namespace FLLua
@@ -0,0 +1,230 @@
+#include "voice_leader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdlib>
+
+namespace FLLua {
+
+namespace {
+
+// Motion is scaled so the first chord's distance from the center (below
+// 1024) only breaks ties between equally smooth progressions
+constexpr int kMotionShift = 10;
+
+// Depth-first enumeration of ascending voicings of one chord
+struct Enumerator {
+  const VoiceLeader::Options& options;
+  std::array<int, 12> toneOf;  // Chord tone index per pitch class, or -1
+  uint32_t required;
+  std::vector<uint8_t>& out;
+  size_t count = 0;
+  bool overflow = false;  // More voicings than kMaxCandidates
+  std::array<uint8_t, VoiceLeader::kMaxVoices> pitches{};
+  std::array<uint8_t, 12> uses{};
+
+  void run(int depth, uint32_t present) {
+    if (depth == options.voices) {
+      if ((present & required) != required) return;
+      if (count == VoiceLeader::kMaxCandidates) {
+        overflow = true;
+        return;
+      }
+      out.insert(out.end(), pitches.begin(), pitches.begin() + depth);
+      ++count;
+      return;
+    }
+    int first = depth == 0 ? options.low : pitches[depth - 1] + 1;
+    for (int pitch = first; pitch <= options.high; ++pitch) {
+      if (overflow) return;
+      if (depth >= 2 && pitch - pitches[depth - 1] > options.maxSpacing) {
+        return;
+      }
+      int tone = toneOf[pitch % 12];
+      if (tone < 0) continue;
+      if (depth == 0 && options.rootInBass && tone != 0) continue;
+      if (uses[tone] > 0 && !(options.doubled >> tone & 1)) continue;
+
+      // The voices left must still cover the missing tones
+      uint32_t next = present | (1u << tone);
+      int missing = std::popcount(required & ~next);
+      if (missing > options.voices - depth - 1) continue;
+
+      pitches[depth] = static_cast<uint8_t>(pitch);
+      ++uses[tone];
+      run(depth + 1, next);
+      --uses[tone];
+    }
+  }
+};
+
+}  // namespace
+
+VoiceLeader::VoiceLeader() : VoiceLeader(Options()) {}
+
+VoiceLeader::VoiceLeader(Options options) : m_options(options) {
+  m_options.voices = std::clamp(m_options.voices, 1, kMaxVoices);
+  m_options.low = std::clamp(m_options.low, 0, 127);
+  m_options.high = std::clamp(m_options.high, m_options.low, 127);
+  m_options.maxLeap = std::clamp(m_options.maxLeap, 0, kMaxLeap);
+}
+
+const VoiceLeader::Candidates* VoiceLeader::candidatesFor(
+    const Chord& chord, uint64_t key, std::string& error) {
+  auto it = m_cache.find(key);
+  if (it != m_cache.end()) return &it->second;
+
+  std::array<int, 12> toneOf;
+  toneOf.fill(-1);
+  int tones = 0;
+  for (int pitch : chord) {
+    int pc = ((pitch % 12) + 12) % 12;
+    if (toneOf[pc] < 0) toneOf[pc] = tones++;
+  }
+
+  uint32_t all = (1u << tones) - 1;
+  uint32_t omitted = m_options.omitted;
+  if (omitted == 0 && tones > m_options.voices && tones > 2) {
+    omitted = 1u << 2;
+  }
+  uint32_t required = all & ~omitted;
+  if (std::popcount(required) > m_options.voices) {
+    error = "the chord has more required tones than voices";
+    return nullptr;
+  }
+
+  Candidates candidates;
+  Enumerator enumerator{m_options, toneOf, required, candidates.pitches};
+  enumerator.run(0, 0);
+  candidates.count = enumerator.count;
+  // Keeping only the lowest voicings would make the solve not minimal
+  if (enumerator.overflow) {
+    error = "the chord has more than " + std::to_string(kMaxCandidates) +
+            " voicings; narrow the range or use fewer voices";
+    return nullptr;
+  }
+  if (candidates.count == 0) {
+    error = "no voicing of the chord fits the range and spacing";
+    return nullptr;
+  }
+  return &m_cache.emplace(key, std::move(candidates)).first->second;
+}
+
+std::string VoiceLeader::set(size_t index, const Chord& chord) {
+  if (index > m_steps.size() || index >= kMaxChords) {
+    return "chord index out of range";
+  }
+  if (chord.empty() || chord.size() > 12) return "a chord has 1-12 tones";
+
+  // Distinct pitch classes in order, 4 bits each, identify the chord
+  uint64_t key = 0;
+  uint32_t seen = 0;
+  for (int pitch : chord) {
+    int pc = ((pitch % 12) + 12) % 12;
+    if (seen >> pc & 1) continue;
+    seen |= 1u << pc;
+    key = key << 4 | static_cast<uint64_t>(pc);
+  }
+  key = key << 4 | static_cast<uint64_t>(std::popcount(seen));
+
+  if (index < m_steps.size() && m_steps[index].key == key) return {};
+
+  std::string error;
+  const auto* candidates = candidatesFor(chord, key, error);
+  if (!candidates) return error;
+
+  if (index == m_steps.size()) m_steps.emplace_back();
+  m_steps[index].key = key;
+  m_steps[index].candidates = candidates;
+  m_solved = std::min(m_solved, index);
+  return {};
+}
+
+void VoiceLeader::truncate(size_t count) {
+  if (count >= m_steps.size()) return;
+  m_steps.resize(count);
+  m_solved = std::min(m_solved, count);
+}
+
+void VoiceLeader::solveStep(size_t index) {
+  auto& step = m_steps[index];
+  const auto& candidates = *step.candidates;
+  int voices = m_options.voices;
+  step.cost.assign(candidates.count, kUnreachable);
+  step.from.assign(candidates.count, -1);
+
+  // Among equals, the first chord sits nearest the center
+  if (index == 0) {
+    for (size_t j = 0; j < candidates.count; ++j) {
+      const auto* pitches = &candidates.pitches[j * voices];
+      int sum = 0;
+      for (int v = 0; v < voices; ++v) sum += pitches[v];
+      step.cost[j] = std::abs(sum - voices * m_options.center);
+    }
+    return;
+  }
+
+  const auto& previous = m_steps[index - 1];
+  const auto& before = *previous.candidates;
+  for (size_t j = 0; j < candidates.count; ++j) {
+    const auto* next = &candidates.pitches[j * voices];
+    int32_t best = kUnreachable;
+    int32_t bestFrom = -1;
+    for (size_t k = 0; k < before.count; ++k) {
+      int32_t base = previous.cost[k];
+      if (base == kUnreachable) continue;
+      const auto* last = &before.pitches[k * voices];
+      int32_t motion = 0;
+      int v = 0;
+      for (; v < voices; ++v) {
+        int leap = std::abs(next[v] - last[v]);
+        if (leap > m_options.maxLeap) break;
+        motion += leap;
+      }
+      if (v < voices) continue;
+      int32_t total = base + (motion << kMotionShift);
+      if (total >= best) continue;
+      best = total;
+      bestFrom = static_cast<int32_t>(k);
+    }
+    step.cost[j] = best;
+    step.from[j] = bestFrom;
+  }
+}
+
+std::string VoiceLeader::solve(std::vector<std::vector<uint8_t>>& out,
+                               int64_t& cost) {
+  out.clear();
+  cost = 0;
+  if (m_steps.empty()) return {};
+
+  for (; m_solved < m_steps.size(); ++m_solved) solveStep(m_solved);
+
+  const auto& last = m_steps.back();
+  auto best = std::min_element(last.cost.begin(), last.cost.end());
+  if (*best == kUnreachable) {
+    for (size_t i = 1; i < m_steps.size(); ++i) {
+      const auto& costs = m_steps[i].cost;
+      if (std::all_of(costs.begin(), costs.end(),
+                      [](int32_t c) { return c == kUnreachable; })) {
+        return "no voicing of chord " + std::to_string(i + 1) +
+               " is within the maximum leap of the one before";
+      }
+    }
+  }
+
+  int voices = m_options.voices;
+  out.resize(m_steps.size());
+  auto choice = static_cast<int32_t>(best - last.cost.begin());
+  for (size_t i = m_steps.size(); i-- > 0;) {
+    const auto& step = m_steps[i];
+    const auto* pitches = &step.candidates->pitches[choice * voices];
+    out[i].assign(pitches, pitches + voices);
+    if (i > 0) choice = step.from[choice];
+  }
+  cost = *best >> kMotionShift;
+  return {};
+}
+
+}  // namespace FLLua
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace FLLua {
+
+// Minimum-movement voice leading over a chord progression. Each chord
+// expands into every voicing that fits the constraints (cached per chord);
+// dynamic programming over consecutive voicings then finds the sequence
+// with the least total voice motion. Costs are kept per chord, so changing
+// the last chords of a progression only re-solves from the first change.
+class VoiceLeader {
+ public:
+  static constexpr int kMaxVoices = 8;
+  // Voicings per chord; a chord with more is an error rather than cut short
+  static constexpr size_t kMaxCandidates = 4096;
+  static constexpr size_t kMaxChords = 4096;
+  static constexpr int kMaxLeap = 24;
+
+  struct Options {
+    int low = 48;   // Lowest MIDI pitch of any voice
+    int high = 79;  // Highest
+    int voices = 4;
+    int maxLeap = 7;      // Semitones a voice may move between chords
+    int maxSpacing = 12;  // Between adjacent voices above the bass
+    bool rootInBass = false;
+    // Chord tones (by index, root first) that may sound twice or more, and
+    // those that may be left out. An empty omit mask lets the fifth go in
+    // chords with more tones than voices.
+    uint32_t doubled = 1;
+    uint32_t omitted = 0;
+    int center = 64;  // Ties go to first voicings centered nearest
+  };
+
+  // Tones of one chord as MIDI pitches or pitch classes, root first
+  using Chord = std::vector<int>;
+
+  VoiceLeader();
+  explicit VoiceLeader(Options options);
+
+  const Options& options() const { return m_options; }
+
+  // Place `chord` at `index` (at most size()); the chords after it keep
+  // their place. Returns an error message, empty on success.
+  std::string set(size_t index, const Chord& chord);
+
+  // Keep only the first `count` chords
+  void truncate(size_t count);
+  size_t size() const { return m_steps.size(); }
+
+  // Voicings for every chord, `voices` ascending pitches each, and their
+  // total motion. Returns an error message, empty on success.
+  std::string solve(std::vector<std::vector<uint8_t>>& out,
+                    int64_t& cost);
+
+ private:
+  static constexpr int32_t kUnreachable = INT32_MAX;
+
+  struct Candidates {
+    std::vector<uint8_t> pitches;  // `voices` per voicing
+    size_t count = 0;
+  };
+
+  struct Step {
+    uint64_t key = 0;
+    const Candidates* candidates = nullptr;
+    std::vector<int32_t> cost;  // Best total ending in each voicing
+    std::vector<int32_t> from;  // Voicing of the previous chord
+  };
+
+  const Candidates* candidatesFor(const Chord& chord, uint64_t key,
+                                  std::string& error);
+  void solveStep(size_t index);
+
+  Options m_options;
+  std::unordered_map<uint64_t, Candidates> m_cache;
+  std::vector<Step> m_steps;
+  size_t m_solved = 0;  // Steps whose costs are current
+};
+
+}  // namespace FLLua
@@ -3,30 +3,58 @@
 namespace FLLua {
 
 void Console::addMessage(const std::string& msg) {
-  m_messages.push_back(msg);
-  if (m_messages.size() > kMaxMessages) {
-    m_messages.erase(m_messages.begin());
-  }
+  m_ring.push(msg);
   m_scrollToBottom = true;
 }
 
-void Console::clear() { m_messages.clear(); }
+void Console::clear() { m_ring.clear(); }
+
+void Console::renderFilter() {
+  ImGui::SetNextItemWidth(200.0f);
+  if (ImGui::InputTextWithHint("##ConsoleFilter", "Filter", m_filterText,
+                               sizeof(m_filterText))) {
+    m_filter.setText(m_filterText);
+    m_scrollToBottom = true;
+  }
+}
+
+void Console::renderLine(const ConsoleRing::Line& line) {
+  // Color errors red and warnings yellow
+  bool colored = line.severity != Severity::Info;
+  if (colored) {
+    ImGui::PushStyleColor(ImGuiCol_Text,
+                          line.severity == Severity::Error
+                              ? ImVec4(1.0f, 0.3f, 0.3f, 1.0f)
+                              : ImVec4(1.0f, 0.8f, 0.3f, 1.0f));
+  }
+  ImGui::TextUnformatted(line.text.data(),
+                         line.text.data() + line.text.size());
+  if (colored) ImGui::PopStyleColor();
+
+  if (line.repeats > 1) {
+    ImGui::SameLine();
+    ImGui::TextDisabled("x%u", static_cast<unsigned>(line.repeats));
+  }
+}
 
 void Console::render() {
   ImGui::BeginChild("ConsoleOutput", ImVec2(0, 0), ImGuiChildFlags_None,
                     ImGuiWindowFlags_HorizontalScrollbar);
 
-  for (const auto& msg : m_messages) {
-    // Color errors red
-    if (msg.find("error") != std::string::npos ||
-        msg.find("Error") != std::string::npos) {
-      ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.3f, 0.3f, 1.0f));
-      ImGui::TextUnformatted(msg.c_str());
-      ImGui::PopStyleColor();
-    } else {
-      ImGui::TextUnformatted(msg.c_str());
+  // Only the visible rows are laid out, however long the history
+  m_filter.update(m_ring);
+  bool filtered = m_filter.active();
+  size_t count = filtered ? m_filter.size() : m_ring.size();
+  ImGuiListClipper clipper;
+  clipper.Begin(static_cast<int>(count));
+  while (clipper.Step()) {
+    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+      uint64_t number =
+          filtered ? m_filter[row] : m_ring.begin() + static_cast<size_t>(row);
+      renderLine(m_ring.at(number));
     }
   }
+  clipper.End();
 
   if (m_scrollToBottom) {
     ImGui::SetScrollHereY(1.0f);
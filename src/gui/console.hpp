@@ -2,8 +2,10 @@
 
 #include <imgui.h>
 
+#include <cstdint>
 #include <string>
-#include <vector>
+
+#include "console_ring.hpp"
 
 namespace FLLua {
 
@@ -13,10 +15,16 @@ class Console {
   void clear();
   void render();
 
+  // Text box narrowing the output to lines containing its text
+  void renderFilter();
+
  private:
-  std::vector<std::string> m_messages;
+  void renderLine(const ConsoleRing::Line& line);
+
+  ConsoleRing m_ring;
+  ConsoleFilter m_filter;
+  char m_filterText[128] = {};
   bool m_scrollToBottom = false;
-  static constexpr size_t kMaxMessages = 500;
 };
 
 }  // namespace FLLua
@@ -0,0 +1,105 @@
+#include "console_ring.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace FLLua {
+
+namespace {
+
+char lowerAscii(char c) {
+  return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool containsWord(std::string_view text, std::string_view lower,
+                  std::string_view capitalized) {
+  return text.find(lower) != std::string_view::npos ||
+         text.find(capitalized) != std::string_view::npos;
+}
+
+}  // namespace
+
+Severity classifyMessage(std::string_view text) {
+  if (containsWord(text, "error", "Error")) return Severity::Error;
+  if (containsWord(text, "warning", "Warning")) return Severity::Warning;
+  return Severity::Info;
+}
+
+ConsoleRing::ConsoleRing(size_t capacity)
+    : m_lines(std::max<size_t>(capacity, 1)) {}
+
+void ConsoleRing::push(std::string text) {
+  if (!empty()) {
+    auto& last = m_lines[(m_end - 1) % m_lines.size()];
+    if (last.text == text) {
+      if (last.repeats < std::numeric_limits<uint32_t>::max()) {
+        ++last.repeats;
+      }
+      return;
+    }
+  }
+
+  if (size() == m_lines.size()) ++m_begin;
+  auto& line = m_lines[m_end % m_lines.size()];
+  line.severity = classifyMessage(text);
+  line.text = std::move(text);
+  line.repeats = 1;
+  ++m_end;
+}
+
+void ConsoleRing::clear() { m_begin = m_end; }
+
+void ConsoleFilter::setText(std::string text) {
+  std::transform(text.begin(), text.end(), text.begin(), lowerAscii);
+  if (text == m_text) return;
+
+  // Lines containing the longer text are among those that matched before
+  if (!m_text.empty() && text.find(m_text) != std::string::npos) {
+    m_narrowed = true;
+  } else {
+    m_rescan = true;
+  }
+  m_text = std::move(text);
+}
+
+bool ConsoleFilter::matches(std::string_view line) const {
+  auto it = std::search(line.begin(), line.end(), m_text.begin(),
+                        m_text.end(), [](char a, char b) {
+                          return lowerAscii(a) == b;
+                        });
+  return it != line.end() || m_text.empty();
+}
+
+void ConsoleFilter::update(const ConsoleRing& ring) {
+  if (!active()) {
+    m_matches.clear();
+    m_scanned = ring.end();
+    m_rescan = false;
+    m_narrowed = false;
+    return;
+  }
+  if (m_rescan) {
+    m_matches.clear();
+    m_scanned = ring.begin();
+    m_rescan = false;
+    m_narrowed = false;
+  }
+
+  while (!m_matches.empty() && m_matches.front() < ring.begin()) {
+    m_matches.pop_front();
+  }
+  if (m_narrowed) {
+    auto kept = std::remove_if(
+        m_matches.begin(), m_matches.end(),
+        [&](uint64_t number) { return !matches(ring.at(number).text); });
+    m_matches.erase(kept, m_matches.end());
+    m_narrowed = false;
+  }
+
+  for (uint64_t n = std::max(m_scanned, ring.begin()); n < ring.end(); ++n) {
+    if (matches(ring.at(n).text)) m_matches.push_back(n);
+  }
+  m_scanned = ring.end();
+}
+
+}  // namespace FLLua
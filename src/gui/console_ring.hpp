@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace FLLua {
+
+enum class Severity : uint8_t { Info, Warning, Error };
+
+// Severity of a log line, from the words it contains
+Severity classifyMessage(std::string_view text);
+
+// Fixed-capacity console history. Once full, each new line replaces the
+// oldest one in place. A line equal to the last one only counts as a
+// repeat. Lines are numbered from the first ever added, so views can tell
+// which lines dropped out.
+class ConsoleRing {
+ public:
+  static constexpr size_t kDefaultCapacity = 131072;
+
+  struct Line {
+    std::string text;
+    Severity severity = Severity::Info;
+    uint32_t repeats = 1;
+  };
+
+  explicit ConsoleRing(size_t capacity = kDefaultCapacity);
+
+  void push(std::string text);
+  void clear();
+
+  size_t capacity() const { return m_lines.size(); }
+  size_t size() const { return static_cast<size_t>(m_end - m_begin); }
+  bool empty() const { return m_end == m_begin; }
+
+  // Numbers of the oldest line held and of the next line to be added
+  uint64_t begin() const { return m_begin; }
+  uint64_t end() const { return m_end; }
+
+  // Line `number`, which must be in [begin(), end())
+  const Line& at(uint64_t number) const {
+    return m_lines[number % m_lines.size()];
+  }
+
+ private:
+  std::vector<Line> m_lines;
+  uint64_t m_begin = 0;
+  uint64_t m_end = 0;
+};
+
+// Numbers of the ring lines containing a text, ignoring ASCII case. Only
+// lines added since the last update are scanned; narrowing the text only
+// rescans the lines that matched before.
+class ConsoleFilter {
+ public:
+  void setText(std::string text);
+  const std::string& text() const { return m_text; }
+  bool active() const { return !m_text.empty(); }
+
+  // Catch up with `ring`, dropping lines it no longer holds
+  void update(const ConsoleRing& ring);
+
+  size_t size() const { return m_matches.size(); }
+  uint64_t operator[](size_t index) const { return m_matches[index]; }
+
+ private:
+  bool matches(std::string_view line) const;
+
+  std::string m_text;
+  std::deque<uint64_t> m_matches;
+  uint64_t m_scanned = 0;  // Lines before this number were scanned
+  bool m_rescan = false;   // The text widened, scan the whole ring again
+  bool m_narrowed = false;
+};
+
+}  // namespace FLLua
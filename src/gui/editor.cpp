@@ -4,6 +4,8 @@
 #include <commdlg.h>
 #include <imgui.h>
 
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 
@@ -29,6 +31,9 @@ function on_beat(ctx, beat)
     ctx.log("Beat: " .. beat)
 end
 )");
+
+  m_checker.start();
+  checkText();
 }
 
 void Editor::render() {
@@ -41,7 +46,10 @@ void Editor::render() {
 
   if (editorHeight < 100) editorHeight = 100;
 
+  renderLayerTabs();
   renderCodeEditor();
+  if (m_textEditor.IsTextChanged()) checkText();
+  pollCheck();
 
   // Splitter
   ImGui::Separator();
@@ -53,6 +61,8 @@ void Editor::render() {
   if (ImGui::SmallButton("Clear")) {
     m_console.clear();
   }
+  ImGui::SameLine();
+  m_console.renderFilter();
   ImGui::Separator();
   m_console.render();
   ImGui::EndChild();
@@ -68,8 +78,9 @@ void Editor::renderMenuBar() {
       ImGui::EndMenu();
     }
     if (ImGui::BeginMenu("Script")) {
-      if (ImGui::MenuItem("Run", "Ctrl+Enter", false, !m_running)) runScript();
-      if (ImGui::MenuItem("Stop", nullptr, false, m_running)) stopScript();
+      bool running = m_running[m_layer];
+      if (ImGui::MenuItem("Run", "Ctrl+Enter", false, !running)) runScript();
+      if (ImGui::MenuItem("Stop", nullptr, false, running)) stopScript();
       ImGui::EndMenu();
     }
     ImGui::EndMenuBar();
@@ -82,20 +93,78 @@ void Editor::renderMenuBar() {
   if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_S)) saveFile();
 }
 
+void Editor::renderLayerTabs() {
+  if (!ImGui::BeginTabBar("Layers")) return;
+
+  for (int i = 0; i < kLayers; ++i) {
+    // The ### suffix keeps the tab's identity while its label changes
+    char label[64];
+    std::snprintf(label, sizeof(label), "Layer %d%s %.1f%%###Layer%d", i + 1,
+                  m_running[i] ? " *" : "", m_layerLoad[i] * 100.0f, i);
+    if (ImGui::BeginTabItem(label)) {
+      if (i != m_layer) selectLayer(i);
+      ImGui::EndTabItem();
+    }
+  }
+  ImGui::EndTabBar();
+}
+
+void Editor::selectLayer(int layer) {
+  m_layerSources[m_layer] = m_textEditor.GetText();
+  m_layer = layer;
+  m_textEditor.SetText(m_layerSources[m_layer]);
+  checkText();
+}
+
 void Editor::renderCodeEditor() { m_textEditor.Render("CodeEditor"); }
 
 void Editor::renderConsolePanel() { m_console.render(); }
 
+void Editor::checkText() {
+  m_checkGeneration = m_checker.submit(m_textEditor.GetText());
+}
+
+void Editor::pollCheck() {
+  ScriptChecker::Result result;
+  if (!m_checker.takeResult(result)) return;
+  // A check of text since edited or of another layer would mark wrong lines
+  if (result.generation != m_checkGeneration) return;
+  showCheck(result);
+}
+
+void Editor::showCheck(const ScriptChecker::Result& result) {
+  TextEditor::ErrorMarkers markers;
+  if (!result.ok) markers[std::max(result.line, 1)] = result.message;
+  m_textEditor.SetErrorMarkers(markers);
+}
+
 void Editor::renderStatusBar() {
   auto cpos = m_textEditor.GetCursorPosition();
-  ImGui::Text(
-      "Ln %d, Col %d | %s | %s", cpos.mLine + 1, cpos.mColumn + 1,
-      m_running ? "Running" : "Stopped",
-      m_currentFilePath.empty() ? "Untitled" : m_currentFilePath.c_str());
+  const auto& path = m_filePaths[m_layer];
+  ImGui::Text("Ln %d, Col %d | Layer %d | %s | %s", cpos.mLine + 1,
+              cpos.mColumn + 1, m_layer + 1,
+              m_running[m_layer] ? "Running" : "Stopped",
+              path.empty() ? "Untitled" : path.c_str());
+  if (m_layerJobs[m_layer] > 0) {
+    ImGui::SameLine();
+    ImGui::Text("| %d async jobs", static_cast<int>(m_layerJobs[m_layer]));
+  }
+
+  // Lua memory for this instance, the whole project, and what sharing saves
+  constexpr double kMB = 1024.0 * 1024.0;
+  const auto& mem = m_memoryStats;
+  ImGui::SameLine();
+  ImGui::TextDisabled(
+      "| Lua %.1f MB (project %.1f MB, %d instances) | shared %.1f MB, "
+      "saves %.1f MB",
+      mem.heapBytes / kMB, mem.projectHeapBytes / kMB,
+      static_cast<int>(mem.instances), mem.sharedBytes / kMB,
+      mem.savedBytes / kMB);
 }
 
 void Editor::setScriptText(const std::string& text) {
   m_textEditor.SetText(text);
+  checkText();
 }
 
 std::string Editor::getScriptText() const { return m_textEditor.GetText(); }
@@ -116,14 +185,16 @@ void Editor::openFile() {
       std::stringstream ss;
       ss << file.rdbuf();
       m_textEditor.SetText(ss.str());
-      m_currentFilePath = filename;
-      m_console.addMessage("Opened: " + m_currentFilePath);
+      checkText();
+      m_filePaths[m_layer] = filename;
+      m_console.addMessage("Opened: " + m_filePaths[m_layer]);
     }
   }
 }
 
 void Editor::saveFile() {
-  if (m_currentFilePath.empty()) {
+  auto& path = m_filePaths[m_layer];
+  if (path.empty()) {
     char filename[MAX_PATH] = {};
     OPENFILENAMEA ofn = {};
     ofn.lStructSize = sizeof(ofn);
@@ -134,27 +205,41 @@ void Editor::saveFile() {
     ofn.lpstrDefExt = "lua";
 
     if (!GetSaveFileNameA(&ofn)) return;
-    m_currentFilePath = filename;
+    path = filename;
   }
 
-  std::ofstream file(m_currentFilePath);
+  std::ofstream file(path);
   if (file.is_open()) {
     file << m_textEditor.GetText();
-    m_console.addMessage("Saved: " + m_currentFilePath);
+    m_console.addMessage("Saved: " + path);
   }
 }
 
 void Editor::runScript() {
-  m_running = true;
+  // Only source that compiles reaches the processor, so a typo leaves the
+  // running script in place instead of tearing it down
+  auto source = m_textEditor.GetText();
+  auto result = ScriptChecker::check(source);
+  showCheck(result);
+  if (!result.ok) {
+    char prefix[64];
+    std::snprintf(prefix, sizeof(prefix),
+                  "Syntax error, layer %d not run, line %d: ", m_layer + 1,
+                  result.line);
+    m_console.addMessage(prefix + result.message);
+    return;
+  }
+
+  m_running[m_layer] = true;
   if (m_runCallback) {
-    m_runCallback(m_textEditor.GetText());
+    m_runCallback(m_layer, source);
   }
 }
 
 void Editor::stopScript() {
-  m_running = false;
+  m_running[m_layer] = false;
   if (m_stopCallback) {
-    m_stopCallback();
+    m_stopCallback(m_layer);
   }
 }
 
@@ -2,17 +2,25 @@
 
 #include <TextEditor.h>
 
+#include <array>
+#include <cstdint>
 #include <functional>
 #include <string>
 
 #include "console.hpp"
+#include "lua/memory_report.hpp"
+#include "script_checker.hpp"
 
 namespace FLLua {
 
 class Editor {
  public:
-  using RunCallback = std::function<void(const std::string& source)>;
-  using StopCallback = std::function<void()>;
+  // Script layers the processor runs side by side
+  static constexpr int kLayers = 4;
+
+  using RunCallback =
+      std::function<void(int layer, const std::string& source)>;
+  using StopCallback = std::function<void(int layer)>;
 
   void init();
   void render();
@@ -25,14 +33,35 @@ class Editor {
 
   Console& getConsole() { return m_console; }
 
-  bool isScriptRunning() const { return m_running; }
+  bool isScriptRunning() const { return m_running[m_layer]; }
+
+  // Share of real time each layer's script takes, shown on its tab
+  void setLayerLoad(const std::array<float, kLayers>& load) {
+    m_layerLoad = load;
+  }
+
+  // Async jobs queued or running per layer, shown in the status bar
+  void setLayerJobs(const std::array<int32_t, kLayers>& jobs) {
+    m_layerJobs = jobs;
+  }
+
+  // Shown in the status bar
+  void setMemoryStats(const LuaMemoryStats& stats) { m_memoryStats = stats; }
 
  private:
   void renderMenuBar();
+  void renderLayerTabs();
+  void selectLayer(int layer);
   void renderCodeEditor();
   void renderConsolePanel();
   void renderStatusBar();
 
+  // Queue the buffer for a background check, and show finished checks as
+  // error markers
+  void checkText();
+  void pollCheck();
+  void showCheck(const ScriptChecker::Result& result);
+
   void openFile();
   void saveFile();
   void runScript();
@@ -40,11 +69,19 @@ class Editor {
 
   TextEditor m_textEditor;
   Console m_console;
+  ScriptChecker m_checker;
+  uint64_t m_checkGeneration = 0;  // Of the buffer as it is now
   RunCallback m_runCallback;
   StopCallback m_stopCallback;
 
-  std::string m_currentFilePath;
-  bool m_running = false;
+  // The text editor holds the selected layer; the others are kept here
+  int m_layer = 0;
+  std::array<std::string, kLayers> m_layerSources;
+  std::array<std::string, kLayers> m_filePaths;
+  std::array<bool, kLayers> m_running{};
+  std::array<float, kLayers> m_layerLoad{};
+  std::array<int32_t, kLayers> m_layerJobs{};
+  LuaMemoryStats m_memoryStats;
   float m_consolePanelHeight = 150.0f;
 };
 
@@ -0,0 +1,120 @@
+#include "script_checker.hpp"
+
+#include <cstdlib>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+namespace {
+
+// Errors read "script:<line>: <message>"
+constexpr char kChunkName[] = "=script";
+constexpr char kErrorPrefix[] = "script:";
+
+void parseError(const std::string& error, ScriptChecker::Result& out) {
+  out.message = error;
+  if (error.rfind(kErrorPrefix, 0) != 0) return;
+
+  const char* start = error.c_str() + sizeof(kErrorPrefix) - 1;
+  char* end = nullptr;
+  long line = std::strtol(start, &end, 10);
+  if (end == start || *end != ':') return;
+  out.line = static_cast<int>(line);
+  out.message = end + 1;
+  if (!out.message.empty() && out.message.front() == ' ') {
+    out.message.erase(0, 1);
+  }
+}
+
+}  // namespace
+
+ScriptChecker::~ScriptChecker() { stop(); }
+
+void ScriptChecker::start() {
+  if (m_thread.joinable()) return;
+  m_stopping = false;
+  m_thread = std::thread(&ScriptChecker::run, this);
+}
+
+void ScriptChecker::stop() {
+  if (!m_thread.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_wake.notify_one();
+  m_thread.join();
+}
+
+uint64_t ScriptChecker::submit(std::string source) {
+  uint64_t generation;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_source = std::move(source);
+    m_pending = true;
+    m_due = Clock::now() + kDebounce;
+    generation = ++m_generation;
+  }
+  m_wake.notify_one();
+  return generation;
+}
+
+bool ScriptChecker::takeResult(Result& out) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_hasResult) return false;
+  out = std::move(m_result);
+  m_hasResult = false;
+  return true;
+}
+
+ScriptChecker::Result ScriptChecker::check(const std::string& source) {
+  Result result;
+  lua_State* L = luaL_newstate();
+  if (!L) {
+    result.ok = false;
+    result.message = "out of memory";
+    return result;
+  }
+  // Text only: the processor never loads precompiled chunks
+  if (luaL_loadbufferx(L, source.data(), source.size(), kChunkName, "t") !=
+      LUA_OK) {
+    result.ok = false;
+    const char* error = lua_tostring(L, -1);
+    parseError(error ? error : "unknown error", result);
+  }
+  lua_close(L);
+  return result;
+}
+
+void ScriptChecker::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (!m_stopping) {
+    if (!m_pending) {
+      m_wake.wait(lock);
+      continue;
+    }
+    // Typing pushes the deadline back
+    if (Clock::now() < m_due) {
+      m_wake.wait_until(lock, m_due);
+      continue;
+    }
+
+    std::string source = std::move(m_source);
+    uint64_t generation = m_generation;
+    m_pending = false;
+    lock.unlock();
+
+    Result result = check(source);
+    result.generation = generation;
+
+    lock.lock();
+    m_result = std::move(result);
+    m_hasResult = true;
+  }
+}
+
+}  // namespace FLLua
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace FLLua {
+
+// Compiles the editor buffer on a worker thread, once typing pauses, so
+// syntax errors show inline before the script is ever run. Compiling runs
+// nothing and needs no sandbox; it only depends on Lua, not the GUI.
+class ScriptChecker {
+ public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr auto kDebounce = std::chrono::milliseconds(300);
+
+  struct Result {
+    uint64_t generation = 0;  // Of the submit it answers
+    bool ok = true;
+    int line = 0;  // 1-based; 0 when the error names no line
+    std::string message;
+  };
+
+  ScriptChecker() = default;
+  ~ScriptChecker();
+
+  void start();
+  void stop();
+
+  // Check `source` once nothing newer arrives for kDebounce; an earlier
+  // submit still waiting is dropped. Returns the generation of its result.
+  uint64_t submit(std::string source);
+
+  // The newest finished check, if one came in since the last call
+  bool takeResult(Result& out);
+
+  // Compile `source` on the calling thread
+  static Result check(const std::string& source);
+
+ private:
+  void run();
+
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  bool m_stopping = false;
+
+  // Guarded by m_mutex
+  std::string m_source;
+  bool m_pending = false;
+  uint64_t m_generation = 0;
+  Clock::time_point m_due;
+  Result m_result;
+  bool m_hasResult = false;
+};
+
+}  // namespace FLLua
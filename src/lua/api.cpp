@@ -2,8 +2,28 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <string>
 
+#include "array_api.hpp"
+#include "async_api.hpp"
+#include "bus_api.hpp"
+#include "cache_api.hpp"
+#include "clip_api.hpp"
+#include "event_buffer_api.hpp"
+#include "groove_api.hpp"
+#include "input_api.hpp"
+#include "markov_api.hpp"
+#include "param_api.hpp"
+#include "pattern_api.hpp"
+#include "ramp_api.hpp"
+#include "rng_api.hpp"
+#include "sequencing/ramp_engine.hpp"
+#include "shared_table_api.hpp"
+#include "task_api.hpp"
+
 extern "C" {
 #include <lauxlib.h>
 #include <lua.h>
@@ -13,13 +33,29 @@ namespace FLLua {
 
 static const char* kContextRegistryKey = "FLLua_PluginContext";
 
-static PluginContext* getContext(lua_State* L) {
+PluginContext* getContext(lua_State* L) {
   lua_getfield(L, LUA_REGISTRYINDEX, kContextRegistryKey);
   auto* ctx = static_cast<PluginContext*>(lua_touserdata(L, -1));
   lua_pop(L, 1);
   return ctx;
 }
 
+void emitNote(PluginContext* ctx, uint8_t note, uint8_t velocity,
+              double duration, uint8_t channel) {
+  ctx->eventQueue->enqueue(NoteOn{note, velocity, channel, ctx->sampleOffset});
+
+  if (ctx->scheduledNoteOffs) {
+    ScheduledNoteOff off{note, channel, ctx->eventBeat() + duration};
+    if (!ctx->transport.playing) {
+      double samples = std::max(duration, 0.0) *
+                       ctx->transport.samplesPerBeat();
+      off.endSample = ctx->sampleClock + ctx->sampleOffset +
+                      static_cast<int64_t>(std::llround(samples));
+    }
+    ctx->scheduledNoteOffs->push_back(off);
+  }
+}
+
 // ctx.note_on(note, velocity, channel?)
 static int ctx_note_on(lua_State* L) {
   auto* ctx = getContext(L);
@@ -29,7 +65,7 @@ static int ctx_note_on(lua_State* L) {
   uint8_t velocity = static_cast<uint8_t>(luaL_checkinteger(L, 2));
   uint8_t channel = static_cast<uint8_t>(luaL_optinteger(L, 3, 0));
 
-  ctx->eventQueue->enqueue(NoteOn{note, velocity, channel, 0});
+  ctx->eventQueue->enqueue(NoteOn{note, velocity, channel, ctx->sampleOffset});
   return 0;
 }
 
@@ -41,7 +77,7 @@ static int ctx_note_off(lua_State* L) {
   uint8_t note = static_cast<uint8_t>(luaL_checkinteger(L, 1));
   uint8_t channel = static_cast<uint8_t>(luaL_optinteger(L, 2, 0));
 
-  ctx->eventQueue->enqueue(NoteOff{note, channel, 0});
+  ctx->eventQueue->enqueue(NoteOff{note, channel, ctx->sampleOffset});
   return 0;
 }
 
@@ -55,12 +91,7 @@ static int ctx_note(lua_State* L) {
   double duration = luaL_checknumber(L, 3);
   uint8_t channel = static_cast<uint8_t>(luaL_optinteger(L, 4, 0));
 
-  ctx->eventQueue->enqueue(NoteOn{note, velocity, channel, 0});
-
-  if (ctx->scheduledNoteOffs) {
-    double endBeat = ctx->transport.beat + duration;
-    ctx->scheduledNoteOffs->push_back(ScheduledNoteOff{note, channel, endBeat});
-  }
+  emitNote(ctx, note, velocity, duration, channel);
   return 0;
 }
 
@@ -73,7 +104,8 @@ static int ctx_cc(lua_State* L) {
   uint8_t value = static_cast<uint8_t>(luaL_checkinteger(L, 2));
   uint8_t channel = static_cast<uint8_t>(luaL_optinteger(L, 3, 0));
 
-  ctx->eventQueue->enqueue(CC{controller, value, channel, 0});
+  if (ctx->ramps) ctx->ramps->cancel(channel, controller);
+  ctx->eventQueue->enqueue(CC{controller, value, channel, ctx->sampleOffset});
   return 0;
 }
 
@@ -85,7 +117,8 @@ static int ctx_pitch_bend(lua_State* L) {
   int16_t value = static_cast<int16_t>(luaL_checkinteger(L, 1));
   uint8_t channel = static_cast<uint8_t>(luaL_optinteger(L, 2, 0));
 
-  ctx->eventQueue->enqueue(PitchBend{value, channel, 0});
+  if (ctx->ramps) ctx->ramps->cancel(channel, RampEngine::kPitchBendTarget);
+  ctx->eventQueue->enqueue(PitchBend{value, channel, ctx->sampleOffset});
   return 0;
 }
 
@@ -107,7 +140,15 @@ static int ctx_index(lua_State* L) {
   if (!ctx) return 0;
 
   if (strcmp(key, "beat") == 0) {
-    lua_pushnumber(L, ctx->transport.beat);
+    double beat = ctx->transport.beat;
+    if (ctx->processOffset > 0) {
+      beat += ctx->processOffset / ctx->transport.samplesPerBeat();
+    }
+    lua_pushnumber(L, beat);
+    return 1;
+  }
+  if (strcmp(key, "sample_offset") == 0) {
+    lua_pushinteger(L, ctx->sampleOffset);
     return 1;
   }
   if (strcmp(key, "bar") == 0) {
@@ -168,6 +209,21 @@ void registerPluginAPI(lua_State* L, PluginContext* ctx) {
                                           {"log", ctx_log},
                                           {nullptr, nullptr}};
   luaL_setfuncs(L, ctxFunctions, 0);
+  registerClipAPI(L);
+  registerPatternAPI(L);
+  registerEventBufferAPI(L);
+  registerArrayAPI(L);
+  registerRngAPI(L);
+  registerMarkovAPI(L);
+  registerInputAPI(L);
+  registerRampAPI(L);
+  registerGrooveAPI(L);
+  registerParamAPI(L);
+  registerBusAPI(L);
+  registerSharedTableAPI(L);
+  registerCacheAPI(L);
+  registerAsyncAPI(L);
+  registerTaskAPI(L);
   lua_setfield(L, metaTable, "__functions");
 
   lua_setmetatable(L, ctxTable);
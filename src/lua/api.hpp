@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "events/event_queue.hpp"
 #include "transport/transport.hpp"
 
@@ -7,14 +9,55 @@ struct lua_State;
 
 namespace FLLua {
 
+class AsyncRunner;
+class ClipPlayer;
+class GrooveProcessor;
+class ParamSnapshot;
+class PatternPlayer;
+class RampEngine;
+class TaskScheduler;
+
 // Context object shared between C++ and Lua
 struct PluginContext {
   MidiEventQueue* eventQueue = nullptr;
   LogQueue* logQueue = nullptr;
   TransportState transport;
   std::vector<ScheduledNoteOff>* scheduledNoteOffs = nullptr;
+  ClipPlayer* clipPlayer = nullptr;
+  PatternPlayer* patternPlayer = nullptr;
+  RampEngine* ramps = nullptr;
+  GrooveProcessor* groove = nullptr;  // Audio-thread states only
+  const ParamSnapshot* params = nullptr;
+  TaskScheduler* tasks = nullptr;
+  const std::vector<MidiEvent>* inputEvents = nullptr;  // This block's input
+  AsyncRunner* async = nullptr;  // ctx.async jobs, audio-thread states only
+  uint64_t scriptHash = 0;       // Of the loaded source, keys ctx.cache
+  uint64_t seed = 0;  // Saved with the instance; seeds ctx.rng, math.random
+
+  // Sample offset for events emitted by the running callback (tasks resume
+  // mid-block)
+  int32_t sampleOffset = 0;
+
+  // Start of the running process() sub-block (options.sub_block)
+  int32_t processOffset = 0;
+
+  // Samples the layer has processed, counting while the transport is
+  // stopped; times note-offs that beats cannot
+  int64_t sampleClock = 0;
+
+  // Beat position that events emitted right now belong to
+  double eventBeat() const {
+    return transport.beat + sampleOffset / transport.samplesPerBeat();
+  }
 };
 
+// Fetch the PluginContext registered for this Lua state
+PluginContext* getContext(lua_State* L);
+
+// Emit a note-on now and schedule its note-off `duration` beats later
+void emitNote(PluginContext* ctx, uint8_t note, uint8_t velocity,
+              double duration, uint8_t channel);
+
 // Register the ctx API table in the given Lua state
 void registerPluginAPI(lua_State* L, PluginContext* ctx);
 
@@ -0,0 +1,385 @@
+#include "array_api.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "num_array.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+static const char* kNumArrayMetatable = "FLLua.NumArray";
+static constexpr lua_Integer kMaxArraySize = 1 << 20;
+
+static const char* const kTypeNames[] = {"i8", "i16", "f32", "f64", nullptr};
+
+static NumArray* checkArray(lua_State* L, int arg) {
+  return static_cast<NumArray*>(luaL_checkudata(L, arg, kNumArrayMetatable));
+}
+
+static NumArray* toArray(lua_State* L, int idx) {
+  return static_cast<NumArray*>(luaL_testudata(L, idx, kNumArrayMetatable));
+}
+
+static NumArray* pushArray(lua_State* L, NumType type, uint32_t size) {
+  auto* array = static_cast<NumArray*>(
+      lua_newuserdatauv(L, NumArray::allocationSize(type, size), 0));
+  array->size = size;
+  array->type = type;
+  std::memset(array->data(), 0, numTypeSize(type) * size);
+  luaL_setmetatable(L, kNumArrayMetatable);
+  return array;
+}
+
+// Copy the array part of the table at `idx` into `array` from index 0
+static void fillFromTable(lua_State* L, int idx, NumArray* array) {
+  auto length = static_cast<uint32_t>(
+      std::min<lua_Integer>(lua_rawlen(L, idx), array->size));
+  for (uint32_t i = 0; i < length; ++i) {
+    lua_rawgeti(L, idx, static_cast<lua_Integer>(i) + 1);
+    int isnum = 0;
+    double value = lua_tonumberx(L, -1, &isnum);
+    lua_pop(L, 1);
+    if (!isnum) {
+      luaL_error(L, "array element %d is not a number",
+                 static_cast<int>(i + 1));
+    }
+    numSet(*array, i, value);
+  }
+}
+
+static void pushElement(lua_State* L, const NumArray* array, uint32_t i) {
+  double value = numGet(*array, i);
+  if (array->type == NumType::Int8 || array->type == NumType::Int16) {
+    lua_pushinteger(L, static_cast<lua_Integer>(value));
+  } else {
+    lua_pushnumber(L, value);
+  }
+}
+
+// Array argument of the same size as `array`, or a table converted to one
+static NumArray* checkOperand(lua_State* L, int arg, const NumArray* array) {
+  auto* other = toArray(L, arg);
+  if (!other) {
+    luaL_checktype(L, arg, LUA_TTABLE);
+    luaL_argcheck(L, lua_rawlen(L, arg) == array->size, arg,
+                  "array sizes differ");
+    other = pushArray(L, NumType::Float64, array->size);
+    fillFromTable(L, arg, other);
+    lua_replace(L, arg);
+  }
+  luaL_argcheck(L, other->size == array->size, arg, "array sizes differ");
+  return other;
+}
+
+// ctx.array(size_or_table [, type]) -> array
+// Types are "i8", "i16", "f32" and "f64" (default)
+static int ctx_array(lua_State* L) {
+  auto type = static_cast<NumType>(luaL_checkoption(L, 2, "f64", kTypeNames));
+  lua_Integer size = 0;
+  bool fromTable = lua_istable(L, 1);
+  if (fromTable) {
+    size = static_cast<lua_Integer>(lua_rawlen(L, 1));
+  } else {
+    size = luaL_checkinteger(L, 1);
+  }
+  luaL_argcheck(L, size >= 0 && size <= kMaxArraySize, 1,
+                "size out of range");
+
+  auto* array = pushArray(L, type, static_cast<uint32_t>(size));
+  if (fromTable) fillFromTable(L, 1, array);
+  return 1;
+}
+
+// array[i] for 1-based integer keys, methods otherwise
+static int array_index(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  int isnum = 0;
+  lua_Integer i = lua_tointegerx(L, 2, &isnum);
+  if (isnum) {
+    if (i >= 1 && i <= static_cast<lua_Integer>(array->size)) {
+      pushElement(L, array, static_cast<uint32_t>(i - 1));
+    } else {
+      lua_pushnil(L);
+    }
+    return 1;
+  }
+  lua_pushvalue(L, 2);
+  lua_rawget(L, lua_upvalueindex(1));
+  return 1;
+}
+
+static int array_newindex(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  lua_Integer i = luaL_checkinteger(L, 2);
+  luaL_argcheck(L, i >= 1 && i <= static_cast<lua_Integer>(array->size), 2,
+                "index out of range");
+  numSet(*array, static_cast<uint32_t>(i - 1), luaL_checknumber(L, 3));
+  return 0;
+}
+
+static int array_len(lua_State* L) {
+  lua_pushinteger(L, checkArray(L, 1)->size);
+  return 1;
+}
+
+static int array_tostring(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  lua_pushfstring(L, "%s array (%d)",
+                  kTypeNames[static_cast<int>(array->type)],
+                  static_cast<int>(array->size));
+  return 1;
+}
+
+// array:type() -> "i8", "i16", "f32" or "f64"
+static int array_type(lua_State* L) {
+  lua_pushstring(L, kTypeNames[static_cast<int>(checkArray(L, 1)->type)]);
+  return 1;
+}
+
+// array:to_table([t]) -> t filled with the elements (new table by default)
+static int array_to_table(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  if (lua_istable(L, 2)) {
+    lua_settop(L, 2);
+  } else {
+    lua_settop(L, 1);
+    lua_createtable(L, static_cast<int>(array->size), 0);
+  }
+  for (uint32_t i = 0; i < array->size; ++i) {
+    pushElement(L, array, i);
+    lua_rawseti(L, 2, static_cast<lua_Integer>(i) + 1);
+  }
+  return 1;
+}
+
+// array:load(t) -> array, copying t's elements from index 1
+static int array_load(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  fillFromTable(L, 2, array);
+  lua_settop(L, 1);
+  return 1;
+}
+
+// array:copy([type]) -> new array with the same elements
+static int array_copy(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  int typeIndex = luaL_checkoption(
+      L, 2, kTypeNames[static_cast<int>(array->type)], kTypeNames);
+  auto* copy = pushArray(L, static_cast<NumType>(typeIndex), array->size);
+  if (copy->type == array->type) {
+    std::memcpy(copy->data(), array->data(),
+                numTypeSize(array->type) * array->size);
+  } else {
+    for (uint32_t i = 0; i < array->size; ++i) {
+      numSet(*copy, i, numGet(*array, i));
+    }
+  }
+  return 1;
+}
+
+// array:fill(value) -> array
+static int array_fill(lua_State* L) {
+  numFill(*checkArray(L, 1), luaL_checknumber(L, 2));
+  lua_settop(L, 1);
+  return 1;
+}
+
+// array:add(number_or_array) -> array
+static int array_add(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  if (lua_type(L, 2) == LUA_TNUMBER) {
+    numAddScalar(*array, lua_tonumber(L, 2));
+  } else {
+    numAdd(*array, *checkOperand(L, 2, array));
+  }
+  lua_settop(L, 1);
+  return 1;
+}
+
+// array:scale(number_or_array) -> array, multiplying element-wise
+static int array_scale(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  if (lua_type(L, 2) == LUA_TNUMBER) {
+    numScaleScalar(*array, lua_tonumber(L, 2));
+  } else {
+    numMul(*array, *checkOperand(L, 2, array));
+  }
+  lua_settop(L, 1);
+  return 1;
+}
+
+// array:clamp(lo, hi) -> array
+static int array_clamp(lua_State* L) {
+  numClamp(*checkArray(L, 1), luaL_checknumber(L, 2), luaL_checknumber(L, 3));
+  lua_settop(L, 1);
+  return 1;
+}
+
+// array:quantize(pitch_classes [, root]) -> array
+// Moves each value to the nearest pitch whose class, relative to `root`
+// (default 0), is in the list; ties resolve downward
+static int array_quantize(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  auto root = static_cast<int>(luaL_optinteger(L, 3, 0));
+
+  std::array<bool, 12> inScale{};
+  bool any = false;
+  auto length = static_cast<lua_Integer>(lua_rawlen(L, 2));
+  for (lua_Integer i = 1; i <= length; ++i) {
+    lua_rawgeti(L, 2, i);
+    int isnum = 0;
+    lua_Integer pc = lua_tointegerx(L, -1, &isnum);
+    lua_pop(L, 1);
+    if (!isnum) return luaL_argerror(L, 2, "pitch classes must be integers");
+    inScale[((pc % 12) + 12) % 12] = true;
+    any = true;
+  }
+  luaL_argcheck(L, any, 2, "empty scale");
+
+  std::array<int8_t, 12> shift{};
+  for (int pc = 0; pc < 12; ++pc) {
+    for (int d = 0; d <= 6; ++d) {
+      if (inScale[(pc - d + 12) % 12]) {
+        shift[pc] = static_cast<int8_t>(-d);
+        break;
+      }
+      if (inScale[(pc + d) % 12]) {
+        shift[pc] = static_cast<int8_t>(d);
+        break;
+      }
+    }
+  }
+  numQuantize(*array, shift, root);
+  lua_settop(L, 1);
+  return 1;
+}
+
+// array:lookup(lut) -> array, replacing each value v with lut[v + 1]
+// (0-based values index the 1-based table, clamped to its range)
+static int array_lookup(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  auto* lut = toArray(L, 2);
+  if (!lut) {
+    luaL_checktype(L, 2, LUA_TTABLE);
+    auto size = std::min<lua_Integer>(lua_rawlen(L, 2), kMaxArraySize);
+    lut = pushArray(L, NumType::Float64, static_cast<uint32_t>(size));
+    fillFromTable(L, 2, lut);
+  }
+  numLookup(*array, *lut);
+  lua_settop(L, 1);
+  return 1;
+}
+
+// array:cumsum() -> array, each element replaced by the running sum
+static int array_cumsum(lua_State* L) {
+  numCumsum(*checkArray(L, 1));
+  lua_settop(L, 1);
+  return 1;
+}
+
+static void pushReduction(lua_State* L, const NumArray* array, double value) {
+  if (array->type == NumType::Int8 || array->type == NumType::Int16) {
+    lua_pushinteger(L, static_cast<lua_Integer>(value));
+  } else {
+    lua_pushnumber(L, value);
+  }
+}
+
+static int array_sum(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  pushReduction(L, array, numSum(*array));
+  return 1;
+}
+
+// array:mean() -> average, nil when empty
+static int array_mean(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  if (array->size == 0) return 0;
+  lua_pushnumber(L, numSum(*array) / array->size);
+  return 1;
+}
+
+// array:min() / array:max() -> value, nil when empty
+static int array_min(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  if (array->size == 0) return 0;
+  pushReduction(L, array, numMin(*array));
+  return 1;
+}
+
+static int array_max(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  if (array->size == 0) return 0;
+  pushReduction(L, array, numMax(*array));
+  return 1;
+}
+
+// array:argmin() / array:argmax() -> 1-based index of the first extreme,
+// nil when empty
+static int array_argmin(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  if (array->size == 0) return 0;
+  lua_pushinteger(L, static_cast<lua_Integer>(numArgmin(*array)) + 1);
+  return 1;
+}
+
+static int array_argmax(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  if (array->size == 0) return 0;
+  lua_pushinteger(L, static_cast<lua_Integer>(numArgmax(*array)) + 1);
+  return 1;
+}
+
+// array:dot(other) -> sum of element-wise products
+static int array_dot(lua_State* L) {
+  auto* array = checkArray(L, 1);
+  lua_pushnumber(L, numDot(*array, *checkOperand(L, 2, array)));
+  return 1;
+}
+
+void registerArrayAPI(lua_State* L) {
+  static const luaL_Reg arrayMethods[] = {{"type", array_type},
+                                          {"to_table", array_to_table},
+                                          {"load", array_load},
+                                          {"copy", array_copy},
+                                          {"fill", array_fill},
+                                          {"add", array_add},
+                                          {"scale", array_scale},
+                                          {"clamp", array_clamp},
+                                          {"quantize", array_quantize},
+                                          {"lookup", array_lookup},
+                                          {"cumsum", array_cumsum},
+                                          {"sum", array_sum},
+                                          {"mean", array_mean},
+                                          {"min", array_min},
+                                          {"max", array_max},
+                                          {"argmin", array_argmin},
+                                          {"argmax", array_argmax},
+                                          {"dot", array_dot},
+                                          {nullptr, nullptr}};
+  if (luaL_newmetatable(L, kNumArrayMetatable)) {
+    luaL_newlib(L, arrayMethods);
+    lua_pushcclosure(L, array_index, 1);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, array_newindex);
+    lua_setfield(L, -2, "__newindex");
+    lua_pushcfunction(L, array_len);
+    lua_setfield(L, -2, "__len");
+    lua_pushcfunction(L, array_tostring);
+    lua_setfield(L, -2, "__tostring");
+  }
+  lua_pop(L, 1);
+
+  lua_pushcfunction(L, ctx_array);
+  lua_setfield(L, -2, "array");
+}
+
+}  // namespace FLLua
@@ -0,0 +1,11 @@
+#pragma once
+
+struct lua_State;
+
+namespace FLLua {
+
+// Add ctx.array and the numeric array type to the ctx function table on
+// top of the stack
+void registerArrayAPI(lua_State* L);
+
+}  // namespace FLLua
@@ -0,0 +1,210 @@
+#include "async_api.hpp"
+
+#include <string>
+#include <vector>
+
+#include "api.hpp"
+#include "async_runner.hpp"
+#include "plain_value.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+static const char* kFutureMetatable = "FLLua.Future";
+static const char* kFuturesKey = "FLLua_Futures";  // Pending futures by id
+
+// The result and error live in the userdata's user values 1 and 2
+enum class FutureState : uint8_t { Pending, Done, Failed, Cancelled };
+
+struct Future {
+  uint32_t id;
+  FutureState state;
+};
+
+static Future* checkFuture(lua_State* L, int arg) {
+  return static_cast<Future*>(luaL_checkudata(L, arg, kFutureMetatable));
+}
+
+// Forget a pending future: its result will not be delivered
+static void unregisterFuture(lua_State* L, uint32_t id) {
+  lua_getfield(L, LUA_REGISTRYINDEX, kFuturesKey);
+  lua_pushnil(L);
+  lua_rawseti(L, -2, id);
+  lua_pop(L, 1);
+}
+
+// ctx.async(name, ...) -> future, or nil and an error if the queue is full
+// Calls the script's function `name` on the job worker with copies of the
+// remaining arguments
+static int ctx_async(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->async) {
+    return luaL_error(L, "ctx.async is not available in this mode");
+  }
+  const char* name = luaL_checkstring(L, 1);
+  int nargs = lua_gettop(L) - 1;
+
+  // C++ state is scoped so lua_error never unwinds past it
+  uint32_t id = 0;
+  bool copied = true;
+  {
+    std::vector<PlainValue> args(nargs);
+    for (int i = 0; i < nargs && copied; ++i) {
+      auto error = toPlainValue(L, i + 2, args[i]);
+      if (!error.empty()) {
+        lua_pushfstring(L, "ctx.async argument %d: %s", i + 2, error.c_str());
+        copied = false;
+      }
+    }
+    if (copied) id = ctx->async->submit(name, std::move(args));
+  }
+  if (!copied) return lua_error(L);
+  if (id == 0) {
+    lua_pushnil(L);
+    lua_pushliteral(L, "job queue is full");
+    return 2;
+  }
+
+  auto* future = static_cast<Future*>(lua_newuserdatauv(L, sizeof(Future), 2));
+  *future = Future{id, FutureState::Pending};
+  luaL_setmetatable(L, kFutureMetatable);
+
+  // Keep pending futures reachable so on_result sees them even if the
+  // script dropped its reference
+  lua_getfield(L, LUA_REGISTRYINDEX, kFuturesKey);
+  lua_pushvalue(L, -2);
+  lua_rawseti(L, -2, id);
+  lua_pop(L, 1);
+  return 1;
+}
+
+// ctx.async_pending() -> jobs queued or running for this script
+static int ctx_async_pending(lua_State* L) {
+  auto* ctx = getContext(L);
+  lua_pushinteger(L, ctx && ctx->async ? ctx->async->pending() : 0);
+  return 1;
+}
+
+// future:ready() -> whether the job finished, failed or was cancelled
+static int future_ready(lua_State* L) {
+  lua_pushboolean(L, checkFuture(L, 1)->state != FutureState::Pending);
+  return 1;
+}
+
+// future:result() -> value, or nil and an error
+static int future_result(lua_State* L) {
+  auto* future = checkFuture(L, 1);
+  switch (future->state) {
+    case FutureState::Pending:
+      lua_pushnil(L);
+      lua_pushliteral(L, "pending");
+      return 2;
+    case FutureState::Done:
+      lua_getiuservalue(L, 1, 1);
+      return 1;
+    case FutureState::Failed:
+      lua_pushnil(L);
+      lua_getiuservalue(L, 1, 2);
+      return 2;
+    case FutureState::Cancelled:
+      break;
+  }
+  lua_pushnil(L);
+  lua_pushliteral(L, "cancelled");
+  return 2;
+}
+
+// future:cancel() -> stop the job; on_result is not called for it
+static int future_cancel(lua_State* L) {
+  auto* future = checkFuture(L, 1);
+  if (future->state != FutureState::Pending) return 0;
+
+  future->state = FutureState::Cancelled;
+  unregisterFuture(L, future->id);
+  auto* ctx = getContext(L);
+  if (ctx && ctx->async) ctx->async->cancel(future->id);
+  return 0;
+}
+
+static int future_tostring(lua_State* L) {
+  static const char* kStates[] = {"pending", "done", "failed", "cancelled"};
+  auto* future = checkFuture(L, 1);
+  lua_pushfstring(L, "future %d (%s)", static_cast<int>(future->id),
+                  kStates[static_cast<int>(future->state)]);
+  return 1;
+}
+
+void registerAsyncAPI(lua_State* L) {
+  if (luaL_newmetatable(L, kFutureMetatable)) {
+    static const luaL_Reg methods[] = {{"ready", future_ready},
+                                       {"result", future_result},
+                                       {"cancel", future_cancel},
+                                       {nullptr, nullptr}};
+    luaL_newlib(L, methods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, future_tostring);
+    lua_setfield(L, -2, "__tostring");
+  }
+  lua_pop(L, 1);
+
+  lua_newtable(L);
+  lua_setfield(L, LUA_REGISTRYINDEX, kFuturesKey);
+
+  static const luaL_Reg asyncFunctions[] = {
+      {"async", ctx_async},
+      {"async_pending", ctx_async_pending},
+      {nullptr, nullptr}};
+  luaL_setfuncs(L, asyncFunctions, 0);
+}
+
+std::string deliverAsyncResults(lua_State* L, PluginContext* ctx) {
+  if (!ctx->async) return {};
+  std::string errors;
+
+  AsyncResult result;
+  while (ctx->async->takeResult(result)) {
+    lua_getfield(L, LUA_REGISTRYINDEX, kFuturesKey);
+    if (lua_rawgeti(L, -1, result.id) != LUA_TUSERDATA) {
+      lua_pop(L, 2);
+      continue;  // Cancelled from Lua
+    }
+    lua_remove(L, -2);
+    unregisterFuture(L, result.id);
+
+    auto* future = static_cast<Future*>(lua_touserdata(L, -1));
+    if (result.error.empty()) {
+      future->state = FutureState::Done;
+      pushPlainValue(L, result.value);
+      lua_setiuservalue(L, -2, 1);
+    } else {
+      future->state = FutureState::Failed;
+      lua_pushlstring(L, result.error.data(), result.error.size());
+      lua_setiuservalue(L, -2, 2);
+    }
+
+    if (lua_getglobal(L, "on_result") != LUA_TFUNCTION) {
+      lua_pop(L, 2);
+      continue;  // Polled through the future
+    }
+    lua_getglobal(L, "ctx");
+    lua_pushvalue(L, -3);
+    lua_getiuservalue(L, -4, 1);
+    lua_getiuservalue(L, -5, 2);
+    if (lua_pcall(L, 4, 0, 0) != LUA_OK) {
+      const char* msg = lua_tostring(L, -1);
+      errors += msg ? msg : "on_result error";
+      errors += '\n';
+      lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+  }
+
+  if (!errors.empty()) errors.pop_back();
+  return errors;
+}
+
+}  // namespace FLLua
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+struct lua_State;
+
+namespace FLLua {
+
+struct PluginContext;
+
+// Add ctx.async / ctx.async_pending and the future type
+void registerAsyncAPI(lua_State* L);
+
+// Fill the futures of finished jobs (ctx->async) and call
+// on_result(ctx, future, value, error) for each. Returns error messages
+// (one per line), empty on success.
+std::string deliverAsyncResults(lua_State* L, PluginContext* ctx);
+
+}  // namespace FLLua
@@ -0,0 +1,124 @@
+#include "async_runner.hpp"
+
+namespace FLLua {
+
+AsyncRunner::AsyncRunner() = default;
+
+AsyncRunner::~AsyncRunner() { stop(); }
+
+void AsyncRunner::start(const std::string& luaLibsPath, uint64_t seed) {
+  stop();
+  m_context.seed = seed;
+  m_running.store(true, std::memory_order_release);
+  m_thread = std::thread(&AsyncRunner::run, this, luaLibsPath);
+}
+
+void AsyncRunner::stop() {
+  if (!m_thread.joinable()) return;
+
+  m_running.store(false, std::memory_order_release);
+  wake();
+  m_thread.join();
+
+  AsyncJob job;
+  while (m_jobs.try_dequeue(job)) {
+  }
+  AsyncResult result;
+  while (m_results.try_dequeue(result)) {
+  }
+  m_finished.store(m_submitted.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+}
+
+void AsyncRunner::setScript(const std::string& source) {
+  m_script = std::make_shared<const std::string>(source);
+  m_firstLive.store(m_nextId, std::memory_order_release);
+  wake();
+}
+
+uint32_t AsyncRunner::submit(std::string function,
+                             std::vector<PlainValue> args) {
+  if (!m_thread.joinable() || !m_script) return 0;
+
+  uint32_t id = m_nextId;
+  if (!m_jobs.try_enqueue(
+          AsyncJob{id, std::move(function), std::move(args), m_script})) {
+    return 0;
+  }
+  ++m_nextId;
+  m_submitted.fetch_add(1, std::memory_order_relaxed);
+  wake();
+  return id;
+}
+
+void AsyncRunner::cancel(uint32_t id) {
+  m_cancelled[id % kCancelSlots].store(id, std::memory_order_release);
+}
+
+bool AsyncRunner::takeResult(AsyncResult& out) {
+  while (m_results.try_dequeue(out)) {
+    if (!isCancelled(out.id)) return true;
+  }
+  return false;
+}
+
+bool AsyncRunner::isCancelled(uint32_t id) const {
+  return id < m_firstLive.load(std::memory_order_acquire) ||
+         id == m_cancelled[id % kCancelSlots].load(std::memory_order_acquire);
+}
+
+void AsyncRunner::wake() {
+  m_wake.fetch_add(1, std::memory_order_release);
+  m_wake.notify_one();
+}
+
+void AsyncRunner::run(std::string luaLibsPath) {
+  m_context.logQueue = &m_logQueue;
+
+  // Jobs may run far longer than a block: no instruction cap, but stop as
+  // soon as the job is cancelled or the runner shuts down
+  m_engine.setInterrupt([this] {
+    return !m_running.load(std::memory_order_relaxed) ||
+           isCancelled(m_runningId.load(std::memory_order_relaxed));
+  });
+
+  while (m_running.load(std::memory_order_acquire)) {
+    uint32_t seen = m_wake.load(std::memory_order_acquire);
+    AsyncJob job;
+    if (!m_jobs.try_dequeue(job)) {
+      m_wake.wait(seen, std::memory_order_acquire);
+      continue;
+    }
+
+    if (!isCancelled(job.id)) runJob(job, luaLibsPath);
+    m_finished.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  m_engine.shutdown();
+  m_loaded.reset();
+  m_heapBytes.store(0, std::memory_order_relaxed);
+}
+
+void AsyncRunner::runJob(AsyncJob& job, const std::string& luaLibsPath) {
+  AsyncResult result{job.id, {}, {}};
+  m_runningId.store(job.id, std::memory_order_release);
+
+  // Reload the worker state when jobs come from a new script
+  if (job.script != m_loaded) {
+    m_loaded = job.script;
+    m_engine.init(&m_context, luaLibsPath);
+    auto error = m_engine.loadScript(*m_loaded);
+    if (!error.empty()) {
+      m_engine.shutdown();
+      m_logQueue.enqueue("Async script error: " + error);
+    }
+  }
+
+  result.error = m_engine.callJob(job.function, job.args, result.value);
+  m_runningId.store(0, std::memory_order_release);
+  m_heapBytes.store(m_engine.heapBytes(), std::memory_order_relaxed);
+
+  m_results.enqueue(std::move(result));
+}
+
+}  // namespace FLLua
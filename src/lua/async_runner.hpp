@@ -0,0 +1,115 @@
+#pragma once
+
+#include <readerwriterqueue/readerwriterqueue.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "api.hpp"
+#include "engine.hpp"
+#include "events/event_queue.hpp"
+#include "plain_value.hpp"
+
+namespace FLLua {
+
+// A call of a named script function on the job worker
+struct AsyncJob {
+  uint32_t id = 0;
+  std::string function;  // Global name, dots for fields ("gen.melody")
+  std::vector<PlainValue> args;
+  std::shared_ptr<const std::string> script;  // Source defining it
+};
+
+struct AsyncResult {
+  uint32_t id = 0;
+  PlainValue value;
+  std::string error;  // Empty on success
+};
+
+// Runs ctx.async jobs on a worker thread with its own sandboxed Lua state,
+// loaded from the same script, so expensive generation never holds up a
+// block. Arguments and results cross as PlainValue copies. Jobs run one at
+// a time in submission order, without the per-call instruction cap.
+class AsyncRunner {
+ public:
+  static constexpr size_t kMaxQueued = 64;
+
+  AsyncRunner();
+  ~AsyncRunner();
+
+  // Start and stop the worker; not on the audio thread. Job states are
+  // seeded like the layer's.
+  void start(const std::string& luaLibsPath, uint64_t seed);
+  void stop();
+
+  // Audio thread: the script was replaced. Cancels every job submitted so
+  // far; later jobs run against `source`.
+  void setScript(const std::string& source);
+
+  // Script thread: queue a job. Returns its id, 0 if the queue is full.
+  uint32_t submit(std::string function, std::vector<PlainValue> args);
+
+  // Script thread: drop a job's result and stop it if it is running
+  void cancel(uint32_t id);
+
+  // Script thread: finished jobs, in completion order. Results of
+  // cancelled jobs are skipped.
+  bool takeResult(AsyncResult& out);
+  bool hasResults() const { return m_results.size_approx() > 0; }
+
+  // Jobs queued or running
+  int pending() const {
+    return static_cast<int>(m_submitted.load(std::memory_order_relaxed) -
+                            m_finished.load(std::memory_order_relaxed));
+  }
+
+  // Lua heap of the worker state after its last job
+  int64_t heapBytes() const {
+    return m_heapBytes.load(std::memory_order_relaxed);
+  }
+
+  // Log output from job functions (worker → script thread)
+  LogQueue& getLogQueue() { return m_logQueue; }
+
+ private:
+  void run(std::string luaLibsPath);
+  void runJob(AsyncJob& job, const std::string& luaLibsPath);
+  bool isCancelled(uint32_t id) const;
+  void wake();
+
+  std::thread m_thread;
+  std::atomic<bool> m_running{false};
+  std::atomic<uint32_t> m_wake{0};
+
+  // Script thread → worker
+  moodycamel::ReaderWriterQueue<AsyncJob> m_jobs{kMaxQueued};
+  // Worker → script thread
+  moodycamel::ReaderWriterQueue<AsyncResult> m_results{kMaxQueued};
+  LogQueue m_logQueue;
+
+  std::shared_ptr<const std::string> m_script;  // Script-thread owned
+  uint32_t m_nextId = 1;                        // Script-thread owned
+  std::atomic<uint32_t> m_submitted{0};
+  std::atomic<uint32_t> m_finished{0};
+
+  // Jobs below m_firstLive belong to a replaced script
+  std::atomic<uint32_t> m_firstLive{1};
+  // Cancelled ids, each in slot id % kCancelSlots. Far fewer jobs than
+  // that are queued, running or awaiting collection at once.
+  static constexpr size_t kCancelSlots = 4 * kMaxQueued;
+  std::array<std::atomic<uint32_t>, kCancelSlots> m_cancelled{};
+  std::atomic<uint32_t> m_runningId{0};
+  std::atomic<int64_t> m_heapBytes{0};
+
+  // Worker-owned state
+  LuaEngine m_engine;
+  PluginContext m_context;
+  std::shared_ptr<const std::string> m_loaded;
+};
+
+}  // namespace FLLua
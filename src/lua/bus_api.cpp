@@ -0,0 +1,102 @@
+#include "bus_api.hpp"
+
+#include <string_view>
+
+#include "api.hpp"
+#include "events/shared_bus.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+// Channel index, or SharedBus::kBusy while another instance creates it
+static int checkChannel(lua_State* L, int arg) {
+  size_t length = 0;
+  const char* name = luaL_checklstring(L, arg, &length);
+  int channel = SharedBus::instance().channel(std::string_view(name, length));
+  if (channel < 0 && channel != SharedBus::kBusy) {
+    if (length == 0 || length > SharedBus::kMaxNameLength) {
+      luaL_argerror(L, arg, "bus channel names are 1-31 characters");
+    }
+    luaL_error(L, "bus is full (%d channels)", SharedBus::kMaxChannels);
+  }
+  return channel;
+}
+
+// ctx.bus.publish(name, value) -> published
+// value is a number or an array of up to 16 numbers, stamped with the
+// current event beat. False when the publication was dropped because the
+// channel was busy.
+static int bus_publish(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx) return 0;
+
+  int channel = checkChannel(L, 1);
+  double values[SharedBus::kMaxValues];
+  int count = 0;
+  bool isArray = lua_istable(L, 2);
+
+  if (isArray) {
+    auto length = luaL_len(L, 2);
+    luaL_argcheck(L, length <= SharedBus::kMaxValues, 2,
+                  "at most 16 values per publication");
+    for (lua_Integer i = 1; i <= length; ++i) {
+      lua_geti(L, 2, i);
+      int isNumber = 0;
+      values[count++] = lua_tonumberx(L, -1, &isNumber);
+      if (!isNumber) luaL_argerror(L, 2, "array must contain only numbers");
+      lua_pop(L, 1);
+    }
+  } else {
+    values[count++] = luaL_checknumber(L, 2);
+  }
+
+  bool published = channel != SharedBus::kBusy &&
+                   SharedBus::instance().publish(channel, ctx->eventBeat(),
+                                                 values, count, isArray);
+  lua_pushboolean(L, published);
+  return 1;
+}
+
+// ctx.bus.read(name [, beat]) -> value, beat
+// The value published for the given beat (default: the current event
+// beat), or nil if the channel was never published
+static int bus_read(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx) return 0;
+
+  int channel = checkChannel(L, 1);
+  double beat = luaL_optnumber(L, 2, ctx->eventBeat());
+
+  SharedBus::Snapshot snapshot;
+  if (channel == SharedBus::kBusy ||
+      !SharedBus::instance().read(channel, beat, snapshot)) {
+    lua_pushnil(L);
+    return 1;
+  }
+
+  if (snapshot.isArray) {
+    lua_createtable(L, snapshot.count, 0);
+    for (int i = 0; i < snapshot.count; ++i) {
+      lua_pushnumber(L, snapshot.values[i]);
+      lua_rawseti(L, -2, i + 1);
+    }
+  } else {
+    lua_pushnumber(L, snapshot.values[0]);
+  }
+  lua_pushnumber(L, snapshot.beat);
+  return 2;
+}
+
+void registerBusAPI(lua_State* L) {
+  static const luaL_Reg busFunctions[] = {{"publish", bus_publish},
+                                          {"read", bus_read},
+                                          {nullptr, nullptr}};
+  luaL_newlib(L, busFunctions);
+  lua_setfield(L, -2, "bus");
+}
+
+}  // namespace FLLua
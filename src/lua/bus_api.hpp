@@ -0,0 +1,11 @@
+#pragma once
+
+struct lua_State;
+
+namespace FLLua {
+
+// Add the ctx.bus table (publish/read on the process-wide SharedBus) to
+// the ctx function table on top of the stack
+void registerBusAPI(lua_State* L);
+
+}  // namespace FLLua
@@ -0,0 +1,120 @@
+#include "cache_api.hpp"
+
+#include <chrono>
+#include <string>
+
+#include "api.hpp"
+#include "disk_cache.hpp"
+#include "plain_value.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+// ctx.cache.get_or_compute(key, fn) -> value, hit
+// Returns the value cached on disk for `key` and this script, or calls
+// fn(key) and queues its result to be written. Keys and values are plain
+// data: booleans, numbers, strings and tables of them. Lookups map files
+// and share a lock with the writer, so they run on workers only.
+static int cache_get_or_compute(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx) return 0;
+  if (ctx->async) {
+    return luaL_error(L,
+                      "ctx.cache runs on workers only: call it through "
+                      "ctx.async");
+  }
+  luaL_checkany(L, 1);
+  luaL_checktype(L, 2, LUA_TFUNCTION);
+  lua_settop(L, 2);
+
+  // C++ state is scoped so lua_error never unwinds past it. On a miss the
+  // encoded key waits at index 3 until the value is stored.
+  bool failed = false;
+  bool found = false;
+  uint64_t hash = 0;
+  {
+    PlainValue key;
+    auto error = toPlainValue(L, 1, key);
+    if (!error.empty()) {
+      lua_pushfstring(L, "ctx.cache key: %s", error.c_str());
+      failed = true;
+    } else {
+      std::string keyBytes;
+      serializePlainValue(key, keyBytes);
+      hash = contentHash(keyBytes, ctx->scriptHash);
+
+      PlainValue value;
+      found = DiskCache::instance().load(hash, keyBytes, value);
+      if (found) {
+        pushPlainValue(L, value);
+      } else {
+        lua_pushlstring(L, keyBytes.data(), keyBytes.size());
+      }
+    }
+  }
+  if (failed) return lua_error(L);
+  if (found) {
+    lua_pushboolean(L, 1);
+    return 2;
+  }
+
+  auto started = std::chrono::steady_clock::now();
+  lua_pushvalue(L, 2);
+  lua_pushvalue(L, 1);
+  lua_call(L, 1, 1);
+  DiskCache::instance().addComputeTime(
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - started)
+          .count());
+
+  {
+    PlainValue value;
+    auto error = toPlainValue(L, 4, value);
+    if (!error.empty()) {
+      lua_pushfstring(L, "ctx.cache value: %s", error.c_str());
+      failed = true;
+    } else {
+      size_t length = 0;
+      const char* keyBytes = lua_tolstring(L, 3, &length);
+      DiskCache::instance().store(hash, std::string_view(keyBytes, length),
+                                  value);
+    }
+  }
+  if (failed) return lua_error(L);
+  lua_pushboolean(L, 0);
+  return 2;
+}
+
+// ctx.cache.stats() -> { entries, bytes, hits, misses, load_seconds,
+// compute_seconds }, shared by every instance in the process
+static int cache_stats(lua_State* L) {
+  auto stats = DiskCache::instance().stats();
+  lua_createtable(L, 0, 6);
+  lua_pushinteger(L, static_cast<lua_Integer>(stats.entries));
+  lua_setfield(L, -2, "entries");
+  lua_pushinteger(L, static_cast<lua_Integer>(stats.bytes));
+  lua_setfield(L, -2, "bytes");
+  lua_pushinteger(L, static_cast<lua_Integer>(stats.hits));
+  lua_setfield(L, -2, "hits");
+  lua_pushinteger(L, static_cast<lua_Integer>(stats.misses));
+  lua_setfield(L, -2, "misses");
+  lua_pushnumber(L, stats.loadSeconds);
+  lua_setfield(L, -2, "load_seconds");
+  lua_pushnumber(L, stats.computeSeconds);
+  lua_setfield(L, -2, "compute_seconds");
+  return 1;
+}
+
+void registerCacheAPI(lua_State* L) {
+  static const luaL_Reg cacheFunctions[] = {
+      {"get_or_compute", cache_get_or_compute},
+      {"stats", cache_stats},
+      {nullptr, nullptr}};
+  luaL_newlib(L, cacheFunctions);
+  lua_setfield(L, -2, "cache");
+}
+
+}  // namespace FLLua
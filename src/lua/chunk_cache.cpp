@@ -0,0 +1,147 @@
+#include "chunk_cache.hpp"
+
+#include <fstream>
+#include <sstream>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+ChunkCache& ChunkCache::instance() {
+  static ChunkCache cache;
+  return cache;
+}
+
+static int appendBytes(lua_State*, const void* p, size_t size, void* ud) {
+  static_cast<std::string*>(ud)->append(static_cast<const char*>(p), size);
+  return 0;
+}
+
+ChunkCache::ChunkRef ChunkCache::load(lua_State* L, const std::string& path,
+                                      std::string& error) {
+  std::error_code ec;
+  auto modified = std::filesystem::last_write_time(path, ec);
+  auto sourceSize = std::filesystem::file_size(path, ec);
+  if (ec) {
+    error = "cannot open " + path;
+    return nullptr;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_chunks.find(path);
+    auto chunk = it != m_chunks.end() ? it->second.lock() : nullptr;
+    if (chunk && chunk->modified == modified &&
+        chunk->sourceSize == sourceSize) {
+      ++m_hits;
+      return chunk;
+    }
+  }
+
+  // Compile without the lock; Lua errors must not unwind past it. Two
+  // states racing on a new library both compile it and the last one wins.
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    error = "cannot open " + path;
+    return nullptr;
+  }
+  std::stringstream ss;
+  ss << file.rdbuf();
+  std::string source = ss.str();
+
+  // Compile in the requesting state, keeping debug info for error lines
+  std::string chunkName = "@" + path;
+  if (luaL_loadbufferx(L, source.data(), source.size(), chunkName.c_str(),
+                       "t") != LUA_OK) {
+    error = lua_tostring(L, -1);
+    lua_pop(L, 1);
+    return nullptr;
+  }
+  auto chunk = std::make_shared<Chunk>();
+  lua_dump(L, appendBytes, &chunk->bytecode, 0);
+  lua_pop(L, 1);
+  chunk->modified = modified;
+  chunk->sourceSize = sourceSize;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_chunks[path] = chunk;
+  return chunk;
+}
+
+ChunkCache::Stats ChunkCache::stats() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Stats stats;
+  stats.hits = m_hits;
+  for (auto it = m_chunks.begin(); it != m_chunks.end();) {
+    if (auto chunk = it->second.lock()) {
+      ++stats.chunks;
+      stats.bytes += chunk->bytecode.size();
+      ++it;
+    } else {
+      it = m_chunks.erase(it);  // No state uses it anymore
+    }
+  }
+  return stats;
+}
+
+// package.searchers entry: resolve like the file searcher, load bytecode
+static int cachedSearcher(lua_State* L) {
+  const char* name = luaL_checkstring(L, 1);
+  auto* retained = static_cast<std::vector<ChunkCache::ChunkRef>*>(
+      lua_touserdata(L, lua_upvalueindex(1)));
+
+  lua_getglobal(L, "package");
+  lua_getfield(L, -1, "searchpath");
+  lua_pushstring(L, name);
+  lua_getfield(L, -3, "path");
+  lua_call(L, 2, 2);
+  if (lua_isnil(L, -2)) return 1;  // Not found: the path search message
+  lua_pop(L, 1);                   // Keep the resolved path string at -2
+
+  // C++ locals are scoped so lua_error never unwinds past them
+  bool loaded = false;
+  {
+    std::string path = lua_tostring(L, -1);
+    std::string error;
+    auto chunk = ChunkCache::instance().load(L, path, error);
+    if (chunk) {
+      std::string chunkName = "@" + path;
+      loaded = luaL_loadbufferx(L, chunk->bytecode.data(),
+                                chunk->bytecode.size(), chunkName.c_str(),
+                                "b") == LUA_OK;
+      if (loaded) retained->push_back(std::move(chunk));
+      else error = lua_tostring(L, -1);
+    }
+    if (!loaded) {
+      lua_pushfstring(L, "error loading module '%s' from file '%s':\n\t%s",
+                      name, path.c_str(), error.c_str());
+    }
+  }
+  if (!loaded) return lua_error(L);
+
+  lua_pushvalue(L, -2);  // The path is the loader's second argument
+  return 2;
+}
+
+void installChunkSearcher(lua_State* L,
+                          std::vector<ChunkCache::ChunkRef>* retained) {
+  lua_getglobal(L, "package");
+  lua_getfield(L, -1, "searchers");
+
+  // Shift entries 2.. up and insert after the preload searcher
+  auto count = static_cast<lua_Integer>(lua_rawlen(L, -1));
+  for (lua_Integer i = count; i >= 2; --i) {
+    lua_rawgeti(L, -1, i);
+    lua_rawseti(L, -2, i + 1);
+  }
+  lua_pushlightuserdata(L, retained);
+  lua_pushcclosure(L, cachedSearcher, 1);
+  lua_rawseti(L, -2, 2);
+
+  lua_pop(L, 2);
+}
+
+}  // namespace FLLua
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct lua_State;
+
+namespace FLLua {
+
+// Library bytecode compiled once per process and reused by every Lua
+// state. Entries live while some state still holds them; a library edited
+// on disk is recompiled on its next require.
+class ChunkCache {
+ public:
+  struct Chunk {
+    std::string bytecode;
+    std::filesystem::file_time_type modified;
+    uintmax_t sourceSize = 0;
+  };
+  using ChunkRef = std::shared_ptr<const Chunk>;
+
+  struct Stats {
+    size_t chunks = 0;  // Live compiled libraries
+    size_t bytes = 0;   // Bytecode held once for all states
+    uint64_t hits = 0;  // Requires served without compiling
+  };
+
+  static ChunkCache& instance();
+
+  // Bytecode for the Lua source at `path`, compiling it with `L` when no
+  // state holds a current copy. Returns null and sets `error` on failure.
+  ChunkRef load(lua_State* L, const std::string& path, std::string& error);
+
+  Stats stats();
+
+ private:
+  std::mutex m_mutex;
+  std::unordered_map<std::string, std::weak_ptr<const Chunk>> m_chunks;
+  uint64_t m_hits = 0;
+};
+
+// Put a package.searchers entry in front of the Lua file searcher that
+// resolves modules on package.path and loads them from the ChunkCache.
+// Chunks used are appended to `retained`, which must outlive the state.
+void installChunkSearcher(lua_State* L,
+                          std::vector<ChunkCache::ChunkRef>* retained);
+
+}  // namespace FLLua
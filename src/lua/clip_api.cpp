@@ -0,0 +1,209 @@
+#include "clip_api.hpp"
+
+#include <memory>
+#include <string>
+
+#include "api.hpp"
+#include "sequencing/clip_player.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+// Clip ids are 1-based on the Lua side
+static int checkClipId(lua_State* L, int arg) {
+  return static_cast<int>(luaL_checkinteger(L, arg)) - 1;
+}
+
+static double optNumberField(lua_State* L, int idx, const char* key,
+                             double def) {
+  lua_getfield(L, idx, key);
+  double value = luaL_optnumber(L, -1, def);
+  lua_pop(L, 1);
+  return value;
+}
+
+// Note tuple fields are read raw, so after validation reading them cannot
+// raise while the clip is being built
+static double numberAt(lua_State* L, int idx, lua_Integer i, double def) {
+  lua_rawgeti(L, idx, i);
+  int isNumber = 0;
+  double value = lua_tonumberx(L, -1, &isNumber);
+  lua_pop(L, 1);
+  return isNumber ? value : def;
+}
+
+// Raise on anything that is not an array of number tuples
+static void checkNotes(lua_State* L, int idx) {
+  lua_Integer count = static_cast<lua_Integer>(lua_rawlen(L, idx));
+  for (lua_Integer i = 1; i <= count; ++i) {
+    if (lua_rawgeti(L, idx, i) != LUA_TTABLE) {
+      luaL_error(L, "clip.load: note %d is not a table", static_cast<int>(i));
+    }
+    for (lua_Integer field = 1; field <= 5; ++field) {
+      int type = lua_rawgeti(L, -1, field);
+      if (type != LUA_TNUMBER && type != LUA_TNIL) {
+        luaL_error(L, "clip.load: note %d field %d is not a number",
+                   static_cast<int>(i), static_cast<int>(field));
+      }
+      lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+  }
+}
+
+// ctx.clip.load(source, length_beats?)
+// source is either Standard MIDI File bytes or an array of
+// {beat, pitch, velocity, duration, channel?} note tuples.
+static int clip_load(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->clipPlayer) return 0;
+
+  // Everything that can raise happens before the clip exists: a Lua error
+  // would skip its destructor
+  double length = luaL_optnumber(L, 2, 0.0);
+  bool smf = lua_type(L, 1) == LUA_TSTRING;
+  if (!smf) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    checkNotes(L, 1);
+  }
+
+  int id = -1;
+  bool failed = false;
+  {
+    auto clip = std::make_shared<MidiClip>();
+    std::string error;
+    if (smf) {
+      size_t size = 0;
+      const char* bytes = lua_tolstring(L, 1, &size);
+      error = clip->loadSmf(reinterpret_cast<const uint8_t*>(bytes), size);
+    } else {
+      auto count = static_cast<lua_Integer>(lua_rawlen(L, 1));
+      for (lua_Integer i = 1; i <= count; ++i) {
+        lua_rawgeti(L, 1, i);
+        int note = lua_gettop(L);
+        clip->addNote(numberAt(L, note, 1, 0.0),
+                      static_cast<uint8_t>(numberAt(L, note, 2, 60)),
+                      static_cast<uint8_t>(numberAt(L, note, 3, 100)),
+                      numberAt(L, note, 4, 1.0),
+                      static_cast<uint8_t>(numberAt(L, note, 5, 0)));
+        lua_pop(L, 1);
+      }
+    }
+    if (error.empty()) {
+      clip->finalize(length);
+      id = ctx->clipPlayer->load(std::move(clip));
+    } else {
+      lua_pushfstring(L, "clip.load: %s", error.c_str());
+      failed = true;
+    }
+  }
+  if (failed) return lua_error(L);
+  if (id < 0) {
+    return luaL_error(L, "clip.load: all %d clip slots are in use",
+                      ClipPlayer::kMaxClips);
+  }
+  lua_pushinteger(L, id + 1);
+  return 1;
+}
+
+// ctx.clip.play(id, {at = beat, loop = true}?)
+static int clip_play(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->clipPlayer) return 0;
+
+  int id = checkClipId(L, 1);
+  double at = ctx->eventBeat();
+  bool loop = true;
+  if (lua_istable(L, 2)) {
+    at = optNumberField(L, 2, "at", at);
+    lua_getfield(L, 2, "loop");
+    if (!lua_isnil(L, -1)) loop = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+  }
+
+  lua_pushboolean(L, ctx->clipPlayer->play(id, at, loop));
+  return 1;
+}
+
+// ctx.clip.stop(id)
+static int clip_stop(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->clipPlayer || !ctx->eventQueue) return 0;
+
+  lua_pushboolean(L,
+                  ctx->clipPlayer->stop(checkClipId(L, 1), *ctx->eventQueue));
+  return 1;
+}
+
+// ctx.clip.transform(id, {transpose, velocity, channel, rate})
+// Omitted fields keep their current value.
+static int clip_transform(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->clipPlayer) return 0;
+
+  int id = checkClipId(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  const auto* current = ctx->clipPlayer->transform(id);
+  if (!current) return luaL_error(L, "clip.transform: invalid clip id");
+
+  ClipTransform xf = *current;
+  xf.transpose =
+      static_cast<int>(optNumberField(L, 2, "transpose", xf.transpose));
+  xf.velocityScale = optNumberField(L, 2, "velocity", xf.velocityScale);
+  xf.channel = static_cast<int>(optNumberField(L, 2, "channel", xf.channel));
+  xf.rate = optNumberField(L, 2, "rate", xf.rate);
+  luaL_argcheck(L, xf.rate > 0.0, 2, "rate must be positive");
+
+  lua_pushboolean(
+      L, ctx->clipPlayer->setTransform(id, xf, ctx->transport.beat));
+  return 1;
+}
+
+// ctx.clip.unload(id)
+static int clip_unload(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->clipPlayer || !ctx->eventQueue) return 0;
+
+  lua_pushboolean(
+      L, ctx->clipPlayer->unload(checkClipId(L, 1), *ctx->eventQueue));
+  return 1;
+}
+
+// ctx.clip.length(id) -> beats
+static int clip_length(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->clipPlayer) return 0;
+
+  const auto* clip = ctx->clipPlayer->clip(checkClipId(L, 1));
+  if (!clip) return 0;
+  lua_pushnumber(L, clip->lengthBeats());
+  return 1;
+}
+
+// ctx.clip.playing(id)
+static int clip_playing(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->clipPlayer) return 0;
+
+  lua_pushboolean(L, ctx->clipPlayer->isPlaying(checkClipId(L, 1)));
+  return 1;
+}
+
+void registerClipAPI(lua_State* L) {
+  static const luaL_Reg clipFunctions[] = {{"load", clip_load},
+                                           {"play", clip_play},
+                                           {"stop", clip_stop},
+                                           {"transform", clip_transform},
+                                           {"unload", clip_unload},
+                                           {"length", clip_length},
+                                           {"playing", clip_playing},
+                                           {nullptr, nullptr}};
+  luaL_newlib(L, clipFunctions);
+  lua_setfield(L, -2, "clip");
+}
+
+}  // namespace FLLua
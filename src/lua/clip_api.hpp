@@ -0,0 +1,10 @@
+#pragma once
+
+struct lua_State;
+
+namespace FLLua {
+
+// Add the ctx.clip sub-table to the ctx function table on top of the stack
+void registerClipAPI(lua_State* L);
+
+}  // namespace FLLua
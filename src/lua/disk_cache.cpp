@@ -0,0 +1,358 @@
+#include "disk_cache.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace FLLua {
+
+// Blob layout: magic, format version, key length (u32 LE), key, value
+static constexpr char kMagic[4] = {'F', 'L', 'L', 'C'};
+static constexpr uint8_t kFormatVersion = 1;
+static constexpr size_t kHeaderSize = sizeof(kMagic) + 1 + 4;
+
+uint64_t contentHash(std::string_view data, uint64_t seed) {
+  uint64_t hash = seed;
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// Read-only view of a whole file, unmapped on destruction
+class MappedFile {
+ public:
+  explicit MappedFile(const std::filesystem::path& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+      HANDLE mapping =
+          CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (mapping) {
+        m_data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (m_data) m_size = static_cast<size_t>(size.QuadPart);
+        CloseHandle(mapping);  // The view keeps the mapping alive
+      }
+    }
+    CloseHandle(file);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ,
+                        MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        m_data = data;
+        m_size = static_cast<size_t>(info.st_size);
+      }
+    }
+    close(fd);
+#endif
+  }
+
+  ~MappedFile() {
+    if (!m_data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+#else
+    munmap(m_data, m_size);
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view bytes() const {
+    return m_data ? std::string_view(static_cast<const char*>(m_data), m_size)
+                  : std::string_view();
+  }
+
+ private:
+  void* m_data = nullptr;
+  size_t m_size = 0;
+};
+
+static std::filesystem::path cacheDirectory() {
+#ifdef _WIN32
+  if (const char* local = std::getenv("LOCALAPPDATA")) {
+    return std::filesystem::path(local) / "FL-Lua" / "Cache";
+  }
+#else
+  if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+    return std::filesystem::path(xdg) / "fl-lua";
+  }
+  if (const char* home = std::getenv("HOME")) {
+    return std::filesystem::path(home) / ".cache" / "fl-lua";
+  }
+#endif
+  return std::filesystem::temp_directory_path() / "fl-lua-cache";
+}
+
+static int64_t nanosSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+DiskCache::DiskCache() : m_directory(cacheDirectory()) {}
+
+DiskCache& DiskCache::instance() {
+  static DiskCache cache;
+  return cache;
+}
+
+void DiskCache::retain() {
+  std::lock_guard lifecycle(m_lifecycle);
+  std::lock_guard lock(m_mutex);
+  if (m_users++ == 0) {
+    m_stopping = false;
+    m_thread = std::thread([this] { run(); });
+  }
+}
+
+// Joins under m_lifecycle, so a retain() racing this release starts its
+// writer only after the old one has exited
+void DiskCache::release() {
+  std::lock_guard lifecycle(m_lifecycle);
+  std::thread thread;
+  {
+    std::lock_guard lock(m_mutex);
+    if (m_users == 0 || --m_users > 0) return;
+    m_stopping = true;
+    thread = std::move(m_thread);
+  }
+  m_wake.notify_one();
+  if (thread.joinable()) thread.join();
+}
+
+bool DiskCache::load(uint64_t hash, std::string_view key, PlainValue& out) {
+  auto started = std::chrono::steady_clock::now();
+  bool found = false;
+  {
+    MappedFile file(pathFor(hash));
+    auto data = file.bytes();
+    if (data.size() >= kHeaderSize &&
+        std::memcmp(data.data(), kMagic, sizeof(kMagic)) == 0 &&
+        static_cast<uint8_t>(data[sizeof(kMagic)]) == kFormatVersion) {
+      uint32_t keySize = 0;
+      for (int i = 0; i < 4; ++i) {
+        keySize |= static_cast<uint32_t>(
+                       static_cast<uint8_t>(data[sizeof(kMagic) + 1 + i]))
+                   << (8 * i);
+      }
+      data.remove_prefix(kHeaderSize);
+      if (keySize <= data.size() && data.substr(0, keySize) == key) {
+        data.remove_prefix(keySize);
+        found = deserializePlainValue(data, out);
+      }
+    }
+  }
+
+  if (!found) {
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  m_hits.fetch_add(1, std::memory_order_relaxed);
+  m_loadNanos.fetch_add(nanosSince(started), std::memory_order_relaxed);
+
+  // Refresh the entry's recency off this thread
+  {
+    std::lock_guard lock(m_mutex);
+    if (!m_thread.joinable()) return true;
+    m_ops.push_back(Op{hash, {}});
+  }
+  m_wake.notify_one();
+  return true;
+}
+
+void DiskCache::store(uint64_t hash, std::string_view key,
+                      const PlainValue& value) {
+  std::string blob(kMagic, sizeof(kMagic));
+  blob.push_back(static_cast<char>(kFormatVersion));
+  auto keySize = static_cast<uint32_t>(key.size());
+  for (int i = 0; i < 4; ++i) {
+    blob.push_back(static_cast<char>((keySize >> (8 * i)) & 0xFF));
+  }
+  blob += key;
+  serializePlainValue(value, blob);
+
+  {
+    std::lock_guard lock(m_mutex);
+    if (!m_thread.joinable()) return;
+    m_ops.push_back(Op{hash, std::move(blob)});
+  }
+  m_wake.notify_one();
+}
+
+void DiskCache::addComputeTime(double seconds) {
+  m_computeNanos.fetch_add(static_cast<int64_t>(seconds * 1e9),
+                           std::memory_order_relaxed);
+}
+
+DiskCache::Stats DiskCache::stats() {
+  Stats stats;
+  {
+    std::lock_guard lock(m_mutex);
+    stats.entries = m_entries.size();
+    stats.bytes = m_bytes;
+  }
+  stats.hits = m_hits.load(std::memory_order_relaxed);
+  stats.misses = m_misses.load(std::memory_order_relaxed);
+  stats.loadSeconds = m_loadNanos.load(std::memory_order_relaxed) * 1e-9;
+  stats.computeSeconds = m_computeNanos.load(std::memory_order_relaxed) * 1e-9;
+  return stats;
+}
+
+void DiskCache::run() {
+  if (!m_scanned) scan();
+
+  std::unique_lock lock(m_mutex);
+  for (;;) {
+    m_wake.wait(lock, [this] { return m_stopping || !m_ops.empty(); });
+    if (m_ops.empty()) break;  // Stopping with everything written
+    Op op = std::move(m_ops.front());
+    m_ops.pop_front();
+    lock.unlock();
+
+    if (op.blob.empty()) {
+      touch(op.hash);
+    } else {
+      write(op);
+    }
+
+    lock.lock();
+  }
+}
+
+// Index what earlier sessions left behind
+void DiskCache::scan() {
+  std::error_code ec;
+  std::filesystem::create_directories(m_directory, ec);
+
+  std::unordered_map<uint64_t, Entry> entries;
+  uint64_t bytes = 0;
+  std::filesystem::directory_iterator it(m_directory, ec), end;
+  for (; !ec && it != end; it.increment(ec)) {
+    const auto& file = *it;
+    const auto& path = file.path();
+    std::error_code fileError;
+    if (path.extension() == ".tmp") {
+      std::filesystem::remove(path, fileError);  // Interrupted write
+      continue;
+    }
+    auto stem = path.stem().string();
+    if (path.extension() != ".bin" || stem.size() != 16) continue;
+
+    char* parsed = nullptr;
+    uint64_t hash = std::strtoull(stem.c_str(), &parsed, 16);
+    if (parsed != stem.c_str() + stem.size()) continue;
+    auto size = file.file_size(fileError);
+    if (fileError) continue;
+    entries[hash] = Entry{size, file.last_write_time(fileError)};
+    bytes += size;
+  }
+
+  {
+    std::lock_guard lock(m_mutex);
+    m_entries = std::move(entries);
+    m_bytes = bytes;
+    m_scanned = true;
+  }
+  evict();
+}
+
+// Write to a temporary name and rename, so readers never map a partial
+// blob
+void DiskCache::write(const Op& op) {
+  auto path = pathFor(op.hash);
+  auto temp = path;
+  temp.replace_extension(".tmp");
+  {
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    out.write(op.blob.data(), static_cast<std::streamsize>(op.blob.size()));
+    if (!out) return;
+  }
+  std::error_code ec;
+  std::filesystem::rename(temp, path, ec);
+  if (ec) {
+    std::filesystem::remove(temp, ec);
+    return;
+  }
+
+  {
+    std::lock_guard lock(m_mutex);
+    auto& entry = m_entries[op.hash];
+    m_bytes = m_bytes - entry.bytes + op.blob.size();
+    entry.bytes = op.blob.size();
+    entry.lastUse = std::filesystem::file_time_type::clock::now();
+  }
+  evict();
+}
+
+// Modification times double as last use, so recency survives sessions
+void DiskCache::touch(uint64_t hash) {
+  auto now = std::filesystem::file_time_type::clock::now();
+  std::error_code ec;
+  std::filesystem::last_write_time(pathFor(hash), now, ec);
+
+  std::lock_guard lock(m_mutex);
+  auto it = m_entries.find(hash);
+  if (it != m_entries.end()) it->second.lastUse = now;
+}
+
+// Drop least recently used entries until 90% of the cap is left
+void DiskCache::evict() {
+  std::vector<std::pair<std::filesystem::file_time_type, uint64_t>> order;
+  {
+    std::lock_guard lock(m_mutex);
+    if (m_bytes <= kMaxBytes) return;
+    order.reserve(m_entries.size());
+    for (const auto& [hash, entry] : m_entries) {
+      order.emplace_back(entry.lastUse, hash);
+    }
+  }
+  std::sort(order.begin(), order.end());
+
+  for (const auto& [lastUse, hash] : order) {
+    std::error_code ec;
+    std::filesystem::remove(pathFor(hash), ec);
+    if (ec) continue;  // Still mapped by a reader
+
+    std::lock_guard lock(m_mutex);
+    auto it = m_entries.find(hash);
+    if (it != m_entries.end()) {
+      m_bytes -= it->second.bytes;
+      m_entries.erase(it);
+    }
+    if (m_bytes <= kMaxBytes / 10 * 9) break;
+  }
+}
+
+std::filesystem::path DiskCache::pathFor(uint64_t hash) const {
+  char name[24];
+  std::snprintf(name, sizeof(name), "%016llx.bin",
+                static_cast<unsigned long long>(hash));
+  return m_directory / name;
+}
+
+}  // namespace FLLua
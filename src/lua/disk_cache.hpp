@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "plain_value.hpp"
+
+namespace FLLua {
+
+// 64-bit FNV-1a of `data`, chained through `seed`
+uint64_t contentHash(std::string_view data,
+                     uint64_t seed = 0xcbf29ce484222325ull);
+
+// Per-user cache of generated data on disk, shared by every instance in
+// the process. Entries are compact blobs named by the hash of their key,
+// read through a memory mapping and written by a background thread, so
+// material computed once survives reloads and sessions. The directory is
+// kept under kMaxBytes by dropping the least recently used entries.
+class DiskCache {
+ public:
+  static constexpr uint64_t kMaxBytes = 512ull << 20;
+
+  struct Stats {
+    size_t entries = 0;  // Known once the writer scanned the directory
+    uint64_t bytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    double loadSeconds = 0.0;     // Spent reading hits (warm)
+    double computeSeconds = 0.0;  // Spent computing misses (cold)
+  };
+
+  static DiskCache& instance();
+
+  // Active plugin instances hold the writer thread; the last release
+  // finishes queued writes and joins it
+  void retain();
+  void release();
+
+  // Read the entry stored under `hash`. `key` is the entry's encoded key,
+  // compared against the stored one to rule out hash collisions.
+  bool load(uint64_t hash, std::string_view key, PlainValue& out);
+
+  // Queue `value` to be written under `hash`. Dropped without a writer.
+  void store(uint64_t hash, std::string_view key, const PlainValue& value);
+
+  // Time a caller spent computing a value that missed
+  void addComputeTime(double seconds);
+
+  Stats stats();
+
+ private:
+  struct Op {
+    uint64_t hash;
+    std::string blob;  // Empty to only mark the entry used
+  };
+
+  struct Entry {
+    uint64_t bytes;
+    std::filesystem::file_time_type lastUse;
+  };
+
+  DiskCache();
+
+  void run();
+  void scan();
+  void write(const Op& op);
+  void touch(uint64_t hash);
+  void evict();
+  std::filesystem::path pathFor(uint64_t hash) const;
+
+  std::filesystem::path m_directory;
+
+  std::mutex m_lifecycle;  // Serializes starting and joining the writer
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::deque<Op> m_ops;
+  std::thread m_thread;
+  int m_users = 0;
+  bool m_stopping = false;
+
+  // Index of the directory, changed by the writer under m_mutex
+  std::unordered_map<uint64_t, Entry> m_entries;
+  uint64_t m_bytes = 0;
+  bool m_scanned = false;
+
+  std::atomic<uint64_t> m_hits{0};
+  std::atomic<uint64_t> m_misses{0};
+  std::atomic<int64_t> m_loadNanos{0};
+  std::atomic<int64_t> m_computeNanos{0};
+};
+
+}  // namespace FLLua
@@ -2,7 +2,16 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
+
+#include "async_api.hpp"
+#include "disk_cache.hpp"
+#include "input_api.hpp"
+#include "param_api.hpp"
 #include "sandbox.hpp"
+#include "solver_api.hpp"
+#include "task_api.hpp"
+#include "voicing_api.hpp"
 
 extern "C" {
 #include <lauxlib.h>
@@ -12,6 +21,15 @@ extern "C" {
 
 namespace FLLua {
 
+// The watchdog runs every kHookInterval instructions and stops a call after
+// kMaxInstructions (runaway loops) or once it passes the deadline
+static constexpr int kHookInterval = 10000;
+static constexpr int kMaxInstructions = 10000000;
+
+// Bounds of options.sub_block, in samples
+static constexpr lua_Integer kMinSubBlock = 16;
+static constexpr lua_Integer kMaxSubBlock = 4096;
+
 LuaEngine::LuaEngine() = default;
 
 LuaEngine::~LuaEngine() { shutdown(); }
@@ -19,38 +37,65 @@ LuaEngine::~LuaEngine() { shutdown(); }
 bool LuaEngine::init(PluginContext* ctx, const std::string& luaLibsPath) {
   shutdown();
   m_ctx = ctx;
+  m_deadline = std::chrono::steady_clock::time_point::max();
 
   m_L = luaL_newstate();
   if (!m_L) return false;
 
   // Open sandboxed standard libraries
   openSandboxedLibs(m_L);
+  preloadSolverModule(m_L);
+  preloadVoicingModule(m_L);
 
-  // Configure package.path for bundled Lua libraries
+  // Configure package.path for bundled Lua libraries, compiled once per
+  // process and shared by every state
   if (!luaLibsPath.empty()) {
     configurePackagePath(m_L, luaLibsPath);
+    installChunkSearcher(m_L, &m_chunks);
   }
 
   // Register the plugin API (ctx table)
+  m_tasks.clear();
+  ctx->tasks = &m_tasks;
   registerPluginAPI(m_L, ctx);
 
-  // Set instruction count hook to prevent infinite loops (10M instructions)
-  lua_sethook(
-      m_L,
-      [](lua_State* L, lua_Debug*) {
-        luaL_error(L,
-                   "Script exceeded maximum instruction count (possible "
-                   "infinite loop)");
-      },
-      LUA_MASKCOUNT, 10000000);
+  // Seed math.random from the instance so a take replays exactly
+  lua_getglobal(m_L, "math");
+  lua_getfield(m_L, -1, "randomseed");
+  lua_pushinteger(m_L, static_cast<lua_Integer>(ctx->seed));
+  if (lua_pcall(m_L, 1, 0, 0) != LUA_OK) lua_pop(m_L, 1);
+  lua_pop(m_L, 1);
+
+  // Watchdog against infinite loops and blocks that overrun their deadline
+  *static_cast<LuaEngine**>(lua_getextraspace(m_L)) = this;
+  lua_sethook(m_L, watchdogHook, LUA_MASKCOUNT, kHookInterval);
 
   return true;
 }
 
+void LuaEngine::watchdogHook(lua_State* L, lua_Debug*) {
+  auto* engine = *static_cast<LuaEngine**>(lua_getextraspace(L));
+  if (engine->m_interrupt) {
+    if (engine->m_interrupt()) luaL_error(L, "Job cancelled");
+    return;
+  }
+  if (++engine->m_hookTicks > kMaxInstructions / kHookInterval) {
+    luaL_error(L,
+               "Script exceeded maximum instruction count (possible "
+               "infinite loop)");
+  }
+  if (std::chrono::steady_clock::now() > engine->m_deadline) {
+    engine->m_overrun = true;
+    luaL_error(L, "Script exceeded its time budget for this block");
+  }
+}
+
 std::string LuaEngine::loadScript(const std::string& source) {
   if (!m_L) return "Lua engine not initialized";
 
   m_scriptLoaded = false;
+  if (m_ctx) m_ctx->scriptHash = contentHash(source);
+  arm();
 
   // Compile the script
   int result = luaL_loadstring(m_L, source.c_str());
@@ -75,6 +120,7 @@ std::string LuaEngine::loadScript(const std::string& source) {
 
 std::string LuaEngine::callOnBeat(int beatNumber) {
   if (!m_L || !m_scriptLoaded) return {};
+  arm();
 
   lua_getglobal(m_L, "on_beat");
   if (!lua_isfunction(m_L, -1)) {
@@ -97,6 +143,7 @@ std::string LuaEngine::callOnBeat(int beatNumber) {
 
 std::string LuaEngine::callProcess() {
   if (!m_L || !m_scriptLoaded) return {};
+  arm();
 
   lua_getglobal(m_L, "process");
   if (!lua_isfunction(m_L, -1)) {
@@ -116,11 +163,138 @@ std::string LuaEngine::callProcess() {
   return {};
 }
 
+std::string LuaEngine::resumeTasks() {
+  if (!m_L || !m_scriptLoaded) return {};
+  arm();
+  return resumeDueTasks(m_L, m_ctx);
+}
+
+std::string LuaEngine::dispatchInput() {
+  if (!m_L || !m_scriptLoaded) return {};
+  arm();
+  return dispatchInputEvents(m_L, m_ctx);
+}
+
+std::string LuaEngine::dispatchParams() {
+  if (!m_L || !m_scriptLoaded) return {};
+  arm();
+  return dispatchParamChanges(m_L, m_ctx);
+}
+
+std::string LuaEngine::dispatchResults() {
+  if (!m_L || !m_scriptLoaded) return {};
+  arm();
+  return deliverAsyncResults(m_L, m_ctx);
+}
+
+// What callJobProtected runs, passed as a light userdata
+struct JobCall {
+  const std::string* function;
+  const std::vector<PlainValue>* args;
+};
+
+// Resolves "module.fn" from the globals and calls it with the job's
+// arguments. Runs under lua_pcall: a raising __index, running out of
+// memory or the interrupt must not escape unprotected.
+static int callJobProtected(lua_State* L) {
+  const auto& call = *static_cast<const JobCall*>(lua_touserdata(L, 1));
+  const auto& function = *call.function;
+
+  lua_pushglobaltable(L);
+  size_t start = 0;
+  while (start <= function.size()) {
+    size_t dot = std::min(function.find('.', start), function.size());
+    if (!lua_istable(L, -1)) break;
+    lua_pushlstring(L, function.data() + start, dot - start);
+    lua_gettable(L, -2);
+    lua_remove(L, -2);
+    start = dot + 1;
+  }
+  if (start <= function.size() || !lua_isfunction(L, -1)) {
+    return luaL_error(L, "'%s' is not a function", function.c_str());
+  }
+
+  const auto& args = *call.args;
+  luaL_checkstack(L, static_cast<int>(args.size()) + 1, "too many arguments");
+  for (const auto& arg : args) pushPlainValue(L, arg);
+  lua_call(L, static_cast<int>(args.size()), 1);
+  return 1;
+}
+
+std::string LuaEngine::callJob(const std::string& function,
+                               const std::vector<PlainValue>& args,
+                               PlainValue& result) {
+  if (!m_L || !m_scriptLoaded) return "no script loaded";
+  arm();
+
+  JobCall call{&function, &args};
+  lua_pushcfunction(m_L, callJobProtected);
+  lua_pushlightuserdata(m_L, &call);
+  int status = lua_pcall(m_L, 1, 1, 0);
+  if (status != LUA_OK) {
+    const char* message = lua_tostring(m_L, -1);
+    std::string error = message ? message : "job failed";
+    lua_pop(m_L, 1);
+    return error;
+  }
+  auto error = toPlainValue(m_L, -1, result);
+  lua_pop(m_L, 1);
+  return error.empty() ? error : "result " + error;
+}
+
+ScriptOptions LuaEngine::readOptions() {
+  ScriptOptions options;
+  if (!m_L || !m_scriptLoaded) return options;
+
+  lua_getglobal(m_L, "options");
+  if (lua_istable(m_L, -1)) {
+    lua_getfield(m_L, -1, "lookahead");
+    if (lua_isnumber(m_L, -1)) options.lookaheadBeats = lua_tonumber(m_L, -1);
+    lua_pop(m_L, 1);
+
+    lua_getfield(m_L, -1, "ramp_resolution");
+    if (lua_isnumber(m_L, -1) && lua_tonumber(m_L, -1) > 0.0) {
+      options.rampResolution = lua_tonumber(m_L, -1);
+    }
+    lua_pop(m_L, 1);
+
+    // Channel routing, 0-15 like the rest of the API
+    lua_getfield(m_L, -1, "input_channel");
+    if (lua_isinteger(m_L, -1)) {
+      options.inputChannel = static_cast<int>(lua_tointeger(m_L, -1)) & 0x0F;
+    }
+    lua_pop(m_L, 1);
+
+    lua_getfield(m_L, -1, "output_channel");
+    if (lua_isinteger(m_L, -1)) {
+      options.outputChannel = static_cast<int>(lua_tointeger(m_L, -1)) & 0x0F;
+    }
+    lua_pop(m_L, 1);
+
+    lua_getfield(m_L, -1, "sub_block");
+    if (lua_isinteger(m_L, -1) && lua_tointeger(m_L, -1) > 0) {
+      options.subBlockSamples = static_cast<int>(std::clamp<lua_Integer>(
+          lua_tointeger(m_L, -1), kMinSubBlock, kMaxSubBlock));
+    }
+    lua_pop(m_L, 1);
+  }
+  lua_pop(m_L, 1);
+  return options;
+}
+
+int64_t LuaEngine::heapBytes() const {
+  if (!m_L) return 0;
+  return static_cast<int64_t>(lua_gc(m_L, LUA_GCCOUNT)) * 1024 +
+         lua_gc(m_L, LUA_GCCOUNTB);
+}
+
 void LuaEngine::shutdown() {
   if (m_L) {
     lua_close(m_L);
     m_L = nullptr;
   }
+  m_chunks.clear();
+  m_tasks.clear();
   m_scriptLoaded = false;
 }
 
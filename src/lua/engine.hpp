@@ -1,14 +1,30 @@
 #pragma once
 
+#include <chrono>
 #include <functional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "api.hpp"
+#include "chunk_cache.hpp"
+#include "plain_value.hpp"
+#include "task_scheduler.hpp"
 
+struct lua_Debug;
 struct lua_State;
 
 namespace FLLua {
 
+// Per-script settings read from the script's global `options` table
+struct ScriptOptions {
+  double lookaheadBeats = 0.0;         // > 0 runs the script on a worker thread
+  double rampResolution = 1.0 / 32.0;  // Beats between ramp points
+  int inputChannel = -1;    // Only MIDI input on this channel, -1 for all
+  int outputChannel = -1;   // Force output onto this channel, -1 to keep
+  int subBlockSamples = 0;  // > 0 calls process() per fixed sub-block
+};
+
 class LuaEngine {
  public:
   LuaEngine();
@@ -27,9 +43,57 @@ class LuaEngine {
   // Call process(ctx) if defined
   std::string callProcess();
 
+  // Whether a ctx.spawn task wakes before the given beat. Checked natively
+  // so blocks without due tasks never enter Lua.
+  bool hasDueTasks(double beforeBeat) const {
+    return m_scriptLoaded && m_tasks.hasDue(beforeBeat);
+  }
+
+  // Resume every ctx.spawn task due in the current block
+  std::string resumeTasks();
+
+  // Deliver this block's MIDI input to on_events / on_note_on / etc.
+  std::string dispatchInput();
+
+  // Call on_param for macro parameters that changed this block
+  std::string dispatchParams();
+
+  // Fill finished ctx.async futures and call on_result for each
+  std::string dispatchResults();
+
+  // Job worker: call the function named `function` (dots reach into
+  // tables) with copies of `args`, and copy its first return value
+  std::string callJob(const std::string& function,
+                      const std::vector<PlainValue>& args,
+                      PlainValue& result);
+
+  // Shift relative task waits after a transport jump
+  void rebaseTasks(double deltaBeats) { m_tasks.rebase(deltaBeats); }
+
+  // Read the `options` table defined by the loaded script
+  ScriptOptions readOptions();
+
+  // Make calls into Lua fail once they run past `deadline`. Every call is
+  // also capped at a fixed instruction count, deadline or not.
+  void setDeadline(std::chrono::steady_clock::time_point deadline) {
+    m_deadline = deadline;
+  }
+
+  // Whether a call was stopped at the deadline since the last check
+  bool takeOverrun() { return std::exchange(m_overrun, false); }
+
+  // Replace the instruction cap and deadline with a check that stops calls
+  // once it returns true. For worker states running long jobs.
+  void setInterrupt(std::function<bool()> interrupt) {
+    m_interrupt = std::move(interrupt);
+  }
+
   // Shutdown the Lua state
   void shutdown();
 
+  // Bytes allocated by the Lua state
+  int64_t heapBytes() const;
+
   bool isInitialized() const { return m_L != nullptr; }
   bool hasScript() const { return m_scriptLoaded; }
 
@@ -37,6 +101,17 @@ class LuaEngine {
   lua_State* m_L = nullptr;
   bool m_scriptLoaded = false;
   PluginContext* m_ctx = nullptr;
+  TaskScheduler m_tasks;
+  std::vector<ChunkCache::ChunkRef> m_chunks;  // Libraries this state loaded
+  std::chrono::steady_clock::time_point m_deadline =
+      std::chrono::steady_clock::time_point::max();
+  int m_hookTicks = 0;  // Hook calls since the current call began
+  bool m_overrun = false;
+  std::function<bool()> m_interrupt;
+
+  // Reset the instruction budget before entering Lua
+  void arm() { m_hookTicks = 0; }
+  static void watchdogHook(lua_State* L, lua_Debug* ar);
 
   // Call a global function safely, returns error or empty
   std::string callGlobalFunction(const char* name, int nargs = 0);
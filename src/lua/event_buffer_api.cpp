@@ -0,0 +1,271 @@
+#include "event_buffer_api.hpp"
+
+#include "api.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+static const char* kEventBufferMetatable = "FLLua.EventBuffer";
+static constexpr lua_Integer kDefaultBufferCapacity = 256;
+static constexpr lua_Integer kMaxBufferCapacity = 4096;
+
+enum class BufferedKind : uint8_t { Note, NoteOn, NoteOff, CC, PitchBend };
+
+struct BufferedEvent {
+  double duration;  // Note only
+  int16_t value;    // Pitch bend only
+  BufferedKind kind;
+  uint8_t data1;
+  uint8_t data2;
+  uint8_t channel;
+};
+
+// Userdata header; the events follow it in the same allocation
+struct EventBuffer {
+  int32_t capacity;
+  int32_t count;
+
+  BufferedEvent* events() { return reinterpret_cast<BufferedEvent*>(this + 1); }
+};
+
+static EventBuffer* checkBuffer(lua_State* L, int arg) {
+  return static_cast<EventBuffer*>(
+      luaL_checkudata(L, arg, kEventBufferMetatable));
+}
+
+// Read field `i` of the tuple at `idx` as an integer, `def` when absent
+static lua_Integer tupleInteger(lua_State* L, int idx, lua_Integer i,
+                                lua_Integer def) {
+  lua_geti(L, idx, i);
+  int isnum = 0;
+  lua_Integer value = lua_tointegerx(L, -1, &isnum);
+  if (!isnum) {
+    if (!lua_isnil(L, -1)) {
+      luaL_error(L, "tuple field %d must be an integer", static_cast<int>(i));
+    }
+    value = def;
+  }
+  lua_pop(L, 1);
+  return value;
+}
+
+static double tupleNumber(lua_State* L, int idx, lua_Integer i, double def) {
+  lua_geti(L, idx, i);
+  int isnum = 0;
+  double value = lua_tonumberx(L, -1, &isnum);
+  if (!isnum) {
+    if (!lua_isnil(L, -1)) {
+      luaL_error(L, "tuple field %d must be a number", static_cast<int>(i));
+    }
+    value = def;
+  }
+  lua_pop(L, 1);
+  return value;
+}
+
+// ctx.notes({{note, velocity, duration, channel?}, ...})
+static int ctx_notes(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->eventQueue) return 0;
+
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_Integer count = luaL_len(L, 1);
+  if (ctx->scheduledNoteOffs) {
+    ctx->scheduledNoteOffs->reserve(ctx->scheduledNoteOffs->size() +
+                                    static_cast<size_t>(count));
+  }
+
+  for (lua_Integer i = 1; i <= count; ++i) {
+    if (lua_geti(L, 1, i) != LUA_TTABLE) {
+      return luaL_error(L, "ctx.notes: entry %d is not a table",
+                        static_cast<int>(i));
+    }
+    int tuple = lua_gettop(L);
+    auto note = static_cast<uint8_t>(tupleInteger(L, tuple, 1, 60));
+    auto velocity = static_cast<uint8_t>(tupleInteger(L, tuple, 2, 100));
+    double duration = tupleNumber(L, tuple, 3, 1.0);
+    auto channel = static_cast<uint8_t>(tupleInteger(L, tuple, 4, 0));
+    lua_pop(L, 1);
+
+    emitNote(ctx, note, velocity, duration, channel);
+  }
+  return 0;
+}
+
+// ctx.chord(notes, velocity, duration, channel?)
+static int ctx_chord(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->eventQueue) return 0;
+
+  luaL_checktype(L, 1, LUA_TTABLE);
+  auto velocity = static_cast<uint8_t>(luaL_checkinteger(L, 2));
+  double duration = luaL_checknumber(L, 3);
+  auto channel = static_cast<uint8_t>(luaL_optinteger(L, 4, 0));
+
+  lua_Integer count = luaL_len(L, 1);
+  for (lua_Integer i = 1; i <= count; ++i) {
+    auto note = static_cast<uint8_t>(tupleInteger(L, 1, i, 60));
+    emitNote(ctx, note, velocity, duration, channel);
+  }
+  return 0;
+}
+
+// ctx.event_buffer(capacity?) -> buffer
+static int ctx_event_buffer(lua_State* L) {
+  lua_Integer capacity = luaL_optinteger(L, 1, kDefaultBufferCapacity);
+  luaL_argcheck(L, capacity > 0 && capacity <= kMaxBufferCapacity, 1,
+                "capacity out of range");
+
+  size_t size = sizeof(EventBuffer) +
+                static_cast<size_t>(capacity) * sizeof(BufferedEvent);
+  auto* buffer = static_cast<EventBuffer*>(lua_newuserdatauv(L, size, 0));
+  buffer->capacity = static_cast<int32_t>(capacity);
+  buffer->count = 0;
+  luaL_setmetatable(L, kEventBufferMetatable);
+  return 1;
+}
+
+// ctx.emit(buffer) -> number of events sent
+// The buffer is left intact so a phrase can be filled once and re-sent.
+static int ctx_emit(lua_State* L) {
+  auto* buffer = checkBuffer(L, 1);
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->eventQueue) return 0;
+
+  auto* events = buffer->events();
+  for (int32_t i = 0; i < buffer->count; ++i) {
+    const auto& ev = events[i];
+    switch (ev.kind) {
+      case BufferedKind::Note:
+        emitNote(ctx, ev.data1, ev.data2, ev.duration, ev.channel);
+        break;
+      case BufferedKind::NoteOn:
+        ctx->eventQueue->enqueue(
+            NoteOn{ev.data1, ev.data2, ev.channel, ctx->sampleOffset});
+        break;
+      case BufferedKind::NoteOff:
+        ctx->eventQueue->enqueue(
+            NoteOff{ev.data1, ev.channel, ctx->sampleOffset});
+        break;
+      case BufferedKind::CC:
+        ctx->eventQueue->enqueue(
+            CC{ev.data1, ev.data2, ev.channel, ctx->sampleOffset});
+        break;
+      case BufferedKind::PitchBend:
+        ctx->eventQueue->enqueue(
+            PitchBend{ev.value, ev.channel, ctx->sampleOffset});
+        break;
+    }
+  }
+  lua_pushinteger(L, buffer->count);
+  return 1;
+}
+
+// Append an event and return the buffer so calls can be chained
+static int pushBuffered(lua_State* L, EventBuffer* buffer,
+                        const BufferedEvent& event) {
+  if (buffer->count >= buffer->capacity) {
+    return luaL_error(L, "event buffer is full (capacity %d)",
+                      static_cast<int>(buffer->capacity));
+  }
+  buffer->events()[buffer->count++] = event;
+  lua_settop(L, 1);
+  return 1;
+}
+
+// buffer:note(note, velocity, duration, channel?)
+static int buffer_note(lua_State* L) {
+  auto* buffer = checkBuffer(L, 1);
+  BufferedEvent ev{};
+  ev.kind = BufferedKind::Note;
+  ev.data1 = static_cast<uint8_t>(luaL_checkinteger(L, 2));
+  ev.data2 = static_cast<uint8_t>(luaL_checkinteger(L, 3));
+  ev.duration = luaL_checknumber(L, 4);
+  ev.channel = static_cast<uint8_t>(luaL_optinteger(L, 5, 0));
+  return pushBuffered(L, buffer, ev);
+}
+
+// buffer:note_on(note, velocity, channel?)
+static int buffer_note_on(lua_State* L) {
+  auto* buffer = checkBuffer(L, 1);
+  BufferedEvent ev{};
+  ev.kind = BufferedKind::NoteOn;
+  ev.data1 = static_cast<uint8_t>(luaL_checkinteger(L, 2));
+  ev.data2 = static_cast<uint8_t>(luaL_checkinteger(L, 3));
+  ev.channel = static_cast<uint8_t>(luaL_optinteger(L, 4, 0));
+  return pushBuffered(L, buffer, ev);
+}
+
+// buffer:note_off(note, channel?)
+static int buffer_note_off(lua_State* L) {
+  auto* buffer = checkBuffer(L, 1);
+  BufferedEvent ev{};
+  ev.kind = BufferedKind::NoteOff;
+  ev.data1 = static_cast<uint8_t>(luaL_checkinteger(L, 2));
+  ev.channel = static_cast<uint8_t>(luaL_optinteger(L, 3, 0));
+  return pushBuffered(L, buffer, ev);
+}
+
+// buffer:cc(controller, value, channel?)
+static int buffer_cc(lua_State* L) {
+  auto* buffer = checkBuffer(L, 1);
+  BufferedEvent ev{};
+  ev.kind = BufferedKind::CC;
+  ev.data1 = static_cast<uint8_t>(luaL_checkinteger(L, 2));
+  ev.data2 = static_cast<uint8_t>(luaL_checkinteger(L, 3));
+  ev.channel = static_cast<uint8_t>(luaL_optinteger(L, 4, 0));
+  return pushBuffered(L, buffer, ev);
+}
+
+// buffer:pitch_bend(value, channel?)
+static int buffer_pitch_bend(lua_State* L) {
+  auto* buffer = checkBuffer(L, 1);
+  BufferedEvent ev{};
+  ev.kind = BufferedKind::PitchBend;
+  ev.value = static_cast<int16_t>(luaL_checkinteger(L, 2));
+  ev.channel = static_cast<uint8_t>(luaL_optinteger(L, 3, 0));
+  return pushBuffered(L, buffer, ev);
+}
+
+// buffer:clear()
+static int buffer_clear(lua_State* L) {
+  checkBuffer(L, 1)->count = 0;
+  lua_settop(L, 1);
+  return 1;
+}
+
+// #buffer
+static int buffer_len(lua_State* L) {
+  lua_pushinteger(L, checkBuffer(L, 1)->count);
+  return 1;
+}
+
+void registerEventBufferAPI(lua_State* L) {
+  static const luaL_Reg bufferMethods[] = {{"note", buffer_note},
+                                           {"note_on", buffer_note_on},
+                                           {"note_off", buffer_note_off},
+                                           {"cc", buffer_cc},
+                                           {"pitch_bend", buffer_pitch_bend},
+                                           {"clear", buffer_clear},
+                                           {nullptr, nullptr}};
+  if (luaL_newmetatable(L, kEventBufferMetatable)) {
+    luaL_newlib(L, bufferMethods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, buffer_len);
+    lua_setfield(L, -2, "__len");
+  }
+  lua_pop(L, 1);
+
+  static const luaL_Reg bulkFunctions[] = {{"notes", ctx_notes},
+                                           {"chord", ctx_chord},
+                                           {"event_buffer", ctx_event_buffer},
+                                           {"emit", ctx_emit},
+                                           {nullptr, nullptr}};
+  luaL_setfuncs(L, bulkFunctions, 0);
+}
+
+}  // namespace FLLua
@@ -0,0 +1,11 @@
+#pragma once
+
+struct lua_State;
+
+namespace FLLua {
+
+// Add the bulk event functions (ctx.notes, ctx.chord, ctx.event_buffer,
+// ctx.emit) to the ctx function table on top of the stack
+void registerEventBufferAPI(lua_State* L);
+
+}  // namespace FLLua
@@ -0,0 +1,110 @@
+#include "groove_api.hpp"
+
+#include <array>
+
+#include "api.hpp"
+#include "sequencing/clip_player.hpp"
+#include "sequencing/groove.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+// Latency reserved when a groove moves notes earlier and sets no `early`
+static constexpr double kDefaultEarlyMs = 20.0;
+static constexpr double kMaxEarlyMs = 100.0;
+
+static double optNumberField(lua_State* L, int idx, const char* key,
+                             double def) {
+  lua_getfield(L, idx, key);
+  double value = luaL_optnumber(L, -1, def);
+  lua_pop(L, 1);
+  return value;
+}
+
+// Read the array field `key` into `values`; returns its length, or -1 when
+// the field is absent
+static int readTable(lua_State* L, int idx, const char* key,
+                     std::array<float, GrooveSettings::kMaxSlots>& values) {
+  if (lua_getfield(L, idx, key) == LUA_TNIL) {
+    lua_pop(L, 1);
+    return -1;
+  }
+  if (!lua_istable(L, -1)) {
+    return luaL_error(L, "groove: %s must be an array", key);
+  }
+  lua_Integer count = luaL_len(L, -1);
+  if (count > GrooveSettings::kMaxSlots) {
+    return luaL_error(L, "groove: %s holds more than %d slots", key,
+                      GrooveSettings::kMaxSlots);
+  }
+  for (lua_Integer i = 1; i <= count; ++i) {
+    lua_geti(L, -1, i);
+    values[i - 1] = static_cast<float>(luaL_checknumber(L, -1));
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+  return static_cast<int>(count);
+}
+
+// ctx.groove{swing=, grid=, offsets=, velocities=, clip=, amount=,
+//            timing=, velocity=, early=}
+// Replaces the layer's groove; ctx.groove() turns it off.
+static int ctx_groove(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->groove) return 0;
+
+  if (lua_isnoneornil(L, 1) ||
+      (lua_isboolean(L, 1) && !lua_toboolean(L, 1))) {
+    ctx->groove->disable();
+    return 0;
+  }
+  luaL_checktype(L, 1, LUA_TTABLE);
+
+  GrooveSettings settings;
+  settings.grid = optNumberField(L, 1, "grid", settings.grid);
+  luaL_argcheck(L, settings.grid > 0.0, 1, "grid must be positive");
+
+  // A loaded clip supplies both tables; explicit tables replace them
+  if (lua_getfield(L, 1, "clip") != LUA_TNIL) {
+    auto id = static_cast<int>(luaL_checkinteger(L, -1)) - 1;
+    const auto* clip = ctx->clipPlayer ? ctx->clipPlayer->clip(id) : nullptr;
+    if (!clip) return luaL_error(L, "groove: no clip %d", id + 1);
+    if (!extractGroove(*clip, settings)) {
+      return luaL_error(L, "groove: clip %d has no notes", id + 1);
+    }
+  }
+  lua_pop(L, 1);
+  int count = readTable(L, 1, "offsets", settings.offsets);
+  if (count >= 0) settings.offsetCount = count;
+  count = readTable(L, 1, "velocities", settings.velocities);
+  if (count >= 0) settings.velocityCount = count;
+
+  settings.swing = optNumberField(L, 1, "swing", settings.swing);
+  luaL_argcheck(L, settings.swing >= 25.0 && settings.swing <= 75.0, 1,
+                "swing must be between 25 and 75");
+  settings.amount = optNumberField(L, 1, "amount", settings.amount);
+  settings.timingMs = optNumberField(L, 1, "timing", 0.0);
+  settings.velocity = optNumberField(L, 1, "velocity", 0.0);
+  luaL_argcheck(L, settings.timingMs >= 0.0 && settings.velocity >= 0.0, 1,
+                "humanize amounts must not be negative");
+
+  double early = settings.movesEarlier() ? kDefaultEarlyMs : 0.0;
+  settings.earlyMs = optNumberField(L, 1, "early", early);
+  luaL_argcheck(L, settings.earlyMs >= 0.0 && settings.earlyMs <= kMaxEarlyMs,
+                1, "early must be between 0 and 100 ms");
+
+  ctx->groove->configure(settings);
+  return 0;
+}
+
+void registerGrooveAPI(lua_State* L) {
+  static const luaL_Reg grooveFunctions[] = {{"groove", ctx_groove},
+                                             {nullptr, nullptr}};
+  luaL_setfuncs(L, grooveFunctions, 0);
+}
+
+}  // namespace FLLua
@@ -0,0 +1,11 @@
+#pragma once
+
+struct lua_State;
+
+namespace FLLua {
+
+// Add the native groove stage settings (ctx.groove) to the ctx function
+// table on top of the stack
+void registerGrooveAPI(lua_State* L);
+
+}  // namespace FLLua
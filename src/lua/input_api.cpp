@@ -0,0 +1,158 @@
+#include "input_api.hpp"
+
+#include "api.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+static const char* kInputBatchMetatable = "FLLua.InputBatch";
+static const char* kInputBatchKey = "FLLua_InputBatch";
+
+// The batch userdata carries no data of its own; it reads the current
+// block's events through the context, so one instance serves every block.
+static const std::vector<MidiEvent>& batchEvents(lua_State* L,
+                                                 PluginContext*& ctx) {
+  static const std::vector<MidiEvent> kEmpty;
+  luaL_checkudata(L, 1, kInputBatchMetatable);
+  ctx = getContext(L);
+  return ctx && ctx->inputEvents ? *ctx->inputEvents : kEmpty;
+}
+
+// Push kind, data1, data2, channel, offset for an event
+static int pushInputEvent(lua_State* L, const MidiEvent& event) {
+  return std::visit(
+      [L](const auto& ev) {
+        using T = std::decay_t<decltype(ev)>;
+        if constexpr (std::is_same_v<T, NoteOn>) {
+          lua_pushliteral(L, "note_on");
+          lua_pushinteger(L, ev.note);
+          lua_pushinteger(L, ev.velocity);
+        } else if constexpr (std::is_same_v<T, NoteOff>) {
+          lua_pushliteral(L, "note_off");
+          lua_pushinteger(L, ev.note);
+          lua_pushinteger(L, 0);
+        } else if constexpr (std::is_same_v<T, CC>) {
+          lua_pushliteral(L, "cc");
+          lua_pushinteger(L, ev.controller);
+          lua_pushinteger(L, ev.value);
+        } else if constexpr (std::is_same_v<T, PitchBend>) {
+          lua_pushliteral(L, "pitch_bend");
+          lua_pushinteger(L, ev.value);
+          lua_pushinteger(L, 0);
+        }
+        lua_pushinteger(L, ev.channel);
+        lua_pushinteger(L, ev.sampleOffset);
+        return 5;
+      },
+      event);
+}
+
+// batch:get(i) -> kind, data1, data2, channel, sample_offset
+// Also moves ctx to the event's sample offset, so events emitted while
+// handling it are sent in the same block at the same position.
+static int batch_get(lua_State* L) {
+  PluginContext* ctx = nullptr;
+  const auto& events = batchEvents(L, ctx);
+  lua_Integer i = luaL_checkinteger(L, 2);
+  if (i < 1 || i > static_cast<lua_Integer>(events.size())) return 0;
+
+  const auto& event = events[static_cast<size_t>(i - 1)];
+  ctx->sampleOffset =
+      std::visit([](const auto& ev) { return ev.sampleOffset; }, event);
+  return pushInputEvent(L, event);
+}
+
+// #batch
+static int batch_len(lua_State* L) {
+  PluginContext* ctx = nullptr;
+  lua_pushinteger(L, static_cast<lua_Integer>(batchEvents(L, ctx).size()));
+  return 1;
+}
+
+void registerInputAPI(lua_State* L) {
+  static const luaL_Reg batchMethods[] = {{"get", batch_get},
+                                          {nullptr, nullptr}};
+  if (luaL_newmetatable(L, kInputBatchMetatable)) {
+    luaL_newlib(L, batchMethods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, batch_len);
+    lua_setfield(L, -2, "__len");
+  }
+  lua_pop(L, 1);
+
+  lua_newuserdatauv(L, 0, 0);
+  luaL_setmetatable(L, kInputBatchMetatable);
+  lua_setfield(L, LUA_REGISTRYINDEX, kInputBatchKey);
+}
+
+// Push a global handler and ctx. Returns false if it is not defined.
+static bool pushHandler(lua_State* L, const char* name) {
+  if (lua_getglobal(L, name) != LUA_TFUNCTION) {
+    lua_pop(L, 1);
+    return false;
+  }
+  lua_getglobal(L, "ctx");
+  return true;
+}
+
+// Call the pushed handler with ctx plus `nargs` arguments
+static void callHandler(lua_State* L, int nargs, std::string& errors) {
+  if (lua_pcall(L, nargs + 1, 0, 0) != LUA_OK) {
+    const char* msg = lua_tostring(L, -1);
+    errors += msg ? msg : "input handler error";
+    errors += '\n';
+    lua_pop(L, 1);
+  }
+}
+
+std::string dispatchInputEvents(lua_State* L, PluginContext* ctx) {
+  if (!ctx->inputEvents || ctx->inputEvents->empty()) return {};
+  std::string errors;
+
+  if (pushHandler(L, "on_events")) {
+    lua_getfield(L, LUA_REGISTRYINDEX, kInputBatchKey);
+    callHandler(L, 1, errors);
+  } else {
+    for (const auto& event : *ctx->inputEvents) {
+      std::visit(
+          [&](const auto& ev) {
+            using T = std::decay_t<decltype(ev)>;
+            ctx->sampleOffset = ev.sampleOffset;
+            int nargs = 0;
+            if constexpr (std::is_same_v<T, NoteOn>) {
+              if (!pushHandler(L, "on_note_on")) return;
+              lua_pushinteger(L, ev.note);
+              lua_pushinteger(L, ev.velocity);
+              nargs = 2;
+            } else if constexpr (std::is_same_v<T, NoteOff>) {
+              if (!pushHandler(L, "on_note_off")) return;
+              lua_pushinteger(L, ev.note);
+              nargs = 1;
+            } else if constexpr (std::is_same_v<T, CC>) {
+              if (!pushHandler(L, "on_cc")) return;
+              lua_pushinteger(L, ev.controller);
+              lua_pushinteger(L, ev.value);
+              nargs = 2;
+            } else if constexpr (std::is_same_v<T, PitchBend>) {
+              if (!pushHandler(L, "on_pitch_bend")) return;
+              lua_pushinteger(L, ev.value);
+              nargs = 1;
+            }
+            lua_pushinteger(L, ev.channel);
+            lua_pushinteger(L, ev.sampleOffset);
+            callHandler(L, nargs + 2, errors);
+          },
+          event);
+    }
+  }
+
+  ctx->sampleOffset = 0;
+  if (!errors.empty()) errors.pop_back();
+  return errors;
+}
+
+}  // namespace FLLua
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+struct lua_State;
+
+namespace FLLua {
+
+struct PluginContext;
+
+// Create the reusable input batch view handed to on_events
+void registerInputAPI(lua_State* L);
+
+// Deliver the block's input events (ctx->inputEvents) in sample order to
+// on_events(ctx, batch), or else to on_note_on / on_note_off / on_cc /
+// on_pitch_bend. Returns error messages (one per line), empty on success.
+std::string dispatchInputEvents(lua_State* L, PluginContext* ctx);
+
+}  // namespace FLLua
@@ -0,0 +1,227 @@
+#include "lookahead.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace FLLua {
+
+// Worker sleep while it is far enough ahead or the transport is stopped
+static constexpr auto kIdleSleep = std::chrono::milliseconds(1);
+
+LookaheadRunner::LookaheadRunner() = default;
+
+LookaheadRunner::~LookaheadRunner() { stop(); }
+
+void LookaheadRunner::start(const std::string& source,
+                            const std::string& luaLibsPath,
+                            double lookaheadBeats, uint64_t seed) {
+  stop();
+
+  m_lookaheadBeats = lookaheadBeats;
+  m_context.seed = seed;
+  m_sounding.fill(0);
+  m_soundingCount = 0;
+  m_needsReset = true;
+
+  m_running.store(true, std::memory_order_release);
+  m_thread = std::thread(&LookaheadRunner::run, this, source, luaLibsPath);
+}
+
+void LookaheadRunner::stop() {
+  if (!m_thread.joinable()) return;
+
+  m_running.store(false, std::memory_order_release);
+  m_thread.join();
+
+  TimedEvent event;
+  while (m_events.try_dequeue(event)) {
+  }
+  TransportState transport;
+  while (m_resets.try_dequeue(transport)) {
+  }
+}
+
+void LookaheadRunner::reset(const TransportState& transport,
+                            MidiEventQueue& out) {
+  m_needsReset = false;
+  m_generation.fetch_add(1, std::memory_order_release);
+  m_playhead.store(transport.beat, std::memory_order_release);
+  releaseSounding(out);
+  m_resets.try_enqueue(transport);
+}
+
+void LookaheadRunner::merge(const TransportState& transport,
+                            MidiEventQueue& out) {
+  if (m_needsReset) reset(transport, out);
+
+  uint32_t generation = m_generation.load(std::memory_order_relaxed);
+  double blockEnd = transport.blockEndBeat();
+
+  while (auto* next = m_events.peek()) {
+    if (next->generation != generation) {
+      m_events.pop();  // Stale tail from before a reset
+      continue;
+    }
+    if (next->beat >= blockEnd) break;
+
+    MidiEvent event = next->event;
+    int32_t offset = transport.sampleOffsetFor(next->beat);
+    std::visit([offset](auto& ev) { ev.sampleOffset = offset; }, event);
+    m_events.pop();
+
+    track(event);
+    out.enqueue(event);
+  }
+
+  m_playhead.store(blockEnd, std::memory_order_release);
+}
+
+void LookaheadRunner::run(std::string source, std::string luaLibsPath) {
+  m_context.eventQueue = &m_workerQueue;
+  m_context.logQueue = &m_logQueue;
+  m_context.scheduledNoteOffs = &m_scheduledNoteOffs;
+  m_scheduledNoteOffs.clear();
+
+  m_engine.init(&m_context, luaLibsPath);
+  auto error = m_engine.loadScript(source);
+  if (!error.empty()) {
+    m_logQueue.enqueue("Lookahead script error: " + error);
+    m_engine.shutdown();
+    return;
+  }
+  m_heapBytes.store(m_engine.heapBytes(), std::memory_order_relaxed);
+
+  TransportState sim;
+  uint32_t generation = 0;
+  bool active = false;
+
+  while (m_running.load(std::memory_order_acquire)) {
+    // Restart from the real playhead after jumps, loops and tempo changes
+    TransportState restart;
+    while (m_resets.try_dequeue(restart)) {
+      if (restart.discontinuity && active) {
+        m_engine.rebaseTasks(restart.beat - sim.beat);
+      }
+      sim = restart;
+      active = restart.playing;
+      generation = m_generation.load(std::memory_order_acquire);
+      m_scheduledNoteOffs.clear();
+      MidiEvent stale;
+      while (m_workerQueue.try_dequeue(stale)) {
+      }
+    }
+
+    double horizon =
+        m_playhead.load(std::memory_order_acquire) + m_lookaheadBeats;
+    if (!active || sim.beat >= horizon) {
+      std::this_thread::sleep_for(kIdleSleep);
+      continue;
+    }
+
+    simulateBlock(sim, generation);
+    m_heapBytes.store(m_engine.heapBytes(), std::memory_order_relaxed);
+  }
+
+  m_engine.shutdown();
+  m_heapBytes.store(0, std::memory_order_relaxed);
+}
+
+void LookaheadRunner::simulateBlock(TransportState& sim,
+                                    uint32_t generation) {
+  if (sim.blockSize <= 0) sim.blockSize = 512;
+  m_context.transport = sim;
+
+  if (sim.isBeatBoundary()) {
+    auto error = m_engine.callOnBeat(sim.currentBeatInt());
+    if (!error.empty()) m_logQueue.enqueue("on_beat error: " + error);
+  }
+  auto error = m_engine.callProcess();
+  if (!error.empty()) m_logQueue.enqueue("process error: " + error);
+  if (m_engine.hasDueTasks(sim.blockEndBeat())) {
+    error = m_engine.resumeTasks();
+    if (!error.empty()) m_logQueue.enqueue("task error: " + error);
+  }
+
+  double samplesPerBeat = sim.samplesPerBeat();
+  double blockEnd = sim.blockEndBeat();
+
+  m_stepEvents.clear();
+  MidiEvent event;
+  while (m_workerQueue.try_dequeue(event)) {
+    int32_t offset =
+        std::visit([](const auto& ev) { return ev.sampleOffset; }, event);
+    m_stepEvents.push_back(
+        TimedEvent{sim.beat + offset / samplesPerBeat, event, generation});
+  }
+
+  // Scheduled note-offs get their exact beat instead of block granularity
+  auto it = m_scheduledNoteOffs.begin();
+  while (it != m_scheduledNoteOffs.end()) {
+    if (it->endBeat < blockEnd) {
+      m_stepEvents.push_back(TimedEvent{std::max(it->endBeat, sim.beat),
+                                        NoteOff{it->note, it->channel, 0},
+                                        generation});
+      it = m_scheduledNoteOffs.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  publish(m_stepEvents);
+
+  sim.lastBeatInt = sim.currentBeatInt();
+  sim.beat = blockEnd;
+  if (sim.timeSigNum > 0) {
+    sim.bar = static_cast<int>(sim.beat / sim.timeSigNum);
+  }
+  sim.discontinuity = false;
+}
+
+void LookaheadRunner::publish(std::vector<TimedEvent>& events) {
+  std::stable_sort(events.begin(), events.end(),
+                   [](const TimedEvent& a, const TimedEvent& b) {
+                     return a.beat < b.beat;
+                   });
+
+  for (auto& event : events) {
+    // The queue is preallocated; wait for the audio thread rather than grow
+    while (!m_events.try_enqueue(event)) {
+      if (!m_running.load(std::memory_order_acquire) ||
+          m_generation.load(std::memory_order_acquire) != event.generation) {
+        return;
+      }
+      std::this_thread::sleep_for(kIdleSleep);
+    }
+  }
+}
+
+void LookaheadRunner::track(const MidiEvent& event) {
+  if (auto* on = std::get_if<NoteOn>(&event)) {
+    auto& count = m_sounding[(on->channel & 0x0F) * 128 + (on->note & 0x7F)];
+    if (count < 255) {
+      ++count;
+      ++m_soundingCount;
+    }
+  } else if (auto* off = std::get_if<NoteOff>(&event)) {
+    auto& count =
+        m_sounding[(off->channel & 0x0F) * 128 + (off->note & 0x7F)];
+    if (count > 0) {
+      --count;
+      --m_soundingCount;
+    }
+  }
+}
+
+void LookaheadRunner::releaseSounding(MidiEventQueue& out) {
+  if (m_soundingCount == 0) return;
+  for (size_t key = 0; key < m_sounding.size(); ++key) {
+    // The voice table counts every retrigger, so end each one
+    for (; m_sounding[key] > 0; --m_sounding[key]) {
+      out.enqueue(NoteOff{static_cast<uint8_t>(key % 128),
+                          static_cast<uint8_t>(key / 128), 0});
+    }
+  }
+  m_soundingCount = 0;
+}
+
+}  // namespace FLLua
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <readerwriterqueue/readerwriterqueue.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "api.hpp"
+#include "engine.hpp"
+#include "events/event_queue.hpp"
+#include "events/midi_event.hpp"
+#include "transport/transport.hpp"
+
+namespace FLLua {
+
+// Runs a script on a dedicated worker thread against a simulated transport
+// that stays a fixed number of beats ahead of the playhead. Generated events
+// are stamped with their beat and handed to the audio thread through a
+// lock-free queue in beat order; the audio thread only merges them.
+//
+// Events are produced ahead of time, so no extra latency is reported to the
+// host: the audio thread never waits for the worker.
+class LookaheadRunner {
+ public:
+  LookaheadRunner();
+  ~LookaheadRunner();
+
+  // Start the worker with its own Lua state, seeded like the layer's.
+  // Load errors are reported through getLogQueue().
+  void start(const std::string& source, const std::string& luaLibsPath,
+             double lookaheadBeats, uint64_t seed);
+  void stop();
+  bool isRunning() const { return m_thread.joinable(); }
+
+  // Audio thread: discard everything generated past the current playhead
+  // and regenerate from there. Releases notes the discarded tail would
+  // have ended.
+  void reset(const TransportState& transport, MidiEventQueue& out);
+
+  // Audio thread: move every event due in the current block into `out`
+  void merge(const TransportState& transport, MidiEventQueue& out);
+
+  // Log output from the worker's script (worker → audio thread)
+  LogQueue& getLogQueue() { return m_logQueue; }
+
+  // Lua heap of the worker state after its last simulated block
+  int64_t heapBytes() const {
+    return m_heapBytes.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void run(std::string source, std::string luaLibsPath);
+  void simulateBlock(TransportState& sim, uint32_t generation);
+  void publish(std::vector<TimedEvent>& events);
+  void track(const MidiEvent& event);
+  void releaseSounding(MidiEventQueue& out);
+
+  static constexpr size_t kEventCapacity = 8192;
+
+  std::thread m_thread;
+  std::atomic<bool> m_running{false};
+  std::atomic<double> m_playhead{0.0};
+  std::atomic<uint32_t> m_generation{0};
+  std::atomic<int64_t> m_heapBytes{0};
+  double m_lookaheadBeats = 0.0;
+
+  // Worker → audio: generated events in beat order
+  moodycamel::ReaderWriterQueue<TimedEvent> m_events{kEventCapacity};
+  // Audio → worker: transport to restart the simulation from
+  moodycamel::ReaderWriterQueue<TransportState> m_resets{16};
+  LogQueue m_logQueue;
+
+  // Worker-owned state
+  LuaEngine m_engine;
+  PluginContext m_context;
+  MidiEventQueue m_workerQueue;
+  std::vector<ScheduledNoteOff> m_scheduledNoteOffs;
+  std::vector<TimedEvent> m_stepEvents;
+
+  // Audio-owned: notes started from merged events, per channel and pitch
+  std::array<uint8_t, 16 * 128> m_sounding{};
+  int m_soundingCount = 0;
+  bool m_needsReset = false;
+};
+
+}  // namespace FLLua
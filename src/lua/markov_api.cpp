@@ -0,0 +1,342 @@
+#include "markov_api.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "api.hpp"
+#include "generation/markov_model.hpp"
+#include "rng_api.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+static const char* kMarkovMetatable = "FLLua.Markov";
+static const char* kWalkMetatable = "FLLua.MarkovWalk";
+
+// Walkers keep their model and rng stream alive as user values
+struct MarkovWalk {
+  const MarkovModel* model;
+  Xoshiro256* rng;
+  MarkovModel::Walk walk;
+  int startPitch;
+};
+
+static MarkovModel* checkModel(lua_State* L, int arg) {
+  return static_cast<MarkovModel*>(luaL_checkudata(L, arg, kMarkovMetatable));
+}
+
+static MarkovWalk* checkWalk(lua_State* L, int arg) {
+  return static_cast<MarkovWalk*>(luaL_checkudata(L, arg, kWalkMetatable));
+}
+
+static MarkovModel* pushModel(lua_State* L,
+                              const MarkovModel::Options& options) {
+  auto* model = static_cast<MarkovModel*>(
+      lua_newuserdatauv(L, sizeof(MarkovModel), 0));
+  new (model) MarkovModel(options);
+  luaL_setmetatable(L, kMarkovMetatable);
+  return model;
+}
+
+static bool isMidiFile(const std::filesystem::path& path) {
+  auto extension = path.extension().string();
+  for (auto& c : extension) c = static_cast<char>(std::tolower(c));
+  return extension == ".mid" || extension == ".midi";
+}
+
+// Train on one .mid file, or every .mid file under a directory. Returns
+// the number of files that could not be read or parsed.
+static int trainPath(MarkovModel& model, std::string_view utf8, int channel,
+                     int& files) {
+  namespace fs = std::filesystem;
+  fs::path root(std::u8string(utf8.begin(), utf8.end()));
+  std::vector<fs::path> paths;
+  std::error_code ec;
+  if (fs::is_directory(root, ec)) {
+    for (fs::recursive_directory_iterator it(root, ec), end;
+         !ec && it != end; it.increment(ec)) {
+      if (it->is_regular_file(ec) && isMidiFile(it->path())) {
+        paths.push_back(it->path());
+      }
+    }
+  } else if (isMidiFile(root)) {
+    paths.push_back(root);
+  }
+
+  int failed = 0;
+  for (const auto& path : paths) {
+    std::ifstream file(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+    if (!file.good() && !file.eof()) {
+      ++failed;
+      continue;
+    }
+    auto error = model.trainSmf(reinterpret_cast<const uint8_t*>(bytes.data()),
+                                bytes.size(), channel);
+    if (!error.empty()) ++failed;
+  }
+  files = static_cast<int>(paths.size()) - failed;
+  return failed;
+}
+
+// ctx.markov.new([options]) -> model
+// Options: order (0-8, default 2), intervals (default false), grid (beats
+// per duration step, default 0.25), durations (default true),
+// velocity_step (default 0: velocities are not modeled)
+static int markov_new(lua_State* L) {
+  MarkovModel::Options options;
+  if (lua_istable(L, 1)) {
+    lua_getfield(L, 1, "order");
+    options.order = static_cast<int>(luaL_optinteger(L, -1, options.order));
+    lua_getfield(L, 1, "intervals");
+    if (!lua_isnil(L, -1)) options.intervals = lua_toboolean(L, -1);
+    lua_getfield(L, 1, "grid");
+    options.grid = luaL_optnumber(L, -1, options.grid);
+    lua_getfield(L, 1, "durations");
+    if (!lua_isnil(L, -1)) options.durations = lua_toboolean(L, -1);
+    lua_getfield(L, 1, "velocity_step");
+    options.velocityStep =
+        static_cast<int>(luaL_optinteger(L, -1, options.velocityStep));
+    lua_pop(L, 5);
+  }
+  luaL_argcheck(L,
+                options.order >= 0 && options.order <= MarkovModel::kMaxOrder,
+                1, "order out of range");
+  luaL_argcheck(L, options.grid > 0.0, 1, "grid must be positive");
+  luaL_argcheck(L, options.velocityStep >= 0 && options.velocityStep <= 127,
+                1, "velocity_step out of range");
+  pushModel(L, options);
+  return 1;
+}
+
+// ctx.markov.load(data) -> frozen model saved by model:save()
+static int markov_load(lua_State* L) {
+  size_t length = 0;
+  const char* data = luaL_checklstring(L, 1, &length);
+  auto* model = pushModel(L, MarkovModel::Options());
+  if (!MarkovModel::deserialize(std::string_view(data, length), *model)) {
+    return luaL_error(L, "markov.load: not a saved model");
+  }
+  return 1;
+}
+
+// model:train(source [, channel]) -> notes added, files skipped
+// `source` is Standard MIDI File bytes, the path of a .mid file or of a
+// directory searched for them, or an array of {beat, pitch, velocity,
+// duration} tuples forming one line. Without `channel` (1-16) every
+// channel but 10 is learned as its own line.
+static bool isSmfBytes(lua_State* L, int idx) {
+  size_t length = 0;
+  const char* source = lua_tolstring(L, idx, &length);
+  return std::string_view(source, length).substr(0, 4) == "MThd";
+}
+
+static int markov_train(lua_State* L) {
+  auto* model = checkModel(L, 1);
+  int channel = static_cast<int>(luaL_optinteger(L, 3, 0)) - 1;
+  luaL_argcheck(L, channel >= -1 && channel < 16, 3, "channel out of range");
+  if (model->frozen()) return luaL_error(L, "markov.train: model is frozen");
+
+  // Walking folders and reading files is native work the audio thread's
+  // instruction deadline cannot interrupt
+  if (lua_type(L, 2) == LUA_TSTRING && !isSmfBytes(L, 2)) {
+    auto* ctx = getContext(L);
+    if (ctx && ctx->async) {
+      return luaL_error(L,
+                        "markov.train: paths are read on workers only: call "
+                        "it through ctx.async");
+    }
+  }
+
+  int64_t before = model->notes();
+  int skipped = 0;
+  bool failed = false;
+  if (lua_type(L, 2) == LUA_TSTRING) {
+    size_t length = 0;
+    const char* source = lua_tolstring(L, 2, &length);
+    std::string_view view(source, length);
+    if (isSmfBytes(L, 2)) {
+      auto error = model->trainSmf(reinterpret_cast<const uint8_t*>(source),
+                                   length, channel);
+      if (!error.empty()) {
+        lua_pushfstring(L, "markov.train: %s", error.c_str());
+        failed = true;
+      }
+    } else {
+      int files = 0;
+      skipped = trainPath(*model, view, channel, files);
+      if (files == 0 && skipped == 0) {
+        lua_pushfstring(L, "markov.train: no MIDI files at '%s'", source);
+        failed = true;
+      }
+    }
+  } else {
+    luaL_checktype(L, 2, LUA_TTABLE);
+    std::vector<MarkovModel::Note> notes;
+    auto count = static_cast<lua_Integer>(lua_rawlen(L, 2));
+    notes.reserve(static_cast<size_t>(count));
+    for (lua_Integer i = 1; i <= count; ++i) {
+      if (lua_rawgeti(L, 2, i) != LUA_TTABLE) {
+        lua_pop(L, 1);
+        lua_pushfstring(L, "markov.train: note %d is not a table",
+                        static_cast<int>(i));
+        failed = true;
+        break;
+      }
+      double fields[4] = {0.0, 60.0, 100.0, 1.0};
+      for (int f = 0; f < 4; ++f) {
+        lua_rawgeti(L, -1, f + 1);
+        if (lua_isnumber(L, -1)) fields[f] = lua_tonumber(L, -1);
+        lua_pop(L, 1);
+      }
+      lua_pop(L, 1);
+      auto pitch = std::clamp(static_cast<int>(fields[1]), 0, 127);
+      auto velocity = std::clamp(static_cast<int>(fields[2]), 0, 127);
+      notes.push_back(MarkovModel::Note{fields[0], static_cast<uint8_t>(pitch),
+                                        static_cast<uint8_t>(velocity),
+                                        fields[3]});
+    }
+    if (!failed) model->train(std::move(notes));
+  }
+  if (failed) return lua_error(L);
+
+  lua_pushinteger(L, static_cast<lua_Integer>(model->notes() - before));
+  lua_pushinteger(L, skipped);
+  return 2;
+}
+
+// model:freeze() -> model, compiled for sampling; training ends
+static int markov_freeze(lua_State* L) {
+  checkModel(L, 1)->freeze();
+  lua_settop(L, 1);
+  return 1;
+}
+
+// model:save() -> string for ctx.markov.load, ctx.cache or async results.
+// Freezes the model.
+static int markov_save(lua_State* L) {
+  auto* model = checkModel(L, 1);
+  model->freeze();
+  auto data = model->serialize();
+  lua_pushlstring(L, data.data(), data.size());
+  return 1;
+}
+
+// model:walk(rng [, start_pitch]) -> walker drawing notes from the model
+// with a ctx.rng stream. Freezes the model.
+static int markov_walk(lua_State* L) {
+  auto* model = checkModel(L, 1);
+  auto* rng = checkRngStream(L, 2);
+  auto startPitch = static_cast<int>(luaL_optinteger(L, 3, 60));
+  luaL_argcheck(L, startPitch >= 0 && startPitch <= 127, 3,
+                "pitch out of range");
+  model->freeze();
+
+  auto* walk = static_cast<MarkovWalk*>(
+      lua_newuserdatauv(L, sizeof(MarkovWalk), 2));
+  new (walk) MarkovWalk{model, rng, {}, startPitch};
+  walk->walk.pitch = startPitch;
+  luaL_setmetatable(L, kWalkMetatable);
+  lua_pushvalue(L, 1);
+  lua_setiuservalue(L, -2, 1);
+  lua_pushvalue(L, 2);
+  lua_setiuservalue(L, -2, 2);
+  return 1;
+}
+
+// model:info() -> { order, notes, contexts, transitions, frozen }
+static int markov_info(lua_State* L) {
+  auto* model = checkModel(L, 1);
+  lua_createtable(L, 0, 5);
+  lua_pushinteger(L, model->options().order);
+  lua_setfield(L, -2, "order");
+  lua_pushinteger(L, static_cast<lua_Integer>(model->notes()));
+  lua_setfield(L, -2, "notes");
+  lua_pushinteger(L, static_cast<lua_Integer>(model->contexts()));
+  lua_setfield(L, -2, "contexts");
+  lua_pushinteger(L, static_cast<lua_Integer>(model->transitions()));
+  lua_setfield(L, -2, "transitions");
+  lua_pushboolean(L, model->frozen());
+  lua_setfield(L, -2, "frozen");
+  return 1;
+}
+
+static int markov_gc(lua_State* L) {
+  checkModel(L, 1)->~MarkovModel();
+  return 0;
+}
+
+static int markov_tostring(lua_State* L) {
+  auto* model = checkModel(L, 1);
+  lua_pushfstring(L, "markov model (order %d, %d notes%s)",
+                  model->options().order, static_cast<int>(model->notes()),
+                  model->frozen() ? ", frozen" : "");
+  return 1;
+}
+
+// walker:next() -> pitch, duration, velocity; nil for an empty model.
+// The duration is also the time until the next note.
+static int walk_next(lua_State* L) {
+  auto* walk = checkWalk(L, 1);
+  MarkovModel::Step step;
+  if (!walk->model->next(walk->walk, *walk->rng, step)) return 0;
+  lua_pushinteger(L, step.pitch);
+  lua_pushnumber(L, step.duration);
+  lua_pushinteger(L, step.velocity);
+  return 3;
+}
+
+// walker:reset([start_pitch]) -> walker, forgetting the notes drawn
+static int walk_reset(lua_State* L) {
+  auto* walk = checkWalk(L, 1);
+  auto pitch = static_cast<int>(luaL_optinteger(L, 2, walk->startPitch));
+  luaL_argcheck(L, pitch >= 0 && pitch <= 127, 2, "pitch out of range");
+  walk->walk = {};
+  walk->walk.pitch = pitch;
+  lua_settop(L, 1);
+  return 1;
+}
+
+void registerMarkovAPI(lua_State* L) {
+  static const luaL_Reg modelMethods[] = {{"train", markov_train},
+                                          {"freeze", markov_freeze},
+                                          {"save", markov_save},
+                                          {"walk", markov_walk},
+                                          {"info", markov_info},
+                                          {nullptr, nullptr}};
+  if (luaL_newmetatable(L, kMarkovMetatable)) {
+    luaL_newlib(L, modelMethods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, markov_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pushcfunction(L, markov_tostring);
+    lua_setfield(L, -2, "__tostring");
+  }
+  lua_pop(L, 1);
+
+  static const luaL_Reg walkMethods[] = {
+      {"next", walk_next}, {"reset", walk_reset}, {nullptr, nullptr}};
+  if (luaL_newmetatable(L, kWalkMetatable)) {
+    luaL_newlib(L, walkMethods);
+    lua_setfield(L, -2, "__index");
+  }
+  lua_pop(L, 1);
+
+  static const luaL_Reg markovFunctions[] = {
+      {"new", markov_new}, {"load", markov_load}, {nullptr, nullptr}};
+  luaL_newlib(L, markovFunctions);
+  lua_setfield(L, -2, "markov");
+}
+
+}  // namespace FLLua
@@ -0,0 +1,11 @@
+#pragma once
+
+struct lua_State;
+
+namespace FLLua {
+
+// Add the Markov melody models (ctx.markov) to the ctx function table on
+// top of the stack
+void registerMarkovAPI(lua_State* L);
+
+}  // namespace FLLua
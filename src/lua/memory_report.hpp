@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace FLLua {
+
+// Lua memory seen by one plugin instance, sent to its editor
+struct LuaMemoryStats {
+  int64_t heapBytes = 0;         // This instance's Lua states
+  int64_t projectHeapBytes = 0;  // Every instance in the process
+  int64_t instances = 0;
+  int64_t sharedBytes = 0;  // Library bytecode and shared tables, held once
+  int64_t savedBytes = 0;   // Shared table copies other states did not make
+  int64_t cacheHits = 0;    // Library requires served without compiling
+};
+
+// Process-wide sum of the Lua heap over all plugin instances
+class MemoryTally {
+ public:
+  static MemoryTally& instance() {
+    static MemoryTally tally;
+    return tally;
+  }
+
+  // Replace an instance's previous contribution with its current heap
+  void update(int64_t& reported, int64_t heapBytes) {
+    m_heapBytes.fetch_add(heapBytes - reported, std::memory_order_relaxed);
+    reported = heapBytes;
+  }
+
+  void addInstance(int delta) {
+    m_instances.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  int64_t heapBytes() const {
+    return m_heapBytes.load(std::memory_order_relaxed);
+  }
+  int64_t instances() const {
+    return m_instances.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<int64_t> m_heapBytes{0};
+  std::atomic<int64_t> m_instances{0};
+};
+
+}  // namespace FLLua
@@ -0,0 +1,266 @@
+#include "num_array.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+namespace FLLua {
+
+size_t numTypeSize(NumType type) {
+  switch (type) {
+    case NumType::Int8:
+      return 1;
+    case NumType::Int16:
+      return 2;
+    case NumType::Float32:
+      return 4;
+    case NumType::Float64:
+      break;
+  }
+  return 8;
+}
+
+template <typename T, typename A>
+static auto typed(A& a) {
+  if constexpr (std::is_const_v<A>) {
+    return static_cast<const T*>(a.data());
+  } else {
+    return static_cast<T*>(a.data());
+  }
+}
+
+// Call f(elements, size) with the array's element type
+template <typename A, typename F>
+static auto visit(A& a, F&& f) {
+  switch (a.type) {
+    case NumType::Int8:
+      return f(typed<int8_t>(a), a.size);
+    case NumType::Int16:
+      return f(typed<int16_t>(a), a.size);
+    case NumType::Float32:
+      return f(typed<float>(a), a.size);
+    case NumType::Float64:
+      break;
+  }
+  return f(typed<double>(a), a.size);
+}
+
+template <typename T>
+static constexpr bool kIsInt = std::is_integral_v<T>;
+
+template <typename T>
+static constexpr int32_t kLo = std::numeric_limits<T>::min();
+
+template <typename T>
+static constexpr int32_t kHi = std::numeric_limits<T>::max();
+
+// Convert to the element type: round and saturate for integers
+template <typename T>
+static T store(double value) {
+  if constexpr (kIsInt<T>) {
+    if (std::isnan(value)) return 0;
+    return static_cast<T>(std::clamp(std::nearbyint(value),
+                                     static_cast<double>(kLo<T>),
+                                     static_cast<double>(kHi<T>)));
+  } else {
+    return static_cast<T>(value);
+  }
+}
+
+// Round a float already clamped to the type's range
+template <typename T>
+static T roundClamped(float value) {
+  return static_cast<T>(
+      static_cast<int32_t>(value + (value < 0 ? -0.5f : 0.5f)));
+}
+
+double numGet(const NumArray& a, uint32_t i) {
+  return visit(a, [i](const auto* data, uint32_t) {
+    return static_cast<double>(data[i]);
+  });
+}
+
+void numSet(NumArray& a, uint32_t i, double value) {
+  visit(a, [i, value](auto* data, uint32_t) {
+    using T = std::remove_pointer_t<decltype(data)>;
+    data[i] = store<T>(value);
+  });
+}
+
+void numFill(NumArray& a, double value) {
+  visit(a, [value](auto* data, uint32_t n) {
+    using T = std::remove_pointer_t<decltype(data)>;
+    std::fill(data, data + n, store<T>(value));
+  });
+}
+
+void numAddScalar(NumArray& a, double value) {
+  visit(a, [value](auto* data, uint32_t n) {
+    using T = std::remove_pointer_t<decltype(data)>;
+    if constexpr (kIsInt<T>) {
+      double rounded = std::isnan(value) ? 0.0 : std::nearbyint(value);
+      auto k = static_cast<int32_t>(std::clamp(rounded, -65536.0, 65536.0));
+      for (uint32_t i = 0; i < n; ++i) {
+        data[i] = static_cast<T>(std::clamp(data[i] + k, kLo<T>, kHi<T>));
+      }
+    } else {
+      auto k = static_cast<T>(value);
+      for (uint32_t i = 0; i < n; ++i) data[i] += k;
+    }
+  });
+}
+
+void numAdd(NumArray& a, const NumArray& b) {
+  visit(a, [&b](auto* data, uint32_t n) {
+    using T = std::remove_pointer_t<decltype(data)>;
+    visit(b, [data, n](const auto* other, uint32_t) {
+      for (uint32_t i = 0; i < n; ++i) {
+        if constexpr (kIsInt<T>) {
+          data[i] = store<T>(static_cast<double>(data[i]) + other[i]);
+        } else {
+          data[i] = static_cast<T>(data[i] + other[i]);
+        }
+      }
+    });
+  });
+}
+
+void numScaleScalar(NumArray& a, double factor) {
+  visit(a, [factor](auto* data, uint32_t n) {
+    using T = std::remove_pointer_t<decltype(data)>;
+    if constexpr (kIsInt<T>) {
+      auto f = static_cast<float>(factor);
+      // NaN and infinite products go through store(), which defines them
+      if (!std::isfinite(f)) {
+        for (uint32_t i = 0; i < n; ++i) data[i] = store<T>(data[i] * factor);
+        return;
+      }
+      auto lo = static_cast<float>(kLo<T>);
+      auto hi = static_cast<float>(kHi<T>);
+      for (uint32_t i = 0; i < n; ++i) {
+        data[i] = roundClamped<T>(std::clamp(data[i] * f, lo, hi));
+      }
+    } else {
+      auto f = static_cast<T>(factor);
+      for (uint32_t i = 0; i < n; ++i) data[i] *= f;
+    }
+  });
+}
+
+void numMul(NumArray& a, const NumArray& b) {
+  visit(a, [&b](auto* data, uint32_t n) {
+    using T = std::remove_pointer_t<decltype(data)>;
+    visit(b, [data, n](const auto* other, uint32_t) {
+      for (uint32_t i = 0; i < n; ++i) {
+        if constexpr (kIsInt<T>) {
+          data[i] = store<T>(static_cast<double>(data[i]) * other[i]);
+        } else {
+          data[i] = static_cast<T>(data[i] * other[i]);
+        }
+      }
+    });
+  });
+}
+
+void numClamp(NumArray& a, double lo, double hi) {
+  visit(a, [lo, hi](auto* data, uint32_t n) {
+    using T = std::remove_pointer_t<decltype(data)>;
+    T low = store<T>(lo);
+    T high = std::max(low, store<T>(hi));
+    for (uint32_t i = 0; i < n; ++i) data[i] = std::clamp(data[i], low, high);
+  });
+}
+
+void numQuantize(NumArray& a, const std::array<int8_t, 12>& shift, int root) {
+  visit(a, [&shift, root](auto* data, uint32_t n) {
+    using T = std::remove_pointer_t<decltype(data)>;
+    for (uint32_t i = 0; i < n; ++i) {
+      double value = data[i];
+      if (std::isnan(value)) continue;
+      auto pitch = static_cast<int64_t>(std::nearbyint(value));
+      int pc = static_cast<int>(((pitch - root) % 12 + 12) % 12);
+      data[i] = store<T>(static_cast<double>(pitch + shift[pc]));
+    }
+  });
+}
+
+void numLookup(NumArray& a, const NumArray& lut) {
+  if (lut.size == 0) return;
+  auto last = static_cast<double>(lut.size - 1);
+  visit(a, [&lut, last](auto* data, uint32_t n) {
+    using T = std::remove_pointer_t<decltype(data)>;
+    visit(lut, [data, n, last](const auto* table, uint32_t) {
+      for (uint32_t i = 0; i < n; ++i) {
+        double index = std::nearbyint(static_cast<double>(data[i]));
+        index = std::isnan(index) ? 0.0 : std::clamp(index, 0.0, last);
+        data[i] = store<T>(table[static_cast<uint32_t>(index)]);
+      }
+    });
+  });
+}
+
+void numCumsum(NumArray& a) {
+  visit(a, [](auto* data, uint32_t n) {
+    using T = std::remove_pointer_t<decltype(data)>;
+    if constexpr (kIsInt<T>) {
+      int32_t sum = 0;
+      for (uint32_t i = 0; i < n; ++i) {
+        sum = std::clamp(sum + data[i], kLo<T>, kHi<T>);
+        data[i] = static_cast<T>(sum);
+      }
+    } else {
+      T sum = 0;
+      for (uint32_t i = 0; i < n; ++i) {
+        sum += data[i];
+        data[i] = sum;
+      }
+    }
+  });
+}
+
+double numSum(const NumArray& a) {
+  return visit(a, [](const auto* data, uint32_t n) {
+    double sum = 0.0;
+    for (uint32_t i = 0; i < n; ++i) sum += data[i];
+    return sum;
+  });
+}
+
+double numMin(const NumArray& a) {
+  return visit(a, [](const auto* data, uint32_t n) {
+    return n ? static_cast<double>(*std::min_element(data, data + n)) : 0.0;
+  });
+}
+
+double numMax(const NumArray& a) {
+  return visit(a, [](const auto* data, uint32_t n) {
+    return n ? static_cast<double>(*std::max_element(data, data + n)) : 0.0;
+  });
+}
+
+uint32_t numArgmin(const NumArray& a) {
+  return visit(a, [](const auto* data, uint32_t n) {
+    return static_cast<uint32_t>(std::min_element(data, data + n) - data);
+  });
+}
+
+uint32_t numArgmax(const NumArray& a) {
+  return visit(a, [](const auto* data, uint32_t n) {
+    return static_cast<uint32_t>(std::max_element(data, data + n) - data);
+  });
+}
+
+double numDot(const NumArray& a, const NumArray& b) {
+  return visit(a, [&b](const auto* data, uint32_t n) {
+    return visit(b, [data, n](const auto* other, uint32_t) {
+      double sum = 0.0;
+      for (uint32_t i = 0; i < n; ++i) {
+        sum += static_cast<double>(data[i]) * other[i];
+      }
+      return sum;
+    });
+  });
+}
+
+}  // namespace FLLua
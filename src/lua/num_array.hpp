@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace FLLua {
+
+enum class NumType : uint8_t { Int8, Int16, Float32, Float64 };
+
+size_t numTypeSize(NumType type);
+
+// Header of a fixed-size numeric array; the elements follow it in the same
+// allocation. Integer arrays round stored values to nearest and saturate at
+// their type's range. The kernels below are plain loops over the raw
+// elements, one instantiation per type, so the compiler can vectorize them.
+struct NumArray {
+  uint32_t size;
+  NumType type;
+
+  void* data() { return this + 1; }
+  const void* data() const { return this + 1; }
+
+  static size_t allocationSize(NumType type, uint32_t size) {
+    return sizeof(NumArray) + numTypeSize(type) * size;
+  }
+};
+
+double numGet(const NumArray& a, uint32_t i);
+void numSet(NumArray& a, uint32_t i, double value);
+void numFill(NumArray& a, double value);
+
+// Element-wise, in place; `b` must have the same size as `a`
+void numAddScalar(NumArray& a, double value);
+void numAdd(NumArray& a, const NumArray& b);
+void numScaleScalar(NumArray& a, double factor);
+void numMul(NumArray& a, const NumArray& b);
+void numClamp(NumArray& a, double lo, double hi);
+
+// Move each value (rounded) to a pitch in the scale. `shift[pc]` is the
+// offset from pitch class pc, relative to the root, to the nearest scale
+// pitch class.
+void numQuantize(NumArray& a, const std::array<int8_t, 12>& shift, int root);
+
+// Replace each value v with lut[round(v)], v clamped to the table's range
+void numLookup(NumArray& a, const NumArray& lut);
+
+// Running sum, in place
+void numCumsum(NumArray& a);
+
+// Reductions; argmin/argmax return the first matching index (0-based) and
+// are meaningless on empty arrays
+double numSum(const NumArray& a);
+double numMin(const NumArray& a);
+double numMax(const NumArray& a);
+uint32_t numArgmin(const NumArray& a);
+uint32_t numArgmax(const NumArray& a);
+double numDot(const NumArray& a, const NumArray& b);
+
+}  // namespace FLLua
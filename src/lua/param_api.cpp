@@ -0,0 +1,77 @@
+#include "param_api.hpp"
+
+#include "api.hpp"
+#include "events/param_snapshot.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+// Parameter indices are 1-based on the Lua side
+static int checkParamIndex(lua_State* L, int arg) {
+  lua_Integer index = luaL_checkinteger(L, arg);
+  luaL_argcheck(L, index >= 1 && index <= ParamSnapshot::kNumParams, arg,
+                "parameter index out of range");
+  return static_cast<int>(index) - 1;
+}
+
+// ctx.param(i) -> value (0..1) at the current event position
+static int ctx_param(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->params) return 0;
+
+  int index = checkParamIndex(L, 1);
+  lua_pushnumber(L, ctx->params->valueAt(index, ctx->sampleOffset));
+  return 1;
+}
+
+// ctx.param_at(i, sample_offset) -> value (0..1)
+static int ctx_param_at(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->params) return 0;
+
+  int index = checkParamIndex(L, 1);
+  auto offset = static_cast<int32_t>(luaL_checkinteger(L, 2));
+  lua_pushnumber(L, ctx->params->valueAt(index, offset));
+  return 1;
+}
+
+void registerParamAPI(lua_State* L) {
+  static const luaL_Reg paramFunctions[] = {{"param", ctx_param},
+                                            {"param_at", ctx_param_at},
+                                            {nullptr, nullptr}};
+  luaL_setfuncs(L, paramFunctions, 0);
+}
+
+std::string dispatchParamChanges(lua_State* L, PluginContext* ctx) {
+  if (!ctx->params) return {};
+  std::string errors;
+
+  for (int i = 0; i < ParamSnapshot::kNumParams; ++i) {
+    if (!ctx->params->changed(i)) continue;
+    if (lua_getglobal(L, "on_param") != LUA_TFUNCTION) {
+      lua_pop(L, 1);
+      break;
+    }
+
+    ctx->sampleOffset = ctx->params->lastOffset(i);
+    lua_getglobal(L, "ctx");
+    lua_pushinteger(L, i + 1);
+    lua_pushnumber(L, ctx->params->value(i));
+    if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
+      const char* msg = lua_tostring(L, -1);
+      errors += msg ? msg : "on_param error";
+      errors += '\n';
+      lua_pop(L, 1);
+    }
+  }
+
+  ctx->sampleOffset = 0;
+  if (!errors.empty()) errors.pop_back();
+  return errors;
+}
+
+}  // namespace FLLua
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+struct lua_State;
+
+namespace FLLua {
+
+struct PluginContext;
+
+// Add ctx.param and ctx.param_at to the ctx function table on top of the
+// stack
+void registerParamAPI(lua_State* L);
+
+// Call on_param(ctx, index, value) for every macro parameter whose value
+// changed this block. Returns error messages (one per line), empty on
+// success.
+std::string dispatchParamChanges(lua_State* L, PluginContext* ctx);
+
+}  // namespace FLLua
@@ -0,0 +1,265 @@
+#include "pattern_api.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <new>
+
+#include "api.hpp"
+#include "sequencing/step_pattern.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+static const char* kPatternMetatable = "FLLua.Pattern";
+static const char* kPatternBuildMetatable = "FLLua.PatternBuild";
+
+// Pattern handles only carry the player slot; the player owns the data so
+// a pattern keeps playing after the script drops its handle.
+struct PatternHandle {
+  int id;
+};
+
+static PatternHandle* checkPattern(lua_State* L, int arg) {
+  return static_cast<PatternHandle*>(
+      luaL_checkudata(L, arg, kPatternMetatable));
+}
+
+// A spec is parsed into a userdata, so the pattern is freed by __gc when
+// a malformed field raises a Lua error partway through
+struct PatternBuild {
+  std::shared_ptr<StepPattern> pattern;
+  std::vector<float> probability;
+};
+
+static int build_gc(lua_State* L) {
+  static_cast<PatternBuild*>(
+      luaL_checkudata(L, 1, kPatternBuildMetatable))->~PatternBuild();
+  return 0;
+}
+
+// Read a lane field that is either a single number or an array of numbers
+template <typename T>
+static void readLane(lua_State* L, int idx, const char* key,
+                     std::vector<T>& out, double lo, double hi) {
+  int type = lua_getfield(L, idx, key);
+  if (type == LUA_TNUMBER) {
+    out.push_back(static_cast<T>(std::clamp(lua_tonumber(L, -1), lo, hi)));
+  } else if (type == LUA_TTABLE) {
+    lua_Integer count = luaL_len(L, -1);
+    for (lua_Integer i = 1; i <= count; ++i) {
+      lua_geti(L, -1, i);
+      out.push_back(
+          static_cast<T>(std::clamp(luaL_optnumber(L, -1, lo), lo, hi)));
+      lua_pop(L, 1);
+    }
+  } else if (type != LUA_TNIL) {
+    luaL_error(L, "pattern: '%s' must be a number or an array", key);
+  }
+  lua_pop(L, 1);
+}
+
+// Build a StepPattern from a spec table, left on the stack in a
+// PatternBuild:
+//   {steps = 16 | {1, 0, 0.5, true, ...}, euclid = {pulses, steps},
+//    rotate = n, probability = {...}, notes = ..., velocities = ...,
+//    gates = ..., rate = 1/16, channel = 0}
+static PatternBuild* parsePattern(lua_State* L, int idx) {
+  idx = lua_absindex(L, idx);
+  luaL_checktype(L, idx, LUA_TTABLE);
+  auto* build = new (lua_newuserdatauv(L, sizeof(PatternBuild), 0))
+      PatternBuild{std::make_shared<StepPattern>(), {}};
+  luaL_setmetatable(L, kPatternBuildMetatable);
+  auto* pattern = build->pattern.get();
+
+  if (lua_getfield(L, idx, "euclid") == LUA_TTABLE) {
+    lua_geti(L, -1, 1);
+    lua_geti(L, -2, 2);
+    auto pulses = static_cast<int>(luaL_checkinteger(L, -2));
+    auto steps = static_cast<int>(luaL_checkinteger(L, -1));
+    lua_pop(L, 2);
+    pattern->hits = StepPattern::euclidean(pulses, steps);
+  }
+  lua_pop(L, 1);
+
+  if (pattern->hits.empty()) {
+    int type = lua_getfield(L, idx, "steps");
+    if (type == LUA_TNUMBER) {
+      pattern->hits.assign(static_cast<size_t>(std::max<lua_Integer>(
+                               lua_tointeger(L, -1), 0)),
+                           1.0f);
+    } else if (type == LUA_TTABLE) {
+      lua_Integer count = luaL_len(L, -1);
+      for (lua_Integer i = 1; i <= count; ++i) {
+        lua_geti(L, -1, i);
+        float hit = lua_isboolean(L, -1)
+                        ? (lua_toboolean(L, -1) ? 1.0f : 0.0f)
+                        : static_cast<float>(luaL_optnumber(L, -1, 0.0));
+        pattern->hits.push_back(std::clamp(hit, 0.0f, 1.0f));
+        lua_pop(L, 1);
+      }
+    }
+    lua_pop(L, 1);
+  }
+  if (pattern->hits.empty()) {
+    luaL_error(L, "pattern: 'steps' or 'euclid' is required");
+  }
+
+  auto& probability = build->probability;
+  readLane(L, idx, "probability", probability, 0.0, 1.0);
+  if (!probability.empty()) {
+    for (size_t i = 0; i < pattern->hits.size(); ++i) {
+      pattern->hits[i] *= probability[i % probability.size()];
+    }
+  }
+
+  lua_getfield(L, idx, "rotate");
+  StepPattern::rotate(pattern->hits,
+                      static_cast<int>(luaL_optinteger(L, -1, 0)));
+  lua_pop(L, 1);
+
+  readLane(L, idx, "notes", pattern->notes, 0, 127);
+  readLane(L, idx, "velocities", pattern->velocities, 0, 127);
+  readLane(L, idx, "gates", pattern->gates, 0.0, 16.0);
+
+  lua_getfield(L, idx, "rate");
+  double rate = luaL_optnumber(L, -1, 1.0 / 16.0);
+  lua_pop(L, 1);
+  if (rate <= 0.0) luaL_error(L, "pattern: rate must be positive");
+  pattern->stepBeats = rate * 4.0;  // Whole-note fraction to quarter notes
+
+  lua_getfield(L, idx, "channel");
+  pattern->channel =
+      static_cast<uint8_t>(std::clamp<lua_Integer>(luaL_optinteger(L, -1, 0),
+                                                   0, 15));
+  lua_pop(L, 1);
+
+  return build;
+}
+
+// ctx.pattern(spec) -> pattern
+static int ctx_pattern(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->patternPlayer) return 0;
+
+  int id = ctx->patternPlayer->add(parsePattern(L, 1)->pattern);
+  if (id < 0) {
+    return luaL_error(L, "pattern: all %d pattern slots are in use",
+                      PatternPlayer::kMaxPatterns);
+  }
+
+  auto* handle = static_cast<PatternHandle*>(
+      lua_newuserdatauv(L, sizeof(PatternHandle), 0));
+  handle->id = id;
+  luaL_setmetatable(L, kPatternMetatable);
+  return 1;
+}
+
+// pattern:play({at = beat}?)
+// Without `at`, step 0 is aligned to the start of the current bar so the
+// pattern lands on the grid.
+static int pattern_play(lua_State* L) {
+  auto* handle = checkPattern(L, 1);
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->patternPlayer) return 0;
+
+  double barBeats = ctx->transport.barBeats();
+  double at = std::floor(ctx->eventBeat() / barBeats) * barBeats;
+  if (lua_istable(L, 2)) {
+    lua_getfield(L, 2, "at");
+    at = luaL_optnumber(L, -1, at);
+    lua_pop(L, 1);
+  }
+
+  lua_pushboolean(L, ctx->patternPlayer->play(handle->id, at));
+  return 1;
+}
+
+// pattern:stop()
+static int pattern_stop(lua_State* L) {
+  auto* handle = checkPattern(L, 1);
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->patternPlayer || !ctx->eventQueue) return 0;
+
+  lua_pushboolean(L,
+                  ctx->patternPlayer->stop(handle->id, *ctx->eventQueue));
+  return 1;
+}
+
+// pattern:swap(spec)
+// The new pattern takes over at the next bar boundary, starting at step 0.
+static int pattern_swap(lua_State* L) {
+  auto* handle = checkPattern(L, 1);
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->patternPlayer) return 0;
+
+  auto* build = parsePattern(L, 2);
+  lua_pushboolean(L, ctx->patternPlayer->swap(handle->id, build->pattern,
+                                              ctx->eventBeat(),
+                                              ctx->transport.barBeats()));
+  return 1;
+}
+
+// pattern:remove()
+static int pattern_remove(lua_State* L) {
+  auto* handle = checkPattern(L, 1);
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->patternPlayer || !ctx->eventQueue) return 0;
+
+  lua_pushboolean(
+      L, ctx->patternPlayer->remove(handle->id, *ctx->eventQueue));
+  handle->id = -1;
+  return 1;
+}
+
+// pattern:playing()
+static int pattern_playing(lua_State* L) {
+  auto* handle = checkPattern(L, 1);
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->patternPlayer) return 0;
+
+  lua_pushboolean(L, ctx->patternPlayer->isPlaying(handle->id));
+  return 1;
+}
+
+// pattern:step() -> 1-based index of the step played last, or nil
+static int pattern_step(lua_State* L) {
+  auto* handle = checkPattern(L, 1);
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->patternPlayer) return 0;
+
+  int step = ctx->patternPlayer->currentStep(handle->id);
+  if (step < 0) return 0;
+  lua_pushinteger(L, step + 1);
+  return 1;
+}
+
+void registerPatternAPI(lua_State* L) {
+  static const luaL_Reg patternMethods[] = {{"play", pattern_play},
+                                            {"stop", pattern_stop},
+                                            {"swap", pattern_swap},
+                                            {"remove", pattern_remove},
+                                            {"playing", pattern_playing},
+                                            {"step", pattern_step},
+                                            {nullptr, nullptr}};
+  if (luaL_newmetatable(L, kPatternMetatable)) {
+    luaL_newlib(L, patternMethods);
+    lua_setfield(L, -2, "__index");
+  }
+  lua_pop(L, 1);
+
+  if (luaL_newmetatable(L, kPatternBuildMetatable)) {
+    lua_pushcfunction(L, build_gc);
+    lua_setfield(L, -2, "__gc");
+  }
+  lua_pop(L, 1);
+
+  lua_pushcfunction(L, ctx_pattern);
+  lua_setfield(L, -2, "pattern");
+}
+
+}  // namespace FLLua
@@ -0,0 +1,11 @@
+#pragma once
+
+struct lua_State;
+
+namespace FLLua {
+
+// Add ctx.pattern and the pattern object metatable to the ctx function
+// table on top of the stack
+void registerPatternAPI(lua_State* L);
+
+}  // namespace FLLua
@@ -0,0 +1,217 @@
+#include "plain_value.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+static constexpr int kMaxDepth = 32;
+
+// Encoding tags
+enum : uint8_t { kNil, kFalse, kTrue, kInteger, kNumber, kString, kTable };
+
+static std::string copyValue(lua_State* L, int idx, PlainValue& out,
+                             int depth) {
+  switch (lua_type(L, idx)) {
+    case LUA_TNIL:
+      out.value = std::monostate{};
+      return {};
+    case LUA_TBOOLEAN:
+      out.value = lua_toboolean(L, idx) != 0;
+      return {};
+    case LUA_TNUMBER:
+      if (lua_isinteger(L, idx)) {
+        out.value = static_cast<int64_t>(lua_tointeger(L, idx));
+      } else {
+        out.value = static_cast<double>(lua_tonumber(L, idx));
+      }
+      return {};
+    case LUA_TSTRING: {
+      size_t length = 0;
+      const char* s = lua_tolstring(L, idx, &length);
+      out.value = std::string(s, length);
+      return {};
+    }
+    case LUA_TTABLE:
+      break;
+    default:
+      return std::string("cannot copy a ") + luaL_typename(L, idx);
+  }
+
+  if (depth >= kMaxDepth) return "tables nested too deeply (or cyclic)";
+  if (!lua_checkstack(L, 2)) return "stack overflow";
+  idx = lua_absindex(L, idx);
+
+  PlainValue::Table table;
+  table.reserve(lua_rawlen(L, idx));
+  lua_pushnil(L);
+  while (lua_next(L, idx)) {
+    auto& field = table.emplace_back();
+    auto error = copyValue(L, -2, field.key, depth + 1);
+    if (error.empty()) error = copyValue(L, -1, field.value, depth + 1);
+    lua_pop(L, 1);
+    if (!error.empty()) {
+      lua_pop(L, 1);
+      return error;
+    }
+  }
+  out.value = std::move(table);
+  return {};
+}
+
+std::string toPlainValue(lua_State* L, int idx, PlainValue& out) {
+  return copyValue(L, idx, out, 0);
+}
+
+void pushPlainValue(lua_State* L, const PlainValue& value) {
+  luaL_checkstack(L, 3, "nested too deeply");
+  std::visit(
+      [L](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::monostate>) {
+          lua_pushnil(L);
+        } else if constexpr (std::is_same_v<T, bool>) {
+          lua_pushboolean(L, v);
+        } else if constexpr (std::is_same_v<T, int64_t>) {
+          lua_pushinteger(L, static_cast<lua_Integer>(v));
+        } else if constexpr (std::is_same_v<T, double>) {
+          lua_pushnumber(L, v);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+          lua_pushlstring(L, v.data(), v.size());
+        } else {
+          lua_createtable(L, 0, static_cast<int>(v.size()));
+          for (const auto& field : v) {
+            pushPlainValue(L, field.key);
+            pushPlainValue(L, field.value);
+            lua_rawset(L, -3);
+          }
+        }
+      },
+      value.value);
+}
+
+static void writeVarint(uint64_t value, std::string& out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+static bool readVarint(std::string_view& data, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && !data.empty(); shift += 7) {
+    auto byte = static_cast<uint8_t>(data.front());
+    data.remove_prefix(1);
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+void serializePlainValue(const PlainValue& value, std::string& out) {
+  std::visit(
+      [&out](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::monostate>) {
+          out.push_back(static_cast<char>(kNil));
+        } else if constexpr (std::is_same_v<T, bool>) {
+          out.push_back(static_cast<char>(v ? kTrue : kFalse));
+        } else if constexpr (std::is_same_v<T, int64_t>) {
+          // Zigzag keeps small negative numbers short
+          out.push_back(static_cast<char>(kInteger));
+          writeVarint((static_cast<uint64_t>(v) << 1) ^
+                          static_cast<uint64_t>(v >> 63),
+                      out);
+        } else if constexpr (std::is_same_v<T, double>) {
+          char bytes[sizeof(double)];
+          std::memcpy(bytes, &v, sizeof(double));
+          out.push_back(static_cast<char>(kNumber));
+          out.append(bytes, sizeof(double));
+        } else if constexpr (std::is_same_v<T, std::string>) {
+          out.push_back(static_cast<char>(kString));
+          writeVarint(v.size(), out);
+          out += v;
+        } else {
+          // Fields sorted by their encoded key
+          std::vector<std::pair<std::string, const PlainValue*>> fields;
+          fields.reserve(v.size());
+          for (const auto& field : v) {
+            auto& entry = fields.emplace_back(std::string(), &field.value);
+            serializePlainValue(field.key, entry.first);
+          }
+          std::sort(fields.begin(), fields.end(),
+                    [](const auto& a, const auto& b) {
+                      return a.first < b.first;
+                    });
+          out.push_back(static_cast<char>(kTable));
+          writeVarint(fields.size(), out);
+          for (const auto& [key, fieldValue] : fields) {
+            out += key;
+            serializePlainValue(*fieldValue, out);
+          }
+        }
+      },
+      value.value);
+}
+
+static bool readValue(std::string_view& data, PlainValue& out, int depth) {
+  if (data.empty() || depth > kMaxDepth) return false;
+  auto tag = static_cast<uint8_t>(data.front());
+  data.remove_prefix(1);
+
+  uint64_t n = 0;
+  switch (tag) {
+    case kNil:
+      out.value = std::monostate{};
+      return true;
+    case kFalse:
+    case kTrue:
+      out.value = tag == kTrue;
+      return true;
+    case kInteger:
+      if (!readVarint(data, n)) return false;
+      out.value = static_cast<int64_t>((n >> 1) ^ (~(n & 1) + 1));
+      return true;
+    case kNumber: {
+      if (data.size() < sizeof(double)) return false;
+      double number;
+      std::memcpy(&number, data.data(), sizeof(double));
+      data.remove_prefix(sizeof(double));
+      out.value = number;
+      return true;
+    }
+    case kString:
+      if (!readVarint(data, n) || n > data.size()) return false;
+      out.value = std::string(data.substr(0, n));
+      data.remove_prefix(n);
+      return true;
+    case kTable: {
+      // Every field takes at least two bytes
+      if (!readVarint(data, n) || n > data.size() / 2) return false;
+      PlainValue::Table table(n);
+      for (auto& field : table) {
+        if (!readValue(data, field.key, depth + 1) ||
+            !readValue(data, field.value, depth + 1)) {
+          return false;
+        }
+      }
+      out.value = std::move(table);
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+bool deserializePlainValue(std::string_view& data, PlainValue& out) {
+  return readValue(data, out, 0);
+}
+
+}  // namespace FLLua
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+struct lua_State;
+
+namespace FLLua {
+
+// Lua data copied out of a state so it can cross to another one: nil,
+// booleans, numbers, strings and tables of those. Functions, userdata,
+// threads and metatables do not survive the copy.
+struct PlainValue {
+  struct Field;
+  using Table = std::vector<Field>;
+
+  std::variant<std::monostate, bool, int64_t, double, std::string, Table>
+      value;
+};
+
+struct PlainValue::Field {
+  PlainValue key;
+  PlainValue value;
+};
+
+// Copy the value at `idx`. Returns an error for values that are not plain
+// data or tables nested deeper than 32 levels (cycles included).
+std::string toPlainValue(lua_State* L, int idx, PlainValue& out);
+
+// Push a fresh Lua copy of `value`
+void pushPlainValue(lua_State* L, const PlainValue& value);
+
+// Append a compact binary encoding of `value`. Table fields are written in
+// a canonical order, so equal values always encode to the same bytes.
+void serializePlainValue(const PlainValue& value, std::string& out);
+
+// Decode one value from the front of `data`, advancing it past the value.
+// Returns false on malformed or truncated input.
+bool deserializePlainValue(std::string_view& data, PlainValue& out);
+
+}  // namespace FLLua
@@ -0,0 +1,75 @@
+#include "ramp_api.hpp"
+
+#include <cstring>
+
+#include "api.hpp"
+#include "sequencing/ramp_engine.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+// Curve argument: "linear", "exp", "log", "smooth" or a power exponent
+static RampCurve checkCurve(lua_State* L, int arg, double& exponent) {
+  if (lua_type(L, arg) == LUA_TNUMBER) {
+    exponent = lua_tonumber(L, arg);
+    luaL_argcheck(L, exponent > 0.0, arg, "exponent must be positive");
+    return RampCurve::Power;
+  }
+  const char* name = luaL_optstring(L, arg, "linear");
+  if (strcmp(name, "linear") == 0) return RampCurve::Linear;
+  if (strcmp(name, "exp") == 0) return RampCurve::Exp;
+  if (strcmp(name, "log") == 0) return RampCurve::Log;
+  if (strcmp(name, "smooth") == 0) return RampCurve::Smooth;
+  luaL_argerror(L, arg, "unknown curve");
+  return RampCurve::Linear;
+}
+
+static int startRamp(lua_State* L, PluginContext* ctx, uint8_t controller,
+                     int firstArg) {
+  double from = luaL_checknumber(L, firstArg);
+  double to = luaL_checknumber(L, firstArg + 1);
+  double beats = luaL_checknumber(L, firstArg + 2);
+  double exponent = 1.0;
+  RampCurve curve = checkCurve(L, firstArg + 3, exponent);
+  auto channel = static_cast<uint8_t>(luaL_optinteger(L, firstArg + 4, 0));
+
+  bool started = ctx->ramps->start(channel, controller, from, to,
+                                   ctx->eventBeat(), beats, curve, exponent);
+  if (!started) {
+    return luaL_error(L, "all %d ramp slots are in use",
+                      RampEngine::kMaxRamps);
+  }
+  return 0;
+}
+
+// ctx.cc_ramp(controller, from, to, beats, curve?, channel?)
+static int ctx_cc_ramp(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->ramps) return 0;
+
+  lua_Integer controller = luaL_checkinteger(L, 1);
+  luaL_argcheck(L, controller >= 0 && controller < 128, 1,
+                "controller out of range");
+  return startRamp(L, ctx, static_cast<uint8_t>(controller), 2);
+}
+
+// ctx.bend_ramp(from, to, beats, curve?, channel?)
+static int ctx_bend_ramp(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->ramps) return 0;
+
+  return startRamp(L, ctx, RampEngine::kPitchBendTarget, 1);
+}
+
+void registerRampAPI(lua_State* L) {
+  static const luaL_Reg rampFunctions[] = {{"cc_ramp", ctx_cc_ramp},
+                                           {"bend_ramp", ctx_bend_ramp},
+                                           {nullptr, nullptr}};
+  luaL_setfuncs(L, rampFunctions, 0);
+}
+
+}  // namespace FLLua
@@ -0,0 +1,11 @@
+#pragma once
+
+struct lua_State;
+
+namespace FLLua {
+
+// Add ctx.cc_ramp and ctx.bend_ramp to the ctx function table on top of
+// the stack
+void registerRampAPI(lua_State* L);
+
+}  // namespace FLLua
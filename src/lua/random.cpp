@@ -0,0 +1,139 @@
+#include "random.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace FLLua {
+
+uint64_t splitMix64(uint64_t& state) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+uint64_t mixSeed(uint64_t a, uint64_t b) {
+  uint64_t state = a ^ (b * 0xd6e8feb86659fd93ull);
+  return splitMix64(state);
+}
+
+static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+void Xoshiro256::reseed(uint64_t seed) {
+  // SplitMix64 never yields four zero words in a row, the one state
+  // xoshiro cannot leave
+  for (auto& word : m_s) word = splitMix64(seed);
+  m_hasSpare = false;
+}
+
+uint64_t Xoshiro256::next() {
+  uint64_t result = rotl(m_s[1] * 5, 7) * 9;
+  uint64_t t = m_s[1] << 17;
+  m_s[2] ^= m_s[0];
+  m_s[3] ^= m_s[1];
+  m_s[1] ^= m_s[2];
+  m_s[0] ^= m_s[3];
+  m_s[2] ^= t;
+  m_s[3] = rotl(m_s[3], 45);
+  return result;
+}
+
+uint64_t Xoshiro256::below(uint64_t bound) {
+  // Reject the low values that would make some remainders more likely
+  uint64_t threshold = (0 - bound) % bound;
+  for (;;) {
+    uint64_t r = next();
+    if (r >= threshold) return r % bound;
+  }
+}
+
+double Xoshiro256::gaussian() {
+  if (m_hasSpare) {
+    m_hasSpare = false;
+    return m_spare;
+  }
+  // Box-Muller; 1 - uniform() is in (0, 1], so the log is finite
+  double radius = std::sqrt(-2.0 * std::log(1.0 - uniform()));
+  double angle = 6.283185307179586 * uniform();
+  m_spare = radius * std::sin(angle);
+  m_hasSpare = true;
+  return radius * std::cos(angle);
+}
+
+bool buildAlias(const double* weights, uint32_t n, float* probabilities,
+                uint32_t* aliases) {
+  double total = 0.0;
+  for (uint32_t i = 0; i < n; ++i) {
+    if (weights[i] > 0.0) total += weights[i];
+  }
+  if (!(total > 0.0) || !std::isfinite(total)) return false;
+
+  // Vose's method: pair each under-full outcome with an over-full one
+  std::vector<double> scaled(n);
+  std::vector<uint32_t> small, large;
+  small.reserve(n);
+  large.reserve(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    scaled[i] = weights[i] > 0.0 ? weights[i] * n / total : 0.0;
+    (scaled[i] < 1.0 ? small : large).push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    uint32_t s = small.back();
+    uint32_t l = large.back();
+    small.pop_back();
+    probabilities[s] = static_cast<float>(scaled[s]);
+    aliases[s] = l;
+    scaled[l] -= 1.0 - scaled[s];
+    if (scaled[l] < 1.0) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // Leftovers are full up to rounding error
+  for (uint32_t i : large) {
+    probabilities[i] = 1.0f;
+    aliases[i] = i;
+  }
+  for (uint32_t i : small) {
+    probabilities[i] = 1.0f;
+    aliases[i] = i;
+  }
+  return true;
+}
+
+uint32_t sampleAlias(const float* probabilities, const uint32_t* aliases,
+                     uint32_t size, Xoshiro256& rng) {
+  uint64_t r = rng.next();
+  // High bits pick the column, the low 24 bits the coin
+  auto column = static_cast<uint32_t>(((r >> 32) * size) >> 32);
+  float coin = static_cast<float>(r & 0xffffff) * 0x1.0p-24f;
+  return coin < probabilities[column] ? column : aliases[column];
+}
+
+// Random value in [-1, 1] at an integer lattice point
+static double latticeValue(uint64_t seed, int64_t i) {
+  uint64_t state = seed ^ (static_cast<uint64_t>(i) * 0x9e3779b97f4a7c15ull);
+  return (splitMix64(state) >> 11) * 0x1.0p-52 - 1.0;
+}
+
+double valueNoise(uint64_t seed, double x, int octaves) {
+  double sum = 0.0;
+  double amplitude = 1.0;
+  double norm = 0.0;
+  for (int octave = 0; octave < octaves; ++octave) {
+    double cell = std::floor(x);
+    double t = x - cell;
+    double fade = t * t * t * (t * (t * 6.0 - 15.0) + 10.0);
+    auto i = static_cast<int64_t>(cell);
+    double a = latticeValue(seed, i);
+    double b = latticeValue(seed, i + 1);
+    sum += amplitude * (a + (b - a) * fade);
+    norm += amplitude;
+    amplitude *= 0.5;
+    x *= 2.0;
+    seed = mixSeed(seed, static_cast<uint64_t>(octave) + 1);
+  }
+  return norm > 0.0 ? sum / norm : 0.0;
+}
+
+}  // namespace FLLua
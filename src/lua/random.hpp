@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace FLLua {
+
+// SplitMix64 step: advances `state` and returns a well-mixed value. Used to
+// expand seeds and to hash noise lattice points.
+uint64_t splitMix64(uint64_t& state);
+
+// Mix two seeds into one, e.g. an instance seed and a stream key
+uint64_t mixSeed(uint64_t a, uint64_t b);
+
+// xoshiro256** generator: small, fast and with a period far beyond any
+// render. Trivially copyable, so it lives inline in Lua userdata.
+class Xoshiro256 {
+ public:
+  explicit Xoshiro256(uint64_t seed = 0) { reseed(seed); }
+
+  void reseed(uint64_t seed);
+
+  uint64_t next();
+
+  // Uniform in [0, 1)
+  double uniform() { return (next() >> 11) * 0x1.0p-53; }
+
+  // Uniform integer in [0, bound), unbiased; bound must be non-zero
+  uint64_t below(uint64_t bound);
+
+  // Standard normal deviate
+  double gaussian();
+
+ private:
+  std::array<uint64_t, 4> m_s{};
+  double m_spare = 0.0;  // Second Box-Muller deviate
+  bool m_hasSpare = false;
+};
+
+// Walker alias table over `size` outcomes: weights are compiled once, then
+// each draw costs one uniform index and one comparison. The probabilities
+// and aliases follow the header in the same allocation.
+struct AliasTable {
+  uint32_t size;
+
+  float* probabilities() { return reinterpret_cast<float*>(this + 1); }
+  const float* probabilities() const {
+    return reinterpret_cast<const float*>(this + 1);
+  }
+  uint32_t* aliases() {
+    return reinterpret_cast<uint32_t*>(probabilities() + size);
+  }
+  const uint32_t* aliases() const {
+    return reinterpret_cast<const uint32_t*>(probabilities() + size);
+  }
+
+  static size_t allocationSize(uint32_t size) {
+    return sizeof(AliasTable) + (sizeof(float) + sizeof(uint32_t)) * size;
+  }
+};
+
+// Compile `size` weights into alias arrays of the same length. Returns
+// false when no weight is positive; negative and NaN weights count as zero.
+bool buildAlias(const double* weights, uint32_t size, float* probabilities,
+                uint32_t* aliases);
+
+// Draw a 0-based outcome from alias arrays
+uint32_t sampleAlias(const float* probabilities, const uint32_t* aliases,
+                     uint32_t size, Xoshiro256& rng);
+
+// The same for a table whose size is already set
+inline bool buildAliasTable(AliasTable& table, const double* weights) {
+  return buildAlias(weights, table.size, table.probabilities(),
+                    table.aliases());
+}
+
+inline uint32_t sampleAlias(const AliasTable& table, Xoshiro256& rng) {
+  return sampleAlias(table.probabilities(), table.aliases(), table.size, rng);
+}
+
+// Smooth 1-D value noise in [-1, 1], a pure function of seed and position:
+// random values at integer positions, blended with a quintic fade. Each
+// octave doubles the frequency and halves the amplitude.
+double valueNoise(uint64_t seed, double x, int octaves = 1);
+
+}  // namespace FLLua
@@ -0,0 +1,283 @@
+#include "rng_api.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <new>
+#include <string_view>
+#include <vector>
+
+#include "api.hpp"
+#include "disk_cache.hpp"
+#include "random.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+static const char* kRngMetatable = "FLLua.Rng";
+static const char* kWeightsMetatable = "FLLua.Weights";
+static constexpr lua_Integer kMaxWeights = 1 << 16;
+static constexpr lua_Integer kMaxOctaves = 8;
+
+// A stream and the seed it started from; noise reads only the seed, so it
+// stays a pure function of position however many draws were made
+struct RngStream {
+  Xoshiro256 rng;
+  uint64_t seed;
+};
+
+static RngStream* checkRng(lua_State* L, int arg) {
+  return static_cast<RngStream*>(luaL_checkudata(L, arg, kRngMetatable));
+}
+
+Xoshiro256* checkRngStream(lua_State* L, int arg) {
+  return &checkRng(L, arg)->rng;
+}
+
+static AliasTable* checkWeights(lua_State* L, int arg) {
+  return static_cast<AliasTable*>(
+      luaL_checkudata(L, arg, kWeightsMetatable));
+}
+
+// Stream seed for an optional integer or string key, mixed with the
+// instance seed saved in the plugin state
+static uint64_t streamSeed(lua_State* L, int arg) {
+  uint64_t key = 0;
+  if (lua_type(L, arg) == LUA_TSTRING) {
+    size_t len = 0;
+    const char* s = lua_tolstring(L, arg, &len);
+    key = contentHash(std::string_view(s, len));
+  } else if (!lua_isnoneornil(L, arg)) {
+    key = static_cast<uint64_t>(luaL_checkinteger(L, arg));
+  }
+  auto* ctx = getContext(L);
+  return mixSeed(ctx ? ctx->seed : 0, key);
+}
+
+// ctx.rng([key]) -> stream
+// Streams with the same key start from the same state in a given instance
+static int ctx_rng(lua_State* L) {
+  uint64_t seed = streamSeed(L, 1);
+  auto* stream = static_cast<RngStream*>(
+      lua_newuserdatauv(L, sizeof(RngStream), 0));
+  new (stream) RngStream{Xoshiro256(seed), seed};
+  luaL_setmetatable(L, kRngMetatable);
+  return 1;
+}
+
+// ctx.weights(weights [, values]) -> compiled table for rng:choice
+static int ctx_weights(lua_State* L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  bool hasValues = !lua_isnoneornil(L, 2);
+  if (hasValues) luaL_checktype(L, 2, LUA_TTABLE);
+
+  auto size = static_cast<lua_Integer>(lua_rawlen(L, 1));
+  luaL_argcheck(L, size > 0 && size <= kMaxWeights, 1,
+                "weight count out of range");
+  luaL_argcheck(L, !hasValues || lua_rawlen(L, 2) >= lua_rawlen(L, 1), 2,
+                "fewer values than weights");
+
+  auto* table = static_cast<AliasTable*>(lua_newuserdatauv(
+      L, AliasTable::allocationSize(static_cast<uint32_t>(size)), 1));
+  table->size = static_cast<uint32_t>(size);
+  luaL_setmetatable(L, kWeightsMetatable);
+  if (hasValues) {
+    lua_pushvalue(L, 2);
+    lua_setiuservalue(L, -2, 1);
+  }
+
+  bool valid = false;
+  {
+    std::vector<double> weights(table->size);
+    for (lua_Integer i = 1; i <= size; ++i) {
+      lua_rawgeti(L, 1, i);
+      weights[i - 1] = lua_tonumber(L, -1);
+      lua_pop(L, 1);
+    }
+    valid = buildAliasTable(*table, weights.data());
+  }
+  if (!valid) return luaL_argerror(L, 1, "no positive weight");
+  return 1;
+}
+
+static int weights_len(lua_State* L) {
+  lua_pushinteger(L, checkWeights(L, 1)->size);
+  return 1;
+}
+
+// rng:random([m [, n]]) -> same ranges as math.random
+static int rng_random(lua_State* L) {
+  auto& rng = checkRng(L, 1)->rng;
+  switch (lua_gettop(L)) {
+    case 1:
+      lua_pushnumber(L, rng.uniform());
+      return 1;
+    case 2: {
+      lua_Integer m = luaL_checkinteger(L, 2);
+      luaL_argcheck(L, m >= 1, 2, "interval is empty");
+      lua_pushinteger(
+          L, static_cast<lua_Integer>(rng.below(static_cast<uint64_t>(m))) + 1);
+      return 1;
+    }
+    default: {
+      lua_Integer low = luaL_checkinteger(L, 2);
+      lua_Integer high = luaL_checkinteger(L, 3);
+      luaL_argcheck(L, low <= high, 3, "interval is empty");
+      uint64_t span =
+          static_cast<uint64_t>(high) - static_cast<uint64_t>(low) + 1;
+      uint64_t r = span ? rng.below(span) : rng.next();
+      lua_pushinteger(
+          L, static_cast<lua_Integer>(static_cast<uint64_t>(low) + r));
+      return 1;
+    }
+  }
+}
+
+// rng:uniform([low, high]) -> float in [low, high), [0, 1) by default
+static int rng_uniform(lua_State* L) {
+  auto& rng = checkRng(L, 1)->rng;
+  double low = luaL_optnumber(L, 2, 0.0);
+  double high = luaL_optnumber(L, 3, 1.0);
+  lua_pushnumber(L, low + (high - low) * rng.uniform());
+  return 1;
+}
+
+// rng:gaussian([mean [, deviation]]) -> normally distributed float
+static int rng_gaussian(lua_State* L) {
+  auto& rng = checkRng(L, 1)->rng;
+  double mean = luaL_optnumber(L, 2, 0.0);
+  double deviation = luaL_optnumber(L, 3, 1.0);
+  lua_pushnumber(L, mean + deviation * rng.gaussian());
+  return 1;
+}
+
+// rng:humanize(value, amount) -> value plus a Gaussian offset with a
+// deviation of amount / 2, limited to +-amount. Integer values stay
+// integers (velocities, ticks).
+static int rng_humanize(lua_State* L) {
+  auto& rng = checkRng(L, 1)->rng;
+  double amount = std::abs(luaL_checknumber(L, 3));
+  double offset = std::clamp(0.5 * amount * rng.gaussian(), -amount, amount);
+  if (lua_isinteger(L, 2)) {
+    lua_pushinteger(L, lua_tointeger(L, 2) +
+                           static_cast<lua_Integer>(std::nearbyint(offset)));
+  } else {
+    lua_pushnumber(L, luaL_checknumber(L, 2) + offset);
+  }
+  return 1;
+}
+
+// rng:chance(probability) -> true with the given probability
+static int rng_chance(lua_State* L) {
+  auto& rng = checkRng(L, 1)->rng;
+  lua_pushboolean(L, rng.uniform() < luaL_checknumber(L, 2));
+  return 1;
+}
+
+// rng:choose(t) -> uniformly chosen element of t, nil when empty
+static int rng_choose(lua_State* L) {
+  auto& rng = checkRng(L, 1)->rng;
+  luaL_checktype(L, 2, LUA_TTABLE);
+  auto length = static_cast<uint64_t>(lua_rawlen(L, 2));
+  if (length == 0) return 0;
+  lua_rawgeti(L, 2, static_cast<lua_Integer>(rng.below(length)) + 1);
+  return 1;
+}
+
+// rng:choice(weights) -> value (or 1-based index) drawn from a table
+// compiled by ctx.weights, in constant time
+static int rng_choice(lua_State* L) {
+  auto& rng = checkRng(L, 1)->rng;
+  auto* table = checkWeights(L, 2);
+  lua_Integer index = static_cast<lua_Integer>(sampleAlias(*table, rng)) + 1;
+  if (lua_getiuservalue(L, 2, 1) == LUA_TTABLE) {
+    lua_rawgeti(L, -1, index);
+  } else {
+    lua_pushinteger(L, index);
+  }
+  return 1;
+}
+
+// rng:shuffle(t) -> t with its array part shuffled in place
+static int rng_shuffle(lua_State* L) {
+  auto& rng = checkRng(L, 1)->rng;
+  luaL_checktype(L, 2, LUA_TTABLE);
+  auto length = static_cast<lua_Integer>(lua_rawlen(L, 2));
+  for (lua_Integer i = length; i > 1; --i) {
+    lua_Integer j =
+        static_cast<lua_Integer>(rng.below(static_cast<uint64_t>(i))) + 1;
+    lua_rawgeti(L, 2, i);
+    lua_rawgeti(L, 2, j);
+    lua_rawseti(L, 2, i);
+    lua_rawseti(L, 2, j);
+  }
+  lua_settop(L, 2);
+  return 1;
+}
+
+// rng:noise(position [, octaves]) -> smooth value in [-1, 1]
+// Depends only on the stream's seed and the position (e.g. the beat), so
+// the same beat always gives the same value
+static int rng_noise(lua_State* L) {
+  auto* stream = checkRng(L, 1);
+  double position = luaL_checknumber(L, 2);
+  lua_Integer octaves = luaL_optinteger(L, 3, 1);
+  luaL_argcheck(L, std::abs(position) < 0x1.0p52, 2, "position out of range");
+  luaL_argcheck(L, octaves >= 1 && octaves <= kMaxOctaves, 3,
+                "octaves out of range");
+  lua_pushnumber(L, valueNoise(stream->seed, position,
+                               static_cast<int>(octaves)));
+  return 1;
+}
+
+// rng:reseed([key]) -> rng, restarted from its own seed or from a new key
+static int rng_reseed(lua_State* L) {
+  auto* stream = checkRng(L, 1);
+  if (!lua_isnoneornil(L, 2)) stream->seed = streamSeed(L, 2);
+  stream->rng.reseed(stream->seed);
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int rng_tostring(lua_State* L) {
+  auto* stream = checkRng(L, 1);
+  lua_pushfstring(L, "rng (%p)", static_cast<void*>(stream));
+  return 1;
+}
+
+void registerRngAPI(lua_State* L) {
+  static const luaL_Reg rngMethods[] = {{"random", rng_random},
+                                        {"uniform", rng_uniform},
+                                        {"gaussian", rng_gaussian},
+                                        {"humanize", rng_humanize},
+                                        {"chance", rng_chance},
+                                        {"choose", rng_choose},
+                                        {"choice", rng_choice},
+                                        {"shuffle", rng_shuffle},
+                                        {"noise", rng_noise},
+                                        {"reseed", rng_reseed},
+                                        {nullptr, nullptr}};
+  if (luaL_newmetatable(L, kRngMetatable)) {
+    luaL_newlib(L, rngMethods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, rng_tostring);
+    lua_setfield(L, -2, "__tostring");
+  }
+  lua_pop(L, 1);
+
+  if (luaL_newmetatable(L, kWeightsMetatable)) {
+    lua_pushcfunction(L, weights_len);
+    lua_setfield(L, -2, "__len");
+  }
+  lua_pop(L, 1);
+
+  lua_pushcfunction(L, ctx_rng);
+  lua_setfield(L, -2, "rng");
+  lua_pushcfunction(L, ctx_weights);
+  lua_setfield(L, -2, "weights");
+}
+
+}  // namespace FLLua
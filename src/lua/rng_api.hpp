@@ -0,0 +1,17 @@
+#pragma once
+
+struct lua_State;
+
+namespace FLLua {
+
+class Xoshiro256;
+
+// Generator of the ctx.rng stream at `arg`, raising an argument error for
+// other values. Valid while the stream userdata is alive.
+Xoshiro256* checkRngStream(lua_State* L, int arg);
+
+// Add the seeded random streams (ctx.rng, ctx.weights) to the ctx function
+// table on top of the stack
+void registerRngAPI(lua_State* L);
+
+}  // namespace FLLua
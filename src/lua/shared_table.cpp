@@ -0,0 +1,53 @@
+#include "shared_table.hpp"
+
+#include <algorithm>
+
+namespace FLLua {
+
+const SharedTable::Value* SharedTable::Node::field(
+    std::string_view key) const {
+  auto it = std::lower_bound(
+      fields.begin(), fields.end(), key,
+      [](const auto& field, std::string_view k) { return field.first < k; });
+  if (it == fields.end() || it->first != key) return nullptr;
+  return &it->second;
+}
+
+SharedTableStore& SharedTableStore::instance() {
+  static SharedTableStore store;
+  return store;
+}
+
+SharedTableStore::TableRef SharedTableStore::find(const std::string& name) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_tables.find(name);
+  return it != m_tables.end() ? it->second.lock() : nullptr;
+}
+
+SharedTableStore::TableRef SharedTableStore::insert(const std::string& name,
+                                                    TableRef table) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto& entry = m_tables[name];
+  if (auto existing = entry.lock()) return existing;
+  entry = table;
+  return table;
+}
+
+SharedTableStore::Stats SharedTableStore::stats() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Stats stats;
+  for (auto it = m_tables.begin(); it != m_tables.end();) {
+    if (auto table = it->second.lock()) {
+      int users = table->users.load(std::memory_order_relaxed);
+      ++stats.tables;
+      stats.bytes += table->bytes;
+      if (users > 1) stats.saved += table->bytes * (users - 1);
+      ++it;
+    } else {
+      it = m_tables.erase(it);
+    }
+  }
+  return stats;
+}
+
+}  // namespace FLLua
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace FLLua {
+
+// Immutable tree of plain Lua data (booleans, numbers, strings, and tables
+// with array or string keys), built once per process and read by every Lua
+// state through userdata instead of per-state copies.
+class SharedTable {
+ public:
+  struct Node;
+  using Value = std::variant<std::monostate, bool, int64_t, double,
+                             std::string, std::unique_ptr<Node>>;
+
+  struct Node {
+    std::vector<Value> array;                           // Keys 1..n
+    std::vector<std::pair<std::string, Value>> fields;  // Sorted by key
+
+    const Value* field(std::string_view key) const;
+  };
+
+  Node root;
+  size_t bytes = 0;  // Approximate native size, for the memory report
+  mutable std::atomic<int> users{0};  // Lua states holding it
+};
+
+// Process-wide shared tables by name; entries go away with their last user
+class SharedTableStore {
+ public:
+  using TableRef = std::shared_ptr<const SharedTable>;
+
+  struct Stats {
+    size_t tables = 0;
+    size_t bytes = 0;  // Held once for all states
+    size_t saved = 0;  // Copies the other states did not make
+  };
+
+  static SharedTableStore& instance();
+
+  TableRef find(const std::string& name);
+
+  // Store a freshly built table. If another state stored one under the
+  // same name first, that one is returned and used instead.
+  TableRef insert(const std::string& name, TableRef table);
+
+  Stats stats();
+
+ private:
+  std::mutex m_mutex;
+  std::unordered_map<std::string, std::weak_ptr<const SharedTable>> m_tables;
+};
+
+}  // namespace FLLua
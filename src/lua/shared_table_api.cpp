@@ -0,0 +1,305 @@
+#include "shared_table_api.hpp"
+
+#include <algorithm>
+#include <new>
+#include <string>
+#include <type_traits>
+
+#include "api.hpp"
+#include "shared_table.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+static const char* kSharedTableMetatable = "FLLua.SharedTable";
+static const char* kSharedTablesKey = "FLLua_SharedTables";
+static constexpr int kMaxDepth = 32;
+
+// Userdata view of one node; nested views keep the whole tree alive
+struct SharedTableProxy {
+  std::shared_ptr<const SharedTable> table;
+  const SharedTable::Node* node;
+  bool root;  // Counted as one Lua state using the table
+};
+
+static bool freezeValue(lua_State* L, int idx, SharedTable::Value& out,
+                        size_t& bytes, int depth, std::string& error);
+
+static bool freezeTable(lua_State* L, int idx, SharedTable::Node& node,
+                        size_t& bytes, int depth, std::string& error) {
+  if (depth > kMaxDepth) {
+    error = "tables nested too deeply (or cyclic)";
+    return false;
+  }
+  idx = lua_absindex(L, idx);
+
+  auto length = static_cast<lua_Integer>(lua_rawlen(L, idx));
+  node.array.resize(static_cast<size_t>(length));
+  for (lua_Integer i = 1; i <= length; ++i) {
+    lua_rawgeti(L, idx, i);
+    bool ok = freezeValue(L, -1, node.array[i - 1], bytes, depth, error);
+    lua_pop(L, 1);
+    if (!ok) return false;
+  }
+
+  lua_pushnil(L);
+  while (lua_next(L, idx)) {
+    if (lua_isinteger(L, -2)) {
+      lua_Integer key = lua_tointeger(L, -2);
+      if (key >= 1 && key <= length) {
+        lua_pop(L, 1);
+        continue;
+      }
+    }
+    if (lua_type(L, -2) != LUA_TSTRING) {
+      lua_pop(L, 2);
+      error = "keys must be strings or array indices";
+      return false;
+    }
+    auto& field = node.fields.emplace_back(lua_tostring(L, -2),
+                                           SharedTable::Value{});
+    bytes += field.first.size();
+    bool ok = freezeValue(L, -1, field.second, bytes, depth, error);
+    lua_pop(L, 1);
+    if (!ok) {
+      lua_pop(L, 1);
+      return false;
+    }
+  }
+
+  std::sort(node.fields.begin(), node.fields.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+  bytes += sizeof(SharedTable::Node) +
+           node.array.size() * sizeof(SharedTable::Value) +
+           node.fields.size() * sizeof(node.fields[0]);
+  return true;
+}
+
+static bool freezeValue(lua_State* L, int idx, SharedTable::Value& out,
+                        size_t& bytes, int depth, std::string& error) {
+  switch (lua_type(L, idx)) {
+    case LUA_TNIL:
+      out = std::monostate{};
+      return true;
+    case LUA_TBOOLEAN:
+      out = lua_toboolean(L, idx) != 0;
+      return true;
+    case LUA_TNUMBER:
+      if (lua_isinteger(L, idx)) {
+        out = static_cast<int64_t>(lua_tointeger(L, idx));
+      } else {
+        out = static_cast<double>(lua_tonumber(L, idx));
+      }
+      return true;
+    case LUA_TSTRING: {
+      size_t length = 0;
+      const char* s = lua_tolstring(L, idx, &length);
+      out = std::string(s, length);
+      bytes += length;
+      return true;
+    }
+    case LUA_TTABLE: {
+      auto node = std::make_unique<SharedTable::Node>();
+      if (!freezeTable(L, idx, *node, bytes, depth + 1, error)) return false;
+      out = std::move(node);
+      return true;
+    }
+    default:
+      error = std::string("cannot share a ") + luaL_typename(L, idx);
+      return false;
+  }
+}
+
+static void pushProxy(lua_State* L, std::shared_ptr<const SharedTable> table,
+                      const SharedTable::Node* node, bool root) {
+  auto* proxy = static_cast<SharedTableProxy*>(
+      lua_newuserdatauv(L, sizeof(SharedTableProxy), 0));
+  new (proxy) SharedTableProxy{std::move(table), node, root};
+  if (root) proxy->table->users.fetch_add(1, std::memory_order_relaxed);
+  luaL_setmetatable(L, kSharedTableMetatable);
+}
+
+static void pushValue(lua_State* L, const SharedTableProxy& owner,
+                      const SharedTable::Value& value) {
+  std::visit(
+      [&](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::monostate>) {
+          lua_pushnil(L);
+        } else if constexpr (std::is_same_v<T, bool>) {
+          lua_pushboolean(L, v);
+        } else if constexpr (std::is_same_v<T, int64_t>) {
+          lua_pushinteger(L, static_cast<lua_Integer>(v));
+        } else if constexpr (std::is_same_v<T, double>) {
+          lua_pushnumber(L, v);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+          lua_pushlstring(L, v.data(), v.size());
+        } else {
+          pushProxy(L, owner.table, v.get(), false);
+        }
+      },
+      value);
+}
+
+static SharedTableProxy* checkProxy(lua_State* L, int arg) {
+  return static_cast<SharedTableProxy*>(
+      luaL_checkudata(L, arg, kSharedTableMetatable));
+}
+
+static int shared_index(lua_State* L) {
+  auto* proxy = checkProxy(L, 1);
+  const auto& node = *proxy->node;
+
+  if (lua_isinteger(L, 2)) {
+    lua_Integer i = lua_tointeger(L, 2);
+    if (i >= 1 && i <= static_cast<lua_Integer>(node.array.size())) {
+      pushValue(L, *proxy, node.array[i - 1]);
+      return 1;
+    }
+  } else if (lua_type(L, 2) == LUA_TSTRING) {
+    size_t length = 0;
+    const char* key = lua_tolstring(L, 2, &length);
+    if (auto* value = node.field(std::string_view(key, length))) {
+      pushValue(L, *proxy, *value);
+      return 1;
+    }
+  }
+  lua_pushnil(L);
+  return 1;
+}
+
+static int shared_newindex(lua_State* L) {
+  return luaL_error(L, "shared tables are read-only");
+}
+
+static int shared_len(lua_State* L) {
+  auto* proxy = checkProxy(L, 1);
+  lua_pushinteger(L, static_cast<lua_Integer>(proxy->node->array.size()));
+  return 1;
+}
+
+// Iterates the array part, then the fields in key order
+static int shared_next(lua_State* L) {
+  auto* proxy = checkProxy(L, 1);
+  const auto& node = *proxy->node;
+  size_t arraySize = node.array.size();
+
+  size_t position = 0;  // Index into array followed by fields
+  if (lua_isinteger(L, 2)) {
+    position = static_cast<size_t>(lua_tointeger(L, 2));
+  } else if (lua_type(L, 2) == LUA_TSTRING) {
+    std::string_view key = lua_tostring(L, 2);
+    auto it = std::lower_bound(
+        node.fields.begin(), node.fields.end(), key,
+        [](const auto& field, std::string_view k) { return field.first < k; });
+    position = arraySize + (it - node.fields.begin()) + 1;
+  }
+
+  for (; position < arraySize + node.fields.size(); ++position) {
+    if (position < arraySize) {
+      const auto& value = node.array[position];
+      if (std::holds_alternative<std::monostate>(value)) continue;
+      lua_pushinteger(L, static_cast<lua_Integer>(position + 1));
+      pushValue(L, *proxy, value);
+    } else {
+      const auto& field = node.fields[position - arraySize];
+      if (std::holds_alternative<std::monostate>(field.second)) continue;
+      lua_pushlstring(L, field.first.data(), field.first.size());
+      pushValue(L, *proxy, field.second);
+    }
+    return 2;
+  }
+  lua_pushnil(L);
+  return 1;
+}
+
+static int shared_pairs(lua_State* L) {
+  checkProxy(L, 1);
+  lua_pushcfunction(L, shared_next);
+  lua_pushvalue(L, 1);
+  lua_pushnil(L);
+  return 3;
+}
+
+static int shared_gc(lua_State* L) {
+  auto* proxy = checkProxy(L, 1);
+  if (proxy->root) proxy->table->users.fetch_sub(1, std::memory_order_relaxed);
+  proxy->~SharedTableProxy();
+  return 0;
+}
+
+static int shared_tostring(lua_State* L) {
+  auto* proxy = checkProxy(L, 1);
+  lua_pushfstring(L, "shared table (%d items)",
+                  static_cast<int>(proxy->node->array.size() +
+                                   proxy->node->fields.size()));
+  return 1;
+}
+
+// ctx.shared_table(name, builder) -> read-only view
+// Calls builder() the first time `name` is used in the process and shares
+// the frozen result with every Lua state that asks for the same name
+static int ctx_shared_table(lua_State* L) {
+  const char* name = luaL_checkstring(L, 1);
+
+  // One view per state and name, so repeated calls are cheap
+  lua_getfield(L, LUA_REGISTRYINDEX, kSharedTablesKey);
+  if (lua_getfield(L, -1, name) != LUA_TNIL) return 1;
+  lua_pop(L, 1);
+  int cache = lua_gettop(L);
+
+  auto table = SharedTableStore::instance().find(name);
+  if (!table) {
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+    lua_pushvalue(L, 2);
+    lua_call(L, 0, 1);
+    luaL_argcheck(L, lua_istable(L, -1), 2, "builder must return a table");
+
+    // C++ state is scoped so lua_error never unwinds past it
+    bool frozen = false;
+    {
+      auto built = std::make_shared<SharedTable>();
+      std::string error;
+      frozen = freezeTable(L, -1, built->root, built->bytes, 0, error);
+      if (frozen) {
+        table = SharedTableStore::instance().insert(name, std::move(built));
+      } else {
+        lua_pushfstring(L, "shared table '%s': %s", name, error.c_str());
+      }
+    }
+    if (!frozen) return lua_error(L);
+    lua_pop(L, 1);
+  }
+
+  pushProxy(L, table, &table->root, true);
+  table.reset();
+  lua_pushvalue(L, -1);
+  lua_setfield(L, cache, name);
+  return 1;
+}
+
+void registerSharedTableAPI(lua_State* L) {
+  if (luaL_newmetatable(L, kSharedTableMetatable)) {
+    static const luaL_Reg methods[] = {{"__index", shared_index},
+                                       {"__newindex", shared_newindex},
+                                       {"__len", shared_len},
+                                       {"__pairs", shared_pairs},
+                                       {"__gc", shared_gc},
+                                       {"__tostring", shared_tostring},
+                                       {nullptr, nullptr}};
+    luaL_setfuncs(L, methods, 0);
+  }
+  lua_pop(L, 1);
+
+  lua_newtable(L);
+  lua_setfield(L, LUA_REGISTRYINDEX, kSharedTablesKey);
+
+  lua_pushcfunction(L, ctx_shared_table);
+  lua_setfield(L, -2, "shared_table");
+}
+
+}  // namespace FLLua
@@ -0,0 +1,10 @@
+#pragma once
+
+struct lua_State;
+
+namespace FLLua {
+
+// Add ctx.shared_table to the ctx function table on top of the stack
+void registerSharedTableAPI(lua_State* L);
+
+}  // namespace FLLua
@@ -0,0 +1,402 @@
+#include "solver_api.hpp"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "api.hpp"
+#include "generation/fd_solver.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+using Constraint = FdSolver::Constraint;
+
+static constexpr int kMaxDepth = 256;
+static constexpr int64_t kMaxModulus = 64;
+
+// Integer expression: sum(coef * var) + constant, or var mod modulus
+struct Expr {
+  std::vector<FdSolver::Term> terms;
+  int64_t constant = 0;
+  int modVar = -1;
+  int64_t modulus = 0;
+
+  bool isConstant() const { return terms.empty() && modVar < 0; }
+
+  void add(const Expr& other, int64_t scale) {
+    for (const auto& term : other.terms) {
+      auto it = std::find_if(terms.begin(), terms.end(),
+                             [&](const auto& t) { return t.var == term.var; });
+      if (it != terms.end()) {
+        it->coef += term.coef * scale;
+      } else {
+        terms.push_back({term.var, term.coef * scale});
+      }
+    }
+    std::erase_if(terms, [](const auto& t) { return t.coef == 0; });
+    constant += other.constant * scale;
+  }
+};
+
+struct Compiler {
+  lua_State* L;
+  int numVars;
+  std::string error;
+
+  std::string op(int idx) {
+    lua_getfield(L, idx, "op");
+    const char* s = lua_tostring(L, -1);
+    std::string result = s ? s : "";
+    lua_pop(L, 1);
+    return result;
+  }
+
+  bool fail(std::string message) {
+    if (error.empty()) error = std::move(message);
+    return false;
+  }
+
+  bool integer(int idx, const char* field, int64_t& out) {
+    lua_getfield(L, idx, field);
+    int isInteger = 0;
+    out = lua_tointegerx(L, -1, &isInteger);
+    lua_pop(L, 1);
+    return isInteger || fail(std::string("expected an integer ") + field);
+  }
+
+  // Child `i` of the node at `idx` is pushed while `fn` runs
+  template <typename Fn>
+  bool child(int idx, int i, Fn&& fn) {
+    if (lua_geti(L, idx, i) != LUA_TTABLE) {
+      lua_pop(L, 1);
+      return fail("malformed expression");
+    }
+    bool ok = fn(lua_gettop(L));
+    lua_pop(L, 1);
+    return ok;
+  }
+
+  bool expr(int idx, Expr& out, int depth) {
+    if (depth > kMaxDepth) return fail("expression nested too deeply");
+    auto name = op(idx);
+
+    if (name == "var") {
+      int64_t index = 0;
+      if (!integer(idx, "index", index)) return false;
+      if (index < 1 || index > numVars) return fail("unknown variable");
+      out.terms.push_back({static_cast<int>(index - 1), 1});
+      return true;
+    }
+    if (name == "const") return integer(idx, "value", out.constant);
+
+    Expr a, b;
+    if (!child(idx, 1, [&](int i) { return expr(i, a, depth + 1); })) {
+      return false;
+    }
+    if (name != "neg" &&
+        !child(idx, 2, [&](int i) { return expr(i, b, depth + 1); })) {
+      return false;
+    }
+    if (a.modVar >= 0 || b.modVar >= 0) {
+      return fail("a mod expression can only be compared to a constant");
+    }
+
+    if (name == "add" || name == "sub") {
+      out = std::move(a);
+      out.add(b, name == "add" ? 1 : -1);
+      return true;
+    }
+    if (name == "neg") {
+      out.add(a, -1);
+      return true;
+    }
+    if (name == "mul") {
+      if (!a.isConstant() && !b.isConstant()) {
+        return fail("only multiplication by a constant is supported");
+      }
+      if (a.isConstant()) std::swap(a, b);
+      out.add(a, b.constant);
+      return true;
+    }
+    if (name == "mod") {
+      if (a.terms.size() != 1 || a.terms[0].coef != 1 || a.constant != 0 ||
+          !b.isConstant() || b.constant < 1 || b.constant > kMaxModulus) {
+        return fail("mod needs a variable and a constant from 1 to 64");
+      }
+      out.modVar = a.terms[0].var;
+      out.modulus = b.constant;
+      return true;
+    }
+    return fail("unsupported expression '" + name + "'");
+  }
+
+  static std::string negate(const std::string& name) {
+    if (name == "eq") return "ne";
+    if (name == "ne") return "eq";
+    if (name == "lt") return "ge";
+    if (name == "ge") return "lt";
+    if (name == "le") return "gt";
+    return "le";  // gt
+  }
+
+  bool compare(int idx, std::string name, bool negated,
+               std::vector<Constraint>& out, int depth) {
+    Expr a, b;
+    if (!child(idx, 1, [&](int i) { return expr(i, a, depth + 1); }) ||
+        !child(idx, 2, [&](int i) { return expr(i, b, depth + 1); })) {
+      return false;
+    }
+    if (negated) name = negate(name);
+
+    // (var mod m) == k and ~= k filter the variable's residues
+    if (a.modVar >= 0 || b.modVar >= 0) {
+      if (b.modVar >= 0) std::swap(a, b);
+      if (!b.isConstant() || (name != "eq" && name != "ne")) {
+        return fail("a mod expression can only be compared to a constant");
+      }
+      Constraint c;
+      c.kind = Constraint::Kind::Residue;
+      c.var = a.modVar;
+      c.modulus = a.modulus;
+      if (b.constant >= 0 && b.constant < a.modulus) {
+        c.residues = uint64_t{1} << b.constant;
+      }
+      if (name == "ne") {
+        uint64_t all = a.modulus == 64 ? ~uint64_t{0}
+                                       : (uint64_t{1} << a.modulus) - 1;
+        c.residues = all & ~c.residues;
+      }
+      out.push_back(std::move(c));
+      return true;
+    }
+
+    // a - b compared to zero, as a range on the variable terms
+    a.add(b, -1);
+    int64_t k = -a.constant;
+    Constraint c;
+    c.terms = std::move(a.terms);
+    if (name == "eq") {
+      c.min = c.max = k;
+    } else if (name == "le") {
+      c.max = k;
+    } else if (name == "lt") {
+      c.max = k - 1;
+    } else if (name == "ge") {
+      c.min = k;
+    } else if (name == "gt") {
+      c.min = k + 1;
+    } else {
+      Constraint below = c, above = c;
+      below.max = k - 1;
+      above.min = k + 1;
+      c = Constraint{};
+      c.kind = Constraint::Kind::AnyOf;
+      c.alternatives = {{std::move(below)}, {std::move(above)}};
+    }
+    out.push_back(std::move(c));
+    return true;
+  }
+
+  // Append the constraints of a boolean expression (or of its negation)
+  bool condition(int idx, bool negated, std::vector<Constraint>& out,
+                 int depth) {
+    if (depth > kMaxDepth) return fail("expression nested too deeply");
+    auto name = op(idx);
+    auto count = static_cast<int>(lua_rawlen(L, idx));
+
+    if (name == "not") {
+      return child(idx, 1, [&](int i) {
+        return condition(i, !negated, out, depth + 1);
+      });
+    }
+    if (name == "eq" || name == "ne" || name == "lt" || name == "le" ||
+        name == "gt" || name == "ge") {
+      return compare(idx, name, negated, out, depth);
+    }
+    if (name != "and" && name != "or") {
+      return fail("unsupported condition '" + name + "'");
+    }
+
+    // not (a and b) == (not a) or (not b), and the other way around
+    bool conjunction = (name == "and") != negated;
+    if (conjunction) {
+      for (int i = 1; i <= count; ++i) {
+        if (!child(idx, i, [&](int c) {
+              return condition(c, negated, out, depth + 1);
+            })) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    Constraint any;
+    any.kind = Constraint::Kind::AnyOf;
+    for (int i = 1; i <= count; ++i) {
+      auto& alternative = any.alternatives.emplace_back();
+      if (!child(idx, i, [&](int c) {
+            return condition(c, negated, alternative, depth + 1);
+          })) {
+        return false;
+      }
+      if (alternative.empty()) return true;  // Always holds
+    }
+    out.push_back(simplify(std::move(any)));
+    return true;
+  }
+
+  // A disjunction of residues of one variable is a single residue set
+  static Constraint simplify(Constraint any) {
+    if (any.alternatives.empty()) return any;  // Never holds
+    if (any.alternatives.size() == 1 && any.alternatives[0].size() == 1) {
+      return std::move(any.alternatives[0][0]);
+    }
+    const auto& first = any.alternatives[0].front();
+    Constraint merged = first;
+    for (const auto& alternative : any.alternatives) {
+      if (alternative.size() != 1 ||
+          alternative[0].kind != Constraint::Kind::Residue ||
+          alternative[0].var != first.var ||
+          alternative[0].modulus != first.modulus) {
+        return any;
+      }
+      merged.residues |= alternative[0].residues;
+    }
+    return merged;
+  }
+};
+
+// Read the domain at `idx`: { min = lo, max = hi } or { values = {...} }
+static bool readDomain(lua_State* L, int idx, std::vector<int32_t>& values,
+                       std::string& error) {
+  if (lua_getfield(L, idx, "values") == LUA_TTABLE) {
+    auto count = lua_rawlen(L, -1);
+    for (lua_Integer i = 1; i <= static_cast<lua_Integer>(count); ++i) {
+      lua_rawgeti(L, -1, i);
+      values.push_back(static_cast<int32_t>(lua_tointeger(L, -1)));
+      lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+  } else {
+    lua_pop(L, 1);
+    lua_getfield(L, idx, "min");
+    lua_getfield(L, idx, "max");
+    auto min = lua_tointeger(L, -2);
+    auto max = lua_tointeger(L, -1);
+    lua_pop(L, 2);
+    if (max - min >= static_cast<lua_Integer>(FdSolver::kMaxDomain)) {
+      error = "domain too large";
+      return false;
+    }
+    for (auto v = min; v <= max; ++v) {
+      values.push_back(static_cast<int32_t>(v));
+    }
+  }
+  if (values.size() > FdSolver::kMaxDomain) {
+    error = "domain too large";
+    return false;
+  }
+  return true;
+}
+
+// solver.solve(problem) -> status, solutions, nodes
+// problem = { domains = {...}, constraints = {...}, max_solutions = 1,
+//             budget = seconds, seed = 0 }
+// status is 'sat', 'unsat' or 'unknown' (out of time before any solution)
+static int solver_solve(lua_State* L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+
+  // Searches can take seconds; keep them off the audio thread
+  auto* ctx = getContext(L);
+  if (ctx && ctx->async) {
+    return luaL_error(
+        L, "the solver runs on workers only: call it through ctx.async");
+  }
+
+  lua_getfield(L, 1, "max_solutions");
+  lua_getfield(L, 1, "budget");
+  lua_getfield(L, 1, "seed");
+  FdSolver::Options options;
+  options.maxSolutions = static_cast<int>(luaL_optinteger(L, -3, 1));
+  options.budgetSeconds = luaL_optnumber(L, -2, 1.0);
+  options.seed = static_cast<uint64_t>(luaL_optinteger(L, -1, 0));
+  lua_pop(L, 3);
+  if (options.maxSolutions < 1) options.maxSolutions = 1;
+
+  luaL_argcheck(L, lua_getfield(L, 1, "domains") == LUA_TTABLE, 1,
+                "domains missing");
+  luaL_argcheck(L, lua_getfield(L, 1, "constraints") == LUA_TTABLE, 1,
+                "constraints missing");
+  int domains = lua_gettop(L) - 1;
+  int constraints = lua_gettop(L);
+
+  // C++ state is scoped so lua_error never unwinds past it
+  bool ok = true;
+  {
+    FdSolver solver;
+    std::string error;
+    auto numVars = static_cast<lua_Integer>(lua_rawlen(L, domains));
+    for (lua_Integer i = 1; i <= numVars && ok; ++i) {
+      std::vector<int32_t> values;
+      lua_rawgeti(L, domains, i);
+      ok = lua_istable(L, -1) && readDomain(L, lua_gettop(L), values, error);
+      lua_pop(L, 1);
+      if (ok) solver.addVariable(std::move(values));
+    }
+
+    Compiler compiler{L, static_cast<int>(numVars), {}};
+    auto count = static_cast<lua_Integer>(lua_rawlen(L, constraints));
+    for (lua_Integer i = 1; i <= count && ok; ++i) {
+      std::vector<Constraint> parts;
+      ok = compiler.child(constraints, static_cast<int>(i), [&](int c) {
+        return compiler.condition(c, false, parts, 0);
+      });
+      for (auto& part : parts) solver.add(std::move(part));
+    }
+    if (!compiler.error.empty()) error = compiler.error;
+
+    if (!ok) {
+      lua_pushfstring(L, "solver: %s",
+                      error.empty() ? "malformed problem" : error.c_str());
+    } else {
+      auto result = solver.solve(options);
+      static const char* kStatus[] = {"sat", "unsat", "unknown"};
+      lua_pushstring(L, kStatus[static_cast<int>(result.status)]);
+      lua_createtable(L, static_cast<int>(result.solutions.size()), 0);
+      for (size_t s = 0; s < result.solutions.size(); ++s) {
+        const auto& solution = result.solutions[s];
+        lua_createtable(L, static_cast<int>(solution.size()), 0);
+        for (size_t v = 0; v < solution.size(); ++v) {
+          lua_pushinteger(L, solution[v]);
+          lua_rawseti(L, -2, static_cast<lua_Integer>(v + 1));
+        }
+        lua_rawseti(L, -2, static_cast<lua_Integer>(s + 1));
+      }
+      lua_pushinteger(L, result.nodes);
+    }
+  }
+  if (!ok) return lua_error(L);
+  return 3;
+}
+
+static int luaopen_solver(lua_State* L) {
+  static const luaL_Reg solverFunctions[] = {{"solve", solver_solve},
+                                             {nullptr, nullptr}};
+  luaL_newlib(L, solverFunctions);
+  return 1;
+}
+
+void preloadSolverModule(lua_State* L) {
+  luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_PRELOAD_TABLE);
+  lua_pushcfunction(L, luaopen_solver);
+  lua_setfield(L, -2, "fllua.solver");
+  lua_pop(L, 1);
+}
+
+}  // namespace FLLua
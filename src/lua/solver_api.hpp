@@ -0,0 +1,12 @@
+#pragma once
+
+struct lua_State;
+
+namespace FLLua {
+
+// Make the native finite-domain solver available as
+// require('fllua.solver'), the backend of musica.generation when z3 is
+// not installed
+void preloadSolverModule(lua_State* L);
+
+}  // namespace FLLua
@@ -0,0 +1,229 @@
+#include "task_api.hpp"
+
+#include <algorithm>
+
+#include "api.hpp"
+#include "task_scheduler.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+static const char* kTasksKey = "FLLua_Tasks";        // id -> thread
+static const char* kTaskPoolKey = "FLLua_TaskPool";  // idle threads
+static constexpr lua_Integer kMaxPooledTasks = 64;
+
+// Yielded by ctx.wait so nested coroutines can tell a task wait apart from
+// an ordinary generator yield
+static char kWaitSentinel;
+
+// coroutine.resume/wrap replacements: when a nested coroutine yields the
+// wait sentinel, yield it further up to the task's root coroutine and hand
+// the resume values (sample offset, beat) back down on wake-up.
+static const char* kCoroutinePrelude = R"(
+  local WAIT = ...
+  local create, resume, yield = coroutine.create, coroutine.resume,
+    coroutine.yield
+  local isyieldable = coroutine.isyieldable
+
+  local function forward(co, ok, ...)
+    if ok and (...) == WAIT and isyieldable() then
+      return forward(co, resume(co, yield(WAIT)))
+    end
+    return ok, ...
+  end
+
+  coroutine.resume = function(co, ...)
+    return forward(co, resume(co, ...))
+  end
+
+  coroutine.wrap = function(fn)
+    local co = create(fn)
+    local function unwrap(ok, ...)
+      if not ok then error((...), 0) end
+      return ...
+    end
+    return function(...)
+      return unwrap(coroutine.resume(co, ...))
+    end
+  end
+)";
+
+// Return a finished or cancelled task's coroutine to the pool
+static void releaseTask(lua_State* L, int id) {
+  lua_getfield(L, LUA_REGISTRYINDEX, kTasksKey);
+  if (lua_rawgeti(L, -1, id) == LUA_TTHREAD) {
+    lua_State* co = lua_tothread(L, -1);
+    lua_closethread(co, L);
+
+    lua_getfield(L, LUA_REGISTRYINDEX, kTaskPoolKey);
+    lua_Integer pooled = luaL_len(L, -1);
+    if (pooled < kMaxPooledTasks) {
+      lua_pushvalue(L, -2);
+      lua_rawseti(L, -2, pooled + 1);
+    }
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+
+  lua_pushnil(L);
+  lua_rawseti(L, -2, id);
+  lua_pop(L, 1);
+}
+
+// Schedule the running task and suspend it until the wake beat
+static int waitUntil(lua_State* L, PluginContext* ctx, double beat,
+                     bool relative) {
+  auto* tasks = ctx->tasks;
+  tasks->schedule(tasks->current, beat, relative);
+  tasks->waited = true;
+  lua_pushlightuserdata(L, &kWaitSentinel);
+  return lua_yield(L, 1);
+}
+
+static PluginContext* checkTaskContext(lua_State* L, const char* name) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->tasks || ctx->tasks->current == 0) {
+    luaL_error(L, "%s can only be called from a ctx.spawn task", name);
+  }
+  return ctx;
+}
+
+// ctx.spawn(fn, ...) -> task id
+static int ctx_spawn(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->tasks) return 0;
+
+  luaL_checktype(L, 1, LUA_TFUNCTION);
+  int nargs = lua_gettop(L);
+
+  // Reuse a pooled coroutine when possible
+  lua_getfield(L, LUA_REGISTRYINDEX, kTaskPoolKey);
+  lua_Integer pooled = luaL_len(L, -1);
+  lua_State* co = nullptr;
+  if (pooled > 0) {
+    lua_rawgeti(L, -1, pooled);
+    co = lua_tothread(L, -1);
+    lua_pushnil(L);
+    lua_rawseti(L, -3, pooled);
+  } else {
+    co = lua_newthread(L);
+  }
+
+  for (int i = 1; i <= nargs; ++i) lua_pushvalue(L, i);
+  lua_xmove(L, co, nargs);
+
+  int id = ctx->tasks->nextId();
+  lua_getfield(L, LUA_REGISTRYINDEX, kTasksKey);
+  lua_pushvalue(L, -2);
+  lua_rawseti(L, -2, id);
+  lua_pop(L, 3);
+
+  // Start on the next resume pass (later in this block if it is due)
+  ctx->tasks->schedule(id, ctx->eventBeat(), true);
+  lua_pushinteger(L, id);
+  return 1;
+}
+
+// ctx.wait(beats) -> sample_offset, beat
+static int ctx_wait(lua_State* L) {
+  auto* ctx = checkTaskContext(L, "ctx.wait");
+  double beats = std::max(luaL_checknumber(L, 1), 0.0);
+  return waitUntil(L, ctx, ctx->tasks->currentBeat + beats, true);
+}
+
+// ctx.wait_until(beat) -> sample_offset, beat
+static int ctx_wait_until(lua_State* L) {
+  auto* ctx = checkTaskContext(L, "ctx.wait_until");
+  return waitUntil(L, ctx, luaL_checknumber(L, 1), false);
+}
+
+// ctx.cancel(task_id)
+static int ctx_cancel(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (!ctx || !ctx->tasks) return 0;
+
+  int id = static_cast<int>(luaL_checkinteger(L, 1));
+  if (id == ctx->tasks->current) {
+    return luaL_error(L, "a task cannot cancel itself; return instead");
+  }
+  ctx->tasks->cancel(id);
+  releaseTask(L, id);
+  return 0;
+}
+
+void registerTaskAPI(lua_State* L) {
+  lua_newtable(L);
+  lua_setfield(L, LUA_REGISTRYINDEX, kTasksKey);
+  lua_newtable(L);
+  lua_setfield(L, LUA_REGISTRYINDEX, kTaskPoolKey);
+
+  if (luaL_loadstring(L, kCoroutinePrelude) == LUA_OK) {
+    lua_pushlightuserdata(L, &kWaitSentinel);
+    if (lua_pcall(L, 1, 0, 0) != LUA_OK) lua_pop(L, 1);
+  } else {
+    lua_pop(L, 1);
+  }
+
+  static const luaL_Reg taskFunctions[] = {{"spawn", ctx_spawn},
+                                           {"wait", ctx_wait},
+                                           {"wait_until", ctx_wait_until},
+                                           {"cancel", ctx_cancel},
+                                           {nullptr, nullptr}};
+  luaL_setfuncs(L, taskFunctions, 0);
+}
+
+std::string resumeDueTasks(lua_State* L, PluginContext* ctx) {
+  auto* tasks = ctx->tasks;
+  const auto& transport = ctx->transport;
+  double blockEnd = transport.blockEndBeat();
+  std::string errors;
+
+  TaskScheduler::Wake wake;
+  while (tasks->popDue(blockEnd, wake)) {
+    lua_getfield(L, LUA_REGISTRYINDEX, kTasksKey);
+    bool alive = lua_rawgeti(L, -1, wake.task) == LUA_TTHREAD;
+    lua_State* co = alive ? lua_tothread(L, -1) : nullptr;
+    lua_pop(L, 2);  // The tasks table keeps the thread alive
+    if (!co) continue;
+
+    // Overdue wakes (e.g. spawned while stopped) run at the block start
+    tasks->currentBeat = std::max(wake.beat, transport.beat);
+    ctx->sampleOffset = transport.sampleOffsetFor(wake.beat);
+    tasks->current = wake.task;
+    tasks->waited = false;
+
+    int nargs = 0;
+    if (lua_status(co) == LUA_YIELD) {
+      lua_pushinteger(co, ctx->sampleOffset);
+      lua_pushnumber(co, tasks->currentBeat);
+      nargs = 2;
+    } else {
+      nargs = lua_gettop(co) - 1;  // Fresh task: function + spawn args
+    }
+
+    int nres = 0;
+    int status = lua_resume(co, L, nargs, &nres);
+    tasks->current = 0;
+
+    if (status == LUA_YIELD) {
+      lua_pop(co, nres);
+      if (tasks->waited) continue;
+      errors += "task yielded without ctx.wait\n";
+    } else if (status != LUA_OK) {
+      const char* msg = lua_tostring(co, -1);
+      errors += msg ? msg : "task error";
+      errors += '\n';
+    }
+    releaseTask(L, wake.task);
+  }
+
+  ctx->sampleOffset = 0;
+  if (!errors.empty()) errors.pop_back();
+  return errors;
+}
+
+}  // namespace FLLua
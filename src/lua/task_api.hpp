@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+struct lua_State;
+
+namespace FLLua {
+
+struct PluginContext;
+
+// Add ctx.spawn/wait/wait_until/cancel to the ctx function table on top of
+// the stack, and make coroutine.resume/wrap forward task waits so that
+// nested coroutines (including llx.coroutine helpers) can call ctx.wait.
+void registerTaskAPI(lua_State* L);
+
+// Resume every task whose wake beat falls inside the current block.
+// Returns error messages (one per line), empty on success.
+std::string resumeDueTasks(lua_State* L, PluginContext* ctx);
+
+}  // namespace FLLua
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace FLLua {
+
+// Native wake queue for ctx.spawn tasks. Tasks are identified by the id
+// handed out to Lua; the Lua side maps ids to pooled coroutines. The audio
+// thread checks nextWake() against the block end without entering Lua.
+class TaskScheduler {
+ public:
+  struct Wake {
+    double beat = 0.0;
+    int task = 0;
+    bool relative = true;  // ctx.wait (follows jumps) vs ctx.wait_until
+    uint64_t seq = 0;      // FIFO order for tasks due on the same beat
+  };
+
+  TaskScheduler() { m_heap.reserve(256); }
+
+  void schedule(int task, double beat, bool relative) {
+    m_heap.push_back(Wake{beat, task, relative, m_seq++});
+    std::push_heap(m_heap.begin(), m_heap.end(), later);
+  }
+
+  bool hasDue(double beforeBeat) const {
+    return !m_heap.empty() && m_heap.front().beat < beforeBeat;
+  }
+
+  bool popDue(double beforeBeat, Wake& out) {
+    if (!hasDue(beforeBeat)) return false;
+    std::pop_heap(m_heap.begin(), m_heap.end(), later);
+    out = m_heap.back();
+    m_heap.pop_back();
+    return true;
+  }
+
+  void cancel(int task) {
+    std::erase_if(m_heap, [task](const Wake& w) { return w.task == task; });
+    std::make_heap(m_heap.begin(), m_heap.end(), later);
+  }
+
+  // Shift relative waits after the playhead jumped or FL looped, so a
+  // ctx.wait(1) still wakes one beat after the new position.
+  void rebase(double deltaBeats) {
+    for (auto& w : m_heap) {
+      if (w.relative) w.beat += deltaBeats;
+    }
+    std::make_heap(m_heap.begin(), m_heap.end(), later);
+  }
+
+  void clear() {
+    m_heap.clear();
+    m_nextId = 0;
+    current = 0;
+    currentBeat = 0.0;
+    waited = false;
+  }
+
+  int nextId() { return ++m_nextId; }
+  size_t size() const { return m_heap.size(); }
+
+  int current = 0;           // Task being resumed, 0 outside of tasks
+  double currentBeat = 0.0;  // Exact wake beat of the running task
+  bool waited = false;       // Set by ctx.wait during the current resume
+
+ private:
+  static bool later(const Wake& a, const Wake& b) {
+    if (a.beat != b.beat) return a.beat > b.beat;
+    return a.seq > b.seq;
+  }
+
+  std::vector<Wake> m_heap;
+  uint64_t m_seq = 0;
+  int m_nextId = 0;
+};
+
+}  // namespace FLLua
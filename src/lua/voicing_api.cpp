@@ -0,0 +1,217 @@
+#include "voicing_api.hpp"
+
+#include <new>
+#include <string>
+#include <vector>
+
+#include "api.hpp"
+#include "generation/voice_leader.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+}
+
+namespace FLLua {
+
+static const char* kVoiceLeaderMetatable = "FLLua.VoiceLeader";
+
+static VoiceLeader* checkLeader(lua_State* L, int arg) {
+  return static_cast<VoiceLeader*>(
+      luaL_checkudata(L, arg, kVoiceLeaderMetatable));
+}
+
+// Enumerating and searching voicings can take long; keep it off the audio
+// thread. A leader kept in the worker state still solves incrementally
+// across jobs.
+static void checkWorker(lua_State* L) {
+  auto* ctx = getContext(L);
+  if (ctx && ctx->async) {
+    luaL_error(L,
+               "voicing runs on workers only: call it through ctx.async");
+  }
+}
+
+static int optIntField(lua_State* L, int idx, const char* key, int def) {
+  lua_getfield(L, idx, key);
+  auto value = static_cast<int>(luaL_optinteger(L, -1, def));
+  lua_pop(L, 1);
+  return value;
+}
+
+// Array field of 0-based chord tone indices as a bit mask
+static uint32_t optMaskField(lua_State* L, int idx, const char* key,
+                             uint32_t def) {
+  if (lua_getfield(L, idx, key) != LUA_TTABLE) {
+    lua_pop(L, 1);
+    return def;
+  }
+  uint32_t mask = 0;
+  lua_Integer count = luaL_len(L, -1);
+  for (lua_Integer i = 1; i <= count; ++i) {
+    lua_geti(L, -1, i);
+    lua_Integer tone = luaL_checkinteger(L, -1);
+    if (tone >= 0 && tone < 12) mask |= 1u << tone;
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+  return mask;
+}
+
+// voicing.new([options]) -> leader
+// options: low, high, voices, max_leap, max_spacing, root_in_bass,
+// doubled, omit, center
+static int voicing_new(lua_State* L) {
+  VoiceLeader::Options options;
+  if (lua_istable(L, 1)) {
+    options.low = optIntField(L, 1, "low", options.low);
+    options.high = optIntField(L, 1, "high", options.high);
+    options.voices = optIntField(L, 1, "voices", options.voices);
+    options.maxLeap = optIntField(L, 1, "max_leap", options.maxLeap);
+    options.maxSpacing = optIntField(L, 1, "max_spacing", options.maxSpacing);
+    options.center = optIntField(L, 1, "center", options.center);
+    lua_getfield(L, 1, "root_in_bass");
+    options.rootInBass = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    options.doubled = optMaskField(L, 1, "doubled", options.doubled);
+    options.omitted = optMaskField(L, 1, "omit", options.omitted);
+  }
+  luaL_argcheck(L, options.low >= 0 && options.high <= 127 &&
+                       options.low <= options.high,
+                1, "range out of bounds");
+  luaL_argcheck(L,
+                options.voices >= 1 &&
+                    options.voices <= VoiceLeader::kMaxVoices,
+                1, "voices out of range");
+  luaL_argcheck(
+      L, options.maxLeap >= 0 && options.maxLeap <= VoiceLeader::kMaxLeap, 1,
+      "max_leap out of range");
+
+  auto* leader = static_cast<VoiceLeader*>(
+      lua_newuserdatauv(L, sizeof(VoiceLeader), 0));
+  new (leader) VoiceLeader(options);
+  luaL_setmetatable(L, kVoiceLeaderMetatable);
+  return 1;
+}
+
+// leader:set(index, pitches) -> leader
+// Place the chord with these MIDI pitches (root first) at `index`, at most
+// one past the end. Chords after it keep their place; changing the last
+// chord only re-solves that step.
+static int leader_set(lua_State* L) {
+  auto* leader = checkLeader(L, 1);
+  lua_Integer index = luaL_checkinteger(L, 2);
+  luaL_checktype(L, 3, LUA_TTABLE);
+  luaL_argcheck(
+      L, index >= 1 && index <= static_cast<lua_Integer>(leader->size()) + 1,
+      2, "index out of range");
+  checkWorker(L);
+
+  // Read the pitches before any C++ state exists
+  int pitches[12];
+  lua_Integer count = luaL_len(L, 3);
+  luaL_argcheck(L, count >= 1 && count <= 12, 3, "a chord has 1-12 tones");
+  for (lua_Integer i = 1; i <= count; ++i) {
+    lua_geti(L, 3, i);
+    int isInteger = 0;
+    lua_Integer pitch = lua_tointegerx(L, -1, &isInteger);
+    if (!isInteger) {
+      return luaL_error(L, "voicing: chord %d: pitch %d is not an integer",
+                        static_cast<int>(index), static_cast<int>(i));
+    }
+    pitches[i - 1] = static_cast<int>(pitch);
+    lua_pop(L, 1);
+  }
+
+  // C++ state is scoped so lua_error never unwinds past it
+  bool ok = true;
+  {
+    VoiceLeader::Chord chord(pitches, pitches + count);
+    auto error = leader->set(static_cast<size_t>(index - 1), chord);
+    if (!error.empty()) {
+      lua_pushfstring(L, "voicing: chord %d: %s", static_cast<int>(index),
+                      error.c_str());
+      ok = false;
+    }
+  }
+  if (!ok) return lua_error(L);
+  lua_settop(L, 1);
+  return 1;
+}
+
+// leader:truncate(count) -> leader, keeping the first `count` chords
+static int leader_truncate(lua_State* L) {
+  auto* leader = checkLeader(L, 1);
+  lua_Integer count = luaL_checkinteger(L, 2);
+  luaL_argcheck(L, count >= 0, 2, "count must not be negative");
+  leader->truncate(static_cast<size_t>(count));
+  lua_settop(L, 1);
+  return 1;
+}
+
+// leader:solve() -> voicings, motion | nil, error
+// One array of ascending MIDI pitches per chord, and the semitones the
+// voices move in total
+static int leader_solve(lua_State* L) {
+  auto* leader = checkLeader(L, 1);
+  checkWorker(L);
+  std::vector<std::vector<uint8_t>> voicings;
+  int64_t motion = 0;
+  auto error = leader->solve(voicings, motion);
+  if (!error.empty()) {
+    lua_pushnil(L);
+    lua_pushstring(L, error.c_str());
+    return 2;
+  }
+  lua_createtable(L, static_cast<int>(voicings.size()), 0);
+  for (size_t i = 0; i < voicings.size(); ++i) {
+    lua_createtable(L, static_cast<int>(voicings[i].size()), 0);
+    for (size_t v = 0; v < voicings[i].size(); ++v) {
+      lua_pushinteger(L, voicings[i][v]);
+      lua_rawseti(L, -2, static_cast<lua_Integer>(v + 1));
+    }
+    lua_rawseti(L, -2, static_cast<lua_Integer>(i + 1));
+  }
+  lua_pushinteger(L, motion);
+  return 2;
+}
+
+static int leader_len(lua_State* L) {
+  lua_pushinteger(L, static_cast<lua_Integer>(checkLeader(L, 1)->size()));
+  return 1;
+}
+
+static int leader_gc(lua_State* L) {
+  checkLeader(L, 1)->~VoiceLeader();
+  return 0;
+}
+
+static int luaopen_voicing(lua_State* L) {
+  static const luaL_Reg leaderMethods[] = {{"set", leader_set},
+                                           {"truncate", leader_truncate},
+                                           {"solve", leader_solve},
+                                           {nullptr, nullptr}};
+  if (luaL_newmetatable(L, kVoiceLeaderMetatable)) {
+    luaL_newlib(L, leaderMethods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, leader_len);
+    lua_setfield(L, -2, "__len");
+    lua_pushcfunction(L, leader_gc);
+    lua_setfield(L, -2, "__gc");
+  }
+  lua_pop(L, 1);
+
+  static const luaL_Reg voicingFunctions[] = {{"new", voicing_new},
+                                              {nullptr, nullptr}};
+  luaL_newlib(L, voicingFunctions);
+  return 1;
+}
+
+void preloadVoicingModule(lua_State* L) {
+  luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_PRELOAD_TABLE);
+  lua_pushcfunction(L, luaopen_voicing);
+  lua_setfield(L, -2, "fllua.voicing");
+  lua_pop(L, 1);
+}
+
+}  // namespace FLLua
@@ -0,0 +1,11 @@
+#pragma once
+
+struct lua_State;
+
+namespace FLLua {
+
+// Make the native voice-leading solver available as
+// require('fllua.voicing'), the engine of musica.voice_leading
+void preloadVoicingModule(lua_State* L);
+
+}  // namespace FLLua
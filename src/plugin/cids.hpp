@@ -13,4 +13,16 @@ static const Steinberg::FUID kControllerUID(0x2B3C4D5E, 0x6F708192, 0xA3B4C5D6,
 
 #define FLLuaVST3Category "Instrument"
 
+// Host-automatable macro parameters, read by scripts through ctx.param
+static constexpr Steinberg::Vst::ParamID kMacroParamFirst = 0;
+static constexpr int kNumMacroParams = 8;
+
+// Independent scripts per instance, each with its own Lua state
+static constexpr int kMaxScriptLayers = 4;
+
+// Version of the chunk stored after the first layer's script in the state:
+// 1 adds the macro parameter values, 2 the other layers' scripts, 3 the
+// instance's random seed
+static constexpr Steinberg::int32 kStateVersion = 3;
+
 }  // namespace FLLua
@@ -1,9 +1,12 @@
 #include "controller.hpp"
 
+#include <algorithm>
 #include <cstring>
 
 #include "base/source/fstreamer.h"
 #include "cids.hpp"
+#include "lua/chunk_cache.hpp"
+#include "lua/shared_table.hpp"
 #include "pluginterfaces/base/ibstream.h"
 #include "plugview.hpp"
 
@@ -13,6 +16,15 @@ Steinberg::tresult PLUGIN_API
 FLLuaController::initialize(Steinberg::FUnknown* context) {
   auto result = EditController::initialize(context);
   if (result != Steinberg::kResultOk) return result;
+
+  static const Steinberg::Vst::TChar* kMacroNames[kNumMacroParams] = {
+      STR16("Macro 1"), STR16("Macro 2"), STR16("Macro 3"), STR16("Macro 4"),
+      STR16("Macro 5"), STR16("Macro 6"), STR16("Macro 7"), STR16("Macro 8")};
+  for (int i = 0; i < kNumMacroParams; ++i) {
+    parameters.addParameter(kMacroNames[i], nullptr, 0, 0.0,
+                            Steinberg::Vst::ParameterInfo::kCanAutomate,
+                            kMacroParamFirst + i);
+  }
   return Steinberg::kResultOk;
 }
 
@@ -43,12 +55,25 @@ FLLuaController::setComponentState(Steinberg::IBStream* state) {
     // Store it for later - the view will read it
   }
 
+  // Macro parameter values follow the script (absent in older states)
+  Steinberg::int32 version = 0;
+  Steinberg::int32 count = 0;
+  if (streamer.readInt32(version) && version >= 1 &&
+      streamer.readInt32(count)) {
+    for (Steinberg::int32 i = 0; i < count; ++i) {
+      double value = 0.0;
+      if (!streamer.readDouble(value)) break;
+      if (i < kNumMacroParams) setParamNormalized(kMacroParamFirst + i, value);
+    }
+  }
+
   return Steinberg::kResultOk;
 }
 
-void FLLuaController::sendScript(const std::string& source) {
+void FLLuaController::sendScript(int layer, const std::string& source) {
   if (auto* msg = allocateMessage()) {
     msg->setMessageID("ScriptSource");
+    msg->getAttributes()->setInt("layer", layer);
     msg->getAttributes()->setBinary(
         "source", source.data(), static_cast<Steinberg::uint32>(source.size()));
     sendMessage(msg);
@@ -82,9 +107,69 @@ FLLuaController::notify(Steinberg::Vst::IMessage* message) {
     return Steinberg::kResultOk;
   }
 
+  if (strcmp(message->getMessageID(), "LayerStats") == 0) {
+    const void* data = nullptr;
+    Steinberg::uint32 size = 0;
+    if (message->getAttributes()->getBinary("load", data, size) ==
+        Steinberg::kResultOk) {
+      std::lock_guard<std::mutex> lock(m_logMutex);
+      std::memcpy(m_layerLoad.data(), data,
+                  std::min<size_t>(size, sizeof(m_layerLoad)));
+    }
+    if (message->getAttributes()->getBinary("jobs", data, size) ==
+        Steinberg::kResultOk) {
+      std::lock_guard<std::mutex> lock(m_logMutex);
+      std::memcpy(m_layerJobs.data(), data,
+                  std::min<size_t>(size, sizeof(m_layerJobs)));
+    }
+    return Steinberg::kResultOk;
+  }
+
+  if (strcmp(message->getMessageID(), "MemoryStats") == 0) {
+    const void* data = nullptr;
+    Steinberg::uint32 size = 0;
+    if (message->getAttributes()->getBinary("stats", data, size) ==
+            Steinberg::kResultOk &&
+        size == sizeof(LuaMemoryStats)) {
+      LuaMemoryStats stats;
+      std::memcpy(&stats, data, size);
+      auto chunks = ChunkCache::instance().stats();
+      auto tables = SharedTableStore::instance().stats();
+      stats.sharedBytes = static_cast<int64_t>(chunks.bytes + tables.bytes);
+      stats.savedBytes = static_cast<int64_t>(tables.saved);
+      stats.cacheHits = static_cast<int64_t>(chunks.hits);
+
+      std::lock_guard<std::mutex> lock(m_logMutex);
+      m_memoryStats = stats;
+    }
+    return Steinberg::kResultOk;
+  }
+
+  if (strcmp(message->getMessageID(), "LatencyChanged") == 0) {
+    if (componentHandler) {
+      componentHandler->restartComponent(Steinberg::Vst::kLatencyChanged);
+    }
+    return Steinberg::kResultOk;
+  }
+
   return EditController::notify(message);
 }
 
+std::array<float, kMaxScriptLayers> FLLuaController::getLayerLoad() {
+  std::lock_guard<std::mutex> lock(m_logMutex);
+  return m_layerLoad;
+}
+
+std::array<int32_t, kMaxScriptLayers> FLLuaController::getLayerJobs() {
+  std::lock_guard<std::mutex> lock(m_logMutex);
+  return m_layerJobs;
+}
+
+LuaMemoryStats FLLuaController::getMemoryStats() {
+  std::lock_guard<std::mutex> lock(m_logMutex);
+  return m_memoryStats;
+}
+
 std::vector<std::string> FLLuaController::drainLogMessages() {
   std::lock_guard<std::mutex> lock(m_logMutex);
   std::vector<std::string> logs;
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <mutex>
 #include <string>
 #include <vector>
 
+#include "cids.hpp"
+#include "lua/memory_report.hpp"
 #include "public.sdk/source/vst/vsteditcontroller.h"
 
 namespace FLLua {
@@ -24,8 +28,8 @@ class FLLuaController : public Steinberg::Vst::EditController {
   Steinberg::tresult PLUGIN_API
   notify(Steinberg::Vst::IMessage* message) override;
 
-  // Send a script source to the processor
-  void sendScript(const std::string& source);
+  // Send a script source to one of the processor's layers
+  void sendScript(int layer, const std::string& source);
 
   // Send lua_libs path to the processor
   void sendLuaLibsPath(const std::string& path);
@@ -33,9 +37,21 @@ class FLLuaController : public Steinberg::Vst::EditController {
   // Drain pending log messages (called from UI thread)
   std::vector<std::string> drainLogMessages();
 
+  // Share of real time each layer's script took, last reported
+  std::array<float, kMaxScriptLayers> getLayerLoad();
+
+  // ctx.async jobs queued or running per layer
+  std::array<int32_t, kMaxScriptLayers> getLayerJobs();
+
+  // Lua memory last reported by the processor
+  LuaMemoryStats getMemoryStats();
+
  private:
   std::mutex m_logMutex;
   std::vector<std::string> m_pendingLogs;
+  std::array<float, kMaxScriptLayers> m_layerLoad{};
+  std::array<int32_t, kMaxScriptLayers> m_layerJobs{};
+  LuaMemoryStats m_memoryStats;
 };
 
 }  // namespace FLLua
@@ -14,6 +14,9 @@ extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd,
 
 namespace FLLua {
 
+static_assert(Editor::kLayers == kMaxScriptLayers,
+              "the editor shows one tab per script layer");
+
 static const wchar_t* kWindowClassName = L"FLLuaEditorWindow";
 
 FLLuaPlugView::FLLuaPlugView(FLLuaController* controller)
@@ -68,16 +71,16 @@ FLLuaPlugView::attached(void* parent, Steinberg::FIDString type) {
   m_editor.init();
 
   // Set up callbacks
-  m_editor.setRunCallback([this](const std::string& source) {
+  m_editor.setRunCallback([this](int layer, const std::string& source) {
     if (m_controller) {
-      m_controller->sendScript(source);
+      m_controller->sendScript(layer, source);
     }
   });
 
-  m_editor.setStopCallback([this]() {
+  m_editor.setStopCallback([this](int layer) {
     if (m_controller) {
       // Send empty script to stop
-      m_controller->sendScript("");
+      m_controller->sendScript(layer, "");
     }
   });
 
@@ -181,6 +184,9 @@ void FLLuaPlugView::renderFrame() {
     for (auto& msg : m_controller->drainLogMessages()) {
       m_editor.getConsole().addMessage(msg);
     }
+    m_editor.setLayerLoad(m_controller->getLayerLoad());
+    m_editor.setLayerJobs(m_controller->getLayerJobs());
+    m_editor.setMemoryStats(m_controller->getMemoryStats());
   }
 
   // Render the editor as a fullscreen window
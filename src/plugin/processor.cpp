@@ -1,10 +1,18 @@
 #include "processor.hpp"
 
+#include <fmt/format.h>
+
 #include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <random>
+#include <thread>
 
 #include "base/source/fstreamer.h"
 #include "cids.hpp"
+#include "lua/disk_cache.hpp"
+#include "lua/memory_report.hpp"
+#include "lua/random.hpp"
 #include "pluginterfaces/base/ibstream.h"
 #include "pluginterfaces/vst/ivstevents.h"
 #include "pluginterfaces/vst/ivstmidicontrollers.h"
@@ -13,7 +21,27 @@
 
 namespace FLLua {
 
-FLLuaProcessor::FLLuaProcessor() { setControllerClass(kControllerUID); }
+static_assert(kNumMacroParams == ParamSnapshot::kNumParams,
+              "macro parameters and the script snapshot must match");
+
+// Notes held longer than this are reported to the console once
+static constexpr double kStuckNoteSeconds = 30.0;
+
+// A layer's script calls fail once the block has taken this many block
+// lengths of real time, so a slow layer cannot hold up the others for long
+static constexpr double kLayerDeadlineBlocks = 1.0;
+static constexpr double kMinLayerDeadlineSeconds = 0.002;
+
+// How often per-layer script load is sent to the editor
+static constexpr double kLayerStatsSeconds = 1.0;
+
+FLLuaProcessor::FLLuaProcessor() {
+  setControllerClass(kControllerUID);
+
+  // New instances get their own seed; saved projects restore theirs
+  std::random_device device;
+  m_seed = (static_cast<uint64_t>(device()) << 32) ^ device();
+}
 
 FLLuaProcessor::~FLLuaProcessor() = default;
 
@@ -25,7 +53,8 @@ FLLuaProcessor::initialize(Steinberg::FUnknown* context) {
   // Add a dummy stereo audio output (required for some hosts)
   addAudioOutput(STR16("Stereo Out"), Steinberg::Vst::SpeakerArr::kStereo);
 
-  // Add event output bus for MIDI
+  // Add event buses for MIDI in and out
+  addEventInput(STR16("Event In"), 1);
   addEventOutput(STR16("Event Out"), 1);
 
   // Determine lua_libs path relative to plugin location
@@ -36,30 +65,49 @@ FLLuaProcessor::initialize(Steinberg::FUnknown* context) {
 }
 
 Steinberg::tresult PLUGIN_API FLLuaProcessor::terminate() {
-  m_luaEngine.shutdown();
+  m_workers.stop();
+  for (auto& layer : m_layers) layer.deactivate();
   return AudioEffect::terminate();
 }
 
 Steinberg::tresult PLUGIN_API
 FLLuaProcessor::setActive(Steinberg::TBool state) {
   if (state) {
-    // Initialize Lua engine
-    m_pluginContext.eventQueue = &m_midiEventQueue;
-    m_pluginContext.logQueue = &m_logQueue;
-    m_pluginContext.scheduledNoteOffs = &m_scheduledNoteOffs;
-
-    m_luaEngine.init(&m_pluginContext, m_luaLibsPath);
-
-    // Reload script if we have one saved
-    if (!m_currentScriptSource.empty()) {
-      auto error = m_luaEngine.loadScript(m_currentScriptSource);
-      if (!error.empty()) {
-        m_logQueue.enqueue("Script error: " + error);
-      }
+    m_inputEvents.reserve(512);
+    m_pendingEvents.reserve(1024);
+
+    // The cache writer runs before scripts can fill it
+    if (!m_countedInstance) {
+      MemoryTally::instance().addInstance(1);
+      DiskCache::instance().retain();
+      m_countedInstance = true;
+    }
+
+    // Start the scripts saved with the project, each layer with its own
+    // stream of the instance seed
+    for (int i = 0; i < kMaxScriptLayers; ++i) {
+      m_layers[i].activate(&m_params, m_luaLibsPath,
+                           mixSeed(m_seed, static_cast<uint64_t>(i)));
     }
+
+    // Layers run in parallel on helpers plus the audio thread
+    int helpers = std::min<int>(kMaxScriptLayers - 1,
+                                std::thread::hardware_concurrency() - 1);
+    m_workers.start(std::max(helpers, 0), [this](int job) {
+      m_layers[m_runningLayers[job]].process(m_layerBlock);
+    });
   } else {
+    m_workers.stop();
+    for (auto& layer : m_layers) layer.deactivate();
+    m_controllerCache.reset();
     sendAllNotesOff();
-    m_luaEngine.shutdown();
+
+    MemoryTally::instance().update(m_reportedHeap, 0);
+    if (m_countedInstance) {
+      MemoryTally::instance().addInstance(-1);
+      DiskCache::instance().release();  // Flushes queued cache writes
+      m_countedInstance = false;
+    }
   }
 
   return AudioEffect::setActive(state);
@@ -74,53 +122,75 @@ FLLuaProcessor::canProcessSampleSize(Steinberg::int32 symbolicSampleSize) {
 
 Steinberg::tresult PLUGIN_API
 FLLuaProcessor::process(Steinberg::Vst::ProcessData& data) {
-  // Check for new script from the UI thread
+  // Check for new scripts from the UI thread
   ScriptSwapMessage msg;
   while (m_scriptQueue.try_dequeue(msg)) {
-    m_currentScriptSource = msg.source;
-    sendAllNotesOff();
-    m_scheduledNoteOffs.clear();
+    if (msg.layer < 0 || msg.layer >= kMaxScriptLayers) continue;
+    m_controllerCache.reset();
 
-    // Reinitialize Lua engine with new script
-    m_luaEngine.init(&m_pluginContext, m_luaLibsPath);
-    auto error = m_luaEngine.loadScript(m_currentScriptSource);
+    // Only the swapped layer's notes are released
+    auto error = m_layers[msg.layer].load(msg.source);
+    auto prefix = msg.layer > 0 ? fmt::format("[Layer {}] ", msg.layer + 1)
+                                : std::string();
     if (!error.empty()) {
-      m_logQueue.enqueue("Script error: " + error);
-    } else {
-      m_logQueue.enqueue("Script loaded successfully.");
+      m_logQueue.enqueue(prefix + "Script error: " + error);
+    } else if (!msg.source.empty()) {
+      m_logQueue.enqueue(prefix + "Script loaded successfully.");
     }
   }
 
   // Update transport state
+  bool wasPlaying = m_transport.playing;
+  double previousTempo = m_transport.tempo;
   updateTransport(data);
 
-  // Run Lua callbacks if playing and script is loaded
-  if (m_transport.playing && m_luaEngine.hasScript()) {
-    // Call on_beat at beat boundaries
-    if (m_transport.isBeatBoundary()) {
-      auto error = m_luaEngine.callOnBeat(m_transport.currentBeatInt());
-      if (!error.empty()) {
-        m_logQueue.enqueue("on_beat error: " + error);
-      }
-    }
-
-    // Call process every block
-    auto error = m_luaEngine.callProcess();
-    if (!error.empty()) {
-      m_logQueue.enqueue("process error: " + error);
+  // Macro parameter automation, snapshotted for the whole block
+  if (m_paramsRestored.exchange(false, std::memory_order_acquire)) {
+    for (int i = 0; i < ParamSnapshot::kNumParams; ++i) {
+      m_params.set(i, m_restoredParams[i]);
     }
   }
+  collectParamChanges(data.inputParameterChanges);
+
+  // Played MIDI is offered to every layer, filtered by its input channel
+  collectInputEvents(data.inputEvents);
+
+  runLayers(wasPlaying, previousTempo);
+  updateLatency();
 
   // Update lastBeatInt for next boundary detection
   m_transport.lastBeatInt = m_transport.currentBeatInt();
 
-  // Process scheduled note-offs
-  processScheduledNoteOffs();
+  if (!m_transport.playing && wasPlaying) {
+    int peak = m_voices.takePeak();
+    if (peak > 0) {
+      m_logQueue.enqueue(
+          fmt::format("Transport stopped: {} notes released, peak {} voices",
+                      m_voices.activeCount(), peak));
+    }
+    sendAllNotesOff();
+  }
 
   // Drain MIDI events to VST3 output
   if (data.outputEvents) {
     drainMidiEvents(data.outputEvents);
   }
+  m_sampleClock += data.numSamples;
+  relayLayerLogs();
+  reportLayerStats(data.numSamples);
+
+  // Warn once per note about notes held suspiciously long
+  if (m_voices.activeCount() > 0) {
+    auto maxHeld =
+        static_cast<int64_t>(kStuckNoteSeconds * m_transport.sampleRate);
+    m_voices.reportStuck(
+        m_sampleClock, maxHeld,
+        [this](uint8_t channel, uint8_t note, int64_t held) {
+          m_logQueue.enqueue(fmt::format(
+              "Possible stuck note: {} on channel {} held for {:.0f}s", note,
+              channel, held / m_transport.sampleRate));
+        });
+  }
 
   // Relay log messages to the controller via IMessage
   std::string logMsg;
@@ -148,7 +218,124 @@ FLLuaProcessor::process(Steinberg::Vst::ProcessData& data) {
   return Steinberg::kResultOk;
 }
 
+void FLLuaProcessor::runLayers(bool wasPlaying, double previousTempo) {
+  m_runningCount = 0;
+  for (int i = 0; i < kMaxScriptLayers; ++i) {
+    if (m_layers[i].isRunning()) m_runningLayers[m_runningCount++] = i;
+  }
+  if (m_runningCount == 0) return;
+
+  double blockSeconds = m_transport.blockSize / m_transport.sampleRate;
+  auto budget = std::chrono::duration<double>(std::max(
+      blockSeconds * kLayerDeadlineBlocks, kMinLayerDeadlineSeconds));
+
+  m_layerBlock.transport = &m_transport;
+  m_layerBlock.input = &m_inputEvents;
+  m_layerBlock.wasPlaying = wasPlaying;
+  m_layerBlock.previousTempo = previousTempo;
+  m_layerBlock.latency = m_latency;
+  m_layerBlock.deadline =
+      std::chrono::steady_clock::now() +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(budget);
+
+  // Returns once every layer has finished the block
+  m_workers.run(m_runningCount);
+}
+
+void FLLuaProcessor::updateLatency() {
+  // Layers share one delay so their output stays aligned
+  int32_t latency = 0;
+  for (const auto& layer : m_layers) {
+    latency = std::max(latency, layer.latencySamples(m_transport.sampleRate));
+  }
+  if (latency == m_latency) return;
+  m_latency = latency;
+  m_reportedLatency.store(latency, std::memory_order_relaxed);
+
+  // The host queries the new latency when the controller restarts
+  if (auto* msg = allocateMessage()) {
+    msg->setMessageID("LatencyChanged");
+    sendMessage(msg);
+    msg->release();
+  }
+}
+
+Steinberg::uint32 PLUGIN_API FLLuaProcessor::getLatencySamples() {
+  return static_cast<Steinberg::uint32>(
+      m_reportedLatency.load(std::memory_order_relaxed));
+}
+
+void FLLuaProcessor::relayLayerLogs() {
+  for (int i = 0; i < kMaxScriptLayers; ++i) {
+    std::string logMsg;
+    while (m_layers[i].getLogQueue().try_dequeue(logMsg)) {
+      if (i > 0) logMsg = fmt::format("[Layer {}] {}", i + 1, logMsg);
+      m_logQueue.enqueue(std::move(logMsg));
+    }
+  }
+}
+
+void FLLuaProcessor::reportLayerStats(Steinberg::int32 numSamples) {
+  for (int i = 0; i < kMaxScriptLayers; ++i) {
+    m_layerSeconds[i] += m_layers[i].takeCpuSeconds();
+    m_layerOverruns[i] += m_layers[i].takeOverruns();
+  }
+  m_statsSamples += numSamples;
+
+  double elapsed = m_statsSamples / m_transport.sampleRate;
+  if (elapsed < kLayerStatsSeconds) return;
+
+  // Share of real time each layer's scripts took, and its async backlog
+  std::array<float, kMaxScriptLayers> load{};
+  std::array<Steinberg::int32, kMaxScriptLayers> jobs{};
+  for (int i = 0; i < kMaxScriptLayers; ++i) {
+    load[i] = static_cast<float>(m_layerSeconds[i] / elapsed);
+    jobs[i] = m_layers[i].pendingJobs();
+    if (m_layerOverruns[i] > 0) {
+      m_logQueue.enqueue(fmt::format(
+          "Layer {} overran its deadline in {} blocks", i + 1,
+          m_layerOverruns[i]));
+    }
+  }
+  m_layerSeconds.fill(0.0);
+  m_layerOverruns.fill(0);
+  m_statsSamples = 0;
+
+  if (auto* msg = allocateMessage()) {
+    msg->setMessageID("LayerStats");
+    msg->getAttributes()->setBinary(
+        "load", load.data(),
+        static_cast<Steinberg::uint32>(load.size() * sizeof(float)));
+    msg->getAttributes()->setBinary(
+        "jobs", jobs.data(),
+        static_cast<Steinberg::uint32>(jobs.size() * sizeof(jobs[0])));
+    sendMessage(msg);
+    msg->release();
+  }
+
+  reportMemory();
+}
+
+void FLLuaProcessor::reportMemory() {
+  LuaMemoryStats stats;
+  for (const auto& layer : m_layers) stats.heapBytes += layer.heapBytes();
+
+  auto& tally = MemoryTally::instance();
+  tally.update(m_reportedHeap, stats.heapBytes);
+  stats.projectHeapBytes = tally.heapBytes();
+  stats.instances = tally.instances();
+
+  // The shared caches lock and prune; the controller adds their sizes
+  if (auto* msg = allocateMessage()) {
+    msg->setMessageID("MemoryStats");
+    msg->getAttributes()->setBinary("stats", &stats, sizeof(stats));
+    sendMessage(msg);
+    msg->release();
+  }
+}
+
 void FLLuaProcessor::updateTransport(Steinberg::Vst::ProcessData& data) {
+  m_transport.blockSize = data.numSamples;
   if (!data.processContext) return;
 
   auto* ctx = data.processContext;
@@ -173,70 +360,233 @@ void FLLuaProcessor::updateTransport(Steinberg::Vst::ProcessData& data) {
         static_cast<int>(m_transport.beat / m_transport.timeSigNum);
   }
 
-  // Update the plugin context so Lua can read it
-  m_pluginContext.transport = m_transport;
+  // A block that does not start where the previous one ended means the
+  // playhead was moved, FL looped, or playback just started.
+  if (m_transport.playing) {
+    double tolerance = 2.0 / m_transport.samplesPerBeat();
+    m_transport.discontinuity =
+        m_expectedBeat < 0.0 ||
+        std::abs(m_transport.beat - m_expectedBeat) > tolerance;
+    m_expectedBeat = m_transport.blockEndBeat();
+  } else {
+    m_transport.discontinuity = false;
+    m_expectedBeat = -1.0;
+  }
+}
+
+void FLLuaProcessor::collectInputEvents(
+    Steinberg::Vst::IEventList* inputEvents) {
+  m_inputEvents.clear();
+  if (!inputEvents) return;
+
+  Steinberg::int32 count = inputEvents->getEventCount();
+  for (Steinberg::int32 i = 0; i < count; ++i) {
+    Steinberg::Vst::Event e = {};
+    if (inputEvents->getEvent(i, e) != Steinberg::kResultOk) continue;
+
+    switch (e.type) {
+      case Steinberg::Vst::Event::kNoteOnEvent: {
+        auto channel = static_cast<uint8_t>(e.noteOn.channel & 0x0F);
+        auto velocity = static_cast<uint8_t>(
+            std::lround(std::clamp(e.noteOn.velocity, 0.0f, 1.0f) * 127.0f));
+        auto pitch = static_cast<uint8_t>(e.noteOn.pitch & 0x7F);
+        // Velocity 0 is a note-off by MIDI convention
+        if (velocity > 0) {
+          m_inputEvents.push_back(
+              NoteOn{pitch, velocity, channel, e.sampleOffset});
+        } else {
+          m_inputEvents.push_back(NoteOff{pitch, channel, e.sampleOffset});
+        }
+        break;
+      }
+      case Steinberg::Vst::Event::kNoteOffEvent:
+        m_inputEvents.push_back(
+            NoteOff{static_cast<uint8_t>(e.noteOff.pitch & 0x7F),
+                    static_cast<uint8_t>(e.noteOff.channel & 0x0F),
+                    e.sampleOffset});
+        break;
+      case Steinberg::Vst::Event::kLegacyMIDICCOutEvent: {
+        // Hosts that forward raw controllers use the legacy CC event
+        auto& cc = e.midiCCOut;
+        auto channel = static_cast<uint8_t>(cc.channel & 0x0F);
+        if (cc.controlNumber < 128) {
+          m_inputEvents.push_back(CC{cc.controlNumber,
+                                     static_cast<uint8_t>(cc.value & 0x7F),
+                                     channel, e.sampleOffset});
+        } else if (cc.controlNumber == Steinberg::Vst::kPitchBend) {
+          int value = ((cc.value2 & 0x7F) << 7 | (cc.value & 0x7F)) - 8192;
+          m_inputEvents.push_back(PitchBend{static_cast<int16_t>(value),
+                                            channel, e.sampleOffset});
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  // Hosts should already send events in order, but callbacks rely on it
+  std::stable_sort(m_inputEvents.begin(), m_inputEvents.end(),
+                   [](const MidiEvent& a, const MidiEvent& b) {
+                     auto offset = [](const MidiEvent& ev) {
+                       return std::visit(
+                           [](const auto& e) { return e.sampleOffset; }, ev);
+                     };
+                     return offset(a) < offset(b);
+                   });
 }
 
-void FLLuaProcessor::processScheduledNoteOffs() {
-  auto it = m_scheduledNoteOffs.begin();
-  while (it != m_scheduledNoteOffs.end()) {
-    if (m_transport.beat >= it->endBeat) {
-      m_midiEventQueue.enqueue(NoteOff{it->note, it->channel, 0});
-      it = m_scheduledNoteOffs.erase(it);
-    } else {
-      ++it;
+void FLLuaProcessor::collectParamChanges(
+    Steinberg::Vst::IParameterChanges* changes) {
+  m_params.beginBlock();
+  if (!changes) return;
+
+  Steinberg::int32 count = changes->getParameterCount();
+  for (Steinberg::int32 i = 0; i < count; ++i) {
+    auto* queue = changes->getParameterData(i);
+    if (!queue) continue;
+    auto param = static_cast<int>(queue->getParameterId()) -
+                 static_cast<int>(kMacroParamFirst);
+    if (param < 0 || param >= ParamSnapshot::kNumParams) continue;
+
+    Steinberg::int32 points = queue->getPointCount();
+    for (Steinberg::int32 p = 0; p < points; ++p) {
+      Steinberg::int32 offset = 0;
+      Steinberg::Vst::ParamValue value = 0.0;
+      if (queue->getPoint(p, offset, value) == Steinberg::kResultOk) {
+        m_params.addPoint(param, offset, value);
+      }
     }
+    m_paramValues[param].store(m_params.value(param),
+                               std::memory_order_relaxed);
   }
 }
 
 void FLLuaProcessor::drainMidiEvents(Steinberg::Vst::IEventList* outputEvents) {
-  MidiEvent midiEvent;
-  while (m_midiEventQueue.try_dequeue(midiEvent)) {
-    Steinberg::Vst::Event e = {};
+  double samplesPerBeat = m_transport.samplesPerBeat();
+  auto send = [&](Steinberg::Vst::Event& e) {
     e.busIndex = 0;
-    e.ppqPosition = m_transport.beat;
+    e.ppqPosition = m_transport.beat + e.sampleOffset / samplesPerBeat;
+    outputEvents->addEvent(e);
+  };
+  auto sendNoteOff = [&](uint8_t channel, uint8_t note, int32_t noteId,
+                         int32_t sampleOffset) {
+    Steinberg::Vst::Event e = {};
+    e.type = Steinberg::Vst::Event::kNoteOffEvent;
+    e.noteOff.channel = channel;
+    e.noteOff.pitch = note;
+    e.noteOff.velocity = 0.0f;
+    e.noteOff.noteId = noteId;
+    e.sampleOffset = sampleOffset;
+    send(e);
+  };
+
+  // Stop and panic release exactly the notes that are sounding
+  if (m_releaseVoices) {
+    m_releaseVoices = false;
+    m_voices.releaseAll([&](uint8_t channel, uint8_t note, int32_t noteId) {
+      sendNoteOff(channel, note, noteId, 0);
+    });
+    for (auto& layer : m_layers) layer.forgetSounding();
+  }
 
+  // Script events (offset 0) and natively rendered clip events arrive
+  // interleaved, one run per layer; they are merged and voices are tracked
+  // and sent in sample order. Equal offsets keep layer order.
+  m_pendingEvents.clear();
+  for (auto& layer : m_layers) layer.collect(m_pendingEvents);
+  std::stable_sort(m_pendingEvents.begin(), m_pendingEvents.end(),
+                   [](const MidiEvent& a, const MidiEvent& b) {
+                     return sampleOffsetOf(a) < sampleOffsetOf(b);
+                   });
+
+  for (const auto& pending : m_pendingEvents) {
     std::visit(
-        [&e](auto&& ev) {
+        [&](auto&& ev) {
           using T = std::decay_t<decltype(ev)>;
           if constexpr (std::is_same_v<T, NoteOn>) {
+            auto voice = m_voices.noteOn(ev.channel, ev.note,
+                                         m_sampleClock + ev.sampleOffset);
+            if (voice.retriggeredId >= 0) {
+              sendNoteOff(ev.channel, ev.note, voice.retriggeredId,
+                          ev.sampleOffset);
+            }
+            Steinberg::Vst::Event e = {};
             e.type = Steinberg::Vst::Event::kNoteOnEvent;
             e.noteOn.channel = ev.channel;
             e.noteOn.pitch = ev.note;
             e.noteOn.velocity = ev.velocity / 127.0f;
-            e.noteOn.noteId = ev.note;  // Simple note ID
+            e.noteOn.noteId = voice.noteId;
             e.sampleOffset = ev.sampleOffset;
+            send(e);
           } else if constexpr (std::is_same_v<T, NoteOff>) {
-            e.type = Steinberg::Vst::Event::kNoteOffEvent;
-            e.noteOff.channel = ev.channel;
-            e.noteOff.pitch = ev.note;
-            e.noteOff.velocity = 0.0f;
-            e.noteOff.noteId = ev.note;
-            e.sampleOffset = ev.sampleOffset;
+            // Dropped when not sounding or still held by a retrigger
+            int32_t noteId = m_voices.noteOff(ev.channel, ev.note);
+            if (noteId >= 0) {
+              sendNoteOff(ev.channel, ev.note, noteId, ev.sampleOffset);
+            }
           } else if constexpr (std::is_same_v<T, CC>) {
+            // A ramp point repeating the controller's value changes nothing
+            if (!m_controllerCache.updateCC(ev.channel, ev.controller,
+                                            ev.value, ev.ramp)) {
+              return;
+            }
+            Steinberg::Vst::Event e = {};
             e.type = Steinberg::Vst::Event::kLegacyMIDICCOutEvent;
             e.midiCCOut.channel = ev.channel;
             e.midiCCOut.controlNumber = ev.controller;
             e.midiCCOut.value = ev.value;
             e.sampleOffset = ev.sampleOffset;
+            send(e);
           } else if constexpr (std::is_same_v<T, PitchBend>) {
+            if (!m_controllerCache.updatePitchBend(ev.channel, ev.value,
+                                                   ev.ramp)) {
+              return;
+            }
+            // 14-bit unsigned bend split into LSB (value) and MSB (value2)
+            int bend = std::clamp(ev.value + 8192, 0, 16383);
+            Steinberg::Vst::Event e = {};
             e.type = Steinberg::Vst::Event::kLegacyMIDICCOutEvent;
             e.midiCCOut.channel = ev.channel;
-            e.midiCCOut.controlNumber = 129;  // Steinberg::Vst::kPitchBend
-            e.midiCCOut.value = ev.value;
+            e.midiCCOut.controlNumber = Steinberg::Vst::kPitchBend;
+            e.midiCCOut.value = static_cast<Steinberg::int8>(bend & 0x7F);
+            e.midiCCOut.value2 = static_cast<Steinberg::int8>(bend >> 7);
             e.sampleOffset = ev.sampleOffset;
+            send(e);
           }
         },
-        midiEvent);
-
-    outputEvents->addEvent(e);
+        pending);
   }
 }
 
 void FLLuaProcessor::sendAllNotesOff() {
-  // Send CC 123 (All Notes Off) on all 16 channels
-  for (uint8_t ch = 0; ch < 16; ++ch) {
-    m_midiEventQueue.enqueue(CC{123, 0, ch, 0});
+  // Released on the next drain, before any newly queued events
+  m_releaseVoices = true;
+}
+
+// Scripts are stored as an int32 length followed by the source
+static bool readScript(Steinberg::IBStream* state, std::string& source) {
+  Steinberg::IBStreamer streamer(state, kLittleEndian);
+  Steinberg::int32 length = 0;
+  if (!streamer.readInt32(length)) return false;
+
+  source.clear();
+  if (length > 0 && length < 1024 * 1024) {  // Max 1MB script
+    source.resize(static_cast<size_t>(length));
+    Steinberg::int32 bytesRead = 0;
+    state->read(source.data(), length, &bytesRead);
+    if (bytesRead != length) return false;
+  }
+  return true;
+}
+
+static void writeScript(Steinberg::IBStream* state, const std::string& source) {
+  Steinberg::IBStreamer streamer(state, kLittleEndian);
+  auto length = static_cast<Steinberg::int32>(source.size());
+  streamer.writeInt32(length);
+  if (length > 0) {
+    Steinberg::int32 bytesWritten = 0;
+    state->write((void*)source.data(), length, &bytesWritten);
   }
 }
 
@@ -246,17 +596,41 @@ FLLuaProcessor::setState(Steinberg::IBStream* state) {
 
   Steinberg::IBStreamer streamer(state, kLittleEndian);
 
-  // Read script source length
-  Steinberg::int32 length = 0;
-  if (!streamer.readInt32(length)) return Steinberg::kResultFalse;
+  // The first layer's script comes first, as in single-script states
+  std::string source;
+  if (!readScript(state, source)) return Steinberg::kResultFalse;
+  m_layers[0].setSource(std::move(source));
+  for (int i = 1; i < kMaxScriptLayers; ++i) m_layers[i].setSource({});
+
+  // Macro parameter values follow the script (absent in older states)
+  Steinberg::int32 version = 0;
+  Steinberg::int32 count = 0;
+  if (streamer.readInt32(version) && version >= 1 &&
+      streamer.readInt32(count)) {
+    for (Steinberg::int32 i = 0; i < count; ++i) {
+      double value = 0.0;
+      if (!streamer.readDouble(value)) break;
+      if (i < ParamSnapshot::kNumParams) {
+        m_restoredParams[i] = value;
+        m_paramValues[i].store(value, std::memory_order_relaxed);
+      }
+    }
+    m_paramsRestored.store(true, std::memory_order_release);
+  }
 
-  if (length > 0 && length < 1024 * 1024) {  // Max 1MB script
-    m_currentScriptSource.resize(static_cast<size_t>(length));
-    Steinberg::int32 bytesRead = 0;
-    state->read(m_currentScriptSource.data(), length, &bytesRead);
-    if (bytesRead != length) return Steinberg::kResultFalse;
-  } else {
-    m_currentScriptSource.clear();
+  // Then the other layers' scripts
+  Steinberg::int32 layers = 0;
+  if (version >= 2 && streamer.readInt32(layers)) {
+    for (Steinberg::int32 i = 1; i < layers; ++i) {
+      if (!readScript(state, source)) return Steinberg::kResultFalse;
+      if (i < kMaxScriptLayers) m_layers[i].setSource(std::move(source));
+    }
+  }
+
+  // Then the seed; older states keep this instance's own
+  Steinberg::int64 seed = 0;
+  if (version >= 3 && streamer.readInt64(seed)) {
+    m_seed = static_cast<uint64_t>(seed);
   }
 
   return Steinberg::kResultOk;
@@ -268,13 +642,20 @@ FLLuaProcessor::getState(Steinberg::IBStream* state) {
 
   Steinberg::IBStreamer streamer(state, kLittleEndian);
 
-  // Write script source
-  auto length = static_cast<Steinberg::int32>(m_currentScriptSource.size());
-  streamer.writeInt32(length);
-  if (length > 0) {
-    Steinberg::int32 bytesWritten = 0;
-    state->write((void*)m_currentScriptSource.data(), length, &bytesWritten);
+  // First layer's script, readable by single-script builds
+  writeScript(state, m_layers[0].source());
+
+  // Versioned chunk; older builds stop reading after the script
+  streamer.writeInt32(kStateVersion);
+  streamer.writeInt32(ParamSnapshot::kNumParams);
+  for (const auto& value : m_paramValues) {
+    streamer.writeDouble(value.load(std::memory_order_relaxed));
+  }
+  streamer.writeInt32(kMaxScriptLayers);
+  for (int i = 1; i < kMaxScriptLayers; ++i) {
+    writeScript(state, m_layers[i].source());
   }
+  streamer.writeInt64(static_cast<Steinberg::int64>(m_seed));
 
   return Steinberg::kResultOk;
 }
@@ -290,7 +671,10 @@ FLLuaProcessor::notify(Steinberg::Vst::IMessage* message) {
     if (message->getAttributes()->getBinary("source", data, size) ==
         Steinberg::kResultOk) {
       std::string source(static_cast<const char*>(data), size);
-      m_scriptQueue.enqueue(ScriptSwapMessage{std::move(source)});
+      Steinberg::int64 layer = 0;
+      message->getAttributes()->getInt("layer", layer);
+      m_scriptQueue.enqueue(
+          ScriptSwapMessage{std::move(source), static_cast<int>(layer)});
     }
     return Steinberg::kResultOk;
   }
@@ -1,14 +1,20 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <memory>
 #include <vector>
 
+#include "cids.hpp"
+#include "events/controller_cache.hpp"
 #include "events/event_queue.hpp"
 #include "events/midi_event.hpp"
-#include "lua/api.hpp"
-#include "lua/engine.hpp"
+#include "events/param_snapshot.hpp"
+#include "events/voice_table.hpp"
 #include "public.sdk/source/vst/vstaudioeffect.h"
+#include "script_layer.hpp"
 #include "transport/transport.hpp"
+#include "worker_pool.hpp"
 
 namespace FLLua {
 
@@ -33,26 +39,56 @@ class FLLuaProcessor : public Steinberg::Vst::AudioEffect {
   Steinberg::tresult PLUGIN_API getState(Steinberg::IBStream* state) override;
   Steinberg::tresult PLUGIN_API
   notify(Steinberg::Vst::IMessage* message) override;
+  Steinberg::uint32 PLUGIN_API getLatencySamples() override;
 
   // Queues shared with the controller
-  MidiEventQueue& getMidiEventQueue() { return m_midiEventQueue; }
   LogQueue& getLogQueue() { return m_logQueue; }
   ScriptQueue& getScriptQueue() { return m_scriptQueue; }
 
  private:
   void updateTransport(Steinberg::Vst::ProcessData& data);
-  void processScheduledNoteOffs();
+  void runLayers(bool wasPlaying, double previousTempo);
+  void updateLatency();
+  void collectInputEvents(Steinberg::Vst::IEventList* inputEvents);
+  void collectParamChanges(Steinberg::Vst::IParameterChanges* changes);
   void drainMidiEvents(Steinberg::Vst::IEventList* outputEvents);
+  void relayLayerLogs();
+  void reportLayerStats(Steinberg::int32 numSamples);
+  void reportMemory();
   void sendAllNotesOff();
 
-  LuaEngine m_luaEngine;
-  PluginContext m_pluginContext;
+  std::array<ScriptLayer, kMaxScriptLayers> m_layers;
+  std::array<int, kMaxScriptLayers> m_runningLayers{};  // This block's jobs
+  int m_runningCount = 0;
+  LayerBlock m_layerBlock;
+  WorkerPool m_workers;
   TransportState m_transport;
-  MidiEventQueue m_midiEventQueue;
   LogQueue m_logQueue;
   ScriptQueue m_scriptQueue;
-  std::vector<ScheduledNoteOff> m_scheduledNoteOffs;
-  std::string m_currentScriptSource;
+  std::vector<MidiEvent> m_inputEvents;
+  ParamSnapshot m_params;
+  // Values restored by setState, applied by the next process call
+  std::array<double, ParamSnapshot::kNumParams> m_restoredParams{};
+  std::atomic<bool> m_paramsRestored{false};
+  // Latest values for getState, written by the audio thread
+  std::array<std::atomic<double>, ParamSnapshot::kNumParams> m_paramValues{};
+  std::vector<MidiEvent> m_pendingEvents;  // Output events being drained
+  VoiceTable m_voices;
+  ControllerCache m_controllerCache;
+  bool m_releaseVoices = false;
+  int64_t m_sampleClock = 0;  // Samples processed, for stuck-note checks
+  // Output delay every layer applies, the largest any groove asks for
+  int32_t m_latency = 0;
+  std::atomic<Steinberg::int32> m_reportedLatency{0};
+  double m_expectedBeat = -1.0;  // Where the next block should start
+  // Per-layer script time and overruns since the last stats message
+  std::array<double, kMaxScriptLayers> m_layerSeconds{};
+  std::array<int, kMaxScriptLayers> m_layerOverruns{};
+  int64_t m_statsSamples = 0;
+  int64_t m_reportedHeap = 0;  // This instance's share of the process tally
+  bool m_countedInstance = false;
+  // Random seed of this instance, saved in the state so takes replay
+  uint64_t m_seed = 0;
   std::string m_luaLibsPath;
 };
 
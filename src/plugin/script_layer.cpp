@@ -0,0 +1,391 @@
+#include "script_layer.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+
+#include "lua/disk_cache.hpp"
+#include "lua/random.hpp"
+
+namespace FLLua {
+
+// Share of real time process() may take in sub-block mode before the cost
+// guard merges sub-blocks, and the share it must stay under for a second
+// before they are split again
+static constexpr double kSubBlockMaxLoad = 0.25;
+static constexpr double kSubBlockCalmLoad = 0.05;
+static constexpr double kSubBlockCalmSeconds = 1.0;
+static constexpr int kMaxSubBlockMerge = 64;
+
+void ScriptLayer::activate(const ParamSnapshot* params,
+                           const std::string& luaLibsPath, uint64_t seed) {
+  m_luaLibsPath = luaLibsPath;
+  m_context.seed = seed;
+  m_context.eventQueue = &m_eventQueue;
+  m_context.logQueue = &m_logQueue;
+  m_context.scheduledNoteOffs = &m_scheduledNoteOffs;
+  m_context.clipPlayer = &m_clipPlayer;
+  m_context.patternPlayer = &m_patternPlayer;
+  m_context.ramps = &m_ramps;
+  m_context.groove = &m_groove;
+  m_context.params = params;
+  m_context.inputEvents = &m_inputEvents;
+  m_context.async = &m_async;
+  m_inputEvents.reserve(512);
+  m_released.reserve(256);
+  m_grooved.reserve(256);
+  m_groove.setSeed(mixSeed(seed, contentHash("groove")));
+
+  m_async.start(luaLibsPath, seed);
+  m_async.setScript(m_source);
+
+  if (!m_source.empty()) {
+    auto error = start();
+    if (!error.empty()) {
+      m_logQueue.enqueue("Script error: " + error);
+    }
+  }
+}
+
+void ScriptLayer::deactivate() {
+  stop();
+  m_engine.shutdown();
+  m_async.stop();
+
+  // The processor releases every voice; drop what the players queued
+  MidiEvent stale;
+  while (m_eventQueue.try_dequeue(stale)) {
+  }
+  m_groove.clear();
+  m_groove.disable();
+  m_grooved.clear();
+  m_released.clear();
+  forgetSounding();
+}
+
+std::string ScriptLayer::load(const std::string& source) {
+  m_source = source;
+  m_async.setScript(m_source);  // Cancels the old script's jobs
+  stop();
+  releaseSounding();
+  m_scheduledNoteOffs.clear();
+  m_engine.shutdown();
+  m_groove.disable();
+  m_options = {};
+  if (m_source.empty()) return {};
+  return start();
+}
+
+std::string ScriptLayer::start() {
+  m_lookahead.stop();
+  m_patternPlayer.seed(mixSeed(m_context.seed, contentHash("pattern")));
+  m_engine.init(&m_context, m_luaLibsPath);
+  auto error = m_engine.loadScript(m_source);
+  if (!error.empty()) return error;
+
+  // Scripts opt into lookahead with `options = { lookahead = beats }`. The
+  // audio-thread state was only needed to read the options.
+  m_options = m_engine.readOptions();
+  m_ramps.setResolution(m_options.rampResolution);
+  m_subBlockMerge = 1;
+  m_subBlockMergeLogged = 1;
+  m_subBlockCalmSeconds = 0.0;
+  m_subBlockPhase = 0;
+  m_lastSubBlockBeat = m_context.transport.currentBeatInt();
+  if (m_options.lookaheadBeats > 0.0) {
+    m_engine.shutdown();
+    m_clipPlayer.reset(m_eventQueue);
+    m_patternPlayer.reset(m_eventQueue);
+    m_ramps.reset();
+    m_lookahead.start(m_source, m_luaLibsPath, m_options.lookaheadBeats,
+                      m_context.seed);
+    m_logQueue.enqueue(
+        fmt::format("Lookahead mode: {} beats", m_options.lookaheadBeats));
+  }
+  return {};
+}
+
+void ScriptLayer::stop() {
+  m_lookahead.stop();
+  m_clipPlayer.reset(m_eventQueue);
+  m_patternPlayer.reset(m_eventQueue);
+  m_ramps.reset();
+}
+
+void ScriptLayer::process(const LayerBlock& block) {
+  auto started = std::chrono::steady_clock::now();
+  const auto& transport = *block.transport;
+  m_context.transport = transport;
+  m_engine.setDeadline(block.deadline);
+
+  // Keep ctx.wait intervals relative to the new position after a jump
+  if (transport.discontinuity && m_lastPlayedBeat >= 0.0) {
+    m_engine.rebaseTasks(transport.beat - m_lastPlayedBeat);
+  }
+  if (transport.playing) m_lastPlayedBeat = transport.blockEndBeat();
+  if (transport.playing && !block.wasPlaying) {
+    m_groove.restart();
+    m_patternPlayer.seed(mixSeed(m_context.seed, contentHash("pattern")));
+  }
+
+  if (m_engine.hasScript()) {
+    auto error = m_engine.dispatchParams();
+    if (!error.empty()) {
+      m_logQueue.enqueue("on_param error: " + error);
+    }
+  }
+
+  // Played MIDI reaches the script whether or not the transport runs
+  m_inputEvents.clear();
+  for (const auto& event : *block.input) {
+    int channel = std::visit([](const auto& e) { return e.channel; }, event);
+    if (m_options.inputChannel < 0 || channel == m_options.inputChannel) {
+      m_inputEvents.push_back(event);
+    }
+  }
+  if (!m_inputEvents.empty() && m_engine.hasScript()) {
+    auto error = m_engine.dispatchInput();
+    if (!error.empty()) {
+      m_logQueue.enqueue("input error: " + error);
+    }
+  }
+
+  // Results of ctx.async jobs that finished since the last block
+  if (m_async.hasResults() && m_engine.hasScript()) {
+    auto error = m_engine.dispatchResults();
+    if (!error.empty()) {
+      m_logQueue.enqueue("on_result error: " + error);
+    }
+  }
+  std::string logMsg;
+  while (m_async.getLogQueue().try_dequeue(logMsg)) {
+    m_logQueue.enqueue(std::move(logMsg));
+  }
+
+  // Lookahead mode: the script runs on a worker, only merge its output
+  if (m_lookahead.isRunning()) {
+    mergeLookahead(block);
+  }
+
+  // Run Lua callbacks if playing and script is loaded
+  if (transport.playing && m_engine.hasScript()) {
+    if (m_options.subBlockSamples > 0) {
+      runSubBlocks(block);
+    } else {
+      // Call on_beat at beat boundaries
+      if (transport.isBeatBoundary()) {
+        auto error = m_engine.callOnBeat(transport.currentBeatInt());
+        if (!error.empty()) {
+          m_logQueue.enqueue("on_beat error: " + error);
+        }
+      }
+
+      // Call process every block
+      auto error = m_engine.callProcess();
+      if (!error.empty()) {
+        m_logQueue.enqueue("process error: " + error);
+      }
+    }
+
+    // Resume spawned tasks due in this block; skipped natively otherwise
+    if (m_engine.hasDueTasks(transport.blockEndBeat())) {
+      auto error = m_engine.resumeTasks();
+      if (!error.empty()) {
+        m_logQueue.enqueue("task error: " + error);
+      }
+    }
+  }
+
+  // Render natively playing clips and patterns after the script changed
+  // what plays
+  if (transport.playing) {
+    m_clipPlayer.render(transport, m_eventQueue);
+    m_patternPlayer.render(transport, m_eventQueue);
+    m_ramps.render(transport, m_eventQueue);
+  } else if (block.wasPlaying) {
+    m_clipPlayer.releaseAll(m_eventQueue);
+    m_patternPlayer.releaseAll(m_eventQueue);
+
+    // Pending ctx.note offs timed in beats would never come due while
+    // stopped, and the processor releases what the groove still holds back
+    std::erase_if(m_scheduledNoteOffs, [](const ScheduledNoteOff& off) {
+      return off.endSample < 0;
+    });
+    m_groove.clear();
+  }
+
+  processScheduledNoteOffs(transport);
+
+  // Delay the block's output and apply the groove natively
+  m_groove.process(transport, block.latency, m_eventQueue, m_grooved);
+  m_context.sampleClock += transport.blockSize;
+
+  if (m_engine.takeOverrun()) ++m_overruns;
+  m_cpuSeconds += std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - started)
+                      .count();
+}
+
+void ScriptLayer::runSubBlocks(const LayerBlock& block) {
+  const auto& transport = *block.transport;
+  if (transport.blockSize <= 0) return;
+  if (!block.wasPlaying) m_lastSubBlockBeat = transport.lastBeatInt;
+  if (!block.wasPlaying || transport.discontinuity) m_subBlockPhase = 0;
+
+  // process() runs at the start of every sub-block, on_beat in the first
+  // sub-block of a beat, with events landing at the sub-block's offset.
+  // Sub-blocks run on across host blocks, so their spacing does not depend
+  // on the host's buffer size.
+  auto started = std::chrono::steady_clock::now();
+  double samplesPerBeat = transport.samplesPerBeat();
+  int32_t step = m_options.subBlockSamples * m_subBlockMerge;
+  int32_t offset = m_subBlockPhase;
+  for (; offset < transport.blockSize; offset += step) {
+    m_context.processOffset = offset;
+    m_context.sampleOffset = offset;
+    int beat = static_cast<int>(transport.beat + offset / samplesPerBeat);
+    if (beat != m_lastSubBlockBeat) {
+      m_lastSubBlockBeat = beat;
+      auto error = m_engine.callOnBeat(beat);
+      if (!error.empty()) {
+        m_logQueue.enqueue("on_beat error: " + error);
+      }
+    }
+    auto error = m_engine.callProcess();
+    if (!error.empty()) {
+      m_logQueue.enqueue("process error: " + error);
+      offset = transport.blockSize;
+      break;
+    }
+  }
+  m_subBlockPhase = offset - transport.blockSize;
+  m_context.processOffset = 0;
+  m_context.sampleOffset = 0;
+
+  // Cost guard: a script too slow for its sub-blocks runs less often
+  // rather than overrunning the block
+  double blockSeconds = transport.blockSize / transport.sampleRate;
+  double load = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - started)
+                    .count() /
+                blockSeconds;
+  if (load > kSubBlockMaxLoad && m_subBlockMerge < kMaxSubBlockMerge) {
+    m_subBlockMerge *= 2;
+    m_subBlockCalmSeconds = 0.0;
+    if (m_subBlockMerge > m_subBlockMergeLogged) {
+      m_subBlockMergeLogged = m_subBlockMerge;
+      m_logQueue.enqueue(fmt::format(
+          "process() is too slow for {}-sample sub-blocks; running it every "
+          "{} samples",
+          m_options.subBlockSamples,
+          m_options.subBlockSamples * m_subBlockMerge));
+    }
+  } else if (m_subBlockMerge > 1 && load < kSubBlockCalmLoad) {
+    m_subBlockCalmSeconds += blockSeconds;
+    if (m_subBlockCalmSeconds >= kSubBlockCalmSeconds) {
+      m_subBlockMerge /= 2;
+      m_subBlockCalmSeconds = 0.0;
+    }
+  } else {
+    m_subBlockCalmSeconds = 0.0;
+  }
+}
+
+void ScriptLayer::mergeLookahead(const LayerBlock& block) {
+  const auto& transport = *block.transport;
+
+  // Tempo changes, jumps and FL loops invalidate the generated tail
+  if (transport.playing) {
+    if (transport.discontinuity || transport.tempo != block.previousTempo) {
+      m_lookahead.reset(transport, m_eventQueue);
+    }
+    m_lookahead.merge(transport, m_eventQueue);
+  } else if (block.wasPlaying) {
+    m_lookahead.reset(transport, m_eventQueue);
+  }
+
+  std::string logMsg;
+  while (m_lookahead.getLogQueue().try_dequeue(logMsg)) {
+    m_logQueue.enqueue(std::move(logMsg));
+  }
+}
+
+void ScriptLayer::processScheduledNoteOffs(const TransportState& transport) {
+  int64_t clock = m_context.sampleClock;
+  auto it = m_scheduledNoteOffs.begin();
+  while (it != m_scheduledNoteOffs.end()) {
+    if (it->endSample >= 0) {
+      // Sample-timed offs land at their offset in the block
+      if (it->endSample < clock + transport.blockSize) {
+        auto offset =
+            static_cast<int32_t>(std::max<int64_t>(it->endSample - clock, 0));
+        m_eventQueue.enqueue(NoteOff{it->note, it->channel, offset});
+        it = m_scheduledNoteOffs.erase(it);
+      } else {
+        ++it;
+      }
+    } else if (transport.beat >= it->endBeat) {
+      m_eventQueue.enqueue(NoteOff{it->note, it->channel, 0});
+      it = m_scheduledNoteOffs.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ScriptLayer::collect(std::vector<MidiEvent>& out) {
+  out.insert(out.end(), m_released.begin(), m_released.end());
+  m_released.clear();
+  for (auto& event : m_grooved) {
+    track(event);
+    out.push_back(event);
+  }
+  m_grooved.clear();
+
+  MidiEvent event;
+  while (m_eventQueue.try_dequeue(event)) {
+    track(event);
+    out.push_back(event);
+  }
+}
+
+void ScriptLayer::track(MidiEvent& event) {
+  if (m_options.outputChannel >= 0) {
+    auto channel = static_cast<uint8_t>(m_options.outputChannel);
+    std::visit([channel](auto& e) { e.channel = channel; }, event);
+  }
+
+  if (auto* on = std::get_if<NoteOn>(&event)) {
+    auto& count = m_sounding[(on->channel & 0x0F) * 128 + (on->note & 0x7F)];
+    if (count < 255) ++count;
+  } else if (auto* off = std::get_if<NoteOff>(&event)) {
+    auto& count =
+        m_sounding[(off->channel & 0x0F) * 128 + (off->note & 0x7F)];
+    if (count > 0) --count;
+  }
+}
+
+void ScriptLayer::releaseSounding() {
+  // Account for offs the players just queued and those the groove holds
+  // back, then end what is left. Other layers' notes on the same keys stay
+  // held in the voice table.
+  m_groove.flush(m_grooved);
+  for (auto& event : m_grooved) {
+    track(event);
+    m_released.push_back(event);
+  }
+  m_grooved.clear();
+  MidiEvent event;
+  while (m_eventQueue.try_dequeue(event)) {
+    track(event);
+    m_released.push_back(event);
+  }
+  for (int key = 0; key < static_cast<int>(m_sounding.size()); ++key) {
+    for (; m_sounding[key] > 0; --m_sounding[key]) {
+      m_released.push_back(NoteOff{static_cast<uint8_t>(key % 128),
+                                   static_cast<uint8_t>(key / 128), 0});
+    }
+  }
+}
+
+}  // namespace FLLua
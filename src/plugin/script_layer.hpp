@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "events/event_queue.hpp"
+#include "events/midi_event.hpp"
+#include "events/param_snapshot.hpp"
+#include "lua/api.hpp"
+#include "lua/async_runner.hpp"
+#include "lua/engine.hpp"
+#include "lua/lookahead.hpp"
+#include "sequencing/clip_player.hpp"
+#include "sequencing/groove.hpp"
+#include "sequencing/ramp_engine.hpp"
+#include "sequencing/step_pattern.hpp"
+#include "transport/transport.hpp"
+
+namespace FLLua {
+
+// What every layer needs to run one block
+struct LayerBlock {
+  const TransportState* transport = nullptr;
+  const std::vector<MidiEvent>* input = nullptr;  // All played MIDI
+  bool wasPlaying = false;
+  double previousTempo = 0.0;
+  int32_t latency = 0;  // Samples every layer delays its output by
+  std::chrono::steady_clock::time_point deadline;
+};
+
+// One script and everything it owns: Lua state, native players, pending
+// note-offs, event and log queues. Layers share nothing while they run, so
+// the processor runs them on parallel threads and merges their output.
+class ScriptLayer {
+ public:
+  // `seed` seeds ctx.rng and math.random in every state of the layer
+  void activate(const ParamSnapshot* params, const std::string& luaLibsPath,
+                uint64_t seed);
+  void deactivate();
+
+  // Replace the script, releasing the notes the old one left sounding.
+  // Audio thread only.
+  std::string load(const std::string& source);
+
+  // Script restored from the plugin state, started on activation
+  void setSource(std::string source) { m_source = std::move(source); }
+  const std::string& source() const { return m_source; }
+  bool isRunning() const {
+    return m_engine.hasScript() || m_lookahead.isRunning();
+  }
+
+  // Run the script callbacks and native players for one block. Called on a
+  // pool thread; touches only this layer.
+  void process(const LayerBlock& block);
+
+  // Audio thread, after every layer finished: append this block's events
+  // to `out` with the output channel applied
+  void collect(std::vector<MidiEvent>& out);
+
+  // The processor released every voice on the output bus
+  void forgetSounding() { m_sounding.fill(0); }
+
+  LogQueue& getLogQueue() { return m_logQueue; }
+
+  // Output delay the layer's groove needs to move notes earlier
+  int32_t latencySamples(double sampleRate) const {
+    return m_groove.latencySamples(sampleRate);
+  }
+
+  // ctx.async jobs queued or running
+  int pendingJobs() const { return m_async.pending(); }
+
+  // Lua heap of the layer's states: the audio-thread one, read between
+  // blocks, and the lookahead and async workers' as they last published
+  int64_t heapBytes() const {
+    return m_engine.heapBytes() + m_lookahead.heapBytes() +
+           m_async.heapBytes();
+  }
+
+  // Time spent in process() and deadline overruns since the last call
+  double takeCpuSeconds() { return std::exchange(m_cpuSeconds, 0.0); }
+  int takeOverruns() { return std::exchange(m_overruns, 0); }
+
+ private:
+  std::string start();
+  void stop();
+  void mergeLookahead(const LayerBlock& block);
+  void runSubBlocks(const LayerBlock& block);
+  void processScheduledNoteOffs(const TransportState& transport);
+  void track(MidiEvent& event);
+  void releaseSounding();
+
+  LuaEngine m_engine;
+  PluginContext m_context;
+  MidiEventQueue m_eventQueue;
+  LogQueue m_logQueue;
+  std::vector<ScheduledNoteOff> m_scheduledNoteOffs;
+  ClipPlayer m_clipPlayer;
+  PatternPlayer m_patternPlayer;
+  RampEngine m_ramps;
+  GrooveProcessor m_groove;
+  LookaheadRunner m_lookahead;
+  AsyncRunner m_async;
+  std::vector<MidiEvent> m_inputEvents;  // Played MIDI this layer listens to
+  std::vector<MidiEvent> m_released;     // Note-offs from the last reload
+  std::vector<MidiEvent> m_grooved;      // Groove output due this block
+  ScriptOptions m_options;
+  std::string m_source;
+  std::string m_luaLibsPath;
+  double m_lastPlayedBeat = -1.0;  // End of the last block played
+
+  // Notes this layer holds on the output bus, per channel and pitch, so a
+  // reload releases only its own notes
+  std::array<uint8_t, 16 * 128> m_sounding{};
+
+  double m_cpuSeconds = 0.0;
+  int m_overruns = 0;
+
+  // options.sub_block: the cost guard merges this many sub-blocks while
+  // process() is too slow, and splits them again once it has been fast
+  // for a while
+  int m_subBlockMerge = 1;
+  int m_subBlockMergeLogged = 1;
+  double m_subBlockCalmSeconds = 0.0;
+  int32_t m_subBlockPhase = 0;  // Samples into this block of the next one
+  int m_lastSubBlockBeat = -1;  // Beat on_beat last ran for
+};
+
+}  // namespace FLLua
@@ -0,0 +1,121 @@
+#include "worker_pool.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <avrt.h>
+#endif
+
+namespace FLLua {
+
+// Spins before sleeping on the barrier; jobs are usually sub-millisecond
+static constexpr int kSpinCount = 2000;
+
+// Registers the calling helper with the scheduler as audio work for as
+// long as it lives, falling back to time-critical priority when MMCSS is
+// unavailable
+class AudioThreadPriority {
+ public:
+  AudioThreadPriority() {
+#ifdef _WIN32
+    DWORD task = 0;
+    m_handle = AvSetMmThreadCharacteristicsW(L"Pro Audio", &task);
+    if (m_handle) {
+      AvSetMmThreadPriority(m_handle, AVRT_PRIORITY_HIGH);
+    } else {
+      SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+    }
+#endif
+  }
+
+  ~AudioThreadPriority() {
+#ifdef _WIN32
+    if (m_handle) AvRevertMmThreadCharacteristics(m_handle);
+#endif
+  }
+
+  AudioThreadPriority(const AudioThreadPriority&) = delete;
+  AudioThreadPriority& operator=(const AudioThreadPriority&) = delete;
+
+ private:
+#ifdef _WIN32
+  HANDLE m_handle = nullptr;
+#endif
+};
+
+void WorkerPool::start(int threads, Job job) {
+  stop();
+  m_job = std::move(job);
+  m_running.store(true, std::memory_order_release);
+  for (int i = 0; i < threads; ++i) {
+    m_threads.emplace_back(&WorkerPool::loop, this);
+  }
+}
+
+void WorkerPool::stop() {
+  if (m_threads.empty()) return;
+
+  m_running.store(false, std::memory_order_release);
+  m_generation.fetch_add(1, std::memory_order_release);
+  m_generation.notify_all();
+  for (auto& thread : m_threads) thread.join();
+  m_threads.clear();
+}
+
+void WorkerPool::run(int count) {
+  if (count <= 0) return;
+  if (count == 1 || m_threads.empty()) {
+    for (int i = 0; i < count; ++i) m_job(i);
+    return;
+  }
+
+  uint64_t run = (m_cursor.load(std::memory_order_relaxed) >> 32) + 1;
+  m_done.store(0, std::memory_order_relaxed);
+  m_cursor.store(run << 32 | static_cast<uint64_t>(count) << 16,
+                 std::memory_order_release);
+  m_generation.fetch_add(1, std::memory_order_release);
+  m_generation.notify_all();
+
+  work();
+
+  // Barrier: wait for jobs still running on helpers
+  for (int spin = 0; m_done.load(std::memory_order_acquire) < count; ++spin) {
+    if (spin < kSpinCount) continue;
+    int done = m_done.load(std::memory_order_acquire);
+    if (done < count) m_done.wait(done, std::memory_order_acquire);
+  }
+}
+
+void WorkerPool::work() {
+  uint64_t cursor = m_cursor.load(std::memory_order_acquire);
+  while (true) {
+    int next = static_cast<int>(cursor & 0xFFFF);
+    int count = static_cast<int>((cursor >> 16) & 0xFFFF);
+    if (next >= count) return;
+    if (!m_cursor.compare_exchange_weak(cursor, cursor + 1,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+      continue;
+    }
+
+    m_job(next);
+    if (m_done.fetch_add(1, std::memory_order_acq_rel) + 1 == count) {
+      m_done.notify_all();
+    }
+    cursor = m_cursor.load(std::memory_order_acquire);
+  }
+}
+
+void WorkerPool::loop() {
+  AudioThreadPriority priority;
+  uint32_t seen = m_generation.load(std::memory_order_acquire);
+  while (true) {
+    m_generation.wait(seen, std::memory_order_acquire);
+    seen = m_generation.load(std::memory_order_acquire);
+    if (!m_running.load(std::memory_order_acquire)) return;
+    work();
+  }
+}
+
+}  // namespace FLLua
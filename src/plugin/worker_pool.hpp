@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace FLLua {
+
+// Small fixed pool that runs indexed jobs in parallel and returns when all
+// of them are done. The calling thread takes jobs too, so a single job
+// never leaves it. Threads sleep on an atomic between runs; starting a run
+// allocates nothing. Helpers join the audio thread's scheduling class, so
+// the barrier never waits on a thread the OS ranks below it.
+class WorkerPool {
+ public:
+  using Job = std::function<void(int index)>;
+
+  WorkerPool() = default;
+  ~WorkerPool() { stop(); }
+
+  // Spawn `threads` helpers that run `job` for the indices handed out
+  void start(int threads, Job job);
+  void stop();
+
+  // Run job(0) .. job(count - 1) and wait for all of them (the barrier)
+  void run(int count);
+
+ private:
+  void work();
+  void loop();
+
+  Job m_job;
+  std::vector<std::thread> m_threads;
+  std::atomic<bool> m_running{false};
+  std::atomic<uint32_t> m_generation{0};  // Wakes helpers
+  // Run number (high 32 bits), job count and next job index (16 bits each)
+  // in one word, so a helper late from a finished run cannot claim a job
+  // of the next one
+  std::atomic<uint64_t> m_cursor{0};
+  std::atomic<int> m_done{0};
+};
+
+}  // namespace FLLua
@@ -0,0 +1,228 @@
+#include "clip_player.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace FLLua {
+
+// Block positions are recomputed from the host beat every block; allow a
+// little rounding drift before treating a mismatch as a transport jump.
+static constexpr int64_t kSeekToleranceTicks = 2;
+
+int ClipPlayer::load(std::shared_ptr<const MidiClip> clip) {
+  for (int id = 0; id < kMaxClips; ++id) {
+    auto& s = m_slots[id];
+    if (s.clip) continue;
+    s = Slot{};
+    s.clip = std::move(clip);
+    s.sounding.fill(kSilent);
+    return id;
+  }
+  return -1;
+}
+
+bool ClipPlayer::unload(int id, MidiEventQueue& out) {
+  auto* s = slot(id);
+  if (!s) return false;
+  releaseSlot(*s, 0, out);
+  s->clip.reset();
+  s->playing = false;
+  return true;
+}
+
+bool ClipPlayer::play(int id, double startBeat, bool loop) {
+  auto* s = slot(id);
+  if (!s) return false;
+  s->anchorBeat = startBeat;
+  s->loop = loop;
+  s->playing = true;
+  s->cursor = 0;
+  s->nextTick = 0;
+  return true;
+}
+
+bool ClipPlayer::stop(int id, MidiEventQueue& out) {
+  auto* s = slot(id);
+  if (!s) return false;
+  releaseSlot(*s, 0, out);
+  s->playing = false;
+  return true;
+}
+
+bool ClipPlayer::setTransform(int id, const ClipTransform& transform,
+                              double currentBeat) {
+  auto* s = slot(id);
+  if (!s || transform.rate <= 0.0) return false;
+
+  // Re-anchor so a rate change keeps the current clip position
+  if (s->playing && transform.rate != s->transform.rate &&
+      currentBeat > s->anchorBeat) {
+    double clipBeats = (currentBeat - s->anchorBeat) * s->transform.rate;
+    s->anchorBeat = currentBeat - clipBeats / transform.rate;
+  }
+  s->transform = transform;
+  return true;
+}
+
+const MidiClip* ClipPlayer::clip(int id) const {
+  auto* s = slot(id);
+  return s ? s->clip.get() : nullptr;
+}
+
+const ClipTransform* ClipPlayer::transform(int id) const {
+  auto* s = slot(id);
+  return s ? &s->transform : nullptr;
+}
+
+bool ClipPlayer::isPlaying(int id) const {
+  auto* s = slot(id);
+  return s && s->playing;
+}
+
+void ClipPlayer::render(const TransportState& transport, MidiEventQueue& out) {
+  for (auto& s : m_slots) {
+    if (s.clip && s.playing) renderSlot(s, transport, out);
+  }
+}
+
+void ClipPlayer::releaseAll(MidiEventQueue& out) {
+  for (auto& s : m_slots) {
+    if (s.clip) {
+      releaseSlot(s, 0, out);
+      s.nextTick = -1;  // Resume with a seek when the transport restarts
+    }
+  }
+}
+
+void ClipPlayer::reset(MidiEventQueue& out) {
+  for (int id = 0; id < kMaxClips; ++id) unload(id, out);
+}
+
+ClipPlayer::Slot* ClipPlayer::slot(int id) {
+  if (id < 0 || id >= kMaxClips || !m_slots[id].clip) return nullptr;
+  return &m_slots[id];
+}
+
+const ClipPlayer::Slot* ClipPlayer::slot(int id) const {
+  if (id < 0 || id >= kMaxClips || !m_slots[id].clip) return nullptr;
+  return &m_slots[id];
+}
+
+void ClipPlayer::renderSlot(Slot& s, const TransportState& transport,
+                            MidiEventQueue& out) {
+  const auto& events = s.clip->events();
+  const int64_t length = s.clip->lengthTicks();
+  const double ticksPerBeat = MidiClip::kTicksPerBeat * s.transform.rate;
+
+  auto tickAt = [&](double beat) {
+    return static_cast<int64_t>(
+        std::floor((beat - s.anchorBeat) * ticksPerBeat));
+  };
+  auto beatAt = [&](int64_t tick) {
+    return s.anchorBeat + static_cast<double>(tick) / ticksPerBeat;
+  };
+
+  int64_t endTick = tickAt(transport.blockEndBeat());
+  if (endTick <= 0) return;  // Start point not reached yet
+  int64_t startTick = std::max<int64_t>(tickAt(transport.beat), 0);
+
+  // Continue from the previous block, or seek after a jump/loop. A clip
+  // started slightly in the past still plays from its first event.
+  bool lateStart = s.nextTick == 0 && startTick < MidiClip::kTicksPerBeat;
+  if (transport.discontinuity || s.nextTick < 0 ||
+      (!lateStart &&
+       std::llabs(startTick - s.nextTick) > kSeekToleranceTicks)) {
+    releaseSlot(s, 0, out);
+    if (!s.loop && startTick >= length) {
+      s.playing = false;
+      return;
+    }
+    s.cursor = s.clip->seek(s.loop ? startTick % length : startTick);
+  } else {
+    startTick = s.nextTick;
+  }
+  s.nextTick = endTick;
+
+  int64_t pos = startTick;
+  while (pos < endTick) {
+    int64_t base = s.loop ? pos / length * length : 0;
+    int64_t segmentEnd = std::min(endTick, base + length);
+
+    while (s.cursor < events.size() &&
+           events[s.cursor].tick < segmentEnd - base) {
+      const auto& ev = events[s.cursor++];
+      emit(s, ev, transport.sampleOffsetFor(beatAt(base + ev.tick)), out);
+    }
+
+    pos = segmentEnd;
+    if (pos == base + length) {
+      // Clip end: close anything still held, then wrap or finish
+      releaseSlot(s, transport.sampleOffsetFor(beatAt(pos)), out);
+      s.cursor = 0;
+      if (!s.loop) {
+        s.playing = false;
+        return;
+      }
+    }
+  }
+}
+
+void ClipPlayer::emit(Slot& s, const ClipEvent& ev, int32_t sampleOffset,
+                      MidiEventQueue& out) {
+  const auto& xf = s.transform;
+  auto channel = static_cast<uint8_t>(xf.channel >= 0 ? xf.channel & 0x0F
+                                                      : ev.channel());
+  size_t key = static_cast<size_t>(ev.channel()) * 128 + (ev.data1 & 0x7F);
+
+  switch (ev.type()) {
+    case 0x90: {
+      auto pitch = static_cast<uint8_t>(std::clamp(ev.data1 + xf.transpose, 0,
+                                                   127));
+      auto velocity = static_cast<uint8_t>(std::clamp(
+          static_cast<int>(std::lround(ev.data2 * xf.velocityScale)), 1, 127));
+      if (s.sounding[key] != kSilent) {
+        // Overlapping source notes: close the earlier one first
+        uint16_t prev = s.sounding[key];
+        out.enqueue(NoteOff{static_cast<uint8_t>(prev & 0xFF),
+                            static_cast<uint8_t>(prev >> 8), sampleOffset});
+        --s.soundingCount;
+      }
+      s.sounding[key] = static_cast<uint16_t>(channel << 8 | pitch);
+      ++s.soundingCount;
+      out.enqueue(NoteOn{pitch, velocity, channel, sampleOffset});
+      break;
+    }
+    case 0x80: {
+      uint16_t held = s.sounding[key];
+      if (held == kSilent) break;
+      out.enqueue(NoteOff{static_cast<uint8_t>(held & 0xFF),
+                          static_cast<uint8_t>(held >> 8), sampleOffset});
+      s.sounding[key] = kSilent;
+      --s.soundingCount;
+      break;
+    }
+    case 0xB0:
+      out.enqueue(CC{ev.data1, ev.data2, channel, sampleOffset});
+      break;
+    case 0xE0: {
+      auto value = static_cast<int16_t>((ev.data2 << 7 | ev.data1) - 8192);
+      out.enqueue(PitchBend{value, channel, sampleOffset});
+      break;
+    }
+  }
+}
+
+void ClipPlayer::releaseSlot(Slot& s, int32_t sampleOffset,
+                             MidiEventQueue& out) {
+  if (s.soundingCount == 0) return;
+  for (auto& held : s.sounding) {
+    if (held == kSilent) continue;
+    out.enqueue(NoteOff{static_cast<uint8_t>(held & 0xFF),
+                        static_cast<uint8_t>(held >> 8), sampleOffset});
+    held = kSilent;
+  }
+  s.soundingCount = 0;
+}
+
+}  // namespace FLLua
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+#include "events/event_queue.hpp"
+#include "midi_clip.hpp"
+#include "transport/transport.hpp"
+
+namespace FLLua {
+
+// Non-destructive playback transform applied while a clip renders
+struct ClipTransform {
+  int transpose = 0;
+  double velocityScale = 1.0;
+  int channel = -1;   // -1 keeps the clip's own channels
+  double rate = 1.0;  // Playback speed (2.0 = double time)
+};
+
+// Renders loaded clips natively, block by block, with sample-accurate
+// offsets. Lua only touches the player when it changes what is playing.
+class ClipPlayer {
+ public:
+  static constexpr int kMaxClips = 32;
+
+  // Returns the clip id, or -1 if all slots are in use
+  int load(std::shared_ptr<const MidiClip> clip);
+  bool unload(int id, MidiEventQueue& out);
+
+  bool play(int id, double startBeat, bool loop);
+  bool stop(int id, MidiEventQueue& out);
+  bool setTransform(int id, const ClipTransform& transform,
+                    double currentBeat);
+
+  const MidiClip* clip(int id) const;
+  const ClipTransform* transform(int id) const;
+  bool isPlaying(int id) const;
+
+  // Emit every clip event that falls inside the current block
+  void render(const TransportState& transport, MidiEventQueue& out);
+
+  // Send note-offs for every sounding clip note (transport stop, panic)
+  void releaseAll(MidiEventQueue& out);
+
+  // Release and unload everything (script swap)
+  void reset(MidiEventQueue& out);
+
+ private:
+  static constexpr uint16_t kSilent = 0xFFFF;
+
+  struct Slot {
+    std::shared_ptr<const MidiClip> clip;
+    ClipTransform transform;
+    double anchorBeat = 0.0;  // Host beat where clip tick 0 plays
+    bool playing = false;
+    bool loop = true;
+    size_t cursor = 0;      // Next event index within the clip
+    int64_t nextTick = -1;  // Unwrapped tick the next block continues from
+    int soundingCount = 0;
+    // Source (channel, pitch) -> sounding (channel << 8 | pitch)
+    std::array<uint16_t, 16 * 128> sounding;
+  };
+
+  Slot* slot(int id);
+  const Slot* slot(int id) const;
+  void renderSlot(Slot& s, const TransportState& transport,
+                  MidiEventQueue& out);
+  void emit(Slot& s, const ClipEvent& ev, int32_t sampleOffset,
+            MidiEventQueue& out);
+  void releaseSlot(Slot& s, int32_t sampleOffset, MidiEventQueue& out);
+
+  std::array<Slot, kMaxClips> m_slots;
+};
+
+}  // namespace FLLua
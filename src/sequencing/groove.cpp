@@ -0,0 +1,166 @@
+#include "groove.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "midi_clip.hpp"
+
+namespace FLLua {
+
+// Pending events a layer holds before the buffers grow
+static constexpr size_t kPendingReserve = 1024;
+
+bool GrooveSettings::movesEarlier() const {
+  if (amount <= 0.0) return timingMs > 0.0;
+  if (swing < 50.0 || timingMs > 0.0) return true;
+  return std::any_of(offsets.begin(), offsets.begin() + offsetCount,
+                     [](float offset) { return offset < 0.0f; });
+}
+
+bool extractGroove(const MidiClip& clip, GrooveSettings& out) {
+  double grid = out.grid;
+  auto slots = static_cast<int>(std::lround(clip.lengthBeats() / grid));
+  slots = std::clamp(slots, 1, GrooveSettings::kMaxSlots);
+
+  std::array<double, GrooveSettings::kMaxSlots> offsets{};
+  std::array<double, GrooveSettings::kMaxSlots> velocities{};
+  std::array<int, GrooveSettings::kMaxSlots> counts{};
+  double velocitySum = 0.0;
+  int notes = 0;
+  for (const auto& event : clip.events()) {
+    if (event.type() != 0x90 || event.data2 == 0) continue;
+    double position =
+        static_cast<double>(event.tick) / MidiClip::kTicksPerBeat / grid;
+    double nearest = std::round(position);
+    auto slot = static_cast<int>(static_cast<int64_t>(nearest) % slots);
+    offsets[slot] += position - nearest;
+    velocities[slot] += event.data2;
+    ++counts[slot];
+    velocitySum += event.data2;
+    ++notes;
+  }
+  if (notes == 0) return false;
+
+  // Velocities relative to the clip's average; empty slots stay neutral
+  double average = velocitySum / notes;
+  for (int i = 0; i < slots; ++i) {
+    out.offsets[i] = counts[i] ? static_cast<float>(offsets[i] / counts[i])
+                               : 0.0f;
+    out.velocities[i] =
+        counts[i] ? static_cast<float>(velocities[i] / counts[i] / average)
+                  : 1.0f;
+  }
+  out.offsetCount = slots;
+  out.velocityCount = slots;
+  return true;
+}
+
+GrooveProcessor::GrooveProcessor() {
+  m_pending.reserve(kPendingReserve);
+  m_due.reserve(kPendingReserve);
+}
+
+void GrooveProcessor::configure(const GrooveSettings& settings) {
+  m_settings = settings;
+  m_enabled = true;
+}
+
+void GrooveProcessor::setSeed(uint64_t seed) {
+  m_seed = seed;
+  m_rng.reseed(seed);
+}
+
+int32_t GrooveProcessor::latencySamples(double sampleRate) const {
+  if (!m_enabled) return 0;
+  return static_cast<int32_t>(m_settings.earlyMs * sampleRate / 1000.0);
+}
+
+int32_t GrooveProcessor::shiftFor(NoteOn& on, const TransportState& transport,
+                                  int32_t sampleOffset, int32_t delay) {
+  const auto& s = m_settings;
+  double samplesPerBeat = transport.samplesPerBeat();
+  double beat = transport.beat + sampleOffset / samplesPerBeat;
+
+  // Template shift of the nearest slot, in slots
+  auto slot = static_cast<int64_t>(std::floor(beat / s.grid + 0.5));
+  double slots = 0.0;
+  if (slot & 1) slots += s.swing / 50.0 - 1.0;
+  if (s.offsetCount > 0) {
+    auto index = ((slot % s.offsetCount) + s.offsetCount) % s.offsetCount;
+    slots += s.offsets[index];
+  }
+  double shift = slots * s.amount * s.grid * samplesPerBeat;
+  if (s.timingMs > 0.0) {
+    shift += m_rng.gaussian() * s.timingMs * transport.sampleRate / 1000.0;
+  }
+
+  double velocity = on.velocity;
+  if (s.velocityCount > 0) {
+    auto index =
+        ((slot % s.velocityCount) + s.velocityCount) % s.velocityCount;
+    velocity *= 1.0 + (s.velocities[index] - 1.0) * s.amount;
+  }
+  if (s.velocity > 0.0) velocity += m_rng.gaussian() * s.velocity;
+  on.velocity = static_cast<uint8_t>(std::clamp(std::lround(velocity), 1L,
+                                                127L));
+
+  // Notes cannot move earlier than the latency allows
+  return std::max(static_cast<int32_t>(std::lround(shift)), -delay);
+}
+
+void GrooveProcessor::process(const TransportState& transport, int32_t delay,
+                              MidiEventQueue& in, std::vector<MidiEvent>& out) {
+  int64_t blockStart = m_clock;
+  m_clock += transport.blockSize;
+  if (!m_enabled && delay == 0 && m_pending.empty()) return;
+
+  bool groove = m_enabled && transport.playing;
+  MidiEvent event;
+  while (in.try_dequeue(event)) {
+    int32_t offset = sampleOffsetOf(event);
+    int32_t shift = 0;
+    if (auto* on = std::get_if<NoteOn>(&event)) {
+      if (groove) shift = shiftFor(*on, transport, offset, delay);
+      m_noteShift[(on->channel & 0x0F) * 128 + (on->note & 0x7F)] = shift;
+    } else if (auto* off = std::get_if<NoteOff>(&event)) {
+      shift = m_noteShift[(off->channel & 0x0F) * 128 + (off->note & 0x7F)];
+    }
+    m_pending.push_back(
+        Delayed{blockStart + offset + delay + shift, m_order++, event});
+  }
+
+  // Move what falls inside this block out, in time order
+  m_due.clear();
+  size_t kept = 0;
+  for (auto& d : m_pending) {
+    if (d.time < m_clock) {
+      m_due.push_back(d);
+    } else {
+      m_pending[kept++] = d;
+    }
+  }
+  m_pending.erase(m_pending.begin() + kept, m_pending.end());
+  std::sort(m_due.begin(), m_due.end(),
+            [](const Delayed& a, const Delayed& b) {
+              return a.time != b.time ? a.time < b.time : a.order < b.order;
+            });
+  for (auto& d : m_due) {
+    auto offset = static_cast<int32_t>(std::max<int64_t>(
+        d.time - blockStart, 0));
+    std::visit([offset](auto& e) { e.sampleOffset = offset; }, d.event);
+    out.push_back(d.event);
+  }
+}
+
+void GrooveProcessor::flush(std::vector<MidiEvent>& out) {
+  // Pending events are kept in arrival order
+  for (auto& d : m_pending) {
+    if (auto* off = std::get_if<NoteOff>(&d.event)) {
+      off->sampleOffset = 0;
+      out.push_back(d.event);
+    }
+  }
+  m_pending.clear();
+}
+
+}  // namespace FLLua
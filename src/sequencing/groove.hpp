@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "events/event_queue.hpp"
+#include "lua/random.hpp"
+#include "transport/transport.hpp"
+
+namespace FLLua {
+
+class MidiClip;
+
+// Groove template and humanization applied to a layer's output
+struct GrooveSettings {
+  static constexpr int kMaxSlots = 32;
+
+  double grid = 0.25;   // Beats per slot
+  double swing = 50.0;  // Percent of a slot pair the first slot takes
+  double amount = 1.0;  // Scales swing, offsets and velocity tables
+  // Per-slot timing in fractions of a slot and velocity scales, cycled
+  std::array<float, kMaxSlots> offsets{};
+  int offsetCount = 0;
+  std::array<float, kMaxSlots> velocities{};
+  int velocityCount = 0;
+  double timingMs = 0.0;  // Standard deviation of random timing
+  double velocity = 0.0;  // Standard deviation of random velocity
+  // Output delay reserved so notes can move earlier, in milliseconds
+  double earlyMs = 0.0;
+
+  // Whether any setting can move a note before its position
+  bool movesEarlier() const;
+};
+
+// Average timing and velocity per slot of every note in `clip`, with as
+// many slots as the clip length holds (at most kMaxSlots). Returns false
+// when the clip has no notes.
+bool extractGroove(const MidiClip& clip, GrooveSettings& out);
+
+// Delays a layer's output by the processor latency and moves note starts by
+// the groove: swing, slot offsets and random timing, all in samples, so
+// notes can land anywhere inside a block and up to the latency early.
+// Note-offs follow their note-on so lengths are kept. Without a groove and
+// latency, events pass straight through.
+class GrooveProcessor {
+ public:
+  GrooveProcessor();
+
+  void configure(const GrooveSettings& settings);
+  void disable() { m_enabled = false; }
+  bool enabled() const { return m_enabled; }
+
+  // Humanization draws from `seed`, restarting with the transport
+  void setSeed(uint64_t seed);
+  void restart() { m_rng.reseed(m_seed); }
+
+  // Latency this layer asks the processor for
+  int32_t latencySamples(double sampleRate) const;
+
+  // Take the block's events from `in`, delay them by `delay` samples plus
+  // their groove shift, and append those due in this block to `out`
+  void process(const TransportState& transport, int32_t delay,
+               MidiEventQueue& in, std::vector<MidiEvent>& out);
+
+  // Append the pending note-offs to `out` at offset 0 and drop pending
+  // note-ons, which never sounded (script swap)
+  void flush(std::vector<MidiEvent>& out);
+
+  // Drop everything pending (transport stop, the processor releases all)
+  void clear() { m_pending.clear(); }
+
+ private:
+  struct Delayed {
+    int64_t time;    // Layer sample clock
+    uint32_t order;  // Arrival, keeps equal times in order
+    MidiEvent event;
+  };
+
+  int32_t shiftFor(NoteOn& on, const TransportState& transport,
+                   int32_t sampleOffset, int32_t delay);
+
+  GrooveSettings m_settings;
+  bool m_enabled = false;
+  uint64_t m_seed = 0;
+  Xoshiro256 m_rng;
+  int64_t m_clock = 0;  // Samples processed by this layer
+  uint32_t m_order = 0;
+  std::vector<Delayed> m_pending;
+  std::vector<Delayed> m_due;
+  // Shift of the last note-on per channel and pitch
+  std::array<int32_t, 16 * 128> m_noteShift{};
+};
+
+}  // namespace FLLua
@@ -0,0 +1,205 @@
+#include "midi_clip.hpp"
+
+#include <algorithm>
+
+namespace FLLua {
+
+namespace {
+
+class ByteReader {
+ public:
+  ByteReader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+  bool eof() const { return m_pos >= m_size; }
+  size_t remaining() const { return m_size - m_pos; }
+  size_t pos() const { return m_pos; }
+
+  bool u8(uint8_t& out) {
+    if (m_pos >= m_size) return false;
+    out = m_data[m_pos++];
+    return true;
+  }
+
+  bool u16(uint16_t& out) {
+    if (remaining() < 2) return false;
+    out = static_cast<uint16_t>(m_data[m_pos] << 8 | m_data[m_pos + 1]);
+    m_pos += 2;
+    return true;
+  }
+
+  bool u32(uint32_t& out) {
+    if (remaining() < 4) return false;
+    out = static_cast<uint32_t>(m_data[m_pos]) << 24 |
+          static_cast<uint32_t>(m_data[m_pos + 1]) << 16 |
+          static_cast<uint32_t>(m_data[m_pos + 2]) << 8 |
+          static_cast<uint32_t>(m_data[m_pos + 3]);
+    m_pos += 4;
+    return true;
+  }
+
+  // Variable-length quantity, at most four bytes
+  bool vlq(uint32_t& out) {
+    out = 0;
+    for (int i = 0; i < 4; ++i) {
+      uint8_t b;
+      if (!u8(b)) return false;
+      out = (out << 7) | (b & 0x7F);
+      if (!(b & 0x80)) return true;
+    }
+    return false;
+  }
+
+  bool skip(size_t n) {
+    if (remaining() < n) return false;
+    m_pos += n;
+    return true;
+  }
+
+ private:
+  const uint8_t* m_data;
+  size_t m_size;
+  size_t m_pos = 0;
+};
+
+bool isChunk(const uint8_t* p, const char* id) {
+  return p[0] == id[0] && p[1] == id[1] && p[2] == id[2] && p[3] == id[3];
+}
+
+}  // namespace
+
+std::string MidiClip::loadSmf(const uint8_t* data, size_t size) {
+  m_events.clear();
+  m_lengthTicks = 0;
+
+  ByteReader header(data, size);
+  uint32_t headerLength = 0;
+  uint16_t format = 0, trackCount = 0, division = 0;
+  if (size < 14 || !isChunk(data, "MThd")) return "Not a Standard MIDI File";
+  header.skip(4);
+  if (!header.u32(headerLength) || headerLength < 6 || !header.u16(format) ||
+      !header.u16(trackCount) || !header.u16(division)) {
+    return "Truncated MIDI header";
+  }
+  if (format > 1) return "MIDI format 2 files are not supported";
+  if (division == 0 || (division & 0x8000)) {
+    return "SMPTE time division is not supported";
+  }
+  header.skip(headerLength - 6);
+
+  size_t pos = 8 + headerLength;
+  int64_t endTick = 0;
+  for (uint16_t track = 0; track < trackCount && pos + 8 <= size; ++track) {
+    ByteReader chunk(data + pos, size - pos);
+    uint32_t chunkLength = 0;
+    chunk.skip(4);
+    chunk.u32(chunkLength);
+    bool isTrack = isChunk(data + pos, "MTrk");
+    pos += 8;
+    if (chunkLength > size - pos) return "Truncated MIDI track";
+    if (!isTrack) {
+      pos += chunkLength;
+      continue;
+    }
+
+    ByteReader r(data + pos, chunkLength);
+    pos += chunkLength;
+
+    int64_t tick = 0;
+    uint8_t runningStatus = 0;
+    while (!r.eof()) {
+      uint32_t delta = 0;
+      uint8_t status = 0;
+      if (!r.vlq(delta) || !r.u8(status)) return "Malformed MIDI track";
+      tick += delta;
+
+      if (status == 0xFF) {
+        uint8_t metaType = 0;
+        uint32_t length = 0;
+        if (!r.u8(metaType) || !r.vlq(length) || !r.skip(length)) {
+          return "Malformed MIDI meta event";
+        }
+        if (metaType == 0x2F) break;  // End of track
+        continue;
+      }
+      if (status == 0xF0 || status == 0xF7) {
+        uint32_t length = 0;
+        if (!r.vlq(length) || !r.skip(length)) return "Malformed SysEx";
+        continue;
+      }
+
+      uint8_t data1 = 0, data2 = 0;
+      if (status & 0x80) {
+        runningStatus = status;
+        if (!r.u8(data1)) return "Malformed MIDI event";
+      } else {
+        if (!runningStatus) return "MIDI data without status byte";
+        data1 = status;
+        status = runningStatus;
+      }
+
+      uint8_t type = status & 0xF0;
+      if (type != 0xC0 && type != 0xD0 && !r.u8(data2)) {
+        return "Malformed MIDI event";
+      }
+      if (type == 0x90 && data2 == 0) {
+        status = static_cast<uint8_t>(0x80 | (status & 0x0F));
+      }
+
+      int64_t clipTick = tick * kTicksPerBeat / division;
+      endTick = std::max(endTick, clipTick);
+      if (type == 0x80 || type == 0x90 || type == 0xB0 || type == 0xE0) {
+        m_events.push_back(ClipEvent{clipTick, status, data1, data2});
+      }
+    }
+    endTick = std::max(endTick, tick * kTicksPerBeat / division);
+  }
+
+  m_lengthTicks = endTick;
+  return {};
+}
+
+void MidiClip::addNote(double beat, uint8_t pitch, uint8_t velocity,
+                       double duration, uint8_t channel) {
+  uint8_t ch = channel & 0x0F;
+  int64_t start = beatToTick(beat);
+  int64_t end = std::max(start + 1, beatToTick(beat + duration));
+  m_events.push_back(
+      ClipEvent{start, static_cast<uint8_t>(0x90 | ch), pitch, velocity});
+  m_events.push_back(
+      ClipEvent{end, static_cast<uint8_t>(0x80 | ch), pitch, 0});
+  m_lengthTicks = std::max(m_lengthTicks, end);
+}
+
+void MidiClip::addEvent(double beat, uint8_t status, uint8_t data1,
+                        uint8_t data2) {
+  int64_t tick = beatToTick(beat);
+  m_events.push_back(ClipEvent{tick, status, data1, data2});
+  m_lengthTicks = std::max(m_lengthTicks, tick);
+}
+
+void MidiClip::finalize(double lengthBeats) {
+  // Note-offs sort before note-ons on the same tick so back-to-back notes
+  // of the same pitch do not cut each other off.
+  std::stable_sort(m_events.begin(), m_events.end(),
+                   [](const ClipEvent& a, const ClipEvent& b) {
+                     if (a.tick != b.tick) return a.tick < b.tick;
+                     return (a.type() == 0x80) > (b.type() == 0x80);
+                   });
+
+  if (lengthBeats > 0.0) {
+    m_lengthTicks = beatToTick(lengthBeats);
+  } else {
+    m_lengthTicks =
+        (m_lengthTicks + kTicksPerBeat - 1) / kTicksPerBeat * kTicksPerBeat;
+  }
+  if (m_lengthTicks <= 0) m_lengthTicks = kTicksPerBeat;
+}
+
+size_t MidiClip::seek(int64_t tick) const {
+  auto it = std::lower_bound(
+      m_events.begin(), m_events.end(), tick,
+      [](const ClipEvent& ev, int64_t t) { return ev.tick < t; });
+  return static_cast<size_t>(it - m_events.begin());
+}
+
+}  // namespace FLLua
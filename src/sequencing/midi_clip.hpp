@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace FLLua {
+
+// A single channel-voice event inside a clip, positioned in clip ticks
+struct ClipEvent {
+  int64_t tick = 0;
+  uint8_t status = 0;  // MIDI status byte (type | channel)
+  uint8_t data1 = 0;
+  uint8_t data2 = 0;
+
+  uint8_t type() const { return status & 0xF0; }
+  uint8_t channel() const { return status & 0x0F; }
+};
+
+// Immutable-after-load MIDI clip, indexed by tick for O(log n) seeking
+class MidiClip {
+ public:
+  static constexpr int64_t kTicksPerBeat = 960;
+
+  // Parse a Standard MIDI File (format 0 or 1). Returns error message on
+  // failure, empty on success.
+  std::string loadSmf(const uint8_t* data, size_t size);
+
+  void addNote(double beat, uint8_t pitch, uint8_t velocity, double duration,
+               uint8_t channel);
+  void addEvent(double beat, uint8_t status, uint8_t data1, uint8_t data2);
+
+  // Sort the event index and fix the clip length. A length of zero rounds
+  // the last event up to a whole beat.
+  void finalize(double lengthBeats = 0.0);
+
+  // Index of the first event at or after the given tick
+  size_t seek(int64_t tick) const;
+
+  const std::vector<ClipEvent>& events() const { return m_events; }
+  int64_t lengthTicks() const { return m_lengthTicks; }
+  double lengthBeats() const {
+    return static_cast<double>(m_lengthTicks) / kTicksPerBeat;
+  }
+
+  static int64_t beatToTick(double beat) {
+    return static_cast<int64_t>(beat * kTicksPerBeat + 0.5);
+  }
+
+ private:
+  std::vector<ClipEvent> m_events;
+  int64_t m_lengthTicks = 0;
+};
+
+}  // namespace FLLua
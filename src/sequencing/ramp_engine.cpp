@@ -0,0 +1,113 @@
+#include "ramp_engine.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace FLLua {
+
+bool RampEngine::start(uint8_t channel, uint8_t controller, double from,
+                       double to, double startBeat, double lengthBeats,
+                       RampCurve curve, double exponent) {
+  Ramp* ramp = find(channel, controller);
+  if (!ramp) {
+    auto it = std::find_if(m_ramps.begin(), m_ramps.end(),
+                           [](const Ramp& r) { return !r.active; });
+    if (it == m_ramps.end()) return false;
+    ramp = &*it;
+  }
+
+  *ramp = Ramp{};
+  ramp->active = true;
+  ramp->channel = channel;
+  ramp->controller = controller;
+  ramp->curve = curve;
+  ramp->exponent = exponent;
+  ramp->from = from;
+  ramp->to = to;
+  ramp->startBeat = startBeat;
+  ramp->lengthBeats = std::max(lengthBeats, 0.0);
+  ramp->nextBeat = startBeat;
+  return true;
+}
+
+void RampEngine::cancel(uint8_t channel, uint8_t controller) {
+  if (auto* ramp = find(channel, controller)) ramp->active = false;
+}
+
+void RampEngine::render(const TransportState& transport,
+                        MidiEventQueue& out) {
+  double blockEnd = transport.blockEndBeat();
+
+  for (auto& ramp : m_ramps) {
+    if (!ramp.active) continue;
+    double endBeat = ramp.startBeat + ramp.lengthBeats;
+
+    // After a jump the ramp's timeline no longer applies; land on target
+    if (transport.discontinuity) ramp.nextBeat = endBeat;
+
+    double beat = std::max(ramp.nextBeat, transport.beat);
+    while (beat < blockEnd) {
+      bool last = beat >= endBeat || ramp.lengthBeats <= 0.0;
+      double x = last ? 1.0 : (beat - ramp.startBeat) / ramp.lengthBeats;
+      auto value = static_cast<int32_t>(std::lround(
+          ramp.from + (ramp.to - ramp.from) * shape(ramp, x)));
+
+      // Quantized value unchanged: nothing worth sending
+      if (value != ramp.lastValue) {
+        emit(ramp, value, transport.sampleOffsetFor(beat), out);
+        ramp.lastValue = value;
+      }
+      if (last) {
+        ramp.active = false;
+        break;
+      }
+      beat = std::min(beat + m_resolution, endBeat);
+    }
+    ramp.nextBeat = beat;
+  }
+}
+
+void RampEngine::reset() {
+  for (auto& ramp : m_ramps) ramp.active = false;
+}
+
+RampEngine::Ramp* RampEngine::find(uint8_t channel, uint8_t controller) {
+  for (auto& ramp : m_ramps) {
+    if (ramp.active && ramp.channel == channel &&
+        ramp.controller == controller) {
+      return &ramp;
+    }
+  }
+  return nullptr;
+}
+
+double RampEngine::shape(const Ramp& ramp, double x) {
+  x = std::clamp(x, 0.0, 1.0);
+  switch (ramp.curve) {
+    case RampCurve::Linear:
+      return x;
+    case RampCurve::Exp:
+      return x * x;
+    case RampCurve::Log:
+      return 1.0 - (1.0 - x) * (1.0 - x);
+    case RampCurve::Smooth:
+      return x * x * (3.0 - 2.0 * x);
+    case RampCurve::Power:
+      return std::pow(x, ramp.exponent);
+  }
+  return x;
+}
+
+void RampEngine::emit(const Ramp& ramp, int32_t value, int32_t sampleOffset,
+                      MidiEventQueue& out) {
+  if (ramp.controller == kPitchBendTarget) {
+    out.enqueue(PitchBend{static_cast<int16_t>(std::clamp(value, -8192, 8191)),
+                          ramp.channel, sampleOffset, true});
+  } else {
+    out.enqueue(CC{ramp.controller,
+                   static_cast<uint8_t>(std::clamp(value, 0, 127)),
+                   ramp.channel, sampleOffset, true});
+  }
+}
+
+}  // namespace FLLua
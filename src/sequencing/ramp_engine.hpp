@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "events/event_queue.hpp"
+#include "transport/transport.hpp"
+
+namespace FLLua {
+
+enum class RampCurve : uint8_t { Linear, Exp, Log, Smooth, Power };
+
+// Renders CC and pitch-bend ramps natively at a fixed beat resolution.
+// Values are only emitted when the quantized value changes, so slow or
+// flat ramps cost almost nothing on the wire.
+class RampEngine {
+ public:
+  static constexpr int kMaxRamps = 64;
+  static constexpr uint8_t kPitchBendTarget = 255;  // Controller slot
+
+  // Start a ramp at `startBeat`. A ramp on the same channel and target
+  // replaces the running one.
+  bool start(uint8_t channel, uint8_t controller, double from, double to,
+             double startBeat, double lengthBeats, RampCurve curve,
+             double exponent = 1.0);
+
+  // Stop ramps on the target without sending anything more
+  void cancel(uint8_t channel, uint8_t controller);
+
+  void setResolution(double beats) { m_resolution = beats; }
+
+  void render(const TransportState& transport, MidiEventQueue& out);
+  void reset();
+
+ private:
+  struct Ramp {
+    bool active = false;
+    uint8_t channel = 0;
+    uint8_t controller = 0;
+    RampCurve curve = RampCurve::Linear;
+    double exponent = 1.0;
+    double from = 0.0;
+    double to = 0.0;
+    double startBeat = 0.0;
+    double lengthBeats = 0.0;
+    double nextBeat = 0.0;
+    int32_t lastValue = INT32_MIN;
+  };
+
+  Ramp* find(uint8_t channel, uint8_t controller);
+  static double shape(const Ramp& ramp, double x);
+  static void emit(const Ramp& ramp, int32_t value, int32_t sampleOffset,
+                   MidiEventQueue& out);
+
+  std::array<Ramp, kMaxRamps> m_ramps;
+  double m_resolution = 1.0 / 32.0;
+};
+
+}  // namespace FLLua
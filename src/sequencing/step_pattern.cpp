@@ -0,0 +1,226 @@
+#include "step_pattern.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace FLLua {
+
+// Guards step-grid arithmetic against floating-point drift
+static constexpr double kBeatEpsilon = 1e-9;
+
+std::vector<float> StepPattern::euclidean(int pulses, int steps) {
+  std::vector<float> hits(static_cast<size_t>(std::max(steps, 0)), 0.0f);
+  pulses = std::clamp(pulses, 0, steps);
+  int bucket = 0;
+  for (auto& hit : hits) {
+    bucket += pulses;
+    if (bucket >= steps) {
+      bucket -= steps;
+      hit = 1.0f;
+    }
+  }
+  return hits;
+}
+
+void StepPattern::rotate(std::vector<float>& hits, int amount) {
+  if (hits.empty()) return;
+  auto n = static_cast<int>(hits.size());
+  int shift = ((amount % n) + n) % n;
+  std::rotate(hits.begin(), hits.begin() + shift, hits.end());
+}
+
+PatternPlayer::PatternPlayer() {
+  for (auto& s : m_slots) s.offs.reserve(64);
+}
+
+int PatternPlayer::add(std::shared_ptr<const StepPattern> pattern) {
+  for (int id = 0; id < kMaxPatterns; ++id) {
+    auto& s = m_slots[id];
+    if (s.pattern) continue;
+    s.pattern = std::move(pattern);
+    s.pending.reset();
+    s.playing = false;
+    s.nextStep = -1;
+    s.lastStep = -1;
+    s.offs.clear();
+    return id;
+  }
+  return -1;
+}
+
+bool PatternPlayer::remove(int id, MidiEventQueue& out) {
+  auto* s = slot(id);
+  if (!s) return false;
+  releaseSlot(*s, out);
+  s->pattern.reset();
+  s->pending.reset();
+  s->playing = false;
+  return true;
+}
+
+bool PatternPlayer::play(int id, double startBeat) {
+  auto* s = slot(id);
+  if (!s) return false;
+  s->anchorBeat = startBeat;
+  s->nextStep = -1;
+  s->playing = true;
+  return true;
+}
+
+bool PatternPlayer::stop(int id, MidiEventQueue& out) {
+  auto* s = slot(id);
+  if (!s) return false;
+  releaseSlot(*s, out);
+  s->playing = false;
+  return true;
+}
+
+bool PatternPlayer::isPlaying(int id) const {
+  auto* s = slot(id);
+  return s && s->playing;
+}
+
+bool PatternPlayer::swap(int id, std::shared_ptr<const StepPattern> pattern,
+                         double fromBeat, double barBeats) {
+  auto* s = slot(id);
+  if (!s || barBeats <= 0.0) return false;
+  if (!s->playing) {
+    s->pattern = std::move(pattern);  // Nothing audible to keep in time
+    return true;
+  }
+  s->pending = std::move(pattern);
+  s->pendingBeat = std::ceil(fromBeat / barBeats - kBeatEpsilon) * barBeats;
+  return true;
+}
+
+int PatternPlayer::currentStep(int id) const {
+  auto* s = slot(id);
+  return s ? s->lastStep : -1;
+}
+
+void PatternPlayer::render(const TransportState& transport,
+                           MidiEventQueue& out) {
+  for (auto& s : m_slots) {
+    if (s.pattern && (s.playing || !s.offs.empty())) {
+      renderSlot(s, transport, out);
+    }
+  }
+}
+
+void PatternPlayer::releaseAll(MidiEventQueue& out) {
+  for (auto& s : m_slots) {
+    releaseSlot(s, out);
+    s.nextStep = -1;
+  }
+}
+
+void PatternPlayer::reset(MidiEventQueue& out) {
+  for (int id = 0; id < kMaxPatterns; ++id) remove(id, out);
+}
+
+PatternPlayer::Slot* PatternPlayer::slot(int id) {
+  if (id < 0 || id >= kMaxPatterns || !m_slots[id].pattern) return nullptr;
+  return &m_slots[id];
+}
+
+const PatternPlayer::Slot* PatternPlayer::slot(int id) const {
+  if (id < 0 || id >= kMaxPatterns || !m_slots[id].pattern) return nullptr;
+  return &m_slots[id];
+}
+
+void PatternPlayer::renderSlot(Slot& s, const TransportState& transport,
+                               MidiEventQueue& out) {
+  double blockEnd = transport.blockEndBeat();
+
+  if (transport.discontinuity) releaseSlot(s, out);
+  flushOffs(s, blockEnd, transport, out);
+  if (!s.playing) return;
+
+  // Locate the first step at or after the playhead after a jump or start
+  if (transport.discontinuity || s.nextStep < 0) {
+    double steps = (transport.beat - s.anchorBeat) / s.pattern->stepBeats;
+    s.nextStep =
+        std::max<int64_t>(0, static_cast<int64_t>(
+                                 std::ceil(steps - kBeatEpsilon)));
+  }
+
+  while (true) {
+    double stepBeat = s.anchorBeat + s.nextStep * s.pattern->stepBeats;
+
+    // Swap on the bar boundary: the new pattern restarts at step 0 there
+    if (s.pending && s.pendingBeat < blockEnd &&
+        stepBeat >= s.pendingBeat - kBeatEpsilon) {
+      s.pattern = std::move(s.pending);
+      s.anchorBeat = s.pendingBeat;
+      s.nextStep = 0;
+      stepBeat = s.anchorBeat;
+    }
+
+    if (stepBeat >= blockEnd - kBeatEpsilon) break;
+
+    size_t length = s.pattern->length();
+    if (length > 0) {
+      auto index = static_cast<size_t>(s.nextStep % length);
+      playStep(s, index, stepBeat, transport, out);
+      s.lastStep = static_cast<int>(index);
+    }
+    ++s.nextStep;
+  }
+
+  // Short gates can end inside the block their note started in
+  flushOffs(s, blockEnd, transport, out);
+}
+
+void PatternPlayer::playStep(Slot& s, size_t index, double beat,
+                             const TransportState& transport,
+                             MidiEventQueue& out) {
+  const auto& p = *s.pattern;
+  float probability = p.hits[index];
+  if (probability <= 0.0f) return;
+  if (probability < 1.0f && nextRandom() >= probability) return;
+
+  auto lane = [index](const auto& values, auto fallback) {
+    return values.empty() ? fallback : values[index % values.size()];
+  };
+  uint8_t note = lane(p.notes, uint8_t{60});
+  uint8_t velocity = lane(p.velocities, uint8_t{100});
+  float gate = lane(p.gates, 0.5f);
+
+  out.enqueue(
+      NoteOn{note, velocity, p.channel, transport.sampleOffsetFor(beat)});
+  double offBeat = beat + std::max(gate, 0.01f) * p.stepBeats;
+  s.offs.push_back(PendingOff{offBeat, note, p.channel});
+}
+
+void PatternPlayer::flushOffs(Slot& s, double beforeBeat,
+                              const TransportState& transport,
+                              MidiEventQueue& out) {
+  auto it = s.offs.begin();
+  while (it != s.offs.end()) {
+    if (it->beat < beforeBeat) {
+      out.enqueue(NoteOff{it->note, it->channel,
+                          transport.sampleOffsetFor(it->beat)});
+      it = s.offs.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void PatternPlayer::releaseSlot(Slot& s, MidiEventQueue& out) {
+  for (const auto& off : s.offs) {
+    out.enqueue(NoteOff{off.note, off.channel, 0});
+  }
+  s.offs.clear();
+}
+
+float PatternPlayer::nextRandom() {
+  // xorshift64*
+  m_rngState ^= m_rngState >> 12;
+  m_rngState ^= m_rngState << 25;
+  m_rngState ^= m_rngState >> 27;
+  uint64_t r = m_rngState * 0x2545F4914F6CDD1Dull;
+  return static_cast<float>(r >> 40) / static_cast<float>(1ull << 24);
+}
+
+}  // namespace FLLua
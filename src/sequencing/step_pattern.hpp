@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "events/event_queue.hpp"
+#include "transport/transport.hpp"
+
+namespace FLLua {
+
+// Immutable step-sequencer pattern. Per-step lanes shorter than the step
+// count cycle, so `notes = {36}` plays the same pitch on every hit.
+struct StepPattern {
+  std::vector<float> hits;  // Per-step trigger probability (0 = rest)
+  std::vector<uint8_t> notes;
+  std::vector<uint8_t> velocities;
+  std::vector<float> gates;  // Note length as a fraction of the step
+  double stepBeats = 0.25;   // Step length in quarter notes (1/16 = 0.25)
+  uint8_t channel = 0;
+
+  size_t length() const { return hits.size(); }
+
+  // Distribute `pulses` hits as evenly as possible over `steps` steps
+  static std::vector<float> euclidean(int pulses, int steps);
+  // Rotate the hit lane so step `amount` becomes step 0
+  static void rotate(std::vector<float>& hits, int amount);
+};
+
+// Plays step patterns natively with sample-accurate timing. Scripts create
+// and swap patterns; steady playback never calls into Lua.
+class PatternPlayer {
+ public:
+  static constexpr int kMaxPatterns = 16;
+
+  PatternPlayer();
+
+  // Returns the pattern id, or -1 if all slots are in use
+  int add(std::shared_ptr<const StepPattern> pattern);
+  bool remove(int id, MidiEventQueue& out);
+
+  // Start with step 0 at `startBeat`
+  bool play(int id, double startBeat);
+  bool stop(int id, MidiEventQueue& out);
+  bool isPlaying(int id) const;
+
+  // Replace the pattern at the next bar boundary after `fromBeat`
+  bool swap(int id, std::shared_ptr<const StepPattern> pattern,
+            double fromBeat, double barBeats);
+
+  // Step index last played, -1 before the first step
+  int currentStep(int id) const;
+
+  void render(const TransportState& transport, MidiEventQueue& out);
+  void releaseAll(MidiEventQueue& out);
+  void reset(MidiEventQueue& out);
+
+  void seed(uint64_t seed) { m_rngState = seed ? seed : 1; }
+
+ private:
+  struct PendingOff {
+    double beat;
+    uint8_t note;
+    uint8_t channel;
+  };
+
+  struct Slot {
+    std::shared_ptr<const StepPattern> pattern;
+    std::shared_ptr<const StepPattern> pending;
+    double pendingBeat = 0.0;
+    double anchorBeat = 0.0;  // Beat of step 0
+    int64_t nextStep = -1;    // -1 = locate from the playhead
+    int lastStep = -1;
+    bool playing = false;
+    std::vector<PendingOff> offs;
+  };
+
+  Slot* slot(int id);
+  const Slot* slot(int id) const;
+  void renderSlot(Slot& s, const TransportState& transport,
+                  MidiEventQueue& out);
+  void playStep(Slot& s, size_t index, double beat,
+                const TransportState& transport, MidiEventQueue& out);
+  void flushOffs(Slot& s, double beforeBeat, const TransportState& transport,
+                 MidiEventQueue& out);
+  void releaseSlot(Slot& s, MidiEventQueue& out);
+  float nextRandom();
+
+  std::array<Slot, kMaxPatterns> m_slots;
+  uint64_t m_rngState = 0x9E3779B97F4A7C15ull;
+};
+
+}  // namespace FLLua
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 
 namespace FLLua {
@@ -10,9 +11,11 @@ struct TransportState {
   double tempo = 120.0;  // BPM
   bool playing = false;  // Transport is running
   double sampleRate = 44100.0;
-  int timeSigNum = 4;    // Time signature numerator
-  int timeSigDen = 4;    // Time signature denominator
-  int lastBeatInt = -1;  // For detecting beat boundaries
+  int timeSigNum = 4;          // Time signature numerator
+  int timeSigDen = 4;          // Time signature denominator
+  int lastBeatInt = -1;        // For detecting beat boundaries
+  int blockSize = 0;           // Samples in the current process block
+  bool discontinuity = false;  // Playhead jumped, looped or just started
 
   bool isBeatBoundary() const {
     int currentBeatInt = static_cast<int>(beat);
@@ -20,6 +23,25 @@ struct TransportState {
   }
 
   int currentBeatInt() const { return static_cast<int>(beat); }
+
+  double samplesPerBeat() const { return sampleRate * 60.0 / tempo; }
+
+  // Bar length in quarter notes
+  double barBeats() const {
+    if (timeSigNum <= 0 || timeSigDen <= 0) return 4.0;
+    return timeSigNum * 4.0 / timeSigDen;
+  }
+
+  // Beat position at the end of the current block (exclusive)
+  double blockEndBeat() const { return beat + blockSize / samplesPerBeat(); }
+
+  // Sample offset of a beat position within the current block, clamped to
+  // the block so late events play immediately.
+  int32_t sampleOffsetFor(double atBeat) const {
+    if (blockSize <= 0) return 0;
+    auto offset = static_cast<int32_t>((atBeat - beat) * samplesPerBeat());
+    return std::clamp(offset, 0, blockSize - 1);
+  }
 };
 
 }  // namespace FLLua